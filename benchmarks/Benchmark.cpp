@@ -0,0 +1,62 @@
+#include "Benchmark.h"
+#include <fmt/format.h>
+#include <string>
+#include <vector>
+
+using namespace bench;
+
+namespace {
+
+struct RegisteredBenchmark {
+    std::string name;
+    BenchmarkFunction function;
+};
+
+auto registry() -> std::vector<RegisteredBenchmark>& {
+    static std::vector<RegisteredBenchmark> benchmarks;
+    return benchmarks;
+}
+
+constexpr auto MIN_RUN_TIME = std::chrono::milliseconds(200);
+constexpr uint64_t MAX_ITERATIONS = uint64_t{1} << 32;
+
+auto run_benchmark(const RegisteredBenchmark& benchmark) -> void {
+    uint64_t iterations = 1;
+    while (true) {
+        State state(iterations);
+        benchmark.function(state);
+        if (state.elapsed() >= MIN_RUN_TIME || iterations >= MAX_ITERATIONS) {
+            auto ns_per_iteration = static_cast<double>(state.elapsed().count()) / static_cast<double>(iterations);
+            if (state.bytes_per_iteration() > 0) {
+                auto gb_per_second = static_cast<double>(state.bytes_per_iteration()) / ns_per_iteration;
+                fmt::print("{:<48} {:>14.1f} ns/op {:>12} ops {:>10.2f} GB/s\n",
+                           benchmark.name,
+                           ns_per_iteration,
+                           iterations,
+                           gb_per_second);
+            } else {
+                fmt::print("{:<48} {:>14.1f} ns/op {:>12} ops\n", benchmark.name, ns_per_iteration, iterations);
+            }
+            return;
+        }
+        iterations *= 4;
+    }
+}
+
+} // namespace
+
+auto bench::register_benchmark(std::string_view name, BenchmarkFunction function) -> bool {
+    registry().push_back({std::string(name), std::move(function)});
+    return true;
+}
+
+// Usage: web-socket-top-server_benchmark [name filter]
+auto main(int argc, char** argv) -> int {
+    std::string_view filter = argc > 1 ? argv[1] : "";
+    for (const auto& benchmark : registry()) {
+        if (benchmark.name.find(filter) != std::string::npos) {
+            run_benchmark(benchmark);
+        }
+    }
+    return 0;
+}
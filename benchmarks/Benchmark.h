@@ -0,0 +1,70 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string_view>
+
+namespace bench {
+
+// State is handed to every benchmark function. The function runs its timed
+// loop with `while (state.keep_running()) { ... }`; the runner keeps growing
+// the iteration count until a run takes long enough to be measured reliably.
+class State final {
+public:
+    explicit State(uint64_t iterations) :
+        iterations_(iterations) {}
+
+    [[nodiscard]] auto keep_running() -> bool {
+        if (remaining_ == iterations_) {
+            start_ = std::chrono::steady_clock::now();
+        }
+        if (remaining_ == 0) {
+            stop_ = std::chrono::steady_clock::now();
+            return false;
+        }
+        --remaining_;
+        return true;
+    }
+
+    // Bytes processed by a single iteration; reported as throughput.
+    auto set_bytes_per_iteration(size_t bytes) -> void { bytes_per_iteration_ = bytes; }
+
+    [[nodiscard]] auto iterations() const -> uint64_t { return iterations_; }
+    [[nodiscard]] auto bytes_per_iteration() const -> size_t { return bytes_per_iteration_; }
+    [[nodiscard]] auto elapsed() const -> std::chrono::nanoseconds { return stop_ - start_; }
+
+private:
+    uint64_t iterations_;
+    uint64_t remaining_{iterations_};
+    size_t bytes_per_iteration_{0};
+    std::chrono::steady_clock::time_point start_{};
+    std::chrono::steady_clock::time_point stop_{};
+};
+
+using BenchmarkFunction = std::function<void(State&)>;
+
+auto register_benchmark(std::string_view name, BenchmarkFunction function) -> bool;
+
+// Keeps the compiler from optimizing away a computed value.
+template <typename T>
+inline auto do_not_optimize(T const& value) -> void {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Forces all pending memory writes to be treated as observable.
+inline auto clobber_memory() -> void {
+    asm volatile("" : : : "memory");
+}
+
+} // namespace bench
+
+#define BENCHMARK_CONCAT_IMPL(a, b) a##b
+#define BENCHMARK_CONCAT(a, b) BENCHMARK_CONCAT_IMPL(a, b)
+
+// Defines and registers a benchmark function taking a bench::State&.
+#define BENCHMARK(name)                                                                                               \
+    static void name(bench::State& state);                                                                            \
+    [[maybe_unused]] static const bool BENCHMARK_CONCAT(name, _registered) = bench::register_benchmark(#name, name);  \
+    static void name(bench::State& state)
@@ -0,0 +1,40 @@
+#include "Benchmark.h"
+#include "Common/BufferPool.h"
+#include <array>
+#include <new>
+
+using namespace common;
+
+namespace {
+
+// chunks a connection takes at once, say for a burst of frames
+constexpr size_t BURST_SIZE = 16;
+
+} // namespace
+
+BENCHMARK(buffer_pool_burst) {
+    std::array<void*, BURST_SIZE> chunks{};
+    while (state.keep_running()) {
+        for (auto& chunk : chunks) {
+            chunk = buffer_pool::allocate();
+            bench::do_not_optimize(chunk);
+        }
+        for (auto* chunk : chunks) {
+            buffer_pool::release(chunk);
+        }
+    }
+}
+
+// the same with the general purpose allocator
+BENCHMARK(buffer_pool_operator_new_burst) {
+    std::array<void*, BURST_SIZE> chunks{};
+    while (state.keep_running()) {
+        for (auto& chunk : chunks) {
+            chunk = ::operator new(buffer_pool::CHUNK_SIZE);
+            bench::do_not_optimize(chunk);
+        }
+        for (auto* chunk : chunks) {
+            ::operator delete(chunk);
+        }
+    }
+}
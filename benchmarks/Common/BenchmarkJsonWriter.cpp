@@ -0,0 +1,85 @@
+#include "Benchmark.h"
+#include "Common/JsonWriter.h"
+#include <array>
+#include <fmt/format.h>
+
+using namespace common;
+
+// counters of all magnitudes, as found in snapshots
+static constexpr auto make_integers() -> std::array<uint64_t, 64> {
+    std::array<uint64_t, 64> integers{};
+    uint64_t value = 1;
+    for (auto& integer : integers) {
+        integer = value;
+        value = value * 7 + 13;
+    }
+    return integers;
+}
+
+static constexpr auto INTEGERS = make_integers();
+
+// percentages with a decimal, like CPU usage
+static constexpr std::array<double, 8> DOUBLES = {0.1, 12.5, 99.9, 3.7, 42.0, 0.0, 57.3, 100.0};
+
+BENCHMARK(json_integers_writer) {
+    fmt::memory_buffer out;
+    while (state.keep_running()) {
+        out.clear();
+        JsonWriter writer(out);
+        for (auto integer : INTEGERS) {
+            writer.number(integer);
+        }
+        bench::do_not_optimize(out.data());
+    }
+    state.set_bytes_per_iteration(out.size());
+}
+
+BENCHMARK(json_integers_fmt) {
+    fmt::memory_buffer out;
+    while (state.keep_running()) {
+        out.clear();
+        for (auto integer : INTEGERS) {
+            fmt::format_to(std::back_inserter(out), "{}", integer);
+        }
+        bench::do_not_optimize(out.data());
+    }
+    state.set_bytes_per_iteration(out.size());
+}
+
+BENCHMARK(json_doubles_writer) {
+    fmt::memory_buffer out;
+    while (state.keep_running()) {
+        out.clear();
+        JsonWriter writer(out);
+        for (auto real : DOUBLES) {
+            writer.number(real);
+        }
+        bench::do_not_optimize(out.data());
+    }
+    state.set_bytes_per_iteration(out.size());
+}
+
+BENCHMARK(json_doubles_fmt) {
+    fmt::memory_buffer out;
+    while (state.keep_running()) {
+        out.clear();
+        for (auto real : DOUBLES) {
+            fmt::format_to(std::back_inserter(out), "{}", real);
+        }
+        bench::do_not_optimize(out.data());
+    }
+    state.set_bytes_per_iteration(out.size());
+}
+
+BENCHMARK(json_strings_writer) {
+    fmt::memory_buffer out;
+    while (state.keep_running()) {
+        out.clear();
+        JsonWriter writer(out);
+        for (int i = 0; i < 16; ++i) {
+            writer.string("/usr/lib/systemd/systemd-journald");
+        }
+        bench::do_not_optimize(out.data());
+    }
+    state.set_bytes_per_iteration(out.size());
+}
@@ -0,0 +1,74 @@
+#include "Benchmark.h"
+#include "Common/Publication.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+using namespace common;
+
+namespace {
+
+struct Message {
+    uint64_t version;
+};
+
+} // namespace
+
+// what a reactor pays to pick up the latest message of a topic
+BENCHMARK(publication_load) {
+    Publication<const Message> publication(1);
+    publication.publish(std::make_shared<const Message>(Message{1}));
+    while (state.keep_running()) {
+        auto published = publication.load(0);
+        bench::do_not_optimize(published.value.get());
+    }
+}
+
+// the check preceding it, which is all a reactor pays when nothing changed
+BENCHMARK(publication_version) {
+    Publication<const Message> publication(1);
+    publication.publish(std::make_shared<const Message>(Message{1}));
+    while (state.keep_running()) {
+        bench::do_not_optimize(publication.version());
+    }
+}
+
+// the same while another thread keeps publishing
+BENCHMARK(publication_load_while_publishing) {
+    Publication<const Message> publication(1);
+    std::atomic<bool> done{false};
+    std::jthread writer([&publication, &done] {
+        for (uint64_t version = 1; !done.load(std::memory_order_relaxed); ++version) {
+            publication.publish(std::make_shared<const Message>(Message{version}));
+        }
+    });
+    while (state.keep_running()) {
+        auto published = publication.load(0);
+        bench::do_not_optimize(published.value.get());
+    }
+    done = true;
+}
+
+// the alternatives: a shared pointer behind a mutex, and the standard
+// library's atomic shared pointer, which takes a lock internally
+BENCHMARK(publication_mutex_load) {
+    std::mutex mutex;
+    std::shared_ptr<const Message> latest = std::make_shared<const Message>(Message{1});
+    while (state.keep_running()) {
+        std::shared_ptr<const Message> value;
+        {
+            std::lock_guard lock(mutex);
+            value = latest;
+        }
+        bench::do_not_optimize(value.get());
+    }
+}
+
+BENCHMARK(publication_atomic_shared_ptr_load) {
+    std::atomic<std::shared_ptr<const Message>> latest = std::make_shared<const Message>(Message{1});
+    while (state.keep_running()) {
+        auto value = latest.load(std::memory_order_acquire);
+        bench::do_not_optimize(value.get());
+    }
+}
@@ -0,0 +1,68 @@
+#include "Benchmark.h"
+#include "Common/Slab.h"
+#include <array>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+using namespace common;
+
+namespace {
+
+// about what a connection keeps inline
+struct Connection {
+    std::array<uint64_t, 48> state{};
+};
+
+constexpr size_t CONNECTION_COUNT = 100000;
+// connections closing and reconnecting per iteration
+constexpr size_t STORM_SIZE = 1000;
+
+} // namespace
+
+// a reconnect storm on a reactor holding 100k connections: a thousand of
+// them drop and come back, and every one of them is looked up once
+BENCHMARK(registry_reconnect_storm_slab) {
+    Slab<Connection> connections;
+    std::vector<uint64_t> handles;
+    for (size_t i = 0; i < CONNECTION_COUNT; ++i) {
+        handles.push_back(connections.emplace().first);
+    }
+    size_t next = 0;
+    while (state.keep_running()) {
+        for (size_t i = 0; i < STORM_SIZE; ++i) {
+            auto& handle = handles[next];
+            next = (next + 7919) % CONNECTION_COUNT;
+            connections.erase(handle);
+            handle = connections.emplace().first;
+        }
+        for (auto handle : handles) {
+            bench::do_not_optimize(connections.find(handle));
+        }
+    }
+}
+
+// the same with the hash map keyed by ever increasing tokens it replaced
+BENCHMARK(registry_reconnect_storm_unordered_map) {
+    std::unordered_map<uint64_t, Connection> connections;
+    std::vector<uint64_t> tokens;
+    uint64_t next_token = 1;
+    for (size_t i = 0; i < CONNECTION_COUNT; ++i) {
+        tokens.push_back(next_token);
+        connections.emplace(next_token++, Connection{});
+    }
+    size_t next = 0;
+    while (state.keep_running()) {
+        for (size_t i = 0; i < STORM_SIZE; ++i) {
+            auto& token = tokens[next];
+            next = (next + 7919) % CONNECTION_COUNT;
+            connections.erase(token);
+            token = next_token++;
+            connections.emplace(token, Connection{});
+        }
+        for (auto token : tokens) {
+            auto it = connections.find(token);
+            bench::do_not_optimize(it == connections.end() ? nullptr : &it->second);
+        }
+    }
+}
@@ -0,0 +1,44 @@
+#include "Benchmark.h"
+#include "Metrics/CpuShares.h"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace common::simd;
+using namespace metrics;
+using namespace metrics::cpu_shares;
+
+static auto register_cpu_shares_benchmarks() -> bool {
+    for (auto implementation : {Implementation::SCALAR, Implementation::SSE2, Implementation::AVX2}) {
+        if (!is_supported(implementation)) {
+            continue;
+        }
+        // a workstation, a large server and the largest machines around
+        for (size_t cores : {size_t{64}, size_t{256}, size_t{1024}}) {
+            auto name = std::string("cpu_shares_") + std::string(format_implementation(implementation)) +
+                        "_" + std::to_string(cores);
+            bench::register_benchmark(name, [implementation, cores](bench::State& state) {
+                // a second's worth of ticks at 100 Hz, mostly busy
+                std::vector<uint64_t> previous(cores);
+                std::vector<uint64_t> current(cores);
+                std::vector<uint64_t> previous_total(cores);
+                std::vector<uint64_t> current_total(cores);
+                for (size_t i = 0; i < cores; ++i) {
+                    previous[i] = 1000000 + i * 31;
+                    current[i] = previous[i] + i % 101;
+                    previous_total[i] = 4000000 + i * 17;
+                    current_total[i] = previous_total[i] + 100;
+                }
+                std::vector<double> shares(cores);
+                state.set_bytes_per_iteration(cores * 4 * sizeof(uint64_t));
+                while (state.keep_running()) {
+                    compute_using(implementation, current, previous, current_total, previous_total, shares);
+                    bench::do_not_optimize(shares.data());
+                }
+            });
+        }
+    }
+    return true;
+}
+
+[[maybe_unused]] static const bool cpu_shares_benchmarks_registered = register_cpu_shares_benchmarks();
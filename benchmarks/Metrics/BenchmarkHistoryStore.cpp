@@ -0,0 +1,105 @@
+#include "Benchmark.h"
+#include "Metrics/HistoryStore.h"
+#include "TemporaryDirectory.h"
+#include <array>
+#include <fmt/format.h>
+#include <string>
+
+using namespace metrics;
+using test::TemporaryDirectory;
+
+namespace {
+
+constexpr std::array<FieldDescriptor, 6> FIELDS = {{
+    field<"rx_bytes">(FieldType::UINT),
+    field<"rx_packets">(FieldType::UINT),
+    field<"rx_errors">(FieldType::UINT),
+    field<"tx_bytes">(FieldType::UINT),
+    field<"tx_packets">(FieldType::UINT),
+    field<"tx_errors">(FieldType::UINT),
+}};
+constexpr Schema SCHEMA = {Topic::NETWORK, "interface", FIELDS};
+constexpr size_t ROW_COUNT = 16;
+
+auto make_sample(uint64_t second) -> Snapshot {
+    Snapshot snapshot(SCHEMA);
+    for (size_t i = 0; i < ROW_COUNT; ++i) {
+        auto& row = snapshot.add_row(fmt::format("eth{}", i));
+        for (size_t field = 0; field < FIELDS.size(); ++field) {
+            row.values[field] = uint64_t{second * 1000 + i * 10 + field};
+        }
+    }
+    snapshot.finish(second, std::chrono::seconds(1700000000 + second));
+    return snapshot;
+}
+
+} // namespace
+
+// a sample a second for a week, every one added to all three resolutions
+BENCHMARK(history_record) {
+    HistoryStore history;
+    MUST(history.add_topic(SCHEMA, ROW_COUNT));
+    auto snapshot = make_sample(0);
+    uint64_t second = 0;
+    while (state.keep_running()) {
+        snapshot.finish(second, std::chrono::seconds(1700000000 + second));
+        history.record(snapshot);
+        ++second;
+    }
+}
+
+// backfilling a dashboard with the last 10 minutes at 1 s steps
+BENCHMARK(history_write_json) {
+    HistoryStore history;
+    MUST(history.add_topic(SCHEMA, ROW_COUNT));
+    for (uint64_t second = 0; second < HistoryStore::DEFAULT_RESOLUTIONS[0].length; ++second) {
+        history.record(make_sample(second));
+    }
+    fmt::memory_buffer out;
+    while (state.keep_running()) {
+        out.clear();
+        MUST(history.write_json(out, Topic::NETWORK, std::chrono::milliseconds(0)));
+        bench::do_not_optimize(out.data());
+    }
+    state.set_bytes_per_iteration(out.size());
+}
+
+// same as history_record, writing through to a mapped file
+BENCHMARK(history_record_mapped) {
+    TemporaryDirectory directory("history-benchmark");
+    {
+        HistoryStore history(HistoryStore::DEFAULT_RESOLUTIONS, directory.path().string());
+        MUST(history.add_topic(SCHEMA, ROW_COUNT));
+        auto snapshot = make_sample(0);
+        uint64_t second = 0;
+        while (state.keep_running()) {
+            snapshot.finish(second, std::chrono::seconds(1700000000 + second));
+            history.record(snapshot);
+            ++second;
+        }
+    }
+}
+
+// a restarted server mapping back 6 hours of history and serving them at
+// 10 s steps
+BENCHMARK(history_restart) {
+    TemporaryDirectory directory("history-benchmark");
+    {
+        HistoryStore history(HistoryStore::DEFAULT_RESOLUTIONS, directory.path().string());
+        MUST(history.add_topic(SCHEMA, ROW_COUNT));
+        auto snapshot = make_sample(0);
+        for (uint64_t second = 0; second < 6 * 3600; ++second) {
+            snapshot.finish(second, std::chrono::seconds(1700000000 + second));
+            history.record(snapshot);
+        }
+    }
+    fmt::memory_buffer out;
+    while (state.keep_running()) {
+        HistoryStore history(HistoryStore::DEFAULT_RESOLUTIONS, directory.path().string());
+        MUST(history.add_topic(SCHEMA, ROW_COUNT));
+        out.clear();
+        MUST(history.write_json(out, Topic::NETWORK, std::chrono::seconds(10)));
+        bench::do_not_optimize(out.data());
+    }
+    state.set_bytes_per_iteration(out.size());
+}
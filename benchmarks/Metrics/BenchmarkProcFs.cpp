@@ -0,0 +1,249 @@
+#include "Benchmark.h"
+#include "Metrics/CgroupCollector.h"
+#include "Metrics/CpuCollector.h"
+#include "Metrics/DiskCollector.h"
+#include "Metrics/MemoryCollector.h"
+#include "Metrics/NetworkCollector.h"
+#include "Metrics/ProcFs.h"
+#include "Metrics/ProcessCollector.h"
+#include "Metrics/ProtocolCollector.h"
+#include "Metrics/SensorCollector.h"
+#include "TemporaryDirectory.h"
+#include <filesystem>
+#include <fmt/format.h>
+#include <string>
+
+using namespace metrics;
+using test::TemporaryDirectory;
+
+// what sampling /proc/stat used to cost: open, read until EOF, close
+BENCHMARK(procfs_stat_reopened) {
+    std::string buffer;
+    while (state.keep_running()) {
+        MUST(procfs::read_file("/proc/stat", buffer));
+        bench::do_not_optimize(buffer.data());
+    }
+    state.set_bytes_per_iteration(buffer.size());
+}
+
+BENCHMARK(procfs_stat_kept_open) {
+    procfs::ProcFile file("/proc/stat");
+    size_t size = 0;
+    while (state.keep_running()) {
+        auto text = MUST(file.read());
+        size = text.size();
+        bench::do_not_optimize(text.data());
+    }
+    state.set_bytes_per_iteration(size);
+}
+
+BENCHMARK(procfs_parse_stat) {
+    std::string text;
+    MUST(procfs::read_file("/proc/stat", text));
+    state.set_bytes_per_iteration(text.size());
+    while (state.keep_running()) {
+        std::string_view remaining = text;
+        uint64_t sum = 0;
+        while (!remaining.empty()) {
+            auto line = procfs::next_line(remaining);
+            procfs::next_field(line);
+            while (!line.empty()) {
+                sum += procfs::next_uint(line);
+            }
+        }
+        bench::do_not_optimize(sum);
+    }
+}
+
+BENCHMARK(collector_cpu) {
+    CpuCollector collector(Topic::CPU);
+    while (state.keep_running()) {
+        Snapshot snapshot(collector.schema());
+        MUST(collector.collect(snapshot));
+        bench::do_not_optimize(snapshot.rows().data());
+    }
+}
+
+BENCHMARK(collector_cpu_per_core) {
+    CpuCollector collector(Topic::CPU_PER_CORE);
+    while (state.keep_running()) {
+        Snapshot snapshot(collector.schema());
+        MUST(collector.collect(snapshot));
+        bench::do_not_optimize(snapshot.rows().data());
+    }
+}
+
+// many-core hosts, from a /proc/stat of as many cores spread over two
+// NUMA nodes
+static auto register_cpu_per_core_benchmarks() -> bool {
+    for (size_t cores : {size_t{64}, size_t{256}, size_t{1024}}) {
+        bench::register_benchmark(fmt::format("collector_cpu_per_core_{}", cores), [cores](bench::State& state) {
+            TemporaryDirectory root("cpu-benchmark");
+            auto stat = fmt::format("cpu  {} 0 {} {} 0 0 0 0 0 0\n", cores * 1000, cores * 500, cores * 8000);
+            for (size_t i = 0; i < cores; ++i) {
+                stat += fmt::format("cpu{} {} 0 {} {} 0 0 0 0 0 0\n", i, 1000 + i, 500 + i, 8000 - i);
+            }
+            stat += "intr 12345\n";
+            root.write("stat", stat);
+            for (size_t node = 0; node < 2; ++node) {
+                root.write(fmt::format("node/node{}/cpulist", node),
+                           fmt::format("{}-{}\n", node * cores / 2, (node + 1) * cores / 2 - 1));
+            }
+            CpuCollector collector(Topic::CPU_PER_CORE, root.path("stat"), "/proc/loadavg", root.path("node"));
+            while (state.keep_running()) {
+                Snapshot snapshot(collector.schema());
+                MUST(collector.collect(snapshot));
+                bench::do_not_optimize(snapshot.rows().data());
+            }
+        });
+    }
+    return true;
+}
+
+[[maybe_unused]] static const bool cpu_per_core_benchmarks_registered = register_cpu_per_core_benchmarks();
+
+BENCHMARK(collector_memory) {
+    MemoryCollector collector;
+    while (state.keep_running()) {
+        Snapshot snapshot(collector.schema());
+        MUST(collector.collect(snapshot));
+        bench::do_not_optimize(snapshot.rows().data());
+    }
+}
+
+BENCHMARK(collector_network) {
+    NetworkCollector collector;
+    while (state.keep_running()) {
+        Snapshot snapshot(collector.schema());
+        MUST(collector.collect(snapshot));
+        bench::do_not_optimize(snapshot.rows().data());
+    }
+}
+
+// a host running containers, with a veth pair end per container
+BENCHMARK(collector_network_500_interfaces) {
+    TemporaryDirectory root("network-benchmark");
+    std::string dev = "Inter-|   Receive                                                |  Transmit\n"
+                      " face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop "
+                      "fifo colls carrier compressed\n";
+    for (int i = 0; i < 500; ++i) {
+        dev += fmt::format("veth{:x}: {} {} 0 0 0 0 0 0 {} {} 0 0 0 0 0 0\n",
+                           0x10000000 + i * 7919,
+                           uint64_t{1} << 33,
+                           i * 1000,
+                           uint64_t{1} << 34,
+                           i * 2000);
+    }
+    root.write("dev", dev);
+    NetworkCollector collector(root.path("dev"), root.path("net"));
+    while (state.keep_running()) {
+        Snapshot snapshot(collector.schema());
+        MUST(collector.collect(snapshot));
+        bench::do_not_optimize(snapshot.rows().data());
+    }
+}
+
+BENCHMARK(collector_disks) {
+    DiskCollector collector;
+    while (state.keep_running()) {
+        Snapshot snapshot(collector.schema());
+        MUST(collector.collect(snapshot));
+        bench::do_not_optimize(snapshot.rows().data());
+    }
+}
+
+BENCHMARK(collector_protocols) {
+    ProtocolCollector collector;
+    while (state.keep_running()) {
+        Snapshot snapshot(collector.schema());
+        MUST(collector.collect(snapshot));
+        bench::do_not_optimize(snapshot.rows().data());
+    }
+}
+
+// the live process table, scanned incrementally from the second sample on
+BENCHMARK(collector_processes) {
+    ProcessCollector collector;
+    while (state.keep_running()) {
+        Snapshot snapshot(collector.schema());
+        MUST(collector.collect(snapshot));
+        bench::do_not_optimize(snapshot.rows().data());
+    }
+}
+
+BENCHMARK(collector_processes_single_threaded) {
+    ProcessCollector collector("/proc", 0);
+    while (state.keep_running()) {
+        Snapshot snapshot(collector.schema());
+        MUST(collector.collect(snapshot));
+        bench::do_not_optimize(snapshot.rows().data());
+    }
+}
+
+// a container host: 2000 services under 20 slices, sampled after the first
+// walk of the tree with nothing changing in between
+BENCHMARK(collector_cgroups_2000) {
+    TemporaryDirectory root("cgroup-benchmark");
+    auto write_cgroup = [&root](const std::filesystem::path& directory) {
+        root.write(directory / "cgroup.events", "populated 1\nfrozen 0\n");
+        root.write(directory / "cpu.stat",
+                   "usage_usec 123456789\nuser_usec 100000000\nsystem_usec 23456789\nnr_periods 0\n"
+                   "nr_throttled 0\nthrottled_usec 0\n");
+        root.write(directory / "memory.current", "104857600\n");
+        root.write(directory / "memory.max", "max\n");
+        root.write(directory / "io.stat", "8:0 rbytes=90112 wbytes=4096 rios=3 wios=1 dbytes=0 dios=0\n");
+        root.write(directory / "pids.current", "12\n");
+        for (const auto* name : {"cpu.pressure", "memory.pressure", "io.pressure"}) {
+            root.write(directory / name,
+                       "some avg10=0.00 avg60=0.00 avg300=0.00 total=0\n"
+                       "full avg10=0.00 avg60=0.00 avg300=0.00 total=0\n");
+        }
+    };
+    root.write("cgroup.controllers", "cpu io memory pids\n");
+    write_cgroup({});
+    for (int slice = 0; slice < 20; ++slice) {
+        auto slice_directory = std::filesystem::path(fmt::format("slice-{}.slice", slice));
+        write_cgroup(slice_directory);
+        for (int service = 0; service < 100; ++service) {
+            write_cgroup(slice_directory / fmt::format("service-{}.service", service));
+        }
+    }
+    CgroupCollector collector(root.path().string());
+    Snapshot first_snapshot(collector.schema());
+    MUST(collector.collect(first_snapshot));
+    while (state.keep_running()) {
+        Snapshot snapshot(collector.schema());
+        MUST(collector.collect(snapshot));
+        bench::do_not_optimize(snapshot.rows().data());
+    }
+}
+
+// a two socket server: 256 CPUs with cpufreq, a temperature per core and
+// package, a few fans and power meters
+BENCHMARK(collector_sensors_256_cores) {
+    TemporaryDirectory root("sensor-benchmark");
+    for (int cpu = 0; cpu < 256; ++cpu) {
+        root.write(fmt::format("cpu/cpu{}/cpufreq/scaling_cur_freq", cpu), "2400000\n");
+    }
+    for (int socket = 0; socket < 2; ++socket) {
+        auto chip = std::filesystem::path("hwmon") / fmt::format("hwmon{}", socket);
+        root.write(chip / "name", "coretemp\n");
+        for (int input = 1; input <= 65; ++input) {
+            root.write(chip / fmt::format("temp{}_input", input), "45000\n");
+            root.write(chip / fmt::format("temp{}_label", input), fmt::format("Core {}\n", input - 1));
+        }
+    }
+    auto board = std::filesystem::path("hwmon/hwmon2");
+    root.write(board / "name", "nct6775\n");
+    for (int input = 1; input <= 4; ++input) {
+        root.write(board / fmt::format("fan{}_input", input), "1200\n");
+        root.write(board / fmt::format("power{}_input", input), "95000000\n");
+    }
+    root.write("thermal/thermal_zone0/temp", "40000\n");
+    SensorCollector collector(root.path("hwmon"), root.path("thermal"), root.path("cpu"));
+    while (state.keep_running()) {
+        Snapshot snapshot(collector.schema());
+        MUST(collector.collect(snapshot));
+        bench::do_not_optimize(snapshot.rows().data());
+    }
+}
@@ -0,0 +1,90 @@
+#include "Benchmark.h"
+#include "Metrics/HistoryStore.h"
+#include "Metrics/QuantileSketch.h"
+#include "Metrics/Reductions.h"
+#include <array>
+#include <fmt/format.h>
+#include <limits>
+#include <string>
+#include <vector>
+
+using namespace common::simd;
+using namespace metrics;
+using namespace metrics::reductions;
+
+// one in a hundred points missing, as after a restart or a failed sample
+static auto make_points(size_t length) -> std::vector<double> {
+    std::vector<double> points(length);
+    for (size_t i = 0; i < length; ++i) {
+        points[i] = i % 100 == 99 ? std::numeric_limits<double>::quiet_NaN() : static_cast<double>(i % 1000) / 10;
+    }
+    return points;
+}
+
+static auto register_reduction_benchmarks() -> bool {
+    for (auto implementation : {Implementation::SCALAR, Implementation::SSE2, Implementation::AVX2}) {
+        if (!is_supported(implementation)) {
+            continue;
+        }
+        // a 10 s step at 1 s resolution, the 10 minute ring and a week at
+        // 1 min resolution
+        for (size_t length : {size_t{10}, size_t{600}, size_t{10080}}) {
+            auto name = std::string("reductions_summarize_") + std::string(format_implementation(implementation)) +
+                        "_" + std::to_string(length);
+            bench::register_benchmark(name, [implementation, length](bench::State& state) {
+                auto points = make_points(length);
+                state.set_bytes_per_iteration(length * sizeof(double));
+                while (state.keep_running()) {
+                    auto summary = summarize_using(implementation, points);
+                    bench::do_not_optimize(summary);
+                }
+            });
+        }
+    }
+    return true;
+}
+
+[[maybe_unused]] static const bool reduction_benchmarks_registered = register_reduction_benchmarks();
+
+BENCHMARK(quantile_sketch_add) {
+    auto points = make_points(600);
+    QuantileSketch sketch;
+    state.set_bytes_per_iteration(points.size() * sizeof(double));
+    while (state.keep_running()) {
+        sketch.clear();
+        for (auto point : points) {
+            sketch.add(point);
+        }
+        bench::do_not_optimize(sketch.quantile(0.99));
+    }
+}
+
+namespace {
+
+constexpr std::array<FieldDescriptor, 1> PER_CORE_FIELDS = {{field<"usage">(FieldType::FLOAT)}};
+constexpr Schema PER_CORE_SCHEMA = {Topic::CPU_PER_CORE, "core", PER_CORE_FIELDS};
+constexpr size_t CORE_COUNT = 64;
+
+} // namespace
+
+// the alerting dashboard's query: per-core usage over 5 minutes in 10 s steps
+BENCHMARK(history_query_per_core) {
+    HistoryStore history;
+    MUST(history.add_topic(PER_CORE_SCHEMA, CORE_COUNT));
+    for (int64_t second = 0; second < 600; ++second) {
+        Snapshot snapshot(PER_CORE_SCHEMA);
+        for (size_t core = 0; core < CORE_COUNT; ++core) {
+            snapshot.add_row(fmt::format("cpu{}", core)).values[0] = static_cast<double>((second * 7 + core) % 100);
+        }
+        snapshot.finish(1, std::chrono::seconds(1700000000 + second));
+        history.record(snapshot);
+    }
+    fmt::memory_buffer out;
+    while (state.keep_running()) {
+        out.clear();
+        MUST(history.write_query_json(
+            out, Topic::CPU_PER_CORE, "usage", std::chrono::minutes(5), std::chrono::seconds(10)));
+        bench::do_not_optimize(out.data());
+    }
+    state.set_bytes_per_iteration(out.size());
+}
@@ -0,0 +1,114 @@
+#include "Benchmark.h"
+#include "Metrics/SnapshotBinary.h"
+#include "Metrics/SnapshotJson.h"
+#include <array>
+#include <fmt/format.h>
+#include <memory>
+#include <vector>
+
+using namespace metrics;
+
+namespace {
+
+constexpr std::array<FieldDescriptor, 4> FIELDS = {{
+    field<"name">(FieldType::TEXT),
+    field<"state">(FieldType::TEXT),
+    field<"cpu_ticks">(FieldType::UINT),
+    field<"rss">(FieldType::UINT),
+}};
+constexpr Schema SCHEMA = {Topic::PROCESSES, "pid", FIELDS};
+
+// a busy machine's process table; between two samples one in ten processes
+// used some CPU time and the odd one changed its memory
+constexpr size_t PROCESS_COUNT = 500;
+
+auto make_processes(uint64_t version) -> std::unique_ptr<Snapshot> {
+    auto snapshot = std::make_unique<Snapshot>(SCHEMA);
+    for (size_t pid = 1; pid <= PROCESS_COUNT; ++pid) {
+        auto& row = snapshot->add_row(fmt::format("{}", pid));
+        row.values[0] = fmt::format("process-{}", pid);
+        row.values[1] = std::string(pid % 50 == 0 ? "R" : "S");
+        row.values[2] = uint64_t{pid * 1000 + (pid % 10 == 0 ? version * 3 : 0)};
+        row.values[3] = uint64_t{pid * 4096 * 100 + (pid % 97 == 0 ? version * 4096 : 0)};
+    }
+    snapshot->finish(version, std::chrono::milliseconds(1700000000000 + version * 1000));
+    return snapshot;
+}
+
+} // namespace
+
+BENCHMARK(snapshot_encode_json_keyframe) {
+    auto snapshot = make_processes(1);
+    fmt::memory_buffer out;
+    json::write_keyframe(out, *snapshot);
+    state.set_bytes_per_iteration(out.size());
+    while (state.keep_running()) {
+        out.clear();
+        json::write_keyframe(out, *snapshot);
+        bench::do_not_optimize(out.data());
+    }
+}
+
+BENCHMARK(snapshot_encode_json_delta) {
+    auto base = make_processes(1);
+    auto snapshot = make_processes(2);
+    fmt::memory_buffer out;
+    json::write_delta(out, *base, *snapshot);
+    state.set_bytes_per_iteration(out.size());
+    while (state.keep_running()) {
+        out.clear();
+        json::write_delta(out, *base, *snapshot);
+        bench::do_not_optimize(out.data());
+    }
+}
+
+BENCHMARK(snapshot_encode_binary_keyframe) {
+    auto snapshot = make_processes(1);
+    std::vector<uint8_t> out;
+    binary::write_keyframe(out, *snapshot);
+    state.set_bytes_per_iteration(out.size());
+    while (state.keep_running()) {
+        out.clear();
+        binary::write_keyframe(out, *snapshot);
+        bench::do_not_optimize(out.data());
+    }
+}
+
+BENCHMARK(snapshot_encode_binary_delta) {
+    auto base = make_processes(1);
+    auto snapshot = make_processes(2);
+    std::vector<uint8_t> out;
+    binary::write_delta(out, *base, *snapshot);
+    state.set_bytes_per_iteration(out.size());
+    while (state.keep_running()) {
+        out.clear();
+        binary::write_delta(out, *base, *snapshot);
+        bench::do_not_optimize(out.data());
+    }
+}
+
+BENCHMARK(snapshot_decode_binary_keyframe) {
+    std::vector<uint8_t> message;
+    binary::write_keyframe(message, *make_processes(1));
+    state.set_bytes_per_iteration(message.size());
+    binary::Decoder decoder;
+    while (state.keep_running()) {
+        bench::do_not_optimize(MUST(decoder.decode(message)));
+    }
+}
+
+BENCHMARK(snapshot_decode_binary_delta) {
+    auto base = make_processes(1);
+    std::vector<uint8_t> keyframe;
+    binary::write_keyframe(keyframe, *base);
+    std::vector<uint8_t> message;
+    binary::write_delta(message, *base, *make_processes(2));
+    state.set_bytes_per_iteration(message.size());
+    binary::Decoder decoder;
+    MUST(decoder.decode(keyframe));
+    // includes copying the base table, as every consumer applying a delta
+    // while keeping the acknowledged version has to
+    while (state.keep_running()) {
+        bench::do_not_optimize(MUST(decoder.decode(message)));
+    }
+}
@@ -0,0 +1,67 @@
+#include "Benchmark.h"
+#include "WebSocket/Handshake.h"
+#include "WebSocket/HttpRequestParser.h"
+#include <array>
+
+using namespace ws;
+
+// a typical browser upgrade request
+static constexpr std::string_view UPGRADE_REQUEST =
+    "GET /ws HTTP/1.1\r\n"
+    "Host: monitoring.example.com:8080\r\n"
+    "Connection: Upgrade\r\n"
+    "Pragma: no-cache\r\n"
+    "Cache-Control: no-cache\r\n"
+    "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) Chrome/120.0 Safari/537.36\r\n"
+    "Upgrade: websocket\r\n"
+    "Origin: https://monitoring.example.com\r\n"
+    "Sec-WebSocket-Version: 13\r\n"
+    "Accept-Encoding: gzip, deflate, br\r\n"
+    "Accept-Language: en-US,en;q=0.9\r\n"
+    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+    "Sec-WebSocket-Extensions: permessage-deflate; client_max_window_bits\r\n"
+    "\r\n";
+
+BENCHMARK(handshake_parse_request) {
+    state.set_bytes_per_iteration(UPGRADE_REQUEST.size());
+    HttpRequestParser parser;
+    while (state.keep_running()) {
+        parser.reset();
+        bench::do_not_optimize(parser.parse(UPGRADE_REQUEST));
+    }
+}
+
+BENCHMARK(handshake_parse_request_split_in_8) {
+    // the request trickling in over eight reads
+    state.set_bytes_per_iteration(UPGRADE_REQUEST.size());
+    const size_t step = UPGRADE_REQUEST.size() / 8 + 1;
+    HttpRequestParser parser;
+    while (state.keep_running()) {
+        parser.reset();
+        for (size_t length = step; length < UPGRADE_REQUEST.size(); length += step) {
+            bench::do_not_optimize(parser.parse(UPGRADE_REQUEST.substr(0, length)));
+        }
+        bench::do_not_optimize(parser.parse(UPGRADE_REQUEST));
+    }
+}
+
+BENCHMARK(handshake_compute_accept_key) {
+    while (state.keep_running()) {
+        bench::do_not_optimize(handshake::compute_accept_key("dGhlIHNhbXBsZSBub25jZQ=="));
+    }
+}
+
+BENCHMARK(handshake_full) {
+    // everything the server does for one upgrade request
+    state.set_bytes_per_iteration(UPGRADE_REQUEST.size());
+    HttpRequestParser parser;
+    std::array<char, handshake::MAX_RESPONSE_SIZE> response;
+    while (state.keep_running()) {
+        parser.reset();
+        parser.parse(UPGRADE_REQUEST);
+        auto client_key = handshake::validate_upgrade_request(parser);
+        auto length = handshake::write_accept_response(handshake::compute_accept_key(client_key.value()), response);
+        bench::do_not_optimize(length);
+        bench::clobber_memory();
+    }
+}
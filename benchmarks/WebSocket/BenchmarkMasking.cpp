@@ -0,0 +1,36 @@
+#include "Benchmark.h"
+#include "WebSocket/Masking.h"
+#include <string>
+#include <vector>
+
+using namespace common::simd;
+using namespace ws::masking;
+
+static constexpr MaskKey KEY = {0x37, 0xFA, 0x21, 0x3D};
+
+static auto register_masking_benchmarks() -> bool {
+    for (auto implementation : {Implementation::SCALAR, Implementation::SSE2, Implementation::AVX2}) {
+        if (!is_supported(implementation)) {
+            continue;
+        }
+        // small control messages, typical subscription commands and large
+        // payloads; the odd sizes exercise unaligned heads and tails
+        for (size_t size : {size_t{61}, size_t{1021}, size_t{16 * 1024}, size_t{1024 * 1024}}) {
+            auto name = std::string("masking_") + std::string(format_implementation(implementation)) + "_" +
+                        std::to_string(size);
+            bench::register_benchmark(name, [implementation, size](bench::State& state) {
+                // offset by one byte so the payload is not vector aligned
+                std::vector<uint8_t> buffer(size + 1, 0x5A);
+                auto payload = std::span<uint8_t>(buffer.data() + 1, size);
+                state.set_bytes_per_iteration(size);
+                while (state.keep_running()) {
+                    apply_mask_using(implementation, payload, payload, KEY);
+                    bench::clobber_memory();
+                }
+            });
+        }
+    }
+    return true;
+}
+
+[[maybe_unused]] static const bool masking_benchmarks_registered = register_masking_benchmarks();
@@ -0,0 +1,85 @@
+#include "Base64.h"
+#include <array>
+
+using namespace common;
+
+static constexpr std::string_view ALPHABET = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static constexpr auto make_decode_table() -> std::array<int8_t, 256> {
+    std::array<int8_t, 256> table{};
+    for (auto& value : table) {
+        value = -1;
+    }
+    for (size_t i = 0; i < ALPHABET.size(); ++i) {
+        table[static_cast<uint8_t>(ALPHABET[i])] = static_cast<int8_t>(i);
+    }
+    return table;
+}
+
+static constexpr auto DECODE_TABLE = make_decode_table();
+
+auto base64::encode(std::span<const uint8_t> input, std::span<char> output) -> size_t {
+    auto* out = output.data();
+    size_t i = 0;
+    for (; i + 3 <= input.size(); i += 3) {
+        uint32_t triple = (input[i] << 16) | (input[i + 1] << 8) | input[i + 2];
+        *out++ = ALPHABET[(triple >> 18) & 0x3F];
+        *out++ = ALPHABET[(triple >> 12) & 0x3F];
+        *out++ = ALPHABET[(triple >> 6) & 0x3F];
+        *out++ = ALPHABET[triple & 0x3F];
+    }
+
+    auto remaining = input.size() - i;
+    if (remaining > 0) {
+        uint32_t triple = input[i] << 16;
+        if (remaining == 2) {
+            triple |= input[i + 1] << 8;
+        }
+        *out++ = ALPHABET[(triple >> 18) & 0x3F];
+        *out++ = ALPHABET[(triple >> 12) & 0x3F];
+        *out++ = remaining == 2 ? ALPHABET[(triple >> 6) & 0x3F] : '=';
+        *out++ = '=';
+    }
+    return static_cast<size_t>(out - output.data());
+}
+
+auto base64::decode(std::string_view input, std::span<uint8_t> output) -> std::optional<size_t> {
+    if (input.size() % 4 != 0) {
+        return {};
+    }
+
+    size_t padding = 0;
+    if (!input.empty() && input.back() == '=') {
+        ++padding;
+        if (input[input.size() - 2] == '=') {
+            ++padding;
+        }
+    }
+
+    auto length = input.size() / 4 * 3 - padding;
+    if (length > output.size()) {
+        return {};
+    }
+
+    size_t written = 0;
+    for (size_t i = 0; i < input.size(); i += 4) {
+        uint32_t quad = 0;
+        for (size_t j = 0; j < 4; ++j) {
+            auto c = static_cast<uint8_t>(input[i + j]);
+            int8_t value = 0;
+            if (c == '=' && i + j >= input.size() - padding) {
+                value = 0;
+            } else {
+                value = DECODE_TABLE[c];
+                if (value < 0) {
+                    return {};
+                }
+            }
+            quad = (quad << 6) | static_cast<uint32_t>(value);
+        }
+        for (size_t j = 0; j < 3 && written < length; ++j) {
+            output[written++] = static_cast<uint8_t>(quad >> (16 - j * 8));
+        }
+    }
+    return written;
+}
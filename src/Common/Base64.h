@@ -0,0 +1,26 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace common::base64 {
+
+// Returns the length of the padded base64 encoding of given number of bytes.
+constexpr auto encoded_length(size_t length) -> size_t {
+    return (length + 2) / 3 * 4;
+}
+
+// Encodes given bytes as padded base64 (RFC 4648) into the output buffer
+// which must hold at least encoded_length(input.size()) characters. Returns
+// the number of characters written.
+auto encode(std::span<const uint8_t> input, std::span<char> output) -> size_t;
+
+// Decodes padded base64 into the output buffer. Returns the number of bytes
+// written or an empty optional when the input is not valid base64 or doesn't
+// fit into the output buffer.
+auto decode(std::string_view input, std::span<uint8_t> output) -> std::optional<size_t>;
+
+} // namespace common::base64
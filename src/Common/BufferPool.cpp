@@ -0,0 +1,213 @@
+#include "BufferPool.h"
+#include "Assertions.h"
+#include "Logging.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <cerrno>
+#include <mutex>
+#include <new>
+#include <sys/mman.h>
+#include <vector>
+
+using namespace common;
+using namespace common::buffer_pool;
+
+namespace {
+
+// a thread keeps up to this many free chunks and moves half of that to or
+// from the shared free list at once
+constexpr size_t CACHE_CAPACITY = 64;
+constexpr size_t TRANSFER_BATCH = CACHE_CAPACITY / 2;
+
+struct SharedPool {
+    std::mutex mutex;
+    std::vector<void*> free_chunks;
+    Statistics statistics;
+    std::atomic<bool> huge_pages{false};
+    std::atomic<bool> warned_about_huge_pages{false};
+};
+
+// never destroyed, since threads exiting after static destruction began may
+// still hand their cached chunks back
+auto shared_pool() -> SharedPool& {
+    static auto* pool = new SharedPool;
+    return *pool;
+}
+
+struct ThreadCache {
+    std::array<void*, CACHE_CAPACITY> chunks{};
+    size_t count{0};
+
+    ThreadCache() = default;
+    ThreadCache(const ThreadCache&) = delete;
+    ThreadCache(ThreadCache&&) noexcept = delete;
+    ~ThreadCache() noexcept;
+
+    auto operator=(const ThreadCache&) -> ThreadCache& = delete;
+    auto operator=(ThreadCache&&) noexcept -> ThreadCache& = delete;
+};
+
+thread_local ThreadCache thread_cache;
+// thread locals destroyed after the cache take and release their chunks
+// straight from and to the shared free list
+thread_local bool thread_cache_destroyed = false;
+
+ThreadCache::~ThreadCache() noexcept {
+    thread_cache_destroyed = true;
+    auto& pool = shared_pool();
+    std::lock_guard lock(pool.mutex);
+    pool.free_chunks.insert(pool.free_chunks.end(), chunks.begin(), chunks.begin() + static_cast<ptrdiff_t>(count));
+    count = 0;
+}
+
+struct Region {
+    std::span<uint8_t> bytes;
+    bool huge_pages;
+};
+
+auto round_up(size_t size, size_t multiple) -> size_t {
+    return (size + multiple - 1) / multiple * multiple;
+}
+
+// Maps size bytes, a multiple of ARENA_SIZE, aligned to ARENA_SIZE so that
+// transparent huge pages can back all of it.
+auto map_aligned(size_t size) -> ErrorOr<Region> {
+    VERIFY(size > 0 && size % ARENA_SIZE == 0);
+    auto& pool = shared_pool();
+    const bool huge_pages = pool.huge_pages.load(std::memory_order_relaxed);
+    if (huge_pages) {
+        auto* memory =
+            ::mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (memory != MAP_FAILED) {
+            return Region{{static_cast<uint8_t*>(memory), size}, true};
+        }
+        if (!pool.warned_about_huge_pages.exchange(true)) {
+            LOG_WARN("No huge pages reserved ({}), falling back to transparent huge pages",
+                     Error::from_errno(errno, "mmap(MAP_HUGETLB)", ErrorDomain::CORE).error_message());
+        }
+    }
+
+    // map one arena more than asked for and trim it down to an aligned range
+    auto* memory = ::mmap(nullptr, size + ARENA_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+        return {Error::from_errno(errno, "mmap()", ErrorDomain::CORE)};
+    }
+    auto address = reinterpret_cast<uintptr_t>(memory);
+    auto aligned = round_up(address, ARENA_SIZE);
+    if (aligned > address) {
+        ::munmap(memory, aligned - address);
+    }
+    ::munmap(reinterpret_cast<void*>(aligned + size), address + ARENA_SIZE - aligned);
+    auto* bytes = reinterpret_cast<uint8_t*>(aligned);
+    if (huge_pages) {
+        // only a hint; the kernel may not have transparent huge pages enabled
+        ::madvise(bytes, size, MADV_HUGEPAGE);
+    }
+    return Region{{bytes, size}, false};
+}
+
+// Maps another arena and puts its chunks on the shared free list. Called
+// with the pool locked.
+auto add_arena(SharedPool& pool) -> void {
+    auto error_or_arena = map_aligned(ARENA_SIZE);
+    if (error_or_arena.is_error()) {
+        LOG_ERROR("Mapping a buffer arena failed: {}", error_or_arena.error().error_message());
+        throw std::bad_alloc();
+    }
+    auto arena = error_or_arena.value();
+    ++pool.statistics.arenas;
+    pool.statistics.huge_page_arenas += arena.huge_pages ? 1 : 0;
+    pool.statistics.chunks += ARENA_SIZE / CHUNK_SIZE;
+    // room for every chunk there is, so handing chunks back never allocates
+    pool.free_chunks.reserve(pool.statistics.chunks);
+    // lowest addresses last, so they are handed out first
+    for (auto offset = ARENA_SIZE; offset > 0; offset -= CHUNK_SIZE) {
+        pool.free_chunks.push_back(arena.bytes.data() + offset - CHUNK_SIZE);
+    }
+}
+
+// Takes a batch of chunks off the shared free list, mapping another arena
+// when it is empty. Called with the pool locked.
+auto refill(SharedPool& pool, ThreadCache& cache) -> void {
+    if (pool.free_chunks.empty()) {
+        add_arena(pool);
+    }
+    while (cache.count < TRANSFER_BATCH && !pool.free_chunks.empty()) {
+        cache.chunks[cache.count++] = pool.free_chunks.back();
+        pool.free_chunks.pop_back();
+    }
+}
+
+} // namespace
+
+auto buffer_pool::configure(const Settings& settings) -> void {
+    shared_pool().huge_pages.store(settings.huge_pages, std::memory_order_relaxed);
+}
+
+auto buffer_pool::statistics() -> Statistics {
+    auto& pool = shared_pool();
+    std::lock_guard lock(pool.mutex);
+    auto statistics = pool.statistics;
+    statistics.free_chunks = pool.free_chunks.size();
+    return statistics;
+}
+
+auto buffer_pool::thread_cached_chunks() -> size_t {
+    return thread_cache_destroyed ? 0 : thread_cache.count;
+}
+
+auto buffer_pool::allocate() -> void* {
+    if (thread_cache_destroyed) {
+        // as in release(), thread locals destroyed after the cache take
+        // their chunks straight from the shared free list
+        auto& pool = shared_pool();
+        std::lock_guard lock(pool.mutex);
+        if (pool.free_chunks.empty()) {
+            add_arena(pool);
+        }
+        auto* chunk = pool.free_chunks.back();
+        pool.free_chunks.pop_back();
+        return chunk;
+    }
+    auto& cache = thread_cache;
+    if (cache.count == 0) {
+        auto& pool = shared_pool();
+        std::lock_guard lock(pool.mutex);
+        refill(pool, cache);
+    }
+    return cache.chunks[--cache.count];
+}
+
+// The shared free list has room reserved for every chunk, so handing chunks
+// back never allocates and never throws.
+auto buffer_pool::release(void* chunk) noexcept -> void {
+    VERIFY(reinterpret_cast<uintptr_t>(chunk) % CHUNK_SIZE == 0);
+    if (thread_cache_destroyed) {
+        auto& pool = shared_pool();
+        std::lock_guard lock(pool.mutex);
+        pool.free_chunks.push_back(chunk);
+        return;
+    }
+    auto& cache = thread_cache;
+    if (cache.count == CACHE_CAPACITY) {
+        // keep the chunks released last, which are the likeliest in cache
+        auto& pool = shared_pool();
+        std::lock_guard lock(pool.mutex);
+        pool.free_chunks.insert(pool.free_chunks.end(), cache.chunks.begin(), cache.chunks.begin() + TRANSFER_BATCH);
+        std::copy(cache.chunks.begin() + TRANSFER_BATCH, cache.chunks.end(), cache.chunks.begin());
+        cache.count -= TRANSFER_BATCH;
+    }
+    cache.chunks[cache.count++] = chunk;
+}
+
+auto buffer_pool::map_region(size_t size) -> ErrorOr<std::span<uint8_t>> {
+    auto region = TRY(map_aligned(round_up(size, ARENA_SIZE)));
+    return {region.bytes.first(size)};
+}
+
+auto buffer_pool::unmap_region(std::span<uint8_t> region) noexcept -> void {
+    if (!region.empty()) {
+        ::munmap(region.data(), round_up(region.size(), ARENA_SIZE));
+    }
+}
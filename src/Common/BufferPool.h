@@ -0,0 +1,105 @@
+#pragma once
+
+#include "Error.h"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <utility>
+
+// The buffer pool hands out the fixed-size chunks connections receive and
+// send bytes in. Chunks are carved from arenas of ARENA_SIZE bytes which are
+// mapped as needed and kept for the life of the process, backed by huge pages
+// when configured to be, so the memory behind thousands of connections sits
+// in a few TLB entries.
+//
+// Every thread keeps a small cache of free chunks; taking a chunk and handing
+// it back, which connections do for every message, costs neither a lock nor
+// a system call. A cache exchanges chunks with the shared free list in
+// batches once it runs empty or full. Chunks may be handed back on any
+// thread, not just the one that took them.
+namespace common::buffer_pool {
+
+constexpr size_t CHUNK_SIZE = 4096;
+// a huge page on x86-64 and arm64 with 4 KiB pages
+constexpr size_t ARENA_SIZE = 2 * 1024 * 1024;
+
+struct Settings {
+    // maps arenas with MAP_HUGETLB, falling back to transparent huge pages
+    // when no huge pages are reserved
+    bool huge_pages{false};
+};
+
+struct Statistics {
+    size_t arenas{0};
+    // arenas backed by reserved huge pages
+    size_t huge_page_arenas{0};
+    // chunks carved from arenas so far
+    size_t chunks{0};
+    // chunks on the shared free list, not counting those cached by threads
+    size_t free_chunks{0};
+};
+
+// Applies to arenas and regions mapped from then on; meant to be called once
+// at startup.
+auto configure(const Settings& settings) -> void;
+
+[[nodiscard]] auto statistics() -> Statistics;
+
+// Number of free chunks cached by the calling thread.
+[[nodiscard]] auto thread_cached_chunks() -> size_t;
+
+// Returns a chunk of CHUNK_SIZE bytes, aligned to CHUNK_SIZE. Throws
+// std::bad_alloc when no arena can be mapped, as operator new would.
+[[nodiscard]] auto allocate() -> void*;
+
+// Hands a chunk back to the pool.
+auto release(void* chunk) noexcept -> void;
+
+// Maps a region of at least given size which is kept as a whole, such as the
+// receive buffers io_uring picks from, with huge pages as configured.
+[[nodiscard]] auto map_region(size_t size) -> ErrorOr<std::span<uint8_t>>;
+
+auto unmap_region(std::span<uint8_t> region) noexcept -> void;
+
+// Chunk owns a chunk of the pool and hands it back when destroyed.
+class Chunk final {
+public:
+    Chunk() = default;
+
+    static auto allocate() -> Chunk { return Chunk(buffer_pool::allocate()); }
+
+    Chunk(const Chunk&) = delete;
+    Chunk(Chunk&& other) noexcept :
+        memory_(std::exchange(other.memory_, nullptr)) {}
+    ~Chunk() noexcept { reset(); }
+
+    auto operator=(const Chunk&) -> Chunk& = delete;
+    auto operator=(Chunk&& rhs) noexcept -> Chunk& {
+        if (this != &rhs) {
+            reset();
+            memory_ = std::exchange(rhs.memory_, nullptr);
+        }
+        return *this;
+    }
+
+    [[nodiscard]] auto is_null() const -> bool { return memory_ == nullptr; }
+    // CHUNK_SIZE bytes, or none for a null chunk
+    [[nodiscard]] auto bytes() const -> std::span<uint8_t> {
+        return memory_ == nullptr ? std::span<uint8_t>() : std::span(static_cast<uint8_t*>(memory_), CHUNK_SIZE);
+    }
+
+    // Hands the chunk back to the pool, leaving this one null.
+    auto reset() noexcept -> void {
+        if (memory_ != nullptr) {
+            release(std::exchange(memory_, nullptr));
+        }
+    }
+
+private:
+    explicit Chunk(void* memory) :
+        memory_(memory) {}
+
+    void* memory_{nullptr};
+};
+
+} // namespace common::buffer_pool
@@ -41,6 +41,7 @@ enum class ErrorDomain : int {
 enum class ErrorType : int {
     GENERIC = 1,
     TIMEOUT = 2,
+    CLOSED = 3,
 };
 
 class Error final {
@@ -70,6 +71,11 @@ public:
         return {error_domain, ErrorType::TIMEOUT, std::move(error_message)};
     }
 
+    static auto from_closed(std::string_view call, ErrorDomain error_domain = ErrorDomain::CORE) -> Error {
+        auto error_message = fmt::format("{} connection closed by peer", call);
+        return {error_domain, ErrorType::CLOSED, std::move(error_message)};
+    }
+
     [[nodiscard]] auto error_domain() const -> ErrorDomain { return error_domain_; }
     [[nodiscard]] auto error_type() const -> ErrorType { return error_type_; }
     [[nodiscard]] auto error_message() const -> const std::string& { return error_message_; }
@@ -159,6 +165,9 @@ public:
     [[nodiscard]] auto is_timeout_error() const -> bool {
         return is_error() && error().error_type() == ErrorType::TIMEOUT;
     }
+    [[nodiscard]] auto is_closed_error() const -> bool {
+        return is_error() && error().error_type() == ErrorType::CLOSED;
+    }
     [[nodiscard]] auto is_value() const -> bool { return std::holds_alternative<T>(value_or_error_); }
 
     auto release_error() -> Error {
@@ -0,0 +1,144 @@
+#include "JsonWriter.h"
+#include "Assertions.h"
+#include <array>
+#include <bit>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+using namespace common;
+
+// "00" to "99", so that integers are formatted two digits at a time
+static constexpr auto make_digit_pairs() -> std::array<char, 200> {
+    std::array<char, 200> pairs{};
+    for (size_t i = 0; i < 100; ++i) {
+        pairs[i * 2] = static_cast<char>('0' + i / 10);
+        pairs[i * 2 + 1] = static_cast<char>('0' + i % 10);
+    }
+    return pairs;
+}
+
+static constexpr auto DIGIT_PAIRS = make_digit_pairs();
+
+static constexpr auto make_powers_of_ten() -> std::array<uint64_t, JsonWriter::MAX_INTEGER_LENGTH> {
+    std::array<uint64_t, JsonWriter::MAX_INTEGER_LENGTH> powers{};
+    uint64_t power = 1;
+    for (auto& value : powers) {
+        value = power;
+        power *= 10;
+    }
+    return powers;
+}
+
+static constexpr auto POWERS_OF_TEN = make_powers_of_ten();
+
+// Returns the number of decimal digits of a non-zero number; the bit width
+// times log10(2), 1233 / 4096, is at most one too many.
+static auto decimal_length(uint64_t number) -> size_t {
+    size_t guess = static_cast<size_t>(std::bit_width(number)) * 1233 >> 12;
+    return guess + 1 - (number < POWERS_OF_TEN[guess] ? 1 : 0);
+}
+static constexpr std::string_view HEX_DIGITS = "0123456789abcdef";
+
+static constexpr auto needs_escaping(char c) -> bool {
+    return static_cast<unsigned char>(c) < 0x20 || c == '"' || c == '\\';
+}
+
+// Whether any of the eight characters in word needs escaping, testing them
+// all at once: subtracting from a byte sets its high bit only when it
+// underflows, which finds bytes below 0x20 and, after xor'ing, equal ones.
+static constexpr auto any_needs_escaping(uint64_t word) -> bool {
+    constexpr uint64_t ONES = 0x0101010101010101;
+    constexpr uint64_t HIGH_BITS = 0x8080808080808080;
+    auto any_below = [](uint64_t word, uint8_t limit) { return (word - ONES * limit) & ~word & HIGH_BITS; };
+    return (any_below(word, 0x20) | any_below(word ^ (ONES * '"'), 1) | any_below(word ^ (ONES * '\\'), 1)) != 0;
+}
+
+auto JsonWriter::string(std::string_view string) -> void {
+    size_t i = 0;
+    for (; i + sizeof(uint64_t) <= string.size(); i += sizeof(uint64_t)) {
+        uint64_t word;
+        std::memcpy(&word, string.data() + i, sizeof(word));
+        if (any_needs_escaping(word)) {
+            escaped_string(string);
+            return;
+        }
+    }
+    for (; i < string.size(); ++i) {
+        if (needs_escaping(string[i])) {
+            escaped_string(string);
+            return;
+        }
+    }
+    auto* out = extend(string.size() + 2);
+    out[0] = '"';
+    std::memcpy(out + 1, string.data(), string.size());
+    out[string.size() + 1] = '"';
+}
+
+auto JsonWriter::escaped_string(std::string_view string) -> void {
+    raw('"');
+    // copy runs of characters needing no escaping at once
+    size_t run = 0;
+    for (size_t i = 0; i < string.size(); ++i) {
+        auto c = string[i];
+        if (!needs_escaping(c)) {
+            continue;
+        }
+        raw(string.substr(run, i - run));
+        run = i + 1;
+        switch (c) {
+        case '"':
+            raw("\\\"");
+            break;
+        case '\\':
+            raw("\\\\");
+            break;
+        case '\n':
+            raw("\\n");
+            break;
+        case '\t':
+            raw("\\t");
+            break;
+        default: {
+            auto byte = static_cast<unsigned char>(c);
+            const char escaped[] = {'\\', 'u', '0', '0', HEX_DIGITS[byte >> 4], HEX_DIGITS[byte & 0xF]};
+            raw(std::string_view(escaped, sizeof(escaped)));
+        }
+        }
+    }
+    raw(string.substr(run));
+    raw('"');
+}
+
+auto JsonWriter::number(uint64_t number) -> void {
+    if (number < 10) {
+        raw(static_cast<char>('0' + number));
+        return;
+    }
+    // written backwards, two digits at a time
+    auto length = decimal_length(number);
+    auto* out = extend(length);
+    auto* position = out + length;
+    while (number >= 100) {
+        position -= 2;
+        std::memcpy(position, &DIGIT_PAIRS[(number % 100) * 2], 2);
+        number /= 100;
+    }
+    if (number >= 10) {
+        std::memcpy(out, &DIGIT_PAIRS[number * 2], 2);
+    } else {
+        *out = static_cast<char>('0' + number);
+    }
+}
+
+auto JsonWriter::number(double number) -> void {
+    if (!std::isfinite(number)) {
+        raw("null");
+        return;
+    }
+    auto* out = extend(MAX_DOUBLE_LENGTH);
+    auto result = std::to_chars(out, out + MAX_DOUBLE_LENGTH, number);
+    VERIFY(result.ec == std::errc());
+    shrink(MAX_DOUBLE_LENGTH - static_cast<size_t>(result.ptr - out));
+}
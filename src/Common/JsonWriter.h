@@ -0,0 +1,59 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fmt/format.h>
+#include <string_view>
+
+namespace common {
+
+// JsonWriter appends JSON values to a caller owned buffer. The buffer keeps
+// its capacity when cleared, so once it has grown to the size of the largest
+// message, writing does not allocate. Structure is left to the caller, who
+// writes keys and separators known at compile time with raw().
+class JsonWriter final {
+public:
+    // longest decimal uint64_t
+    static constexpr size_t MAX_INTEGER_LENGTH = 20;
+    // longest shortest round-trip double, such as -2.2250738585072014e-308
+    static constexpr size_t MAX_DOUBLE_LENGTH = 24;
+
+    explicit JsonWriter(fmt::memory_buffer& out) :
+        out_(out) {}
+
+    JsonWriter(const JsonWriter&) = delete;
+    JsonWriter(JsonWriter&&) = delete;
+    auto operator=(const JsonWriter&) -> JsonWriter& = delete;
+    auto operator=(JsonWriter&&) -> JsonWriter& = delete;
+
+    // Appends already encoded JSON as is.
+    auto raw(std::string_view json) -> void { std::memcpy(extend(json.size()), json.data(), json.size()); }
+    auto raw(char c) -> void { *extend(1) = c; }
+
+    // Appends given string quoted, escaping as necessary.
+    auto string(std::string_view string) -> void;
+
+    auto number(uint64_t number) -> void;
+    // Appends the shortest representation that reads back as the same
+    // double; null for infinities and NaN, which JSON has no numbers for.
+    auto number(double number) -> void;
+
+private:
+    // Grows the buffer by given number of characters and returns the first
+    // of them. Cheaper than memory_buffer::append(), which copies piecewise.
+    auto extend(size_t length) -> char* {
+        auto size = out_.size();
+        out_.try_resize(size + length);
+        return out_.data() + size;
+    }
+    // Gives back the characters of the latest extend() that went unused.
+    auto shrink(size_t unused) -> void { out_.try_resize(out_.size() - unused); }
+
+    // string() for strings with characters to escape
+    auto escaped_string(std::string_view string) -> void;
+
+    fmt::memory_buffer& out_;
+};
+
+} // namespace common
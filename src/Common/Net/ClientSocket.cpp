@@ -21,3 +21,42 @@ ClientSocket::~ClientSocket() noexcept {
 auto ClientSocket::close() noexcept -> void {
     socket_.close();
 }
+
+auto ClientSocket::receive(std::span<uint8_t> buffer) -> ErrorOr<size_t> {
+    while (true) {
+        auto bytes_read = ::recv(socket_.file_descriptor(), buffer.data(), buffer.size(), 0);
+        if (bytes_read > 0) {
+            return static_cast<size_t>(bytes_read);
+        }
+        if (bytes_read == 0) {
+            if (buffer.empty()) {
+                return size_t{0};
+            }
+            return {Error::from_closed("recv()", ErrorDomain::NET)};
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return size_t{0};
+        }
+        return {Error::from_errno(errno, "recv()", ErrorDomain::NET)};
+    }
+}
+
+auto ClientSocket::send(std::span<const uint8_t> buffer) -> ErrorOr<size_t> {
+    while (true) {
+        // MSG_NOSIGNAL: report a disconnected peer as EPIPE instead of SIGPIPE
+        auto bytes_written = ::send(socket_.file_descriptor(), buffer.data(), buffer.size(), MSG_NOSIGNAL);
+        if (bytes_written >= 0) {
+            return static_cast<size_t>(bytes_written);
+        }
+        if (errno == EINTR) {
+            continue;
+        }
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return size_t{0};
+        }
+        return {Error::from_errno(errno, "send()", ErrorDomain::NET)};
+    }
+}
@@ -6,6 +6,7 @@
 #include "Socket.h"
 #include <array>
 #include <cstdint>
+#include <span>
 #include <string_view>
 #include <sys/socket.h>
 #include <unistd.h>
@@ -32,6 +33,12 @@ public:
 
     auto close() noexcept -> void;
 
+    // Non-blocking variants of read() and write() meant for sockets driven by
+    // an event loop. Both return 0 when the call would block. Orderly shutdown
+    // by the peer is reported as an error for which is_closed_error() holds.
+    auto receive(std::span<uint8_t> buffer) -> ErrorOr<size_t>;
+    auto send(std::span<const uint8_t> buffer) -> ErrorOr<size_t>;
+
     template <size_t N>
     auto read(std::array<uint8_t, N>& buffer, int timeout_ms) -> ErrorOr<ssize_t> {
         auto wont_block = TRY(socket_.can_read_without_blocking(timeout_ms));
@@ -0,0 +1,111 @@
+#include "EventLoop.h"
+#include "../Logging.h"
+#include <cerrno>
+#include <sys/eventfd.h>
+#include <unistd.h>
+#include <utility>
+
+using namespace common;
+using namespace common::net;
+
+auto EventLoop::create() -> ErrorOr<EventLoop> {
+    auto epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+    if (epoll_fd < 0) {
+        return {Error::from_errno(errno, "epoll_create1()", ErrorDomain::NET)};
+    }
+
+    auto wakeup_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (wakeup_fd < 0) {
+        auto error = Error::from_errno(errno, "eventfd()", ErrorDomain::NET);
+        ::close(epoll_fd);
+        return {std::move(error)};
+    }
+
+    EventLoop event_loop{epoll_fd, wakeup_fd};
+    TRY(event_loop.add(wakeup_fd, EPOLLIN, WAKEUP_TOKEN));
+    return {std::move(event_loop)};
+}
+
+EventLoop::EventLoop(int epoll_fd, int wakeup_fd) :
+    epoll_fd_(epoll_fd),
+    wakeup_fd_(wakeup_fd) {}
+
+EventLoop::EventLoop(EventLoop&& other) noexcept :
+    epoll_fd_(std::exchange(other.epoll_fd_, -1)),
+    wakeup_fd_(std::exchange(other.wakeup_fd_, -1)) {}
+
+EventLoop::~EventLoop() noexcept {
+    cleanup();
+}
+
+auto EventLoop::operator=(EventLoop&& rhs) noexcept -> EventLoop& {
+    if (this != &rhs) {
+        cleanup();
+        epoll_fd_ = std::exchange(rhs.epoll_fd_, -1);
+        wakeup_fd_ = std::exchange(rhs.wakeup_fd_, -1);
+    }
+    return *this;
+}
+
+auto EventLoop::add(int fd, uint32_t events, uint64_t token) -> ErrorOr<void> {
+    struct epoll_event event {};
+    event.events = events;
+    event.data.u64 = token;
+    if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event) != 0) {
+        return {Error::from_errno(errno, "epoll_ctl(EPOLL_CTL_ADD)", ErrorDomain::NET)};
+    }
+    return {};
+}
+
+auto EventLoop::modify(int fd, uint32_t events, uint64_t token) -> ErrorOr<void> {
+    struct epoll_event event {};
+    event.events = events;
+    event.data.u64 = token;
+    if (::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event) != 0) {
+        return {Error::from_errno(errno, "epoll_ctl(EPOLL_CTL_MOD)", ErrorDomain::NET)};
+    }
+    return {};
+}
+
+auto EventLoop::remove(int fd) -> ErrorOr<void> {
+    if (::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr) != 0) {
+        return {Error::from_errno(errno, "epoll_ctl(EPOLL_CTL_DEL)", ErrorDomain::NET)};
+    }
+    return {};
+}
+
+auto EventLoop::wait(struct epoll_event* events, int max_events, int timeout_ms) -> ErrorOr<size_t> {
+    auto result = ::epoll_wait(epoll_fd_, events, max_events, timeout_ms);
+    if (result < 0) {
+        if (errno == EINTR) {
+            // interrupted by a signal; let the caller re-check its state
+            return size_t{0};
+        }
+        return {Error::from_errno(errno, "epoll_wait()", ErrorDomain::NET)};
+    }
+
+    for (int i = 0; i < result; ++i) {
+        if (events[i].data.u64 == WAKEUP_TOKEN) {
+            // drain the eventfd counter so that the next wakeup() triggers a
+            // new level change
+            uint64_t counter = 0;
+            [[maybe_unused]] auto rc = ::read(wakeup_fd_, &counter, sizeof(counter));
+        }
+    }
+    return static_cast<size_t>(result);
+}
+
+auto EventLoop::wakeup() noexcept -> void {
+    uint64_t one = 1;
+    [[maybe_unused]] auto rc = ::write(wakeup_fd_, &one, sizeof(one));
+}
+
+auto EventLoop::cleanup() noexcept -> void {
+    if (wakeup_fd_ >= 0) {
+        ::close(std::exchange(wakeup_fd_, -1));
+    }
+    if (epoll_fd_ >= 0) {
+        LOG_DEBUG("Cleaning up event loop (fd: {})", epoll_fd_);
+        ::close(std::exchange(epoll_fd_, -1));
+    }
+}
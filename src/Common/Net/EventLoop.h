@@ -0,0 +1,57 @@
+#pragma once
+
+#include "../Error.h"
+#include <array>
+#include <cstdint>
+#include <sys/epoll.h>
+
+namespace common::net {
+
+// EventLoop is a thin wrapper around an epoll instance. File descriptors are
+// registered with an opaque 64-bit token which is handed back with every
+// readiness event. The loop also owns an eventfd which other threads can use
+// to wake up a thread blocked in wait().
+class EventLoop final {
+public:
+    // token reserved for the internal wakeup eventfd
+    static constexpr uint64_t WAKEUP_TOKEN = UINT64_MAX;
+
+    static auto create() -> ErrorOr<EventLoop>;
+
+    EventLoop(const EventLoop&) = delete;
+    EventLoop(EventLoop&& other) noexcept;
+    ~EventLoop() noexcept;
+
+    auto operator=(const EventLoop&) -> EventLoop& = delete;
+    auto operator=(EventLoop&& rhs) noexcept -> EventLoop&;
+
+    [[nodiscard]] auto file_descriptor() const -> int { return epoll_fd_; }
+
+    auto add(int fd, uint32_t events, uint64_t token) -> ErrorOr<void>;
+    auto modify(int fd, uint32_t events, uint64_t token) -> ErrorOr<void>;
+    auto remove(int fd) -> ErrorOr<void>;
+
+    // Waits until at least one registered file descriptor is ready or the
+    // timeout is reached. Returns the number of events written to the given
+    // array; zero means timeout. Wakeup events are consumed internally but
+    // still reported with WAKEUP_TOKEN so the caller can re-check its state.
+    template <size_t N>
+    auto wait(std::array<struct epoll_event, N>& events, int timeout_ms) -> ErrorOr<size_t> {
+        return wait(events.data(), static_cast<int>(events.size()), timeout_ms);
+    }
+
+    // Wakes up the thread blocked in wait(). Safe to call from any thread and
+    // from signal handlers.
+    auto wakeup() noexcept -> void;
+
+private:
+    EventLoop(int epoll_fd, int wakeup_fd);
+
+    auto wait(struct epoll_event* events, int max_events, int timeout_ms) -> ErrorOr<size_t>;
+    auto cleanup() noexcept -> void;
+
+    int epoll_fd_;
+    int wakeup_fd_;
+};
+
+} // namespace common::net
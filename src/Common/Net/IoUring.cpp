@@ -0,0 +1,416 @@
+#include "IoUring.h"
+#include "../BufferPool.h"
+#include "../Logging.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <utility>
+
+using namespace common;
+using namespace common::net;
+
+// glibc doesn't provide wrappers for the io_uring system calls
+static auto io_uring_setup(uint32_t entries, struct io_uring_params* params) -> int {
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+static auto io_uring_enter(int ring_fd,
+                           uint32_t to_submit,
+                           uint32_t min_complete,
+                           uint32_t flags,
+                           const void* arg,
+                           size_t arg_size) -> int {
+    return static_cast<int>(::syscall(__NR_io_uring_enter, ring_fd, to_submit, min_complete, flags, arg, arg_size));
+}
+
+static auto io_uring_register(int ring_fd, uint32_t opcode, void* arg, uint32_t nr_args) -> int {
+    return static_cast<int>(::syscall(__NR_io_uring_register, ring_fd, opcode, arg, nr_args));
+}
+
+auto IoUring::create(uint32_t entries) -> ErrorOr<IoUring> {
+    struct io_uring_params params {};
+    // multishot requests can complete many times per submission so give the
+    // completion queue more room than the submission queue
+    params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_COOP_TASKRUN;
+    params.cq_entries = entries * 4;
+
+    auto ring_fd = io_uring_setup(entries, &params);
+    if (ring_fd < 0) {
+        return {Error::from_errno(errno, "io_uring_setup()", ErrorDomain::NET)};
+    }
+
+    IoUring io_uring{ring_fd, params};
+    TRY(io_uring.map_rings(params));
+    return {std::move(io_uring)};
+}
+
+IoUring::IoUring(int ring_fd, const struct io_uring_params& params) :
+    ring_fd_(ring_fd),
+    sq_entries_(params.sq_entries) {}
+
+IoUring::IoUring(IoUring&& other) noexcept :
+    ring_fd_(std::exchange(other.ring_fd_, -1)),
+    sq_ring_ptr_(std::exchange(other.sq_ring_ptr_, nullptr)),
+    sq_ring_size_(std::exchange(other.sq_ring_size_, 0)),
+    cq_ring_ptr_(std::exchange(other.cq_ring_ptr_, nullptr)),
+    cq_ring_size_(std::exchange(other.cq_ring_size_, 0)),
+    sqes_(std::exchange(other.sqes_, nullptr)),
+    sqes_size_(std::exchange(other.sqes_size_, 0)),
+    sq_head_(other.sq_head_),
+    sq_tail_(other.sq_tail_),
+    sq_mask_(other.sq_mask_),
+    sq_entries_(other.sq_entries_),
+    sq_array_(other.sq_array_),
+    sq_pending_(std::exchange(other.sq_pending_, 0)),
+    cq_head_(other.cq_head_),
+    cq_tail_(other.cq_tail_),
+    cq_mask_(other.cq_mask_),
+    cqes_(other.cqes_) {}
+
+IoUring::~IoUring() noexcept {
+    cleanup();
+}
+
+auto IoUring::operator=(IoUring&& rhs) noexcept -> IoUring& {
+    if (this != &rhs) {
+        cleanup();
+        ring_fd_ = std::exchange(rhs.ring_fd_, -1);
+        sq_ring_ptr_ = std::exchange(rhs.sq_ring_ptr_, nullptr);
+        sq_ring_size_ = std::exchange(rhs.sq_ring_size_, 0);
+        cq_ring_ptr_ = std::exchange(rhs.cq_ring_ptr_, nullptr);
+        cq_ring_size_ = std::exchange(rhs.cq_ring_size_, 0);
+        sqes_ = std::exchange(rhs.sqes_, nullptr);
+        sqes_size_ = std::exchange(rhs.sqes_size_, 0);
+        sq_head_ = rhs.sq_head_;
+        sq_tail_ = rhs.sq_tail_;
+        sq_mask_ = rhs.sq_mask_;
+        sq_entries_ = rhs.sq_entries_;
+        sq_array_ = rhs.sq_array_;
+        sq_pending_ = std::exchange(rhs.sq_pending_, 0);
+        cq_head_ = rhs.cq_head_;
+        cq_tail_ = rhs.cq_tail_;
+        cq_mask_ = rhs.cq_mask_;
+        cqes_ = rhs.cqes_;
+    }
+    return *this;
+}
+
+auto IoUring::map_rings(const struct io_uring_params& params) -> ErrorOr<void> {
+    sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+    cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (single_mmap) {
+        sq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+    }
+
+    sq_ring_ptr_ = ::mmap(nullptr,
+                          sq_ring_size_,
+                          PROT_READ | PROT_WRITE,
+                          MAP_SHARED | MAP_POPULATE,
+                          ring_fd_,
+                          IORING_OFF_SQ_RING);
+    if (sq_ring_ptr_ == MAP_FAILED) {
+        sq_ring_ptr_ = nullptr;
+        return {Error::from_errno(errno, "mmap(IORING_OFF_SQ_RING)", ErrorDomain::NET)};
+    }
+
+    if (single_mmap) {
+        cq_ring_size_ = 0; // shared with the submission queue ring
+    } else {
+        cq_ring_ptr_ = ::mmap(nullptr,
+                              cq_ring_size_,
+                              PROT_READ | PROT_WRITE,
+                              MAP_SHARED | MAP_POPULATE,
+                              ring_fd_,
+                              IORING_OFF_CQ_RING);
+        if (cq_ring_ptr_ == MAP_FAILED) {
+            cq_ring_ptr_ = nullptr;
+            return {Error::from_errno(errno, "mmap(IORING_OFF_CQ_RING)", ErrorDomain::NET)};
+        }
+    }
+
+    sqes_size_ = params.sq_entries * sizeof(struct io_uring_sqe);
+    auto* sqes_ptr =
+        ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_fd_, IORING_OFF_SQES);
+    if (sqes_ptr == MAP_FAILED) {
+        sqes_size_ = 0;
+        return {Error::from_errno(errno, "mmap(IORING_OFF_SQES)", ErrorDomain::NET)};
+    }
+    sqes_ = static_cast<struct io_uring_sqe*>(sqes_ptr);
+
+    auto* sq_ring = static_cast<uint8_t*>(sq_ring_ptr_);
+    auto* cq_ring = single_mmap ? sq_ring : static_cast<uint8_t*>(cq_ring_ptr_);
+
+    sq_head_ = reinterpret_cast<uint32_t*>(sq_ring + params.sq_off.head);
+    sq_tail_ = reinterpret_cast<uint32_t*>(sq_ring + params.sq_off.tail);
+    sq_mask_ = *reinterpret_cast<uint32_t*>(sq_ring + params.sq_off.ring_mask);
+    sq_array_ = reinterpret_cast<uint32_t*>(sq_ring + params.sq_off.array);
+
+    cq_head_ = reinterpret_cast<uint32_t*>(cq_ring + params.cq_off.head);
+    cq_tail_ = reinterpret_cast<uint32_t*>(cq_ring + params.cq_off.tail);
+    cq_mask_ = *reinterpret_cast<uint32_t*>(cq_ring + params.cq_off.ring_mask);
+    cqes_ = reinterpret_cast<struct io_uring_cqe*>(cq_ring + params.cq_off.cqes);
+
+    return {};
+}
+
+auto IoUring::next_sqe() -> ErrorOr<struct io_uring_sqe*> {
+    auto head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+    auto tail = *sq_tail_;
+    if (tail - head >= sq_entries_) {
+        // submission queue full; hand the queued entries to the kernel
+        TRY(submit());
+        head = __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE);
+        if (tail - head >= sq_entries_) {
+            return {Error::from_errno(EBUSY, "io_uring_get_sqe()", ErrorDomain::NET)};
+        }
+    }
+
+    // publishing the tail before the entry is filled in is fine since the
+    // kernel only looks at the queue from within io_uring_enter()
+    auto index = tail & sq_mask_;
+    auto* sqe = &sqes_[index];
+    std::memset(sqe, 0, sizeof(*sqe));
+    sq_array_[index] = index;
+    __atomic_store_n(sq_tail_, tail + 1, __ATOMIC_RELEASE);
+    ++sq_pending_;
+    return sqe;
+}
+
+auto IoUring::prepare_multishot_accept(int fd, uint64_t user_data) -> ErrorOr<void> {
+    auto* sqe = TRY(next_sqe());
+    sqe->opcode = IORING_OP_ACCEPT;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+    sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+    sqe->user_data = user_data;
+    return {};
+}
+
+auto IoUring::prepare_multishot_recv(int fd, uint16_t buffer_group, uint64_t user_data) -> ErrorOr<void> {
+    auto* sqe = TRY(next_sqe());
+    sqe->opcode = IORING_OP_RECV;
+    sqe->fd = fd;
+    sqe->ioprio = IORING_RECV_MULTISHOT;
+    sqe->flags = IOSQE_BUFFER_SELECT;
+    sqe->buf_group = buffer_group;
+    sqe->user_data = user_data;
+    return {};
+}
+
+auto IoUring::prepare_send(int fd, std::span<const uint8_t> buffer, uint64_t user_data) -> ErrorOr<void> {
+    auto* sqe = TRY(next_sqe());
+    sqe->opcode = IORING_OP_SEND;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buffer.data());
+    sqe->len = static_cast<uint32_t>(buffer.size());
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = user_data;
+    return {};
+}
+
+auto IoUring::prepare_read(int fd, std::span<uint8_t> buffer, uint64_t user_data) -> ErrorOr<void> {
+    auto* sqe = TRY(next_sqe());
+    sqe->opcode = IORING_OP_READ;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uint64_t>(buffer.data());
+    sqe->len = static_cast<uint32_t>(buffer.size());
+    sqe->user_data = user_data;
+    return {};
+}
+
+auto IoUring::prepare_cancel(uint64_t target_user_data, uint64_t user_data) -> ErrorOr<void> {
+    auto* sqe = TRY(next_sqe());
+    sqe->opcode = IORING_OP_ASYNC_CANCEL;
+    sqe->fd = -1;
+    sqe->addr = target_user_data;
+    sqe->user_data = user_data;
+    return {};
+}
+
+auto IoUring::submit() -> ErrorOr<size_t> {
+    if (sq_pending_ == 0) {
+        return size_t{0};
+    }
+    return enter(sq_pending_, 0, 0);
+}
+
+auto IoUring::submit_and_wait(uint32_t min_completions) -> ErrorOr<size_t> {
+    return enter(sq_pending_, min_completions, IORING_ENTER_GETEVENTS);
+}
+
+auto IoUring::submit_and_wait(uint32_t min_completions, std::chrono::milliseconds timeout) -> ErrorOr<size_t> {
+    if (timeout.count() < 0) {
+        return submit_and_wait(min_completions);
+    }
+    // the extended argument bounds the wait without a timeout request, which
+    // would need a submission entry and a completion of its own
+    struct __kernel_timespec timespec {};
+    timespec.tv_sec = timeout.count() / 1000;
+    timespec.tv_nsec = (timeout.count() % 1000) * 1000000;
+    struct io_uring_getevents_arg arg {};
+    arg.ts = reinterpret_cast<uint64_t>(&timespec);
+    return enter(sq_pending_, min_completions, IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+}
+
+auto IoUring::enter(uint32_t to_submit, uint32_t min_completions, uint32_t flags, const void* arg, size_t arg_size)
+    -> ErrorOr<size_t> {
+    auto result = io_uring_enter(ring_fd_, to_submit, min_completions, flags, arg, arg_size);
+    if (result < 0) {
+        if (errno == EINTR || errno == ETIME) {
+            // interrupted by a signal or timed out; whatever got submitted
+            // is reported through sq_head_ on the next call
+            return size_t{0};
+        }
+        if (errno == EBUSY || errno == EAGAIN) {
+            // the completion queue overflowed or the kernel is short of
+            // memory for requests; nothing got submitted, and the entries
+            // are submitted again once the caller drained its completions
+            return size_t{0};
+        }
+        return {Error::from_errno(errno, "io_uring_enter()", ErrorDomain::NET)};
+    }
+    sq_pending_ -= std::min(sq_pending_, static_cast<uint32_t>(result));
+    return static_cast<size_t>(result);
+}
+
+auto IoUring::cleanup() noexcept -> void {
+    if (sqes_ != nullptr) {
+        ::munmap(std::exchange(sqes_, nullptr), sqes_size_);
+    }
+    if (cq_ring_ptr_ != nullptr) {
+        ::munmap(std::exchange(cq_ring_ptr_, nullptr), cq_ring_size_);
+    }
+    if (sq_ring_ptr_ != nullptr) {
+        ::munmap(std::exchange(sq_ring_ptr_, nullptr), sq_ring_size_);
+    }
+    if (ring_fd_ >= 0) {
+        LOG_DEBUG("Cleaning up io_uring (fd: {})", ring_fd_);
+        ::close(std::exchange(ring_fd_, -1));
+    }
+}
+
+auto IoUringBufferRing::create(IoUring& io_uring, uint16_t buffer_group, uint16_t buffer_count, uint32_t buffer_size)
+    -> ErrorOr<IoUringBufferRing> {
+    // the kernel uses the buffer count as a ring mask
+    VERIFY(buffer_count > 0 && (buffer_count & (buffer_count - 1)) == 0);
+
+    auto ring_size = buffer_count * sizeof(struct io_uring_buf);
+    auto* ring_ptr = ::mmap(nullptr, ring_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (ring_ptr == MAP_FAILED) {
+        return {Error::from_errno(errno, "mmap()", ErrorDomain::NET)};
+    }
+
+    // the buffers come from the buffer pool's mappings so that they sit on
+    // huge pages along with the send buffers when those are configured
+    auto error_or_buffers = buffer_pool::map_region(static_cast<size_t>(buffer_count) * buffer_size);
+    if (error_or_buffers.is_error()) {
+        ::munmap(ring_ptr, ring_size);
+        return {error_or_buffers.release_error()};
+    }
+    auto* buffers_ptr = error_or_buffers.value().data();
+
+    auto* ring = static_cast<struct io_uring_buf_ring*>(ring_ptr);
+    IoUringBufferRing buffer_ring{io_uring.file_descriptor(),
+                                  buffer_group,
+                                  buffer_count,
+                                  buffer_size,
+                                  ring,
+                                  ring_size,
+                                  buffers_ptr};
+
+    struct io_uring_buf_reg reg {};
+    reg.ring_addr = reinterpret_cast<uint64_t>(ring);
+    reg.ring_entries = buffer_count;
+    reg.bgid = buffer_group;
+    if (io_uring_register(io_uring.file_descriptor(), IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+        auto error = Error::from_errno(errno, "io_uring_register(IORING_REGISTER_PBUF_RING)", ErrorDomain::NET);
+        buffer_ring.ring_fd_ = -1; // nothing to unregister
+        return {std::move(error)};
+    }
+
+    for (uint16_t buffer_id = 0; buffer_id < buffer_count; ++buffer_id) {
+        buffer_ring.recycle(buffer_id);
+    }
+    return {std::move(buffer_ring)};
+}
+
+IoUringBufferRing::IoUringBufferRing(int ring_fd,
+                                     uint16_t buffer_group,
+                                     uint16_t buffer_count,
+                                     uint32_t buffer_size,
+                                     struct io_uring_buf_ring* ring,
+                                     size_t ring_size,
+                                     uint8_t* buffers) :
+    ring_fd_(ring_fd),
+    buffer_group_(buffer_group),
+    buffer_count_(buffer_count),
+    buffer_size_(buffer_size),
+    ring_(ring),
+    ring_size_(ring_size),
+    buffers_(buffers) {}
+
+IoUringBufferRing::IoUringBufferRing(IoUringBufferRing&& other) noexcept :
+    ring_fd_(std::exchange(other.ring_fd_, -1)),
+    buffer_group_(other.buffer_group_),
+    buffer_count_(std::exchange(other.buffer_count_, 0)),
+    buffer_size_(other.buffer_size_),
+    ring_(std::exchange(other.ring_, nullptr)),
+    ring_size_(std::exchange(other.ring_size_, 0)),
+    buffers_(std::exchange(other.buffers_, nullptr)) {}
+
+IoUringBufferRing::~IoUringBufferRing() noexcept {
+    cleanup();
+}
+
+auto IoUringBufferRing::operator=(IoUringBufferRing&& rhs) noexcept -> IoUringBufferRing& {
+    if (this != &rhs) {
+        cleanup();
+        ring_fd_ = std::exchange(rhs.ring_fd_, -1);
+        buffer_group_ = rhs.buffer_group_;
+        buffer_count_ = std::exchange(rhs.buffer_count_, 0);
+        buffer_size_ = rhs.buffer_size_;
+        ring_ = std::exchange(rhs.ring_, nullptr);
+        ring_size_ = std::exchange(rhs.ring_size_, 0);
+        buffers_ = std::exchange(rhs.buffers_, nullptr);
+    }
+    return *this;
+}
+
+auto IoUringBufferRing::buffer(uint16_t buffer_id, size_t length) -> std::span<uint8_t> {
+    VERIFY(buffer_id < buffer_count_ && length <= buffer_size_);
+    return {buffers_ + static_cast<size_t>(buffer_id) * buffer_size_, length};
+}
+
+auto IoUringBufferRing::recycle(uint16_t buffer_id) -> void {
+    // only this thread writes the tail; the kernel reads it
+    auto tail = ring_->tail;
+    // don't use ring_->bufs; the kernel header declares it with a macro which
+    // in C++ places an empty struct (of size 1) in front of the array
+    auto* entries = reinterpret_cast<struct io_uring_buf*>(ring_);
+    auto& entry = entries[tail & (buffer_count_ - 1)];
+    entry.addr = reinterpret_cast<uint64_t>(buffers_ + static_cast<size_t>(buffer_id) * buffer_size_);
+    entry.len = buffer_size_;
+    entry.bid = buffer_id;
+    __atomic_store_n(&ring_->tail, static_cast<uint16_t>(tail + 1), __ATOMIC_RELEASE);
+}
+
+auto IoUringBufferRing::cleanup() noexcept -> void {
+    if (ring_fd_ >= 0) {
+        struct io_uring_buf_reg reg {};
+        reg.bgid = buffer_group_;
+        [[maybe_unused]] auto rc = io_uring_register(ring_fd_, IORING_UNREGISTER_PBUF_RING, &reg, 1);
+        ring_fd_ = -1;
+    }
+    if (buffers_ != nullptr) {
+        auto buffers_size = static_cast<size_t>(buffer_count_) * buffer_size_;
+        buffer_pool::unmap_region({std::exchange(buffers_, nullptr), buffers_size});
+    }
+    if (ring_ != nullptr) {
+        ::munmap(std::exchange(ring_, nullptr), ring_size_);
+    }
+}
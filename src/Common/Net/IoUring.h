@@ -0,0 +1,151 @@
+#pragma once
+
+#include "../Error.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <linux/io_uring.h>
+#include <span>
+
+namespace common::net {
+
+// IoUring is a minimal wrapper around an io_uring instance using the raw
+// system calls, covering just what the network reactors need: multishot
+// accept, multishot recv with provided buffers, send and reads from eventfds.
+//
+// Submissions are only queued by the prepare_*() calls; nothing reaches the
+// kernel before submit() or submit_and_wait() is called, which lets callers
+// batch everything produced while handling one round of completions into a
+// single system call. While the completion queue overflowed, submitting
+// hands nothing to the kernel and reports 0 submitted; the entries stay
+// queued until the caller consumed completions and submits again.
+//
+// Instances must only be used from a single thread.
+class IoUring final {
+public:
+    static auto create(uint32_t entries) -> ErrorOr<IoUring>;
+
+    IoUring(const IoUring&) = delete;
+    IoUring(IoUring&& other) noexcept;
+    ~IoUring() noexcept;
+
+    auto operator=(const IoUring&) -> IoUring& = delete;
+    auto operator=(IoUring&& rhs) noexcept -> IoUring&;
+
+    [[nodiscard]] auto file_descriptor() const -> int { return ring_fd_; }
+
+    auto prepare_multishot_accept(int fd, uint64_t user_data) -> ErrorOr<void>;
+    auto prepare_multishot_recv(int fd, uint16_t buffer_group, uint64_t user_data) -> ErrorOr<void>;
+    auto prepare_send(int fd, std::span<const uint8_t> buffer, uint64_t user_data) -> ErrorOr<void>;
+    auto prepare_read(int fd, std::span<uint8_t> buffer, uint64_t user_data) -> ErrorOr<void>;
+    // Cancels the request in flight submitted with target_user_data. Unlike
+    // cancelling by file descriptor this still finds the request once the
+    // descriptor got closed, or reused for another socket.
+    auto prepare_cancel(uint64_t target_user_data, uint64_t user_data) -> ErrorOr<void>;
+
+    // Submits queued entries without waiting for completions.
+    auto submit() -> ErrorOr<size_t>;
+    // Submits queued entries and waits until at least min_completions
+    // completions are available.
+    auto submit_and_wait(uint32_t min_completions) -> ErrorOr<size_t>;
+    // Like above but returns once given timeout expired without enough
+    // completions, too. A negative timeout waits indefinitely.
+    auto submit_and_wait(uint32_t min_completions, std::chrono::milliseconds timeout) -> ErrorOr<size_t>;
+
+    // Calls given callback for every available completion and marks them
+    // consumed. Returns the number of completions handled.
+    template <typename Callback>
+    auto for_each_completion(Callback&& callback) -> size_t {
+        auto head = *cq_head_;
+        auto tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+        size_t count = 0;
+        for (; head != tail; ++head, ++count) {
+            callback(cqes_[head & cq_mask_]);
+        }
+        __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+        return count;
+    }
+
+private:
+    IoUring(int ring_fd, const struct io_uring_params& params);
+
+    auto map_rings(const struct io_uring_params& params) -> ErrorOr<void>;
+    // Returns the next free submission entry cleared to zero. When the
+    // submission queue is full the queued entries are submitted first.
+    auto next_sqe() -> ErrorOr<struct io_uring_sqe*>;
+    auto enter(uint32_t to_submit,
+               uint32_t min_completions,
+               uint32_t flags,
+               const void* arg = nullptr,
+               size_t arg_size = 0) -> ErrorOr<size_t>;
+    auto cleanup() noexcept -> void;
+
+    int ring_fd_;
+
+    void* sq_ring_ptr_{nullptr};
+    size_t sq_ring_size_{0};
+    void* cq_ring_ptr_{nullptr};
+    size_t cq_ring_size_{0};
+    struct io_uring_sqe* sqes_{nullptr};
+    size_t sqes_size_{0};
+
+    uint32_t* sq_head_{nullptr};
+    uint32_t* sq_tail_{nullptr};
+    uint32_t sq_mask_{0};
+    uint32_t sq_entries_{0};
+    uint32_t* sq_array_{nullptr};
+    // entries queued with prepare_*() but not yet handed to the kernel
+    uint32_t sq_pending_{0};
+
+    uint32_t* cq_head_{nullptr};
+    uint32_t* cq_tail_{nullptr};
+    uint32_t cq_mask_{0};
+    struct io_uring_cqe* cqes_{nullptr};
+};
+
+// IoUringBufferRing is a provided buffer ring registered with an IoUring
+// instance. Receive requests submitted with the ring's buffer group pick a
+// free buffer at completion time, so idle connections don't pin any receive
+// memory. Buffers must be handed back with recycle() once consumed.
+class IoUringBufferRing final {
+public:
+    static auto create(IoUring& io_uring, uint16_t buffer_group, uint16_t buffer_count, uint32_t buffer_size)
+        -> ErrorOr<IoUringBufferRing>;
+
+    IoUringBufferRing(const IoUringBufferRing&) = delete;
+    IoUringBufferRing(IoUringBufferRing&& other) noexcept;
+    ~IoUringBufferRing() noexcept;
+
+    auto operator=(const IoUringBufferRing&) -> IoUringBufferRing& = delete;
+    auto operator=(IoUringBufferRing&& rhs) noexcept -> IoUringBufferRing&;
+
+    [[nodiscard]] auto buffer_group() const -> uint16_t { return buffer_group_; }
+
+    // Returns the buffer selected by the kernel for given completion. The
+    // buffer is the caller's to modify (e.g. unmask in place) until recycled.
+    [[nodiscard]] auto buffer(uint16_t buffer_id, size_t length) -> std::span<uint8_t>;
+
+    // Hands the buffer back to the kernel for reuse.
+    auto recycle(uint16_t buffer_id) -> void;
+
+private:
+    IoUringBufferRing(int ring_fd,
+                      uint16_t buffer_group,
+                      uint16_t buffer_count,
+                      uint32_t buffer_size,
+                      struct io_uring_buf_ring* ring,
+                      size_t ring_size,
+                      uint8_t* buffers);
+
+    auto cleanup() noexcept -> void;
+
+    int ring_fd_;
+    uint16_t buffer_group_;
+    uint16_t buffer_count_;
+    uint32_t buffer_size_;
+    struct io_uring_buf_ring* ring_;
+    size_t ring_size_;
+    uint8_t* buffers_;
+};
+
+} // namespace common::net
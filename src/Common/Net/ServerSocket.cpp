@@ -18,17 +18,36 @@ ServerSocket::~ServerSocket() noexcept {
 auto ServerSocket::accept(int timeout_ms) -> ErrorOr<ClientSocket> {
     TRY(socket_.poll(POLLIN, timeout_ms));
 
+    auto maybe_client_socket = TRY(try_accept());
+    if (!maybe_client_socket.has_value()) {
+        // connection went away between poll() and accept()
+        return {Error::from_timeout("accept()", ErrorDomain::NET)};
+    }
+    return {std::move(maybe_client_socket.value())};
+}
+
+auto ServerSocket::try_accept() -> ErrorOr<std::optional<ClientSocket>> {
     struct sockaddr_in remote_address;
     socklen_t remote_address_size = sizeof(remote_address);
-    auto socket_fd = ::accept(socket_.file_descriptor(),
+    int socket_fd = -1;
+    // connections reset while waiting in the backlog are skipped for the next
+    // one, so that they don't end a caller's drain of the backlog early
+    do {
+        // accept4() saves us the extra fcntl() call to make the socket non-blocking
+        socket_fd = ::accept4(socket_.file_descriptor(),
                               reinterpret_cast<struct sockaddr*>(&remote_address),
-                              &remote_address_size);
+                              &remote_address_size,
+                              SOCK_NONBLOCK | SOCK_CLOEXEC);
+    } while (socket_fd < 0 && (errno == EINTR || errno == ECONNABORTED));
+
     if (socket_fd < 0) {
-        return {Error::from_errno(errno, "accept()", ErrorDomain::NET)};
+        if (errno == EAGAIN || errno == EWOULDBLOCK) {
+            return {std::optional<ClientSocket>{}};
+        }
+        return {Error::from_errno(errno, "accept4()", ErrorDomain::NET)};
     }
 
     auto socket = Socket::from(socket_fd);
-    MUST(socket.set_nonblocking(true));
 
     // resolve local remote_address
     struct sockaddr_in local_address;
@@ -37,6 +56,26 @@ auto ServerSocket::accept(int timeout_ms) -> ErrorOr<ClientSocket> {
         return {Error::from_errno(errno, "getsockname()", ErrorDomain::NET)};
     }
 
+    return {std::optional<ClientSocket>{ClientSocket(std::move(socket),
+                                                     IpSocketAddress::from_ipv4_sockaddr(&local_address),
+                                                     IpSocketAddress::from_ipv4_sockaddr(&remote_address))}};
+}
+
+auto ServerSocket::adopt(int socket_fd) -> ErrorOr<ClientSocket> {
+    auto socket = Socket::from(socket_fd);
+
+    struct sockaddr_in local_address;
+    socklen_t local_address_size = sizeof(local_address);
+    if (::getsockname(socket_fd, reinterpret_cast<struct sockaddr*>(&local_address), &local_address_size) != 0) {
+        return {Error::from_errno(errno, "getsockname()", ErrorDomain::NET)};
+    }
+
+    struct sockaddr_in remote_address;
+    socklen_t remote_address_size = sizeof(remote_address);
+    if (::getpeername(socket_fd, reinterpret_cast<struct sockaddr*>(&remote_address), &remote_address_size) != 0) {
+        return {Error::from_errno(errno, "getpeername()", ErrorDomain::NET)};
+    }
+
     return {ClientSocket(std::move(socket),
                          IpSocketAddress::from_ipv4_sockaddr(&local_address),
                          IpSocketAddress::from_ipv4_sockaddr(&remote_address))};
@@ -50,9 +89,15 @@ auto ServerSocket::listen(const IpSocketAddress& listen_address) -> ErrorOr<Serv
     auto socket = TRY(Socket::create());
     MUST(socket.set_nonblocking(true));
 
+    // socket options are not bit flags so each one has to be set separately;
+    // SO_REUSEPORT lets every reactor shard bind its own listener to the same
+    // address and have the kernel balance incoming connections between them
     int opt = 1;
-    if (::setsockopt(socket.file_descriptor(), SOL_SOCKET, SO_REUSEADDR | SO_REUSEPORT, &opt, sizeof(opt)) != 0) {
-        return {Error::from_errno(errno, "setsockopt()", ErrorDomain::NET)};
+    if (::setsockopt(socket.file_descriptor(), SOL_SOCKET, SO_REUSEADDR, &opt, sizeof(opt)) != 0) {
+        return {Error::from_errno(errno, "setsockopt(SO_REUSEADDR)", ErrorDomain::NET)};
+    }
+    if (::setsockopt(socket.file_descriptor(), SOL_SOCKET, SO_REUSEPORT, &opt, sizeof(opt)) != 0) {
+        return {Error::from_errno(errno, "setsockopt(SO_REUSEPORT)", ErrorDomain::NET)};
     }
 
     struct sockaddr_in addr;
@@ -62,7 +107,9 @@ auto ServerSocket::listen(const IpSocketAddress& listen_address) -> ErrorOr<Serv
     }
 
     // start listening to socket; handle incoming connections with accept()
-    int backlog = 10;
+    // reconnect storms can bring in thousands of connections at once so let
+    // the kernel queue as many as it allows
+    int backlog = SOMAXCONN;
     if (::listen(socket.file_descriptor(), backlog) != 0) {
         return {Error::from_errno(errno, "listen()", ErrorDomain::NET)};
     }
@@ -24,6 +24,12 @@ public:
     [[nodiscard]] auto local_address() const -> const IpSocketAddress& { return local_address_; }
 
     auto accept(int timeout_ms) -> ErrorOr<ClientSocket>;
+    // Accepts a pending connection without waiting. Returns an empty optional
+    // when there are no pending connections.
+    auto try_accept() -> ErrorOr<std::optional<ClientSocket>>;
+    // Wraps a connection accepted from this socket by other means, such as
+    // io_uring, into a ClientSocket. The socket must be non-blocking.
+    auto adopt(int socket_fd) -> ErrorOr<ClientSocket>;
     auto close() noexcept -> void;
 
 private:
@@ -0,0 +1,136 @@
+#pragma once
+
+#include "Assertions.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <memory>
+#include <utility>
+#include <vector>
+
+namespace common {
+
+// Publication hands the latest value of something, such as the newest
+// sample of a topic, from a single writer to a fixed set of reader threads
+// without a lock on either side. The writer swaps in a new value with
+// publish(); readers take a reference to the latest one with load(), which
+// is wait-free: a handful of atomic loads and stores that never retry,
+// whatever the writer does in the meantime.
+//
+// Every value is numbered by a version, starting at 1, so that readers can
+// tell with a single atomic load whether anything was published since they
+// last looked.
+//
+// Values replaced by publish() are freed by epoch based reclamation: every
+// reader has a slot announcing the version it read while it is in load(),
+// and the writer frees a replaced value only once no slot announces a
+// version at or below its own. Readers thus never wait for the writer nor
+// the writer for readers; a reader stalled within load() merely delays
+// freeing the values published since.
+template <typename T>
+class Publication final {
+public:
+    using Pointer = std::shared_ptr<T>;
+
+    struct Published {
+        // null before the first publish()
+        Pointer value;
+        uint64_t version{0};
+    };
+
+    // Creates a publication read by up to reader_count threads, each using
+    // its own reader index in [0, reader_count).
+    explicit Publication(size_t reader_count) :
+        readers_(std::make_unique<ReaderSlot[]>(reader_count)),
+        reader_count_(reader_count),
+        current_(new Node{nullptr, 0}) {}
+
+    Publication(const Publication&) = delete;
+    Publication(Publication&&) noexcept = delete;
+
+    ~Publication() noexcept {
+        delete current_.load(std::memory_order_relaxed);
+        for (auto* node : retired_) {
+            delete node;
+        }
+    }
+
+    auto operator=(const Publication&) -> Publication& = delete;
+    auto operator=(Publication&&) noexcept -> Publication& = delete;
+
+    [[nodiscard]] auto reader_count() const -> size_t { return reader_count_; }
+
+    // Version of the latest value published; zero before the first one.
+    // Safe to call from any thread.
+    [[nodiscard]] auto version() const -> uint64_t { return version_.load(std::memory_order_acquire); }
+
+    // Makes value the latest and returns its version. Not to be called
+    // concurrently.
+    auto publish(Pointer value) -> uint64_t {
+        auto* previous = current_.load(std::memory_order_relaxed);
+        auto* node = new Node{std::move(value), previous->version + 1};
+        // sequentially consistent along with the announcements in load(), so
+        // that a reader either announced its version before reclaim() looks
+        // or sees the new node
+        current_.store(node, std::memory_order_seq_cst);
+        version_.store(node->version, std::memory_order_seq_cst);
+        retired_.push_back(previous);
+        reclaim();
+        return node->version;
+    }
+
+    // Returns the latest value along with its version. Each reader index
+    // must only be used by one thread at a time.
+    [[nodiscard]] auto load(size_t reader) const -> Published {
+        VERIFY(reader < reader_count_);
+        auto& slot = readers_[reader];
+        // the node loaded below is at least as new as the announced version,
+        // which keeps it from being freed until the slot is cleared
+        slot.announced.store(version_.load(std::memory_order_acquire), std::memory_order_seq_cst);
+        const auto* node = current_.load(std::memory_order_seq_cst);
+        Published published{node->value, node->version};
+        slot.announced.store(IDLE, std::memory_order_release);
+        return published;
+    }
+
+private:
+    // announced by readers outside of load()
+    static constexpr uint64_t IDLE = std::numeric_limits<uint64_t>::max();
+
+    struct Node {
+        Pointer value;
+        uint64_t version;
+    };
+
+    // a cache line each, so that readers announcing don't slow each other
+    // down
+    struct alignas(64) ReaderSlot {
+        std::atomic<uint64_t> announced{IDLE};
+    };
+
+    // Frees the retired nodes no reader may still be looking at.
+    auto reclaim() -> void {
+        auto oldest = IDLE;
+        for (size_t i = 0; i < reader_count_; ++i) {
+            oldest = std::min(oldest, readers_[i].announced.load(std::memory_order_seq_cst));
+        }
+        std::erase_if(retired_, [oldest](Node* node) {
+            if (node->version >= oldest) {
+                return false;
+            }
+            delete node;
+            return true;
+        });
+    }
+
+    std::unique_ptr<ReaderSlot[]> readers_;
+    size_t reader_count_;
+    std::atomic<Node*> current_;
+    std::atomic<uint64_t> version_{0};
+    // replaced nodes not freed yet; only touched by the writer
+    std::vector<Node*> retired_;
+};
+
+} // namespace common
@@ -0,0 +1,121 @@
+#include "Sha1.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+using namespace common;
+
+static inline auto load_be32(const uint8_t* bytes) -> uint32_t {
+    return (static_cast<uint32_t>(bytes[0]) << 24) | (static_cast<uint32_t>(bytes[1]) << 16) |
+           (static_cast<uint32_t>(bytes[2]) << 8) | static_cast<uint32_t>(bytes[3]);
+}
+
+auto Sha1::digest(std::span<const uint8_t> data) -> Digest {
+    Sha1 sha1;
+    sha1.update(data);
+    return sha1.finalize();
+}
+
+auto Sha1::update(std::span<const uint8_t> data) -> void {
+    total_length_ += data.size();
+
+    const auto* bytes = data.data();
+    auto remaining = data.size();
+
+    if (block_length_ > 0) {
+        auto count = std::min(remaining, BLOCK_SIZE - block_length_);
+        std::memcpy(block_.data() + block_length_, bytes, count);
+        block_length_ += count;
+        bytes += count;
+        remaining -= count;
+        if (block_length_ < BLOCK_SIZE) {
+            return;
+        }
+        process_block(block_.data());
+        block_length_ = 0;
+    }
+
+    // full blocks are processed straight from the input
+    for (; remaining >= BLOCK_SIZE; bytes += BLOCK_SIZE, remaining -= BLOCK_SIZE) {
+        process_block(bytes);
+    }
+
+    std::memcpy(block_.data(), bytes, remaining);
+    block_length_ = remaining;
+}
+
+auto Sha1::finalize() -> Digest {
+    const uint64_t total_bits = total_length_ * 8;
+
+    // pad with a single 1 bit, zeroes and the message length in bits so that
+    // the total length is a multiple of the block size
+    block_[block_length_++] = 0x80;
+    if (block_length_ > BLOCK_SIZE - 8) {
+        std::memset(block_.data() + block_length_, 0, BLOCK_SIZE - block_length_);
+        process_block(block_.data());
+        block_length_ = 0;
+    }
+    std::memset(block_.data() + block_length_, 0, BLOCK_SIZE - 8 - block_length_);
+    for (size_t i = 0; i < 8; ++i) {
+        block_[BLOCK_SIZE - 1 - i] = static_cast<uint8_t>(total_bits >> (i * 8));
+    }
+    process_block(block_.data());
+
+    Digest digest;
+    for (size_t i = 0; i < state_.size(); ++i) {
+        digest[i * 4 + 0] = static_cast<uint8_t>(state_[i] >> 24);
+        digest[i * 4 + 1] = static_cast<uint8_t>(state_[i] >> 16);
+        digest[i * 4 + 2] = static_cast<uint8_t>(state_[i] >> 8);
+        digest[i * 4 + 3] = static_cast<uint8_t>(state_[i]);
+    }
+    return digest;
+}
+
+auto Sha1::process_block(const uint8_t* block) -> void {
+    // message schedule kept as a rolling window of 16 words
+    std::array<uint32_t, 16> w;
+    for (size_t i = 0; i < 16; ++i) {
+        w[i] = load_be32(block + i * 4);
+    }
+
+    auto a = state_[0];
+    auto b = state_[1];
+    auto c = state_[2];
+    auto d = state_[3];
+    auto e = state_[4];
+
+    for (size_t i = 0; i < 80; ++i) {
+        if (i >= 16) {
+            w[i & 15] = std::rotl(w[(i + 13) & 15] ^ w[(i + 8) & 15] ^ w[(i + 2) & 15] ^ w[i & 15], 1);
+        }
+
+        uint32_t f;
+        uint32_t k;
+        if (i < 20) {
+            f = (b & c) | (~b & d);
+            k = 0x5A827999;
+        } else if (i < 40) {
+            f = b ^ c ^ d;
+            k = 0x6ED9EBA1;
+        } else if (i < 60) {
+            f = (b & c) | (b & d) | (c & d);
+            k = 0x8F1BBCDC;
+        } else {
+            f = b ^ c ^ d;
+            k = 0xCA62C1D6;
+        }
+
+        auto temp = std::rotl(a, 5) + f + e + k + w[i & 15];
+        e = d;
+        d = c;
+        c = std::rotl(b, 30);
+        b = a;
+        a = temp;
+    }
+
+    state_[0] += a;
+    state_[1] += b;
+    state_[2] += c;
+    state_[3] += d;
+    state_[4] += e;
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace common {
+
+// Sha1 computes SHA-1 digests (RFC 3174) incrementally without allocating.
+// SHA-1 is not fit for any security purpose; it is here because the
+// WebSocket handshake (RFC 6455) requires it.
+class Sha1 final {
+public:
+    static constexpr size_t DIGEST_SIZE = 20;
+    using Digest = std::array<uint8_t, DIGEST_SIZE>;
+
+    static auto digest(std::span<const uint8_t> data) -> Digest;
+
+    auto update(std::span<const uint8_t> data) -> void;
+    auto finalize() -> Digest;
+
+private:
+    static constexpr size_t BLOCK_SIZE = 64;
+
+    auto process_block(const uint8_t* block) -> void;
+
+    std::array<uint32_t, 5> state_{0x67452301, 0xEFCDAB89, 0x98BADCFE, 0x10325476, 0xC3D2E1F0};
+    std::array<uint8_t, BLOCK_SIZE> block_{};
+    size_t block_length_{0};
+    uint64_t total_length_{0};
+};
+
+} // namespace common
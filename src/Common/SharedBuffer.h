@@ -0,0 +1,151 @@
+#pragma once
+
+#include "Assertions.h"
+#include "BufferPool.h"
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <initializer_list>
+#include <new>
+#include <span>
+#include <utility>
+
+namespace common {
+
+// SharedBuffer is an immutable, reference counted byte buffer. The bytes are
+// written once when the buffer is created and stored in the same allocation
+// as the reference count; copying a SharedBuffer only bumps the count. The
+// count is atomic so copies may be handed to and released on other threads.
+//
+// Buffers of up to MAX_POOLED_SIZE bytes, which most frames are, live in a
+// chunk of the buffer pool; larger ones are allocated on the heap.
+class SharedBuffer final {
+public:
+    // a chunk less the reference count and size in front of the bytes
+    static constexpr size_t MAX_POOLED_SIZE = buffer_pool::CHUNK_SIZE - 16;
+
+    SharedBuffer() = default;
+
+    // Allocates a buffer of given size and lets writer fill it in place;
+    // writer is called with a std::span<uint8_t> covering the whole buffer.
+    template <typename Writer>
+    static auto create(size_t size, Writer&& writer) -> SharedBuffer {
+        const bool pooled = size <= MAX_POOLED_SIZE;
+        auto* memory = pooled ? buffer_pool::allocate() : ::operator new(sizeof(Storage) + size);
+        auto* storage = new (memory) Storage{.reference_count{1}, .pooled = pooled, .size = size};
+        writer(std::span<uint8_t>(storage->data(), size));
+        return SharedBuffer(storage);
+    }
+
+    // Copies the concatenation of given parts into pooled buffers of at most
+    // MAX_POOLED_SIZE bytes each and calls callback with each of them in
+    // order, so that large output can be queued as a chain of chunks rather
+    // than as a single large allocation.
+    template <typename Callback>
+    static auto chain_of(std::initializer_list<std::span<const uint8_t>> parts, Callback&& callback) -> void {
+        size_t remaining = 0;
+        for (auto part : parts) {
+            remaining += part.size();
+        }
+        const auto* part = parts.begin();
+        size_t offset = 0;
+        while (remaining > 0) {
+            auto size = std::min(remaining, MAX_POOLED_SIZE);
+            callback(create(size, [&part, &offset](std::span<uint8_t> buffer) {
+                while (!buffer.empty()) {
+                    auto length = std::min(buffer.size(), part->size() - offset);
+                    if (length > 0) {
+                        std::memcpy(buffer.data(), part->data() + offset, length);
+                    }
+                    buffer = buffer.subspan(length);
+                    offset += length;
+                    if (offset == part->size()) {
+                        ++part;
+                        offset = 0;
+                    }
+                }
+            }));
+            remaining -= size;
+        }
+    }
+
+    static auto copy_of(std::span<const uint8_t> bytes) -> SharedBuffer {
+        return create(bytes.size(), [&bytes](std::span<uint8_t> buffer) {
+            if (!bytes.empty()) {
+                std::memcpy(buffer.data(), bytes.data(), bytes.size());
+            }
+        });
+    }
+
+    SharedBuffer(const SharedBuffer& other) noexcept :
+        storage_(other.storage_) {
+        if (storage_ != nullptr) {
+            storage_->reference_count.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+
+    SharedBuffer(SharedBuffer&& other) noexcept :
+        storage_(std::exchange(other.storage_, nullptr)) {}
+
+    ~SharedBuffer() noexcept { release(); }
+
+    auto operator=(const SharedBuffer& rhs) noexcept -> SharedBuffer& {
+        if (this != &rhs) {
+            SharedBuffer copy(rhs);
+            std::swap(storage_, copy.storage_);
+        }
+        return *this;
+    }
+
+    auto operator=(SharedBuffer&& rhs) noexcept -> SharedBuffer& {
+        if (this != &rhs) {
+            release();
+            storage_ = std::exchange(rhs.storage_, nullptr);
+        }
+        return *this;
+    }
+
+    [[nodiscard]] auto bytes() const -> std::span<const uint8_t> {
+        return storage_ == nullptr ? std::span<const uint8_t>() : std::span<const uint8_t>(storage_->data(), size());
+    }
+    [[nodiscard]] auto size() const -> size_t { return storage_ == nullptr ? 0 : storage_->size; }
+    [[nodiscard]] auto is_empty() const -> bool { return size() == 0; }
+    [[nodiscard]] auto use_count() const -> size_t {
+        return storage_ == nullptr ? 0 : storage_->reference_count.load(std::memory_order_relaxed);
+    }
+
+private:
+    struct Storage {
+        std::atomic<uint32_t> reference_count;
+        // whether the storage is a chunk of the buffer pool
+        bool pooled;
+        size_t size;
+
+        // the bytes follow the header in the same allocation
+        auto data() -> uint8_t* { return reinterpret_cast<uint8_t*>(this + 1); }
+    };
+
+    static_assert(sizeof(Storage) + MAX_POOLED_SIZE == buffer_pool::CHUNK_SIZE);
+
+    explicit SharedBuffer(Storage* storage) :
+        storage_(storage) {}
+
+    auto release() noexcept -> void {
+        auto* storage = std::exchange(storage_, nullptr);
+        if (storage != nullptr && storage->reference_count.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            const bool pooled = storage->pooled;
+            storage->~Storage();
+            if (pooled) {
+                buffer_pool::release(storage);
+            } else {
+                ::operator delete(storage);
+            }
+        }
+    }
+
+    Storage* storage_{nullptr};
+};
+
+} // namespace common
@@ -0,0 +1,47 @@
+#include "Simd.h"
+#include "Assertions.h"
+
+using namespace common;
+using namespace common::simd;
+
+auto simd::format_implementation(Implementation implementation) -> std::string_view {
+    switch (implementation) {
+    case Implementation::SCALAR:
+        return "scalar";
+    case Implementation::SSE2:
+        return "sse2";
+    case Implementation::AVX2:
+        return "avx2";
+    }
+    VERIFY_NOT_REACHED();
+}
+
+auto simd::is_supported(Implementation implementation) -> bool {
+    switch (implementation) {
+    case Implementation::SCALAR:
+        return true;
+#ifdef COMMON_SIMD_X86
+    case Implementation::SSE2:
+        return __builtin_cpu_supports("sse2");
+    case Implementation::AVX2:
+        return __builtin_cpu_supports("avx2");
+#else
+    case Implementation::SSE2:
+    case Implementation::AVX2:
+        return false;
+#endif
+    }
+    VERIFY_NOT_REACHED();
+}
+
+auto simd::best_implementation() -> Implementation {
+    static const Implementation implementation = [] {
+        for (auto candidate : {Implementation::AVX2, Implementation::SSE2}) {
+            if (is_supported(candidate)) {
+                return candidate;
+            }
+        }
+        return Implementation::SCALAR;
+    }();
+    return implementation;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <string_view>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define COMMON_SIMD_X86 1
+#endif
+
+// CPU feature detection shared by the vectorized kernels, such as
+// ws::masking and metrics::reductions. Every kernel comes in each of the
+// implementations below, compiled with __attribute__((target(...))) so that
+// the binary still runs on CPUs lacking the instructions, and dispatches to
+// best_implementation() through a function pointer chosen on first use.
+//
+// AVX2 kernels returning to SSE code end with _mm256_zeroupper(). Compilers
+// only insert it themselves when optimizing; without it the SSE code of the
+// caller runs with dirty upper halves, which costs hundreds of cycles per
+// call on some CPUs.
+namespace common::simd {
+
+enum class Implementation : int {
+    SCALAR = 1,
+    SSE2 = 2,
+    AVX2 = 3,
+};
+
+auto format_implementation(Implementation implementation) -> std::string_view;
+
+// Returns true when the implementation can run on this CPU.
+auto is_supported(Implementation implementation) -> bool;
+
+// Returns the fastest implementation supported by this CPU; chosen once on
+// first use.
+auto best_implementation() -> Implementation;
+
+} // namespace common::simd
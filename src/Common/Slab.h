@@ -0,0 +1,158 @@
+#pragma once
+
+#include "Assertions.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace common {
+
+// Slab keeps objects, such as the connections of a reactor, in slots of
+// chunks allocated SLOTS_PER_CHUNK at a time and never freed before the slab
+// is. Objects are never moved once constructed, and a freed slot goes on a
+// free list to be reused by the next object, so a slab that has grown to its
+// peak size adds and removes objects in constant time without allocating,
+// however many come and go.
+//
+// Objects are referred to by handles made of their slot index and the
+// slot's generation, which changes whenever an object is added or removed.
+// A handle kept past its object's removal, say by a timer or a completion
+// still in flight, thus finds nothing rather than whichever object took the
+// slot over. Handles are never zero and fit in 56 bits, leaving the top byte
+// to callers packing them along with something else.
+template <typename T>
+class Slab final {
+public:
+    using Handle = uint64_t;
+
+    static constexpr Handle NO_HANDLE = 0;
+    static constexpr size_t SLOTS_PER_CHUNK = 256;
+
+    explicit Slab(size_t capacity = 0) { reserve(capacity); }
+
+    Slab(const Slab&) = delete;
+    Slab(Slab&&) noexcept = delete;
+    ~Slab() noexcept { clear(); }
+
+    auto operator=(const Slab&) -> Slab& = delete;
+    auto operator=(Slab&&) noexcept -> Slab& = delete;
+
+    [[nodiscard]] auto size() const -> size_t { return size_; }
+    [[nodiscard]] auto is_empty() const -> bool { return size_ == 0; }
+    [[nodiscard]] auto capacity() const -> size_t { return chunks_.size() * SLOTS_PER_CHUNK; }
+
+    // Allocates slots for at least given number of objects up front.
+    auto reserve(size_t capacity) -> void {
+        while (this->capacity() < capacity) {
+            add_chunk();
+        }
+    }
+
+    // Constructs an object in a free slot and returns its handle along with
+    // the object.
+    template <typename... Args>
+    auto emplace(Args&&... args) -> std::pair<Handle, T&> {
+        if (free_.empty()) {
+            add_chunk();
+        }
+        auto index = free_.back();
+        auto& slot = slot_at(index);
+        auto* value = new (slot.storage) T(std::forward<Args>(args)...);
+        free_.pop_back();
+        ++slot.generation;
+        ++size_;
+        return {make_handle(index, slot.generation), *value};
+    }
+
+    // Returns the object of given handle; null when it was removed already.
+    [[nodiscard]] auto find(Handle handle) -> T* {
+        auto index = static_cast<uint32_t>(handle);
+        if (index >= capacity()) {
+            return nullptr;
+        }
+        auto& slot = slot_at(index);
+        if (!is_live(slot) || make_handle(index, slot.generation) != handle) {
+            return nullptr;
+        }
+        return slot.value();
+    }
+
+    // Destroys the object of given handle and frees its slot; returns
+    // whether there was one.
+    auto erase(Handle handle) -> bool {
+        auto* value = find(handle);
+        if (value == nullptr) {
+            return false;
+        }
+        auto index = static_cast<uint32_t>(handle);
+        value->~T();
+        ++slot_at(index).generation;
+        free_.push_back(index);
+        --size_;
+        return true;
+    }
+
+    // Destroys every object, keeping the slots.
+    auto clear() -> void {
+        for_each([this](Handle handle, T&) { erase(handle); });
+    }
+
+    // Calls callback with the handle and object of every object in slot
+    // order. The callback may erase the object it is called with but must
+    // not add any.
+    template <typename Callback>
+    auto for_each(Callback&& callback) -> void {
+        for (uint32_t index = 0; index < capacity() && size_ > 0; ++index) {
+            auto& slot = slot_at(index);
+            if (is_live(slot)) {
+                callback(make_handle(index, slot.generation), *slot.value());
+            }
+        }
+    }
+
+private:
+    // generations are kept to 24 bits in handles; they wrap around after 8
+    // million objects came and went through the same slot
+    static constexpr uint32_t GENERATION_MASK = 0xFFFFFF;
+
+    struct Slot {
+        alignas(T) std::byte storage[sizeof(T)];
+        // odd while the slot holds an object
+        uint32_t generation{0};
+
+        auto value() -> T* { return std::launder(reinterpret_cast<T*>(storage)); }
+    };
+
+    using Chunk = std::array<Slot, SLOTS_PER_CHUNK>;
+
+    static auto is_live(const Slot& slot) -> bool { return (slot.generation & 1) != 0; }
+
+    // Live slots have odd generations, so handles are never zero.
+    static auto make_handle(uint32_t index, uint32_t generation) -> Handle {
+        return (static_cast<uint64_t>(generation & GENERATION_MASK) << 32) | index;
+    }
+
+    auto slot_at(uint32_t index) -> Slot& { return (*chunks_[index / SLOTS_PER_CHUNK])[index % SLOTS_PER_CHUNK]; }
+
+    auto add_chunk() -> void {
+        VERIFY(capacity() + SLOTS_PER_CHUNK <= UINT32_MAX);
+        auto first = static_cast<uint32_t>(capacity());
+        chunks_.push_back(std::make_unique<Chunk>());
+        free_.reserve(capacity());
+        // the lowest index is taken first
+        for (auto index = first + SLOTS_PER_CHUNK; index > first; --index) {
+            free_.push_back(index - 1);
+        }
+    }
+
+    std::vector<std::unique_ptr<Chunk>> chunks_;
+    // the slot freed last is reused first, while it's still in the cache
+    std::vector<uint32_t> free_;
+    size_t size_{0};
+};
+
+} // namespace common
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <string>
 #include <thread>
@@ -15,9 +16,10 @@ public:
     auto operator=(const Runnable&) -> Runnable& = delete;
     auto operator=(Runnable&&) noexcept -> Runnable& = delete;
 
-    [[nodiscard]] auto stop_requested() const -> bool { return stop_requested_; }
+    [[nodiscard]] auto stop_requested() const -> bool { return stop_requested_.load(std::memory_order_relaxed); }
 
-    auto request_stop() noexcept -> void { stop_requested_ = true; }
+    // Called from the thread stopping this one.
+    auto request_stop() noexcept -> void { stop_requested_.store(true, std::memory_order_relaxed); }
 
     virtual auto run() noexcept -> void = 0;
 
@@ -25,7 +27,7 @@ protected:
     Runnable() = default;
 
 private:
-    bool stop_requested_{false};
+    std::atomic<bool> stop_requested_{false};
 };
 
 class Thread final {
@@ -0,0 +1,148 @@
+#include "TimerWheel.h"
+#include <algorithm>
+#include <bit>
+
+using namespace common;
+
+static constexpr uint64_t MAX_DISTANCE = (uint64_t{1} << (TimerWheel::SLOT_BITS * TimerWheel::LEVELS)) - 1;
+
+Timer::~Timer() noexcept {
+    if (wheel_ != nullptr) {
+        wheel_->cancel(*this);
+    }
+}
+
+TimerWheel::~TimerWheel() noexcept {
+    // disarm timers outliving the wheel so they don't point back at it
+    for (auto& level : slots_) {
+        for (auto* timer : level) {
+            while (timer != nullptr) {
+                auto* next = timer->next_;
+                timer->wheel_ = nullptr;
+                timer->previous_ = nullptr;
+                timer->next_ = nullptr;
+                timer = next;
+            }
+        }
+    }
+}
+
+auto TimerWheel::to_tick_floor(Clock::time_point time) const -> uint64_t {
+    if (time <= epoch_) {
+        return 0;
+    }
+    return static_cast<uint64_t>((time - epoch_) / TICK);
+}
+
+auto TimerWheel::schedule(Timer& timer, Clock::time_point expires_at) -> void {
+    if (timer.is_armed()) {
+        unlink(timer);
+    }
+    // round up so that timers never fire early, and never into the tick
+    // that is currently being (or has been) processed
+    auto since_epoch = expires_at > epoch_ ? expires_at - epoch_ : Clock::duration::zero();
+    // clamp before rounding so that far away deadlines can't overflow
+    since_epoch = std::min<Clock::duration>(since_epoch, (current_tick_ + MAX_DISTANCE) * TICK);
+    auto expires_tick = static_cast<uint64_t>((since_epoch + TICK - Clock::duration(1)) / TICK);
+    expires_tick = std::max(expires_tick, current_tick_ + 1);
+    expires_tick = std::min(expires_tick, current_tick_ + MAX_DISTANCE);
+
+    timer.expires_tick_ = expires_tick;
+    timer.wheel_ = this;
+    ++armed_count_;
+    insert(timer);
+}
+
+auto TimerWheel::cancel(Timer& timer) -> void {
+    if (timer.wheel_ == this) {
+        unlink(timer);
+    }
+}
+
+auto TimerWheel::insert(Timer& timer) -> void {
+    // pick the lowest level whose range covers the remaining distance
+    auto distance = timer.expires_tick_ > current_tick_ ? timer.expires_tick_ - current_tick_ : 0;
+    size_t level = 0;
+    while (level + 1 < LEVELS && distance >= (uint64_t{1} << (SLOT_BITS * (level + 1)))) {
+        ++level;
+    }
+    auto slot = static_cast<size_t>((timer.expires_tick_ >> (SLOT_BITS * level)) & (SLOTS - 1));
+
+    timer.level_ = static_cast<uint8_t>(level);
+    timer.slot_ = static_cast<uint8_t>(slot);
+    timer.previous_ = nullptr;
+    timer.next_ = slots_[level][slot];
+    if (timer.next_ != nullptr) {
+        timer.next_->previous_ = &timer;
+    }
+    slots_[level][slot] = &timer;
+    occupied_[level] |= uint64_t{1} << slot;
+}
+
+auto TimerWheel::unlink(Timer& timer) -> void {
+    VERIFY(timer.wheel_ == this);
+    if (timer.previous_ != nullptr) {
+        timer.previous_->next_ = timer.next_;
+    } else {
+        slots_[timer.level_][timer.slot_] = timer.next_;
+        if (timer.next_ == nullptr) {
+            occupied_[timer.level_] &= ~(uint64_t{1} << timer.slot_);
+        }
+    }
+    if (timer.next_ != nullptr) {
+        timer.next_->previous_ = timer.previous_;
+    }
+    timer.wheel_ = nullptr;
+    timer.previous_ = nullptr;
+    timer.next_ = nullptr;
+    --armed_count_;
+}
+
+auto TimerWheel::cascade() -> void {
+    // find the highest level whose slot boundary was just crossed and move
+    // its due slot down, highest first so that timers cascade all the way
+    size_t top_level = 0;
+    while (top_level + 1 < LEVELS && (current_tick_ & ((uint64_t{1} << (SLOT_BITS * (top_level + 1))) - 1)) == 0) {
+        ++top_level;
+    }
+    for (auto level = top_level; level > 0; --level) {
+        auto slot = static_cast<size_t>((current_tick_ >> (SLOT_BITS * level)) & (SLOTS - 1));
+        auto* timer = slots_[level][slot];
+        slots_[level][slot] = nullptr;
+        occupied_[level] &= ~(uint64_t{1} << slot);
+        while (timer != nullptr) {
+            auto* next = timer->next_;
+            insert(*timer);
+            timer = next;
+        }
+    }
+}
+
+auto TimerWheel::next_event_tick() const -> uint64_t {
+    if (armed_count_ == 0) {
+        return 0;
+    }
+    // level 0 holds everything due within the next 64 ticks; rotate its
+    // occupancy so that bit 0 stands for the next tick
+    auto next = (current_tick_ + 1) & (SLOTS - 1);
+    auto rotated = std::rotr(occupied_[0], static_cast<int>(next));
+    if (rotated != 0) {
+        return current_tick_ + 1 + static_cast<uint64_t>(std::countr_zero(rotated));
+    }
+    // otherwise nothing can fire before the next level 1 boundary, at which
+    // timers are cascaded down
+    return ((current_tick_ >> SLOT_BITS) + 1) << SLOT_BITS;
+}
+
+auto TimerWheel::time_until_next_tick(Clock::time_point now) const -> std::chrono::milliseconds {
+    auto tick = next_event_tick();
+    if (tick == 0) {
+        return std::chrono::milliseconds(-1);
+    }
+    auto due = epoch_ + tick * TICK;
+    if (due <= now) {
+        return std::chrono::milliseconds(0);
+    }
+    // round up; waking up early would only mean an empty turn
+    return std::chrono::ceil<std::chrono::milliseconds>(due - now);
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include "Assertions.h"
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace common {
+
+class TimerWheel;
+
+// Timer is an intrusive timer node embedded in whatever owns the timeout,
+// so arming and cancelling never allocate. A timer can only be moved while
+// it is not armed and is cancelled automatically when destroyed.
+class Timer final {
+public:
+    explicit Timer(uint64_t user_data = 0) :
+        user_data_(user_data) {}
+
+    Timer(const Timer&) = delete;
+    Timer(Timer&& other) noexcept :
+        user_data_(other.user_data_) {
+        VERIFY(!other.is_armed());
+    }
+    ~Timer() noexcept;
+
+    auto operator=(const Timer&) -> Timer& = delete;
+    auto operator=(Timer&& rhs) noexcept -> Timer& {
+        VERIFY(!is_armed() && !rhs.is_armed());
+        user_data_ = rhs.user_data_;
+        return *this;
+    }
+
+    [[nodiscard]] auto is_armed() const -> bool { return wheel_ != nullptr; }
+    [[nodiscard]] auto user_data() const -> uint64_t { return user_data_; }
+    auto set_user_data(uint64_t user_data) -> void { user_data_ = user_data; }
+
+private:
+    friend class TimerWheel;
+
+    uint64_t user_data_;
+    TimerWheel* wheel_{nullptr};
+    Timer* previous_{nullptr};
+    Timer* next_{nullptr};
+    uint64_t expires_tick_{0};
+    uint8_t level_{0};
+    uint8_t slot_{0};
+};
+
+// TimerWheel is a hierarchical timing wheel (Varghese & Lauck) with four
+// levels of 64 slots. Level 0 has one slot per tick; each higher level
+// covers 64 times the range of the one below, so with 10 ms ticks timers
+// up to about 46 hours away are held exactly and later ones are clamped.
+// Scheduling and cancelling are O(1) list operations; timers in higher
+// levels are cascaded down as the wheel turns. Timers never fire early but
+// may fire up to one tick late.
+//
+// Instances must only be used from a single thread.
+class TimerWheel final {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    static constexpr auto TICK = std::chrono::milliseconds(10);
+    static constexpr size_t LEVELS = 4;
+    static constexpr size_t SLOT_BITS = 6;
+    static constexpr size_t SLOTS = size_t{1} << SLOT_BITS;
+
+    explicit TimerWheel(Clock::time_point now = Clock::now()) :
+        epoch_(now) {}
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel(TimerWheel&&) = delete;
+    ~TimerWheel() noexcept;
+
+    auto operator=(const TimerWheel&) -> TimerWheel& = delete;
+    auto operator=(TimerWheel&&) -> TimerWheel& = delete;
+
+    // Arms the timer to fire at given time, re-arming it if already armed.
+    auto schedule(Timer& timer, Clock::time_point expires_at) -> void;
+    auto cancel(Timer& timer) -> void;
+
+    // Fires every timer due by now by calling callback(Timer&). Timers are
+    // disarmed before their callback runs, which may schedule them again.
+    // Returns the number of timers fired.
+    template <typename Callback>
+    auto advance(Clock::time_point now, Callback&& callback) -> size_t {
+        auto target_tick = to_tick_floor(now);
+        size_t fired = 0;
+        while (current_tick_ < target_tick) {
+            if (armed_count_ == 0) {
+                current_tick_ = target_tick;
+                break;
+            }
+            ++current_tick_;
+            cascade();
+            auto slot = static_cast<size_t>(current_tick_ & (SLOTS - 1));
+            while (slots_[0][slot] != nullptr) {
+                auto& timer = *slots_[0][slot];
+                unlink(timer);
+                callback(timer);
+                ++fired;
+            }
+        }
+        return fired;
+    }
+
+    // Returns how long a caller may sleep before advance() has work to do,
+    // or a negative duration when no timer is armed. Suitable as the
+    // timeout for epoll_wait() or io_uring_enter().
+    [[nodiscard]] auto time_until_next_tick(Clock::time_point now) const -> std::chrono::milliseconds;
+
+    [[nodiscard]] auto armed_count() const -> size_t { return armed_count_; }
+
+private:
+    auto to_tick_floor(Clock::time_point time) const -> uint64_t;
+    auto insert(Timer& timer) -> void;
+    auto unlink(Timer& timer) -> void;
+    // Moves timers from higher levels down once the levels below wrapped.
+    auto cascade() -> void;
+    // Returns the next tick at which something is due or has to be
+    // cascaded; zero when nothing is armed.
+    [[nodiscard]] auto next_event_tick() const -> uint64_t;
+
+    Clock::time_point epoch_;
+    uint64_t current_tick_{0};
+    size_t armed_count_{0};
+    std::array<std::array<Timer*, SLOTS>, LEVELS> slots_{};
+    // bit n is set when slot n of the level holds timers
+    std::array<uint64_t, LEVELS> occupied_{};
+};
+
+} // namespace common
@@ -0,0 +1,77 @@
+#include "WorkerPool.h"
+#include <algorithm>
+
+using namespace common;
+
+WorkerPool::WorkerPool(size_t thread_count) {
+    threads_.reserve(thread_count);
+    for (size_t i = 0; i < thread_count; ++i) {
+        threads_.emplace_back([this](std::stop_token stop_token) { thread_main(std::move(stop_token)); });
+    }
+}
+
+auto WorkerPool::default_thread_count() -> size_t {
+    return std::min<size_t>(std::thread::hardware_concurrency() / 8, 3);
+}
+
+WorkerPool::~WorkerPool() noexcept {
+    for (auto& thread : threads_) {
+        thread.request_stop();
+    }
+    threads_.clear();
+}
+
+auto WorkerPool::run(size_t task_count, const Task& task) -> void {
+    if (threads_.empty() || task_count <= 1) {
+        for (size_t i = 0; i < task_count; ++i) {
+            task(i);
+        }
+        return;
+    }
+
+    {
+        std::lock_guard lock(mutex_);
+        task_ = &task;
+        task_count_ = task_count;
+        next_task_.store(0, std::memory_order_relaxed);
+        ++batch_;
+    }
+    work_condition_.notify_all();
+    work(task, task_count);
+
+    // threads that haven't picked up the batch by now find nothing left to
+    // take; only those that did may still be running a task
+    std::unique_lock lock(mutex_);
+    done_condition_.wait(lock, [this] { return busy_threads_ == 0; });
+    task_ = nullptr;
+}
+
+auto WorkerPool::work(const Task& task, size_t task_count) -> void {
+    for (auto i = next_task_.fetch_add(1, std::memory_order_relaxed); i < task_count;
+         i = next_task_.fetch_add(1, std::memory_order_relaxed)) {
+        task(i);
+    }
+}
+
+auto WorkerPool::thread_main(std::stop_token stop_token) -> void {
+    uint64_t batch = 0;
+    std::unique_lock lock(mutex_);
+    while (true) {
+        work_condition_.wait(lock, stop_token, [&] { return task_ != nullptr && batch_ != batch; });
+        if (stop_token.stop_requested()) {
+            return;
+        }
+        batch = batch_;
+        const auto& task = *task_;
+        auto task_count = task_count_;
+        ++busy_threads_;
+        lock.unlock();
+
+        work(task, task_count);
+
+        lock.lock();
+        if (--busy_threads_ == 0) {
+            done_condition_.notify_all();
+        }
+    }
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace common {
+
+// WorkerPool runs batches of independent tasks on a fixed set of threads.
+// The thread calling run() works on the batch as well and run() returns
+// once every task is done, so a pool of N threads runs up to N + 1 tasks at
+// a time and a pool without threads simply runs them in turn.
+class WorkerPool final {
+public:
+    using Task = std::function<void(size_t index)>;
+
+    explicit WorkerPool(size_t thread_count);
+
+    // A small pool for the machine's core count: one more thread for every
+    // eight cores, the calling thread included, up to four in all.
+    static auto default_thread_count() -> size_t;
+
+    WorkerPool(const WorkerPool&) = delete;
+    WorkerPool(WorkerPool&&) noexcept = delete;
+    ~WorkerPool() noexcept;
+
+    auto operator=(const WorkerPool&) -> WorkerPool& = delete;
+    auto operator=(WorkerPool&&) noexcept -> WorkerPool& = delete;
+
+    // Calls task with every index in [0, task_count), spread across the
+    // pool. Tasks must not throw. Not to be called concurrently.
+    auto run(size_t task_count, const Task& task) -> void;
+
+    [[nodiscard]] auto thread_count() const -> size_t { return threads_.size(); }
+
+private:
+    auto thread_main(std::stop_token stop_token) -> void;
+    // Runs tasks of the current batch until none are left to take.
+    auto work(const Task& task, size_t task_count) -> void;
+
+    std::mutex mutex_;
+    std::condition_variable_any work_condition_;
+    std::condition_variable done_condition_;
+    // the current batch; task_ is null between batches
+    const Task* task_{nullptr};
+    size_t task_count_{0};
+    uint64_t batch_{0};
+    // threads working on the current batch
+    size_t busy_threads_{0};
+    std::atomic<size_t> next_task_{0};
+
+    std::vector<std::jthread> threads_;
+};
+
+} // namespace common
@@ -0,0 +1,654 @@
+#include "CgroupCollector.h"
+#include "ProcFs.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cmath>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <sys/inotify.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+using namespace common;
+using namespace metrics;
+
+namespace {
+
+enum CgroupField : size_t {
+    CPU,
+    CPU_THROTTLED,
+    MEMORY,
+    MEMORY_MAX,
+    IO_READ_BYTES_PER_S,
+    IO_WRITE_BYTES_PER_S,
+    IO_READS_PER_S,
+    IO_WRITES_PER_S,
+    PIDS,
+    CPU_PRESSURE,
+    CPU_PRESSURE_FULL,
+    MEMORY_PRESSURE,
+    MEMORY_PRESSURE_FULL,
+    IO_PRESSURE,
+    IO_PRESSURE_FULL,
+};
+
+constexpr std::array<FieldDescriptor, 15> FIELDS = {{
+    field<"cpu">(FieldType::FLOAT),
+    field<"cpu_throttled">(FieldType::FLOAT),
+    field<"memory">(FieldType::UINT),
+    field<"memory_max">(FieldType::UINT),
+    field<"io_read_bytes_per_s">(FieldType::UINT),
+    field<"io_write_bytes_per_s">(FieldType::UINT),
+    field<"io_reads_per_s">(FieldType::UINT),
+    field<"io_writes_per_s">(FieldType::UINT),
+    field<"pids">(FieldType::UINT),
+    field<"cpu_pressure">(FieldType::FLOAT),
+    field<"cpu_pressure_full">(FieldType::FLOAT),
+    field<"memory_pressure">(FieldType::FLOAT),
+    field<"memory_pressure_full">(FieldType::FLOAT),
+    field<"io_pressure">(FieldType::FLOAT),
+    field<"io_pressure_full">(FieldType::FLOAT),
+}};
+constexpr Schema SCHEMA = {Topic::CGROUPS, "cgroup", FIELDS};
+
+// The files read at every sample. Those of a controller not enabled for
+// the cgroup are missing, as are some of the root cgroup's.
+enum CgroupFile : size_t {
+    CPU_STAT_FILE,
+    MEMORY_CURRENT_FILE,
+    MEMORY_MAX_FILE,
+    IO_STAT_FILE,
+    PIDS_CURRENT_FILE,
+    CPU_PRESSURE_FILE,
+    MEMORY_PRESSURE_FILE,
+    IO_PRESSURE_FILE,
+    FILE_COUNT,
+};
+
+constexpr std::array<const char*, FILE_COUNT> FILE_NAMES = {
+    "cpu.stat",
+    "memory.current",
+    "memory.max",
+    "io.stat",
+    "pids.current",
+    "cpu.pressure",
+    "memory.pressure",
+    "io.pressure",
+};
+
+// the counters turned into rates
+enum CgroupCounter : size_t {
+    CPU_USAGE_COUNTER,
+    CPU_THROTTLED_COUNTER,
+    IO_READ_BYTES_COUNTER,
+    IO_WRITE_BYTES_COUNTER,
+    IO_READS_COUNTER,
+    IO_WRITES_COUNTER,
+    COUNTER_COUNT,
+};
+
+// enabling a controller creates its files without any event to tell
+constexpr uint64_t MISSING_FILE_RETRY_SAMPLES = 60;
+// enough for every file but io.stat, which holds a line of about a hundred
+// bytes per device and is read into a buffer that grows
+constexpr size_t READ_BUFFER_SIZE = 4096;
+
+using ReadBuffer = std::array<char, READ_BUFFER_SIZE>;
+
+constexpr uint32_t DIRECTORY_EVENTS = IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR;
+
+// Leaves half the open files limit to the process table and a quarter to
+// the server's connections.
+auto max_open_files() -> size_t {
+    rlimit limit{};
+    if (::getrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur == RLIM_INFINITY) {
+        return 512;
+    }
+    return static_cast<size_t>(limit.rlim_cur) / 4;
+}
+
+// Returns the directory of the cgroup at given path in the hierarchy.
+auto directory_path(const std::string& root, const std::string& path) -> std::string {
+    return path == "/" ? root : root + path;
+}
+
+// Returns what the paths of the children of the cgroup at given path start
+// with; those of its further descendants sort right after.
+auto child_prefix(const std::string& path) -> std::string {
+    return path == "/" ? path : path + "/";
+}
+
+// Parses the averages over ten seconds of a pressure file:
+//   some avg10=1.52 avg60=0.87 avg300=0.25 total=123456
+//   full avg10=0.00 avg60=0.00 avg300=0.00 total=0
+auto parse_pressure(std::string_view text, double& some, double& full) -> void {
+    some = 0.0;
+    full = 0.0;
+    while (!text.empty()) {
+        auto line = procfs::next_line(text);
+        auto kind = procfs::next_field(line);
+        auto average = procfs::next_field(line);
+        if (!average.starts_with("avg10=")) {
+            continue;
+        }
+        average.remove_prefix(std::string_view("avg10=").size());
+        auto value = procfs::next_decimal(average);
+        if (kind == "some") {
+            some = value;
+        } else if (kind == "full") {
+            full = value;
+        }
+    }
+}
+
+} // namespace
+
+struct CgroupCollector::Cgroup {
+    explicit Cgroup(std::string path) :
+        path(std::move(path)) {
+        fds.fill(-1);
+    }
+
+    Cgroup(const Cgroup&) = delete;
+    Cgroup(Cgroup&&) noexcept = delete;
+    ~Cgroup() noexcept {
+        close_files();
+        if (directory_fd >= 0) {
+            ::close(directory_fd);
+        }
+    }
+
+    auto operator=(const Cgroup&) -> Cgroup& = delete;
+    auto operator=(Cgroup&&) noexcept -> Cgroup& = delete;
+
+    auto close_files() noexcept -> void {
+        for (auto& fd : fds) {
+            if (fd >= 0) {
+                ::close(fd);
+                fd = -1;
+            }
+        }
+    }
+
+    std::string path;
+    // kept open as long as the open files limit leaves room for it
+    int directory_fd{-1};
+    // whether this cgroup may keep its files open as well
+    bool keeps_files_open{false};
+    std::array<int, FILE_COUNT> fds{};
+    // bit per CgroupFile the cgroup was found not to have
+    uint32_t missing_files{0};
+    int directory_watch{-1};
+    int events_watch{-1};
+    // the root cgroup has no cgroup.events and always counts as populated
+    bool is_populated{true};
+
+    // whether the latest scan could read the cgroup
+    bool alive{false};
+    std::array<uint64_t, COUNTER_COUNT> counters{};
+    // of the previous scan; valid when has_previous_counters
+    std::array<uint64_t, COUNTER_COUNT> previous_counters{};
+    bool has_previous_counters{false};
+    uint64_t memory{0};
+    // zero when unlimited
+    uint64_t memory_max{0};
+    uint64_t pids{0};
+    double cpu_pressure{0.0};
+    double cpu_pressure_full{0.0};
+    double memory_pressure{0.0};
+    double memory_pressure_full{0.0};
+    double io_pressure{0.0};
+    double io_pressure_full{0.0};
+};
+
+CgroupCollector::CgroupCollector(std::string root, RateClock clock, std::optional<size_t> thread_count) :
+    root_(std::move(root)),
+    clock_(std::move(clock)),
+    max_open_files_(max_open_files()),
+    inotify_fd_(::inotify_init1(IN_NONBLOCK | IN_CLOEXEC)),
+    is_watching_(inotify_fd_ >= 0),
+    workers_(thread_count.value_or(WorkerPool::default_thread_count())) {}
+
+CgroupCollector::~CgroupCollector() noexcept {
+    if (inotify_fd_ >= 0) {
+        ::close(inotify_fd_);
+    }
+}
+
+auto CgroupCollector::schema() const -> const Schema& {
+    return SCHEMA;
+}
+
+auto CgroupCollector::update_tree() -> ErrorOr<void> {
+    if (cgroups_.empty()) {
+        // cgroup v1 hierarchies, mounted at the same place by older systems,
+        // have no such file
+        auto controllers_path = root_ + "/cgroup.controllers";
+        if (::access(controllers_path.c_str(), F_OK) != 0) {
+            return {Error::from_errno(errno, fmt::format("access({})", controllers_path), ErrorDomain::FILE)};
+        }
+        add_subtree("/");
+        return {};
+    }
+
+    read_events();
+    if (needs_rescan_ || (!is_watching_ && sample_ % RESCAN_SAMPLES == 0)) {
+        needs_rescan_ = false;
+        changed_directories_.clear();
+        changed_events_.clear();
+        rescan("/", true);
+        return {};
+    }
+    // a cgroup may have changed more than once, or be gone by now along
+    // with its parent
+    std::sort(changed_directories_.begin(), changed_directories_.end());
+    changed_directories_.erase(std::unique(changed_directories_.begin(), changed_directories_.end()),
+                               changed_directories_.end());
+    for (const auto& path : changed_directories_) {
+        if (cgroups_.contains(path)) {
+            rescan(path, false);
+        }
+    }
+    changed_directories_.clear();
+    for (const auto& path : changed_events_) {
+        if (auto it = cgroups_.find(path); it != cgroups_.end()) {
+            read_populated(*it->second);
+        }
+    }
+    changed_events_.clear();
+    return {};
+}
+
+auto CgroupCollector::read_events() -> void {
+    if (inotify_fd_ < 0) {
+        return;
+    }
+    alignas(inotify_event) std::array<char, 16384> buffer;
+    while (true) {
+        auto bytes_read = ::read(inotify_fd_, buffer.data(), buffer.size());
+        if (bytes_read < 0 && errno == EINTR) {
+            continue;
+        }
+        // EAGAIN once every event was read
+        if (bytes_read <= 0) {
+            return;
+        }
+        for (size_t offset = 0; offset < static_cast<size_t>(bytes_read);) {
+            inotify_event event{};
+            std::memcpy(&event, buffer.data() + offset, sizeof(event));
+            // null padded to the length
+            auto name = std::string_view(reinterpret_cast<const char*>(buffer.data() + offset + sizeof(event)));
+            offset += sizeof(event) + event.len;
+            if ((event.mask & IN_Q_OVERFLOW) != 0) {
+                needs_rescan_ = true;
+                continue;
+            }
+            // unknown for the cgroups removed meanwhile
+            auto it = watches_.find(event.wd);
+            if (it == watches_.end()) {
+                continue;
+            }
+            const auto& cgroup = *it->second;
+            if (event.wd == cgroup.events_watch) {
+                if ((event.mask & IN_MODIFY) != 0) {
+                    changed_events_.push_back(cgroup.path);
+                }
+            } else if ((event.mask & IN_ISDIR) != 0) {
+                auto parent = cgroup.path;
+                // forgotten right away rather than by the rescan of the
+                // parent, which would take a cgroup recreated under the same
+                // name meanwhile, as services being restarted are, for the
+                // one removed and keep its stale descriptors and watches
+                if ((event.mask & (IN_DELETE | IN_MOVED_FROM)) != 0) {
+                    remove_subtree(child_prefix(parent) + std::string(name));
+                }
+                changed_directories_.push_back(std::move(parent));
+            }
+        }
+    }
+}
+
+auto CgroupCollector::add_subtree(const std::string& path) -> void {
+    auto directory = directory_path(root_, path);
+    auto cgroup = std::make_unique<Cgroup>(path);
+    // watched before being listed, so that no child created meanwhile is
+    // missed
+    if (is_watching_) {
+        cgroup->directory_watch = ::inotify_add_watch(inotify_fd_, directory.c_str(), DIRECTORY_EVENTS);
+        if (cgroup->directory_watch < 0 && (errno == ENOENT || errno == ENOTDIR)) {
+            // removed meanwhile
+            return;
+        }
+    }
+    if (is_watching_ && path != "/") {
+        auto events_path = directory + "/cgroup.events";
+        cgroup->events_watch = ::inotify_add_watch(inotify_fd_, events_path.c_str(), IN_MODIFY);
+    }
+    for (auto watch : {cgroup->directory_watch, cgroup->events_watch}) {
+        if (watch >= 0) {
+            watches_.emplace(watch, cgroup.get());
+        }
+    }
+    // most likely out of watches, see fs.inotify.max_user_watches
+    if (is_watching_ && (cgroup->directory_watch < 0 || (path != "/" && cgroup->events_watch < 0))) {
+        is_watching_ = false;
+    }
+
+    // the directory is kept open while there is room for it, so that its
+    // files are opened relative to it, and the files while there is room
+    // for all of them
+    if (open_file_count_ < max_open_files_) {
+        cgroup->directory_fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (cgroup->directory_fd >= 0) {
+            ++open_file_count_;
+            if (open_file_count_ + FILE_COUNT <= max_open_files_) {
+                cgroup->keeps_files_open = true;
+                open_file_count_ += FILE_COUNT;
+            }
+        }
+    }
+    auto& added = *cgroups_.emplace(path, std::move(cgroup)).first->second;
+    if (path != "/") {
+        added.is_populated = false;
+        read_populated(added);
+    }
+    is_tree_changed_ = true;
+    rescan(path, false);
+}
+
+auto CgroupCollector::remove_subtree(const std::string& path) -> void {
+    auto it = cgroups_.find(path);
+    if (it == cgroups_.end()) {
+        return;
+    }
+    auto release = [this](const Cgroup& cgroup) {
+        for (auto watch : {cgroup.directory_watch, cgroup.events_watch}) {
+            if (watch >= 0) {
+                watches_.erase(watch);
+                // fails when removing the directory removed the watch
+                // already
+                ::inotify_rm_watch(inotify_fd_, watch);
+            }
+        }
+        if (cgroup.directory_fd >= 0) {
+            --open_file_count_;
+        }
+        if (cgroup.keeps_files_open) {
+            open_file_count_ -= FILE_COUNT;
+        }
+    };
+    release(*it->second);
+    cgroups_.erase(it);
+
+    // '0' follows '/'
+    auto prefix = child_prefix(path);
+    auto end_prefix = prefix;
+    end_prefix.back() = '0';
+    auto begin = cgroups_.lower_bound(prefix);
+    auto end = cgroups_.lower_bound(end_prefix);
+    for (auto descendant = begin; descendant != end; ++descendant) {
+        release(*descendant->second);
+    }
+    cgroups_.erase(begin, end);
+    is_tree_changed_ = true;
+}
+
+auto CgroupCollector::rescan(const std::string& path, bool deep) -> void {
+    std::vector<std::string> names;
+    auto directory = directory_path(root_, path);
+    ++listed_directory_count_;
+    auto* stream = ::opendir(directory.c_str());
+    if (stream == nullptr) {
+        // removed meanwhile; the watch of its parent tells
+        return;
+    }
+    while (auto* entry = ::readdir(stream)) {
+        auto name = std::string_view(entry->d_name);
+        if (entry->d_type == DT_DIR && name != "." && name != "..") {
+            names.emplace_back(name);
+        }
+    }
+    ::closedir(stream);
+    std::sort(names.begin(), names.end());
+
+    // the children known, skipping the cgroups beneath them
+    auto prefix = child_prefix(path);
+    std::vector<std::string> children;
+    for (auto it = cgroups_.lower_bound(prefix); it != cgroups_.end() && it->first.starts_with(prefix);) {
+        auto name = std::string_view(it->first).substr(prefix.size());
+        if (name.empty()) {
+            // the root itself
+            ++it;
+        } else if (auto slash = name.find('/'); slash != std::string_view::npos) {
+            it = cgroups_.lower_bound(fmt::format("{}{}0", prefix, name.substr(0, slash)));
+        } else {
+            children.emplace_back(name);
+            ++it;
+        }
+    }
+    std::sort(children.begin(), children.end());
+
+    std::vector<std::string> removed;
+    std::set_difference(children.begin(), children.end(), names.begin(), names.end(), std::back_inserter(removed));
+    for (const auto& name : removed) {
+        remove_subtree(prefix + name);
+    }
+    for (const auto& name : names) {
+        auto child_path = prefix + name;
+        auto it = cgroups_.find(child_path);
+        if (it == cgroups_.end()) {
+            add_subtree(child_path);
+        } else if (deep) {
+            read_populated(*it->second);
+            rescan(child_path, true);
+        }
+    }
+}
+
+auto CgroupCollector::read_populated(Cgroup& cgroup) -> void {
+    // cgroup.events reads
+    //   populated 1
+    //   frozen 0
+    auto is_populated = false;
+    auto fd = open_file(cgroup, "cgroup.events");
+    if (fd >= 0) {
+        ReadBuffer buffer;
+        auto text_or_error = procfs::read_file(fd, buffer);
+        ::close(fd);
+        auto text = text_or_error.is_error() ? std::string_view() : text_or_error.value();
+        while (!text.empty()) {
+            auto line = procfs::next_line(text);
+            if (procfs::next_field(line) == "populated") {
+                is_populated = procfs::next_uint(line) != 0;
+                break;
+            }
+        }
+    }
+    if (cgroup.is_populated != is_populated) {
+        cgroup.is_populated = is_populated;
+        // the counters of an empty cgroup aren't read; those of its previous
+        // processes are stale by the time it is populated again
+        cgroup.has_previous_counters = false;
+        is_tree_changed_ = true;
+    }
+}
+
+auto CgroupCollector::open_file(const Cgroup& cgroup, const char* name) const -> int {
+    if (cgroup.directory_fd >= 0) {
+        return ::openat(cgroup.directory_fd, name, O_RDONLY | O_CLOEXEC);
+    }
+    auto path = fmt::format("{}/{}", directory_path(root_, cgroup.path), name);
+    return ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+}
+
+auto CgroupCollector::scan(Cgroup& cgroup, bool retry_missing_files) const -> void {
+    ReadBuffer buffer;
+    cgroup.alive = false;
+
+    // returns nothing when the cgroup doesn't have the file or went away;
+    // the contents are valid until the next call
+    // one per worker thread, kept for the next sample
+    thread_local std::vector<char> io_stat_buffer;
+
+    auto read_cgroup_file = [&](CgroupFile file) -> std::optional<std::string_view> {
+        auto bit = uint32_t{1} << file;
+        if ((cgroup.missing_files & bit) != 0 && !retry_missing_files) {
+            return {};
+        }
+        auto& fd = cgroup.fds[file];
+        if (fd < 0) {
+            fd = open_file(cgroup, FILE_NAMES[file]);
+            if (fd < 0) {
+                if (errno == ENOENT) {
+                    cgroup.missing_files |= bit;
+                }
+                return {};
+            }
+            cgroup.missing_files &= ~bit;
+        }
+        auto text_or_error = file == IO_STAT_FILE ? procfs::read_file(fd, io_stat_buffer)
+                                                  : procfs::read_file(fd, buffer);
+        if (!cgroup.keeps_files_open || text_or_error.is_error()) {
+            ::close(fd);
+            fd = -1;
+        }
+        if (text_or_error.is_error()) {
+            return {};
+        }
+        return text_or_error.value();
+    };
+
+    // every cgroup has a cpu.stat, whether the cpu controller is enabled
+    // or not
+    auto cpu_stat = read_cgroup_file(CPU_STAT_FILE);
+    if (!cpu_stat) {
+        return;
+    }
+    for (auto text = *cpu_stat; !text.empty();) {
+        auto line = procfs::next_line(text);
+        auto name = procfs::next_field(line);
+        if (name == "usage_usec") {
+            cgroup.counters[CPU_USAGE_COUNTER] = procfs::next_uint(line);
+        } else if (name == "throttled_usec") {
+            cgroup.counters[CPU_THROTTLED_COUNTER] = procfs::next_uint(line);
+        }
+    }
+
+    auto memory_current = read_cgroup_file(MEMORY_CURRENT_FILE);
+    cgroup.memory = memory_current ? procfs::parse_uint(procfs::next_line(*memory_current)) : 0;
+    // "max" when unlimited, which parses as zero
+    auto memory_max = read_cgroup_file(MEMORY_MAX_FILE);
+    cgroup.memory_max = memory_max ? procfs::parse_uint(procfs::next_line(*memory_max)) : 0;
+    auto pids_current = read_cgroup_file(PIDS_CURRENT_FILE);
+    cgroup.pids = pids_current ? procfs::parse_uint(procfs::next_line(*pids_current)) : 0;
+
+    // a line per device:
+    //   8:0 rbytes=90112 wbytes=0 rios=3 wios=0 dbytes=0 dios=0
+    for (auto counter : {IO_READ_BYTES_COUNTER, IO_WRITE_BYTES_COUNTER, IO_READS_COUNTER, IO_WRITES_COUNTER}) {
+        cgroup.counters[counter] = 0;
+    }
+    if (auto io_stat = read_cgroup_file(IO_STAT_FILE)) {
+        for (auto text = *io_stat; !text.empty();) {
+            auto line = procfs::next_line(text);
+            procfs::next_field(line);
+            while (!line.empty()) {
+                auto field = procfs::next_field(line);
+                auto equals = field.find('=');
+                if (equals == std::string_view::npos) {
+                    continue;
+                }
+                auto name = field.substr(0, equals);
+                auto value = procfs::parse_uint(field.substr(equals + 1));
+                if (name == "rbytes") {
+                    cgroup.counters[IO_READ_BYTES_COUNTER] += value;
+                } else if (name == "wbytes") {
+                    cgroup.counters[IO_WRITE_BYTES_COUNTER] += value;
+                } else if (name == "rios") {
+                    cgroup.counters[IO_READS_COUNTER] += value;
+                } else if (name == "wios") {
+                    cgroup.counters[IO_WRITES_COUNTER] += value;
+                }
+            }
+        }
+    }
+
+    auto cpu_pressure = read_cgroup_file(CPU_PRESSURE_FILE);
+    parse_pressure(cpu_pressure.value_or(std::string_view()), cgroup.cpu_pressure, cgroup.cpu_pressure_full);
+    auto memory_pressure = read_cgroup_file(MEMORY_PRESSURE_FILE);
+    parse_pressure(memory_pressure.value_or(std::string_view()), cgroup.memory_pressure, cgroup.memory_pressure_full);
+    auto io_pressure = read_cgroup_file(IO_PRESSURE_FILE);
+    parse_pressure(io_pressure.value_or(std::string_view()), cgroup.io_pressure, cgroup.io_pressure_full);
+    cgroup.alive = true;
+}
+
+auto CgroupCollector::collect(Snapshot& snapshot) -> ErrorOr<void> {
+    ++sample_;
+    TRY(update_tree());
+    if (is_tree_changed_) {
+        populated_.clear();
+        for (const auto& [path, cgroup] : cgroups_) {
+            if (cgroup->is_populated) {
+                populated_.push_back(cgroup.get());
+            }
+        }
+        is_tree_changed_ = false;
+    }
+
+    auto now = clock_();
+    auto elapsed = previous_time_ ? std::chrono::duration<double>(now - *previous_time_).count() : 0.0;
+    previous_time_ = now;
+
+    auto retry_missing_files = sample_ % MISSING_FILE_RETRY_SAMPLES == 0;
+    auto task_count = (populated_.size() + CGROUPS_PER_TASK - 1) / CGROUPS_PER_TASK;
+    workers_.run(task_count, [this, retry_missing_files](size_t task) {
+        auto begin = task * CGROUPS_PER_TASK;
+        auto end = std::min(begin + CGROUPS_PER_TASK, populated_.size());
+        for (auto i = begin; i < end; ++i) {
+            scan(*populated_[i], retry_missing_files);
+        }
+    });
+
+    for (auto* cgroup : populated_) {
+        if (!cgroup->alive) {
+            cgroup->has_previous_counters = false;
+            continue;
+        }
+        // cgroup counters are 64 bits wide and never wrap; one going down,
+        // such as io.stat after a device went away, was reset
+        for (size_t counter = 0; counter < COUNTER_COUNT && cgroup->has_previous_counters; ++counter) {
+            if (cgroup->counters[counter] < cgroup->previous_counters[counter]) {
+                cgroup->has_previous_counters = false;
+            }
+        }
+        auto rate = [cgroup, elapsed](CgroupCounter counter) {
+            if (!cgroup->has_previous_counters || elapsed <= 0.0) {
+                return 0.0;
+            }
+            auto delta = cgroup->counters[counter] - cgroup->previous_counters[counter];
+            return static_cast<double>(delta) / elapsed;
+        };
+        auto& row = snapshot.add_row(cgroup->path);
+        // microseconds per second, in percent of a core
+        row.values[CPU] = std::round(rate(CPU_USAGE_COUNTER) / 1000.0) / 10.0;
+        row.values[CPU_THROTTLED] = std::round(rate(CPU_THROTTLED_COUNTER) / 1000.0) / 10.0;
+        row.values[MEMORY] = cgroup->memory;
+        row.values[MEMORY_MAX] = cgroup->memory_max;
+        row.values[IO_READ_BYTES_PER_S] = whole_rate(rate(IO_READ_BYTES_COUNTER));
+        row.values[IO_WRITE_BYTES_PER_S] = whole_rate(rate(IO_WRITE_BYTES_COUNTER));
+        row.values[IO_READS_PER_S] = whole_rate(rate(IO_READS_COUNTER));
+        row.values[IO_WRITES_PER_S] = whole_rate(rate(IO_WRITES_COUNTER));
+        row.values[PIDS] = cgroup->pids;
+        row.values[CPU_PRESSURE] = cgroup->cpu_pressure;
+        row.values[CPU_PRESSURE_FULL] = cgroup->cpu_pressure_full;
+        row.values[MEMORY_PRESSURE] = cgroup->memory_pressure;
+        row.values[MEMORY_PRESSURE_FULL] = cgroup->memory_pressure_full;
+        row.values[IO_PRESSURE] = cgroup->io_pressure;
+        row.values[IO_PRESSURE_FULL] = cgroup->io_pressure_full;
+        cgroup->previous_counters = cgroup->counters;
+        cgroup->has_previous_counters = true;
+    }
+    return {};
+}
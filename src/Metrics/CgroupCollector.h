@@ -0,0 +1,106 @@
+#pragma once
+
+#include "../Common/WorkerPool.h"
+#include "Collector.h"
+#include "DeviceTable.h"
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace metrics {
+
+// CgroupCollector reports every populated cgroup of the cgroup v2 hierarchy,
+// keyed by its path in the hierarchy, e.g. "/system.slice/nginx.service":
+// the share of a core it used and spent throttled, its memory and limit,
+// the bytes and operations it read and wrote per second, its process count
+// and how much it stalled on CPU, memory and IO as reported by the pressure
+// stall information (PSI) files.
+//
+// The tree is walked once. From then on every cgroup directory is watched
+// with inotify for cgroups created, removed or renamed beneath it, and its
+// cgroup.events file for the cgroup becoming populated or empty, so that a
+// sample only lists the directories that changed. Should the watches run
+// out or the event queue overflow, the tree is walked again as a fallback.
+//
+// Like the process table, the directory and files of as many cgroups as the
+// open files limit leaves room for are kept open, so that sampling them
+// costs a pread() per file. Past that, cgroups keep their directory open
+// and open their files relative to it at every sample.
+// The cgroups are split into batches read by a small pool of threads.
+class CgroupCollector final : public Collector {
+public:
+    // cgroups read by one task of the worker pool
+    static constexpr size_t CGROUPS_PER_TASK = 64;
+    // samples between walks of the tree when inotify can't be relied on
+    static constexpr uint64_t RESCAN_SAMPLES = 10;
+
+    // Picks a small worker pool for the machine's core count when no thread
+    // count is given.
+    explicit CgroupCollector(std::string root = "/sys/fs/cgroup",
+                             RateClock clock = std::chrono::steady_clock::now,
+                             std::optional<size_t> thread_count = {});
+
+    CgroupCollector(const CgroupCollector&) = delete;
+    CgroupCollector(CgroupCollector&&) noexcept = delete;
+    ~CgroupCollector() noexcept override;
+
+    auto operator=(const CgroupCollector&) -> CgroupCollector& = delete;
+    auto operator=(CgroupCollector&&) noexcept -> CgroupCollector& = delete;
+
+    [[nodiscard]] auto schema() const -> const Schema& override;
+    auto collect(Snapshot& snapshot) -> common::ErrorOr<void> override;
+
+    // Exposed for testing: the cgroups known, populated or not, the files
+    // currently kept open and the directories listed so far.
+    [[nodiscard]] auto cgroup_count() const -> size_t { return cgroups_.size(); }
+    [[nodiscard]] auto open_file_count() const -> size_t { return open_file_count_; }
+    [[nodiscard]] auto listed_directory_count() const -> uint64_t { return listed_directory_count_; }
+
+private:
+    struct Cgroup;
+
+    // Walks the tree the first time, then follows the changes inotify
+    // reported since the previous sample.
+    auto update_tree() -> common::ErrorOr<void>;
+    auto read_events() -> void;
+    // Adds the cgroup at given path and every cgroup beneath it.
+    auto add_subtree(const std::string& path) -> void;
+    // Removes the cgroup at given path and every cgroup beneath it.
+    auto remove_subtree(const std::string& path) -> void;
+    // Brings the children of the cgroup at given path in line with its
+    // directory; recursively when deep, checking every cgroup beneath it.
+    auto rescan(const std::string& path, bool deep) -> void;
+    auto read_populated(Cgroup& cgroup) -> void;
+    // Opens a file of the cgroup, relative to its directory if kept open.
+    auto open_file(const Cgroup& cgroup, const char* name) const -> int;
+    auto scan(Cgroup& cgroup, bool retry_missing_files) const -> void;
+
+    std::string root_;
+    RateClock clock_;
+    std::optional<std::chrono::steady_clock::time_point> previous_time_;
+    uint64_t sample_{0};
+    size_t max_open_files_;
+    size_t open_file_count_{0};
+    uint64_t listed_directory_count_{0};
+    int inotify_fd_{-1};
+    // false once a watch could not be added; the tree is then walked every
+    // RESCAN_SAMPLES samples instead
+    bool is_watching_{false};
+    bool needs_rescan_{false};
+    // by path, so that the cgroups beneath one follow it
+    std::map<std::string, std::unique_ptr<Cgroup>, std::less<>> cgroups_;
+    // by watch descriptor, of directories and cgroup.events files alike
+    std::unordered_map<int, Cgroup*> watches_;
+    // paths of the cgroups whose children or cgroup.events changed
+    std::vector<std::string> changed_directories_;
+    std::vector<std::string> changed_events_;
+    // the populated cgroups, in path order; rebuilt when the tree changed
+    std::vector<Cgroup*> populated_;
+    bool is_tree_changed_{true};
+    common::WorkerPool workers_;
+};
+
+} // namespace metrics
@@ -0,0 +1,31 @@
+#pragma once
+
+#include "../Common/Error.h"
+#include "Snapshot.h"
+#include "Topic.h"
+
+namespace metrics {
+
+// Collector takes the samples of a single topic. Collectors are only used
+// from the sampler thread and may keep whatever state they need between
+// samples, e.g. the previous counters to turn them into utilizations.
+class Collector {
+public:
+    Collector(const Collector&) = delete;
+    Collector(Collector&&) noexcept = delete;
+    virtual ~Collector() noexcept = default;
+
+    auto operator=(const Collector&) -> Collector& = delete;
+    auto operator=(Collector&&) noexcept -> Collector& = delete;
+
+    [[nodiscard]] virtual auto schema() const -> const Schema& = 0;
+    [[nodiscard]] auto topic() const -> Topic { return schema().topic; }
+
+    // Takes a sample and adds its rows to given snapshot of schema().
+    virtual auto collect(Snapshot& snapshot) -> common::ErrorOr<void> = 0;
+
+protected:
+    Collector() = default;
+};
+
+} // namespace metrics
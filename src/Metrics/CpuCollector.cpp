@@ -0,0 +1,245 @@
+#include "CpuCollector.h"
+#include "CpuShares.h"
+#include "ProcFs.h"
+#include <algorithm>
+#include <array>
+#include <fmt/format.h>
+#include <functional>
+#include <map>
+
+using namespace common;
+using namespace metrics;
+
+namespace {
+
+enum CpuField : size_t { USAGE, USER, SYSTEM, IOWAIT, STEAL, CORES, LOAD_1, LOAD_5, LOAD_15 };
+
+constexpr std::array<FieldDescriptor, 9> CPU_FIELDS = {{
+    field<"usage">(FieldType::FLOAT),
+    field<"user">(FieldType::FLOAT),
+    field<"system">(FieldType::FLOAT),
+    field<"iowait">(FieldType::FLOAT),
+    field<"steal">(FieldType::FLOAT),
+    field<"cores">(FieldType::UINT),
+    field<"load1">(FieldType::FLOAT),
+    field<"load5">(FieldType::FLOAT),
+    field<"load15">(FieldType::FLOAT),
+}};
+constexpr Schema CPU_SCHEMA = {Topic::CPU, {}, CPU_FIELDS};
+
+enum PerCoreField : size_t { CORE_USAGE, CORE_USER, CORE_SYSTEM, CORE_IOWAIT, CORE_STEAL, CORE_IDLE };
+
+constexpr std::array<FieldDescriptor, 6> PER_CORE_FIELDS = {{
+    field<"usage">(FieldType::FLOAT),
+    field<"user">(FieldType::FLOAT),
+    field<"system">(FieldType::FLOAT),
+    field<"iowait">(FieldType::FLOAT),
+    field<"steal">(FieldType::FLOAT),
+    field<"idle">(FieldType::FLOAT),
+}};
+// keyed by core number, or "node0" and "socket0" for the rollups
+constexpr Schema PER_CORE_SCHEMA = {Topic::CPU_PER_CORE, "core", PER_CORE_FIELDS};
+
+} // namespace
+
+CpuCollector::CpuCollector(Topic topic, std::string stat_path, std::string loadavg_path, std::string node_root) :
+    topic_(topic),
+    stat_file_(std::move(stat_path)),
+    loadavg_file_(std::move(loadavg_path)),
+    node_root_(std::move(node_root)) {
+    VERIFY(topic == Topic::CPU || topic == Topic::CPU_PER_CORE);
+}
+
+auto CpuCollector::schema() const -> const Schema& {
+    return topic_ == Topic::CPU ? CPU_SCHEMA : PER_CORE_SCHEMA;
+}
+
+auto CpuCollector::parse_stat(std::string_view text) -> void {
+    for (auto& column : current_) {
+        column.clear();
+    }
+    core_ids_.clear();
+    while (!text.empty()) {
+        auto line = procfs::next_line(text);
+        auto name = procfs::next_field(line);
+        if (!name.starts_with("cpu")) {
+            // the cpu lines come first
+            break;
+        }
+        auto is_core = name.size() > 3;
+        if (is_core) {
+            // numbered as the kernel does; offline cores leave gaps
+            core_ids_.push_back(static_cast<uint32_t>(procfs::parse_uint(name.substr(3))));
+            if (topic_ == Topic::CPU) {
+                // counting the cores does
+                continue;
+            }
+        }
+        // user nice system idle iowait irq softirq steal; guest time is
+        // accounted in user already
+        std::array<uint64_t, 8> fields{};
+        for (auto& field : fields) {
+            field = procfs::next_uint(line);
+        }
+        uint64_t total = 0;
+        for (auto field : fields) {
+            total += field;
+        }
+        current_[BUSY_TIME].push_back(total - fields[3] - fields[4]);
+        current_[USER_TIME].push_back(fields[0] + fields[1]);
+        current_[SYSTEM_TIME].push_back(fields[2] + fields[5] + fields[6]);
+        current_[IOWAIT_TIME].push_back(fields[4]);
+        current_[STEAL_TIME].push_back(fields[7]);
+        current_[IDLE_TIME].push_back(fields[3]);
+        current_[TOTAL_TIME].push_back(total);
+    }
+}
+
+// Parses a list of CPUs like "0-15,32-47" into given callback.
+static auto for_each_listed_cpu(std::string_view list, const std::function<void(uint32_t cpu)>& callback) -> void {
+    list = procfs::next_line(list);
+    while (!list.empty()) {
+        auto comma = list.find(',');
+        auto range = list.substr(0, comma);
+        list = comma == std::string_view::npos ? std::string_view() : list.substr(comma + 1);
+        auto dash = range.find('-');
+        auto first = procfs::parse_uint(range.substr(0, dash));
+        auto last = dash == std::string_view::npos ? first : procfs::parse_uint(range.substr(dash + 1));
+        for (auto cpu = first; cpu <= last; ++cpu) {
+            callback(static_cast<uint32_t>(cpu));
+        }
+    }
+}
+
+auto CpuCollector::update_layout() -> void {
+    keys_.clear();
+    rollup_members_.clear();
+    if (topic_ != Topic::CPU_PER_CORE) {
+        return;
+    }
+    for (auto id : core_ids_) {
+        keys_.push_back(fmt::format("{}", id));
+    }
+    if (node_root_.empty()) {
+        return;
+    }
+
+    // the node and socket of every core listed by a node; machines without
+    // NUMA have no such directory, or a single node
+    std::vector<uint32_t> nodes;
+    [[maybe_unused]] auto error_or_void = procfs::for_each_entry(node_root_.c_str(), [&nodes](std::string_view name) {
+        auto number = name.substr(std::min(name.size(), size_t{4}));
+        if (name.starts_with("node") && !number.empty() &&
+            number.find_first_not_of("0123456789") == std::string_view::npos) {
+            nodes.push_back(static_cast<uint32_t>(procfs::parse_uint(number)));
+        }
+    });
+    std::map<uint32_t, uint32_t> node_of;
+    std::map<uint32_t, uint32_t> socket_of;
+    for (auto node : nodes) {
+        if (procfs::read_file(fmt::format("{}/node{}/cpulist", node_root_, node).c_str(), buffer_).is_error()) {
+            continue;
+        }
+        std::vector<uint32_t> cpus;
+        for_each_listed_cpu(buffer_, [&cpus](uint32_t cpu) { cpus.push_back(cpu); });
+        for (auto cpu : cpus) {
+            node_of[cpu] = node;
+            auto path = fmt::format("{}/node{}/cpu{}/topology/physical_package_id", node_root_, node, cpu);
+            if (!procfs::read_file(path.c_str(), buffer_).is_error()) {
+                std::string_view text = buffer_;
+                socket_of[cpu] = static_cast<uint32_t>(procfs::parse_uint(procfs::next_line(text)));
+            }
+        }
+    }
+
+    // rows only for machines having more than one node or socket; on others
+    // the rollup would just repeat the aggregate
+    auto add_rollups = [this](const std::map<uint32_t, uint32_t>& group_of, std::string_view prefix) {
+        std::map<uint32_t, uint32_t> rows;
+        for (auto [cpu, group] : group_of) {
+            rows.emplace(group, 0);
+        }
+        if (rows.size() < 2) {
+            return;
+        }
+        for (auto& [group, row] : rows) {
+            keys_.push_back(fmt::format("{}{}", prefix, group));
+            // the aggregate is row zero
+            row = static_cast<uint32_t>(keys_.size());
+        }
+        for (size_t i = 0; i < core_ids_.size(); ++i) {
+            if (auto it = group_of.find(core_ids_[i]); it != group_of.end()) {
+                rollup_members_.emplace_back(static_cast<uint32_t>(i + 1), rows.at(it->second));
+            }
+        }
+    };
+    add_rollups(node_of, "node");
+    add_rollups(socket_of, "socket");
+}
+
+auto CpuCollector::collect(Snapshot& snapshot) -> ErrorOr<void> {
+    parse_stat(TRY(stat_file_.read()));
+    if (current_[TOTAL_TIME].empty()) {
+        return {Error::from_string("no cpu lines in /proc/stat", ErrorDomain::FILE)};
+    }
+
+    // cores going offline or online change the layout; start over
+    auto row_count = keys_.size() + 1;
+    if (core_ids_ != previous_core_ids_ || previous_[TOTAL_TIME].empty()) {
+        update_layout();
+        previous_core_ids_ = core_ids_;
+        row_count = keys_.size() + 1;
+        for (auto& column : previous_) {
+            column.assign(row_count, 0);
+        }
+    }
+    // the rollups add up their cores, column by column
+    for (auto& column : current_) {
+        column.resize(row_count, 0);
+        for (auto [core, rollup] : rollup_members_) {
+            column[rollup] += column[core];
+        }
+    }
+    for (size_t counter = 0; counter < shares_.size(); ++counter) {
+        shares_[counter].resize(row_count);
+        cpu_shares::compute(current_[counter],
+                            previous_[counter],
+                            current_[TOTAL_TIME],
+                            previous_[TOTAL_TIME],
+                            shares_[counter]);
+    }
+
+    if (topic_ == Topic::CPU) {
+        auto& row = snapshot.add_row();
+        row.values[USAGE] = shares_[BUSY_TIME][0];
+        row.values[USER] = shares_[USER_TIME][0];
+        row.values[SYSTEM] = shares_[SYSTEM_TIME][0];
+        row.values[IOWAIT] = shares_[IOWAIT_TIME][0];
+        row.values[STEAL] = shares_[STEAL_TIME][0];
+        row.values[CORES] = uint64_t{core_ids_.size()};
+        TRY(collect_load_averages(row));
+    } else {
+        for (size_t i = 1; i < row_count; ++i) {
+            auto& row = snapshot.add_row(keys_[i - 1]);
+            row.values[CORE_USAGE] = shares_[BUSY_TIME][i];
+            row.values[CORE_USER] = shares_[USER_TIME][i];
+            row.values[CORE_SYSTEM] = shares_[SYSTEM_TIME][i];
+            row.values[CORE_IOWAIT] = shares_[IOWAIT_TIME][i];
+            row.values[CORE_STEAL] = shares_[STEAL_TIME][i];
+            row.values[CORE_IDLE] = shares_[IDLE_TIME][i];
+        }
+    }
+
+    previous_.swap(current_);
+    return {};
+}
+
+auto CpuCollector::collect_load_averages(Row& row) -> ErrorOr<void> {
+    // 0.52 0.58 0.59 2/1234 5678
+    auto text = TRY(loadavg_file_.read());
+    auto line = procfs::next_line(text);
+    row.values[LOAD_1] = procfs::next_decimal(line);
+    row.values[LOAD_5] = procfs::next_decimal(line);
+    row.values[LOAD_15] = procfs::next_decimal(line);
+    return {};
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include "Collector.h"
+#include "ProcFs.h"
+#include <array>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace metrics {
+
+// CpuCollector reports how busy the CPUs were since the previous sample,
+// from the counters in /proc/stat. Depending on its topic it reports the
+// machine as a whole (cpu), along with the load averages from /proc/loadavg,
+// or every core on its own (cpu.per_core), keyed by core number.
+//
+// The counters are kept in columns, one per kind of time with a value per
+// core, and turned into shares of the elapsed time by the vectorized
+// kernels of cpu_shares, which matters on hosts with hundreds of cores.
+// Machines with more than one NUMA node or socket, according to the
+// directory given, also get per-core rows adding up the cores of every node
+// ("node0", ...) and socket ("socket0", ...).
+class CpuCollector final : public Collector {
+public:
+    explicit CpuCollector(Topic topic,
+                          std::string stat_path = "/proc/stat",
+                          std::string loadavg_path = "/proc/loadavg",
+                          std::string node_root = "/sys/devices/system/node");
+
+    [[nodiscard]] auto schema() const -> const Schema& override;
+    auto collect(Snapshot& snapshot) -> common::ErrorOr<void> override;
+
+private:
+    // the kinds of time counted for every row, busy time being the total
+    // less the idle and iowait times
+    enum Counter : size_t { BUSY_TIME, USER_TIME, SYSTEM_TIME, IOWAIT_TIME, STEAL_TIME, IDLE_TIME, TOTAL_TIME };
+    static constexpr size_t COUNTER_COUNT = TOTAL_TIME + 1;
+
+    using Columns = std::array<std::vector<uint64_t>, COUNTER_COUNT>;
+
+    // Parses the cpu lines of /proc/stat into current_, the aggregate first,
+    // and their core numbers into core_ids_.
+    auto parse_stat(std::string_view text) -> void;
+    // Works out the rows and rollups for the cores in core_ids_.
+    auto update_layout() -> void;
+    auto collect_load_averages(Row& row) -> common::ErrorOr<void>;
+
+    Topic topic_;
+    procfs::ProcFile stat_file_;
+    procfs::ProcFile loadavg_file_;
+    std::string node_root_;
+    // by row: the aggregate, a row per core, then the rollups
+    Columns previous_;
+    Columns current_;
+    // by counter but the total, then row
+    std::array<std::vector<double>, COUNTER_COUNT - 1> shares_;
+    std::vector<uint32_t> core_ids_;
+    // core numbers of the previous sample; the layout changes with them
+    std::vector<uint32_t> previous_core_ids_;
+    // every row but the aggregate
+    std::vector<std::string> keys_;
+    // pairs of a core's row and a rollup row it adds up into
+    std::vector<std::pair<uint32_t, uint32_t>> rollup_members_;
+    std::string buffer_;
+};
+
+} // namespace metrics
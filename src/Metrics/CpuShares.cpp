@@ -0,0 +1,174 @@
+#include "CpuShares.h"
+#include "../Common/Assertions.h"
+#include <algorithm>
+#include <cmath>
+
+#ifdef COMMON_SIMD_X86
+#include <immintrin.h>
+#endif
+
+using namespace common;
+using namespace metrics;
+using namespace metrics::cpu_shares;
+
+using ComputeFunction = void (*)(const uint64_t* current,
+                                 const uint64_t* previous,
+                                 const uint64_t* current_total,
+                                 const uint64_t* previous_total,
+                                 double* shares,
+                                 size_t length);
+
+// Differences of counters are taken as signed, so that a counter that went
+// down shows as negative, and capped at 100 %: the busy time, the total
+// less the idle and iowait times, grows faster than the total on kernels
+// whose iowait goes down now and then.
+constexpr double MAX_PERMILLE = 1000.0;
+
+// Computes the shares one at a time. Inlined into the vector kernels for
+// their tails, so that these are compiled for the same instruction set.
+__attribute__((always_inline)) static inline auto compute_shares(const uint64_t* current,
+                                                                 const uint64_t* previous,
+                                                                 const uint64_t* current_total,
+                                                                 const uint64_t* previous_total,
+                                                                 double* shares,
+                                                                 size_t length) -> void {
+    for (size_t i = 0; i < length; ++i) {
+        auto delta = static_cast<double>(static_cast<int64_t>(current[i] - previous[i]));
+        auto elapsed = static_cast<double>(static_cast<int64_t>(current_total[i] - previous_total[i]));
+        if (!(elapsed > 0.0) || delta < 0.0) {
+            shares[i] = 0.0;
+            continue;
+        }
+        // nearbyint() rounds halves to even like the vector kernels
+        shares[i] = std::nearbyint(std::min(delta * 1000.0 / elapsed, MAX_PERMILLE)) / 10.0;
+    }
+}
+
+static auto compute_scalar(const uint64_t* current,
+                           const uint64_t* previous,
+                           const uint64_t* current_total,
+                           const uint64_t* previous_total,
+                           double* shares,
+                           size_t length) -> void {
+    compute_shares(current, previous, current_total, previous_total, shares, length);
+}
+
+#ifdef COMMON_SIMD_X86
+
+// Neither SSE2 nor AVX2 converts 64-bit integers to doubles. Adding the bits
+// of 1.5 * 2^52 to an integer of less than 2^51 either way gives the bits of
+// that double plus the integer, exactly, so subtracting the double leaves
+// the integer converted.
+constexpr int64_t MAGIC_BITS = 0x4338000000000000;
+constexpr double MAGIC = 6755399441055744.0;
+
+__attribute__((target("sse2"), always_inline)) static inline auto to_double_sse2(__m128i value) -> __m128d {
+    return _mm_sub_pd(_mm_castsi128_pd(_mm_add_epi64(value, _mm_set1_epi64x(MAGIC_BITS))), _mm_set1_pd(MAGIC));
+}
+
+__attribute__((target("sse2"))) static auto compute_sse2(const uint64_t* current,
+                                                         const uint64_t* previous,
+                                                         const uint64_t* current_total,
+                                                         const uint64_t* previous_total,
+                                                         double* shares,
+                                                         size_t length) -> void {
+    const __m128d zero = _mm_setzero_pd();
+    const __m128d thousand = _mm_set1_pd(1000.0);
+    const __m128d ten = _mm_set1_pd(10.0);
+    const __m128d magic = _mm_set1_pd(MAGIC);
+    size_t i = 0;
+    for (; i + 2 <= length; i += 2) {
+        auto delta = to_double_sse2(_mm_sub_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(current + i)),
+                                                  _mm_loadu_si128(reinterpret_cast<const __m128i*>(previous + i))));
+        auto elapsed = to_double_sse2(
+            _mm_sub_epi64(_mm_loadu_si128(reinterpret_cast<const __m128i*>(current_total + i)),
+                          _mm_loadu_si128(reinterpret_cast<const __m128i*>(previous_total + i))));
+        auto is_valid = _mm_and_pd(_mm_cmpgt_pd(elapsed, zero), _mm_cmpge_pd(delta, zero));
+        // lanes dividing by zero give NaN or infinity, masked out below
+        auto permille = _mm_min_pd(_mm_div_pd(_mm_mul_pd(delta, thousand), elapsed), thousand);
+        // SSE2 has no rounding instruction; adding and subtracting 1.5 *
+        // 2^52 leaves no bits for a fraction and rounds halves to even
+        auto rounded = _mm_sub_pd(_mm_add_pd(permille, magic), magic);
+        _mm_storeu_pd(shares + i, _mm_and_pd(is_valid, _mm_div_pd(rounded, ten)));
+    }
+    compute_shares(current + i, previous + i, current_total + i, previous_total + i, shares + i, length - i);
+}
+
+__attribute__((target("avx2"), always_inline)) static inline auto to_double_avx2(__m256i value) -> __m256d {
+    return _mm256_sub_pd(_mm256_castsi256_pd(_mm256_add_epi64(value, _mm256_set1_epi64x(MAGIC_BITS))),
+                         _mm256_set1_pd(MAGIC));
+}
+
+__attribute__((target("avx2"))) static auto compute_avx2(const uint64_t* current,
+                                                         const uint64_t* previous,
+                                                         const uint64_t* current_total,
+                                                         const uint64_t* previous_total,
+                                                         double* shares,
+                                                         size_t length) -> void {
+    const __m256d zero = _mm256_setzero_pd();
+    const __m256d thousand = _mm256_set1_pd(1000.0);
+    const __m256d ten = _mm256_set1_pd(10.0);
+    size_t i = 0;
+    for (; i + 4 <= length; i += 4) {
+        auto delta = to_double_avx2(
+            _mm256_sub_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(current + i)),
+                             _mm256_loadu_si256(reinterpret_cast<const __m256i*>(previous + i))));
+        auto elapsed = to_double_avx2(
+            _mm256_sub_epi64(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(current_total + i)),
+                             _mm256_loadu_si256(reinterpret_cast<const __m256i*>(previous_total + i))));
+        auto is_valid =
+            _mm256_and_pd(_mm256_cmp_pd(elapsed, zero, _CMP_GT_OQ), _mm256_cmp_pd(delta, zero, _CMP_GE_OQ));
+        // lanes dividing by zero give NaN or infinity, masked out below
+        auto permille = _mm256_min_pd(_mm256_div_pd(_mm256_mul_pd(delta, thousand), elapsed), thousand);
+        auto rounded = _mm256_round_pd(permille, _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+        _mm256_storeu_pd(shares + i, _mm256_and_pd(is_valid, _mm256_div_pd(rounded, ten)));
+    }
+    // see Simd.h
+    _mm256_zeroupper();
+    compute_shares(current + i, previous + i, current_total + i, previous_total + i, shares + i, length - i);
+}
+
+#endif
+
+static auto compute_function(Implementation implementation) -> ComputeFunction {
+    switch (implementation) {
+    case Implementation::SCALAR:
+        return compute_scalar;
+#ifdef COMMON_SIMD_X86
+    case Implementation::SSE2:
+        return compute_sse2;
+    case Implementation::AVX2:
+        return compute_avx2;
+#else
+    case Implementation::SSE2:
+    case Implementation::AVX2:
+        break;
+#endif
+    }
+    VERIFY_NOT_REACHED();
+}
+
+auto cpu_shares::compute(std::span<const uint64_t> current,
+                         std::span<const uint64_t> previous,
+                         std::span<const uint64_t> current_total,
+                         std::span<const uint64_t> previous_total,
+                         std::span<double> shares) -> void {
+    static const ComputeFunction function = compute_function(simd::best_implementation());
+    VERIFY(previous.size() == current.size() && current_total.size() == current.size() &&
+           previous_total.size() == current.size() && shares.size() == current.size());
+    function(
+        current.data(), previous.data(), current_total.data(), previous_total.data(), shares.data(), shares.size());
+}
+
+auto cpu_shares::compute_using(Implementation implementation,
+                               std::span<const uint64_t> current,
+                               std::span<const uint64_t> previous,
+                               std::span<const uint64_t> current_total,
+                               std::span<const uint64_t> previous_total,
+                               std::span<double> shares) -> void {
+    VERIFY(simd::is_supported(implementation));
+    VERIFY(previous.size() == current.size() && current_total.size() == current.size() &&
+           previous_total.size() == current.size() && shares.size() == current.size());
+    compute_function(implementation)(
+        current.data(), previous.data(), current_total.data(), previous_total.data(), shares.data(), shares.size());
+}
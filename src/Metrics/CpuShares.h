@@ -0,0 +1,38 @@
+#pragma once
+
+#include "../Common/Simd.h"
+#include <cstdint>
+#include <span>
+
+// Turns columns of CPU time counters, such as the user time of every core
+// from /proc/stat, into the share of the elapsed time each counter grew by
+// since the previous sample. The columns are laid out one counter after the
+// other, a value per core each, so that the kernels run down contiguous
+// arrays; they are vectorized with SSE2 or AVX2 when the CPU has them; see
+// Simd.h.
+namespace metrics::cpu_shares {
+
+using common::simd::Implementation;
+
+// Sets shares[i] to how much counter i grew from previous to current, in
+// percent of how much total i grew, capped at 100 and rounded to a tenth so
+// that noise doesn't defeat delta encoding. Halves round to even. The share
+// is zero when the total didn't grow or the counter went down, as after a
+// core came online. Counters must change by less than 2^51 between samples,
+// which clock ticks take millions of years to.
+auto compute(std::span<const uint64_t> current,
+             std::span<const uint64_t> previous,
+             std::span<const uint64_t> current_total,
+             std::span<const uint64_t> previous_total,
+             std::span<double> shares) -> void;
+
+// Same as above with given implementation, which must be supported. Meant
+// for tests and benchmarks; every implementation gives the same shares.
+auto compute_using(Implementation implementation,
+                   std::span<const uint64_t> current,
+                   std::span<const uint64_t> previous,
+                   std::span<const uint64_t> current_total,
+                   std::span<const uint64_t> previous_total,
+                   std::span<double> shares) -> void;
+
+} // namespace metrics::cpu_shares
@@ -0,0 +1,79 @@
+#include "DeviceTable.h"
+#include "../Common/Assertions.h"
+#include <cmath>
+
+using namespace metrics;
+
+auto metrics::counter_delta(uint64_t previous, uint64_t current) -> uint64_t {
+    if (current >= previous) {
+        return current - previous;
+    }
+    // between two samples only a counter near the top of 32 bits can have
+    // wrapped around; one that went down from further below was reset
+    if (previous > UINT32_MAX / 2 && previous <= UINT32_MAX && current <= UINT32_MAX) {
+        return current + (uint64_t{1} << 32) - previous;
+    }
+    return 0;
+}
+
+auto metrics::whole_rate(double rate) -> uint64_t {
+    return static_cast<uint64_t>(std::llround(rate));
+}
+
+DeviceTable::DeviceTable(size_t counter_count, RateClock clock) :
+    counter_count_(counter_count),
+    clock_(std::move(clock)) {
+    VERIFY(counter_count_ > 0);
+}
+
+auto DeviceTable::begin_sample() -> void {
+    auto now = clock_();
+    elapsed_ = sample_ == 0 ? 0.0 : std::chrono::duration<double>(now - previous_time_).count();
+    previous_time_ = now;
+    ++sample_;
+}
+
+auto DeviceTable::see(std::string_view name) -> uint32_t {
+    uint32_t id = 0;
+    if (auto it = ids_.find(name); it != ids_.end()) {
+        id = it->second;
+        is_new_[id] = 0;
+    } else {
+        if (free_ids_.empty()) {
+            id = static_cast<uint32_t>(names_.size());
+            names_.emplace_back(name);
+            seen_in_sample_.push_back(0);
+            is_new_.push_back(1);
+            counters_.resize(counters_.size() + counter_count_);
+        } else {
+            id = free_ids_.back();
+            free_ids_.pop_back();
+            names_[id] = name;
+            is_new_[id] = 1;
+        }
+        ids_.emplace(names_[id], id);
+    }
+    seen_in_sample_[id] = sample_;
+    return id;
+}
+
+auto DeviceTable::end_sample() -> void {
+    for (uint32_t id = 0; id < names_.size(); ++id) {
+        // zero for the ids already free
+        if (seen_in_sample_[id] != sample_ && seen_in_sample_[id] != 0) {
+            ids_.erase(names_[id]);
+            seen_in_sample_[id] = 0;
+            free_ids_.push_back(id);
+        }
+    }
+}
+
+auto DeviceTable::rate(uint32_t id, size_t counter, uint64_t current) -> double {
+    auto& previous = counters_[id * counter_count_ + counter];
+    auto delta = counter_delta(previous, current);
+    previous = current;
+    if (is_new_[id] != 0 || elapsed_ <= 0.0) {
+        return 0.0;
+    }
+    return static_cast<double>(delta) / elapsed_;
+}
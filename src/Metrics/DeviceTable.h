@@ -0,0 +1,80 @@
+#pragma once
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace metrics {
+
+// Clock the collectors reporting rates measure the time between samples
+// on; tests pass their own.
+using RateClock = std::function<std::chrono::steady_clock::time_point()>;
+
+// Returns how much a counter went up from previous to current. A counter
+// that went down from above 2^31 wrapped around 32 bits, as counters of some
+// drivers and older kernels do; any other was reset, e.g. by a driver being
+// reloaded, and counts as not having gone up at all.
+auto counter_delta(uint64_t previous, uint64_t current) -> uint64_t;
+
+// Rounds a rate to a whole number per second.
+auto whole_rate(double rate) -> uint64_t;
+
+// DeviceTable keeps the counters of the devices of a collector, such as
+// network interfaces or disks, from one sample to the next to turn them
+// into rates.
+//
+// Every device gets a stable id, its index in flat arrays of counters, for
+// as long as it is seen in every sample. A device gone from a sample is
+// forgotten and its id reused by the next new device, so that hot-plugged
+// devices coming and going don't grow the table, and a device coming back
+// starts over rather than being compared with stale counters.
+class DeviceTable final {
+public:
+    explicit DeviceTable(size_t counter_count, RateClock clock = std::chrono::steady_clock::now);
+
+    // Starts a sample, taking the time rates are computed over.
+    auto begin_sample() -> void;
+    // Returns the id of the named device, seen in the sample begun, adding
+    // it when new.
+    auto see(std::string_view name) -> uint32_t;
+    // Forgets the devices not seen since begin_sample().
+    auto end_sample() -> void;
+
+    // Returns true when the device was added in the sample begun.
+    [[nodiscard]] auto is_new(uint32_t id) const -> bool { return is_new_[id] != 0; }
+    // Stores the current value of a counter of given device and returns
+    // its increase per second since the previous sample; zero for a new
+    // device.
+    auto rate(uint32_t id, size_t counter, uint64_t current) -> double;
+
+    [[nodiscard]] auto size() const -> size_t { return ids_.size(); }
+    // Seconds since the previous sample; zero for the first.
+    [[nodiscard]] auto elapsed() const -> double { return elapsed_; }
+
+private:
+    struct NameHash {
+        using is_transparent = void;
+        auto operator()(std::string_view name) const -> size_t { return std::hash<std::string_view>{}(name); }
+    };
+
+    size_t counter_count_;
+    RateClock clock_;
+    std::chrono::steady_clock::time_point previous_time_{};
+    double elapsed_{0.0};
+    uint32_t sample_{0};
+    std::unordered_map<std::string, uint32_t, NameHash, std::equal_to<>> ids_;
+    // by id
+    std::vector<std::string> names_;
+    std::vector<uint32_t> seen_in_sample_;
+    std::vector<uint8_t> is_new_;
+    // counter_count_ per id
+    std::vector<uint64_t> counters_;
+    std::vector<uint32_t> free_ids_;
+};
+
+} // namespace metrics
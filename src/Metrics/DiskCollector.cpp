@@ -0,0 +1,108 @@
+#include "DiskCollector.h"
+#include "ProcFs.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+using namespace common;
+using namespace metrics;
+
+namespace {
+
+// /proc/diskstats counts sectors of 512 bytes whatever the device uses
+constexpr uint64_t SECTOR_SIZE = 512;
+
+enum DiskField : size_t {
+    READS,
+    READ_BYTES,
+    WRITES,
+    WRITTEN_BYTES,
+    IO_MS,
+    READS_PER_S,
+    READ_BYTES_PER_S,
+    WRITES_PER_S,
+    WRITTEN_BYTES_PER_S,
+    UTILIZATION,
+};
+
+constexpr std::array<FieldDescriptor, 10> FIELDS = {{
+    field<"reads">(FieldType::UINT),
+    field<"read_bytes">(FieldType::UINT),
+    field<"writes">(FieldType::UINT),
+    field<"written_bytes">(FieldType::UINT),
+    field<"io_ms">(FieldType::UINT),
+    field<"reads_per_s">(FieldType::UINT),
+    field<"read_bytes_per_s">(FieldType::UINT),
+    field<"writes_per_s">(FieldType::UINT),
+    field<"written_bytes_per_s">(FieldType::UINT),
+    field<"utilization">(FieldType::FLOAT),
+}};
+constexpr Schema SCHEMA = {Topic::DISK, "device", FIELDS};
+
+// the counters kept per device to compute rates
+enum RateCounter : size_t {
+    RATE_READS,
+    RATE_SECTORS_READ,
+    RATE_WRITES,
+    RATE_SECTORS_WRITTEN,
+    RATE_IO_MS,
+    RATE_COUNTER_COUNT,
+};
+
+} // namespace
+
+DiskCollector::DiskCollector(std::string diskstats_path, RateClock clock) :
+    diskstats_file_(std::move(diskstats_path)),
+    devices_(RATE_COUNTER_COUNT, std::move(clock)) {}
+
+auto DiskCollector::schema() const -> const Schema& {
+    return SCHEMA;
+}
+
+auto DiskCollector::collect(Snapshot& snapshot) -> ErrorOr<void> {
+    auto text = TRY(diskstats_file_.read());
+    devices_.begin_sample();
+
+    while (!text.empty()) {
+        auto line = procfs::next_line(text);
+        procfs::next_field(line); // major
+        procfs::next_field(line); // minor
+        auto name = procfs::next_field(line);
+        if (name.empty() || name.starts_with("loop") || name.starts_with("ram")) {
+            continue;
+        }
+
+        // reads, reads merged, sectors read, ms reading, writes, writes
+        // merged, sectors written, ms writing, in flight, ms doing I/O
+        std::array<uint64_t, 10> fields{};
+        for (auto& field : fields) {
+            field = procfs::next_uint(line);
+        }
+
+        auto id = devices_.see(name);
+        auto reads_per_s = devices_.rate(id, RATE_READS, fields[0]);
+        auto writes_per_s = devices_.rate(id, RATE_WRITES, fields[4]);
+        // sectors are kept rather than bytes, which would wrap around sooner
+        constexpr auto sector_size = static_cast<double>(SECTOR_SIZE);
+        auto read_bytes_per_s = devices_.rate(id, RATE_SECTORS_READ, fields[2]) * sector_size;
+        auto written_bytes_per_s = devices_.rate(id, RATE_SECTORS_WRITTEN, fields[6]) * sector_size;
+        // ms busy per s, in tenths of a percent; requests in flight when
+        // sampled may push it a little past 100
+        auto utilization = std::min(devices_.rate(id, RATE_IO_MS, fields[9]), 1000.0);
+
+        auto& row = snapshot.add_row(std::string(name));
+        row.values[READS] = fields[0];
+        row.values[READ_BYTES] = fields[2] * SECTOR_SIZE;
+        row.values[WRITES] = fields[4];
+        row.values[WRITTEN_BYTES] = fields[6] * SECTOR_SIZE;
+        row.values[IO_MS] = fields[9];
+        row.values[READS_PER_S] = whole_rate(reads_per_s);
+        row.values[READ_BYTES_PER_S] = whole_rate(read_bytes_per_s);
+        row.values[WRITES_PER_S] = whole_rate(writes_per_s);
+        row.values[WRITTEN_BYTES_PER_S] = whole_rate(written_bytes_per_s);
+        // in percent, rounded to a tenth
+        row.values[UTILIZATION] = std::round(utilization) / 10.0;
+    }
+    devices_.end_sample();
+    return {};
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+#include "Collector.h"
+#include "DeviceTable.h"
+#include "ProcFs.h"
+#include <string>
+
+namespace metrics {
+
+// DiskCollector reports the I/O counters of every block device from
+// /proc/diskstats, their rates per second since the previous sample and the
+// share of that time the device was busy. Loop and RAM disks are left out.
+class DiskCollector final : public Collector {
+public:
+    explicit DiskCollector(std::string diskstats_path = "/proc/diskstats",
+                           RateClock clock = std::chrono::steady_clock::now);
+
+    [[nodiscard]] auto schema() const -> const Schema& override;
+    auto collect(Snapshot& snapshot) -> common::ErrorOr<void> override;
+
+private:
+    procfs::ProcFile diskstats_file_;
+    DeviceTable devices_;
+};
+
+} // namespace metrics
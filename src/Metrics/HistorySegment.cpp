@@ -0,0 +1,137 @@
+#include "HistorySegment.h"
+#include <array>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+using namespace common;
+using namespace metrics;
+
+namespace {
+
+constexpr std::array<char, 8> MAGIC = {'S', 'M', 'H', 'I', 'S', 'T', 'O', 'R'};
+constexpr uint32_t VERSION = 1;
+
+struct Header {
+    std::array<char, 8> magic;
+    uint32_t version;
+    uint32_t reserved;
+    uint64_t layout;
+    uint64_t size;
+};
+
+// the block starts at the next cache line
+constexpr size_t HEADER_SIZE = 64;
+static_assert(sizeof(Header) <= HEADER_SIZE);
+
+} // namespace
+
+auto HistorySegment::create(size_t size) -> ErrorOr<HistorySegment> {
+    auto mapping_size = HEADER_SIZE + size;
+    auto* mapping = ::mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (mapping == MAP_FAILED) {
+        return {Error::from_errno(errno, "mmap()")};
+    }
+    return {HistorySegment(-1, mapping, mapping_size, 0, true)};
+}
+
+auto HistorySegment::open(const std::string& path, size_t size, uint64_t layout) -> ErrorOr<HistorySegment> {
+    auto fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        return {Error::from_errno(errno, fmt::format("open({})", path), ErrorDomain::FILE)};
+    }
+    auto fail = [fd](std::string_view call) -> ErrorOr<HistorySegment> {
+        auto error = Error::from_errno(errno, call, ErrorDomain::FILE);
+        ::close(fd);
+        return {std::move(error)};
+    };
+    if (::flock(fd, LOCK_EX | LOCK_NB) != 0) {
+        return fail(fmt::format("flock({})", path));
+    }
+
+    // the header is read rather than mapped first, so that a file of the
+    // wrong size is never mapped
+    auto mapping_size = HEADER_SIZE + size;
+    struct stat status {};
+    if (::fstat(fd, &status) != 0) {
+        return fail(fmt::format("fstat({})", path));
+    }
+    Header header{};
+    auto is_new = static_cast<size_t>(status.st_size) != mapping_size ||
+                  ::pread(fd, &header, sizeof(header), 0) != static_cast<ssize_t>(sizeof(header)) ||
+                  header.magic != MAGIC || header.version != VERSION || header.layout != layout || header.size != size;
+    if (is_new) {
+        // truncating first drops every page, leaving a sparse file of zeroes
+        if (::ftruncate(fd, 0) != 0 || ::ftruncate(fd, static_cast<off_t>(mapping_size)) != 0) {
+            return fail(fmt::format("ftruncate({})", path));
+        }
+    }
+
+    auto* mapping = ::mmap(nullptr, mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        return fail(fmt::format("mmap({})", path));
+    }
+    return {HistorySegment(fd, mapping, mapping_size, layout, is_new)};
+}
+
+HistorySegment::HistorySegment(int fd, void* mapping, size_t mapping_size, uint64_t layout, bool is_new) :
+    fd_(fd),
+    mapping_(mapping),
+    mapping_size_(mapping_size),
+    layout_(layout),
+    is_new_(is_new) {}
+
+HistorySegment::HistorySegment(HistorySegment&& other) noexcept :
+    fd_(std::exchange(other.fd_, -1)),
+    mapping_(std::exchange(other.mapping_, nullptr)),
+    mapping_size_(std::exchange(other.mapping_size_, 0)),
+    layout_(other.layout_),
+    is_new_(other.is_new_) {}
+
+HistorySegment::~HistorySegment() noexcept {
+    cleanup();
+}
+
+auto HistorySegment::operator=(HistorySegment&& rhs) noexcept -> HistorySegment& {
+    if (this != &rhs) {
+        cleanup();
+        fd_ = std::exchange(rhs.fd_, -1);
+        mapping_ = std::exchange(rhs.mapping_, nullptr);
+        mapping_size_ = std::exchange(rhs.mapping_size_, 0);
+        layout_ = rhs.layout_;
+        is_new_ = rhs.is_new_;
+    }
+    return *this;
+}
+
+auto HistorySegment::cleanup() noexcept -> void {
+    // unmapping a shared mapping leaves its pages to be written back by the
+    // kernel; nothing is lost short of the machine going down
+    if (mapping_ != nullptr) {
+        ::munmap(mapping_, mapping_size_);
+        mapping_ = nullptr;
+    }
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+auto HistorySegment::data() const -> std::byte* {
+    return static_cast<std::byte*>(mapping_) + HEADER_SIZE;
+}
+
+auto HistorySegment::size() const -> size_t {
+    return mapping_size_ - HEADER_SIZE;
+}
+
+auto HistorySegment::seal() -> void {
+    Header header{MAGIC, VERSION, 0, layout_, size()};
+    std::memcpy(mapping_, &header, sizeof(header));
+    is_new_ = false;
+}
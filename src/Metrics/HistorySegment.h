@@ -0,0 +1,58 @@
+#pragma once
+
+#include "../Common/Error.h"
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+namespace metrics {
+
+// HistorySegment is the memory HistoryStore keeps the history of a topic in:
+// a header followed by a block laid out by the store. It is either anonymous
+// memory, or a file mapped shared so that whatever the store writes lands in
+// the page cache and is still there when the server starts again.
+//
+// The header holds a number identifying the layout of the block, so that a
+// file written for other resolutions, fields or row limits is started anew
+// rather than misread. A file is only taken over once the store called
+// seal() on it, after initializing the block; until then it is not trusted.
+//
+// Files are locked while mapped, so that two servers can't share them.
+class HistorySegment final {
+public:
+    // Maps anonymous zeroed memory for a block of given size.
+    static auto create(size_t size) -> common::ErrorOr<HistorySegment>;
+    // Maps the file at given path, created if need be, for a block of given
+    // size and layout. The block is kept if the file was sealed with the
+    // same size and layout, and zeroed otherwise.
+    static auto open(const std::string& path, size_t size, uint64_t layout) -> common::ErrorOr<HistorySegment>;
+
+    HistorySegment(const HistorySegment&) = delete;
+    HistorySegment(HistorySegment&& other) noexcept;
+    ~HistorySegment() noexcept;
+
+    auto operator=(const HistorySegment&) -> HistorySegment& = delete;
+    auto operator=(HistorySegment&& rhs) noexcept -> HistorySegment&;
+
+    [[nodiscard]] auto data() const -> std::byte*;
+    [[nodiscard]] auto size() const -> size_t;
+    // Returns true when the block was zeroed rather than kept.
+    [[nodiscard]] auto is_new() const -> bool { return is_new_; }
+    [[nodiscard]] auto is_file() const -> bool { return fd_ >= 0; }
+
+    // Marks a new block as initialized; opening the file again keeps it.
+    auto seal() -> void;
+
+private:
+    HistorySegment(int fd, void* mapping, size_t mapping_size, uint64_t layout, bool is_new);
+
+    auto cleanup() noexcept -> void;
+
+    int fd_;
+    void* mapping_;
+    size_t mapping_size_;
+    uint64_t layout_;
+    bool is_new_;
+};
+
+} // namespace metrics
@@ -0,0 +1,550 @@
+#include "HistoryStore.h"
+#include "../Common/Assertions.h"
+#include "../Common/JsonWriter.h"
+#include "QuantileSketch.h"
+#include "Reductions.h"
+#include <algorithm>
+#include <limits>
+#include <sys/stat.h>
+
+using namespace common;
+using namespace metrics;
+
+static constexpr double EMPTY = std::numeric_limits<double>::quiet_NaN();
+// identifies how segments are laid out by this code; changing the layout
+// must change it, so that files written by older servers are started anew
+static constexpr uint64_t SEGMENT_LAYOUT_VERSION = 1;
+
+static auto as_double(const Value& value) -> double {
+    if (const auto* number = std::get_if<uint64_t>(&value)) {
+        return static_cast<double>(*number);
+    }
+    return std::get<double>(value);
+}
+
+HistoryStore::HistoryStore(std::span<const Resolution> resolutions, std::string directory) :
+    resolutions_(resolutions.begin(), resolutions.end()),
+    directory_(std::move(directory)) {
+    VERIFY(!resolutions_.empty());
+    VERIFY(std::is_sorted(resolutions_.begin(), resolutions_.end(), [](const auto& lhs, const auto& rhs) {
+        return lhs.step < rhs.step;
+    }));
+}
+
+auto HistoryStore::add_topic(const Schema& schema, size_t max_rows) -> ErrorOr<void> {
+    auto& history_pointer = topics_[static_cast<size_t>(schema.topic)];
+    VERIFY(history_pointer == nullptr);
+    VERIFY(max_rows > 0 && (schema.has_rows() || max_rows == 1));
+    auto history = std::make_unique<TopicHistory>();
+    history->schema = &schema;
+    for (size_t i = 0; i < schema.fields.size(); ++i) {
+        if (schema.fields[i].type != FieldType::TEXT) {
+            history->fields.push_back(i);
+        }
+    }
+    history->max_rows = max_rows;
+    TRY(map_segment(*history));
+    if (history->segment->is_new()) {
+        initialize_segment(*history);
+        history->segment->seal();
+    } else {
+        restore_slots(*history);
+        history->is_restored = true;
+    }
+    history_pointer = std::move(history);
+    return {};
+}
+
+// Returns offset rounded up to the next cache line.
+static auto align(size_t offset) -> size_t {
+    return (offset + 63) & ~size_t{63};
+}
+
+auto HistoryStore::map_segment(TopicHistory& history) const -> ErrorOr<void> {
+    // the number of slots taken, the steps of every level and the slots,
+    // then per level its points, sums and counts
+    auto series_count = history.fields.size() * history.max_rows;
+    auto steps_offset = align(sizeof(uint64_t));
+    auto slots_offset = align(steps_offset + resolutions_.size() * sizeof(LevelSteps));
+    auto size = align(slots_offset + history.max_rows * sizeof(SlotEntry));
+    std::vector<size_t> level_offsets;
+    for (const auto& resolution : resolutions_) {
+        level_offsets.push_back(size);
+        size = align(size + series_count * (resolution.length + 1) * sizeof(double) +
+                     history.max_rows * sizeof(uint32_t));
+    }
+
+    if (directory_.empty()) {
+        history.segment = TRY(HistorySegment::create(size));
+    } else {
+        auto path = fmt::format("{}/{}.history", directory_, format_topic(history.schema->topic));
+        history.segment = TRY(HistorySegment::open(path, size, segment_layout(history)));
+    }
+    auto* data = history.segment->data();
+    history.slot_count = reinterpret_cast<uint64_t*>(data);
+    auto* steps = reinterpret_cast<LevelSteps*>(data + steps_offset);
+    history.slot_entries = {reinterpret_cast<SlotEntry*>(data + slots_offset), history.max_rows};
+    for (size_t i = 0; i < resolutions_.size(); ++i) {
+        auto points_count = series_count * resolutions_[i].length;
+        auto* points = reinterpret_cast<double*>(data + level_offsets[i]);
+        auto* sums = points + points_count;
+        auto* counts = reinterpret_cast<uint32_t*>(sums + series_count);
+        history.levels.push_back(Level{
+            {points, points_count},
+            {sums, series_count},
+            {counts, history.max_rows},
+            steps + i,
+        });
+    }
+    return {};
+}
+
+// Hashes (FNV-1a) everything the layout of a segment depends on.
+auto HistoryStore::segment_layout(const TopicHistory& history) const -> uint64_t {
+    uint64_t hash = 14695981039346656037ULL;
+    auto add = [&hash](std::string_view bytes) {
+        for (auto byte : bytes) {
+            hash = (hash ^ static_cast<uint8_t>(byte)) * 1099511628211ULL;
+        }
+    };
+    auto add_number = [&add](uint64_t number) {
+        add({reinterpret_cast<const char*>(&number), sizeof(number)});
+    };
+    add_number(SEGMENT_LAYOUT_VERSION);
+    add_number(MAX_KEY_LENGTH);
+    add_number(history.max_rows);
+    for (const auto& resolution : resolutions_) {
+        add_number(static_cast<uint64_t>(resolution.step.count()));
+        add_number(resolution.length);
+    }
+    for (auto index : history.fields) {
+        // names may be prefixes of each other; the type separates them
+        add(history.schema->fields[index].name);
+        add_number(static_cast<uint64_t>(history.schema->fields[index].type));
+    }
+    return hash;
+}
+
+auto HistoryStore::initialize_segment(TopicHistory& history) const -> void {
+    // the segment is zeroed, which makes for no slots, zero sums and counts
+    for (auto& level : history.levels) {
+        std::fill(level.points.begin(), level.points.end(), EMPTY);
+        *level.steps = {-1, -1};
+    }
+}
+
+auto HistoryStore::restore_slots(TopicHistory& history) -> void {
+    auto slot_count = std::min(*history.slot_count, static_cast<uint64_t>(history.max_rows));
+    for (uint32_t slot = 0; slot < slot_count; ++slot) {
+        const auto& entry = history.slot_entries[slot];
+        auto key_length = std::min<size_t>(entry.key_length, MAX_KEY_LENGTH);
+        const auto& key = history.keys.emplace_back(entry.key.data(), key_length);
+        history.slots.emplace(key, slot);
+    }
+}
+
+auto HistoryStore::is_restored(Topic topic) const -> bool {
+    const auto& history = topics_[static_cast<size_t>(topic)];
+    return history != nullptr && history->is_restored;
+}
+
+auto HistoryStore::memory_size() const -> size_t {
+    size_t size = 0;
+    for (const auto& history : topics_) {
+        if (history != nullptr) {
+            size += history->segment->size();
+        }
+    }
+    return size;
+}
+
+auto HistoryStore::record(const Snapshot& snapshot) -> void {
+    auto& history_pointer = topics_[static_cast<size_t>(snapshot.topic())];
+    if (history_pointer == nullptr) {
+        return;
+    }
+    auto& history = *history_pointer;
+    std::lock_guard lock(history.mutex);
+
+    auto timestamp = snapshot.timestamp();
+    for (size_t i = 0; i < resolutions_.size(); ++i) {
+        auto& level = history.levels[i];
+        auto step = timestamp / resolutions_[i].step;
+        if (level.steps->current < 0) {
+            level.steps->current = step;
+            level.steps->first = step;
+        } else if (step > level.steps->current) {
+            advance(history, level, resolutions_[i].length, step);
+        }
+        // a clock stepping back keeps adding to the step in progress
+    }
+
+    // rows seen before keep their slots; only then may new rows take over
+    // the slots of rows that are gone
+    auto rows = snapshot.rows();
+    history.row_slots.assign(rows.size(), std::nullopt);
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if (auto it = history.slots.find(rows[i].key); it != history.slots.end()) {
+            history.row_slots[i] = it->second;
+            history.slot_entries[it->second].last_seen = timestamp.count();
+        }
+    }
+    for (size_t i = 0; i < rows.size(); ++i) {
+        if (!history.row_slots[i].has_value()) {
+            history.row_slots[i] = take_slot(history, rows[i].key, timestamp);
+        }
+        if (!history.row_slots[i].has_value()) {
+            continue;
+        }
+        auto slot = history.row_slots[i].value();
+        for (auto& level : history.levels) {
+            ++level.counts[slot];
+            for (size_t field = 0; field < history.fields.size(); ++field) {
+                level.sums[field * history.max_rows + slot] += as_double(rows[i].values[history.fields[field]]);
+            }
+        }
+    }
+}
+
+auto HistoryStore::take_slot(TopicHistory& history, const std::string& key, std::chrono::milliseconds timestamp) const
+    -> std::optional<uint32_t> {
+    if (key.size() > MAX_KEY_LENGTH) {
+        return std::nullopt;
+    }
+    uint32_t slot = 0;
+    if (history.keys.size() < history.max_rows) {
+        slot = static_cast<uint32_t>(history.keys.size());
+        history.keys.push_back(key);
+    } else {
+        auto slot_entries = history.slot_entries.first(history.keys.size());
+        auto oldest = std::min_element(slot_entries.begin(), slot_entries.end(), [](const auto& lhs, const auto& rhs) {
+            return lhs.last_seen < rhs.last_seen;
+        });
+        if (oldest->last_seen >= timestamp.count()) {
+            return std::nullopt;
+        }
+        slot = static_cast<uint32_t>(oldest - slot_entries.begin());
+        history.slots.erase(history.keys[slot]);
+        history.keys[slot] = key;
+        clear_slot(history, slot);
+    }
+    auto& entry = history.slot_entries[slot];
+    entry.last_seen = timestamp.count();
+    entry.key_length = static_cast<uint32_t>(key.size());
+    std::copy(key.begin(), key.end(), entry.key.begin());
+    *history.slot_count = history.keys.size();
+    history.slots.emplace(key, slot);
+    return slot;
+}
+
+auto HistoryStore::clear_slot(TopicHistory& history, uint32_t slot) const -> void {
+    for (size_t i = 0; i < resolutions_.size(); ++i) {
+        auto& level = history.levels[i];
+        auto length = resolutions_[i].length;
+        for (size_t field = 0; field < history.fields.size(); ++field) {
+            auto series = field * history.max_rows + slot;
+            std::fill_n(level.points.begin() + static_cast<ptrdiff_t>(series * length), length, EMPTY);
+            level.sums[series] = 0.0;
+        }
+        level.counts[slot] = 0;
+    }
+}
+
+auto HistoryStore::advance(const TopicHistory& history, Level& level, size_t length, int64_t step) -> void {
+    auto slot_count = history.keys.size();
+    auto position = static_cast<size_t>(level.steps->current) % length;
+    for (size_t field = 0; field < history.fields.size(); ++field) {
+        for (size_t slot = 0; slot < slot_count; ++slot) {
+            auto series = field * history.max_rows + slot;
+            auto count = level.counts[slot];
+            level.points[series * length + position] = count == 0 ? EMPTY : level.sums[series] / count;
+        }
+    }
+    // at most a whole ring's worth of steps went by without samples
+    auto skipped_end = std::min(step, level.steps->current + static_cast<int64_t>(length) + 1);
+    for (auto skipped = level.steps->current + 1; skipped < skipped_end; ++skipped) {
+        position = static_cast<size_t>(skipped) % length;
+        for (size_t field = 0; field < history.fields.size(); ++field) {
+            for (size_t slot = 0; slot < slot_count; ++slot) {
+                level.points[(field * history.max_rows + slot) * length + position] = EMPTY;
+            }
+        }
+    }
+    std::fill(level.sums.begin(), level.sums.end(), 0.0);
+    std::fill(level.counts.begin(), level.counts.end(), 0);
+    level.steps->current = step;
+}
+
+// Returns the slots of the kept rows ordered by key.
+auto HistoryStore::sorted_slots(const TopicHistory& history) -> std::vector<uint32_t> {
+    std::vector<uint32_t> slots(history.keys.size());
+    for (uint32_t slot = 0; slot < slots.size(); ++slot) {
+        slots[slot] = slot;
+    }
+    std::sort(slots.begin(), slots.end(), [&history](uint32_t lhs, uint32_t rhs) {
+        return history.keys[lhs] < history.keys[rhs];
+    });
+    return slots;
+}
+
+auto HistoryStore::copy_window(const TopicHistory& history,
+                               const Level& level,
+                               size_t length,
+                               size_t first_field,
+                               size_t field_count,
+                               int64_t begin,
+                               int64_t end) -> Window {
+    Window window{.begin = begin, .end = end, .field_count = field_count, .row_count = 0, .keys = {}, .points = {}};
+    std::vector<uint32_t> slots;
+    if (history.schema->has_rows()) {
+        slots = sorted_slots(history);
+        window.keys.reserve(slots.size());
+        for (auto slot : slots) {
+            window.keys.push_back(history.keys[slot]);
+        }
+    } else if (!history.keys.empty()) {
+        slots.push_back(0);
+    }
+    window.row_count = slots.size();
+    window.points.reserve(slots.size() * field_count * static_cast<size_t>(end - begin));
+    for (auto slot : slots) {
+        for (auto field = first_field; field < first_field + field_count; ++field) {
+            auto series = field * history.max_rows + slot;
+            const auto* points = level.points.data() + series * length;
+            for (auto step_number = begin; step_number < end; ++step_number) {
+                if (step_number == level.steps->current) {
+                    window.points.push_back(level.counts[slot] == 0 ? EMPTY : level.sums[series] / level.counts[slot]);
+                } else {
+                    window.points.push_back(points[static_cast<size_t>(step_number) % length]);
+                }
+            }
+        }
+    }
+    return window;
+}
+
+auto HistoryStore::write_json(fmt::memory_buffer& out, Topic topic, std::chrono::milliseconds step) const
+    -> ErrorOr<void> {
+    const auto* history_pointer = topics_[static_cast<size_t>(topic)].get();
+    if (history_pointer == nullptr) {
+        return {Error::from_string("no history kept")};
+    }
+    auto level_index = static_cast<size_t>(
+        std::find_if(resolutions_.begin(), resolutions_.end(), [step](const auto& r) { return r.step >= step; }) -
+        resolutions_.begin());
+    if (level_index == resolutions_.size()) {
+        return {Error::from_string("step too coarse")};
+    }
+    const auto& history = *history_pointer;
+    const auto& resolution = resolutions_[level_index];
+
+    // only the copy is made under the lock, so recording the topic never
+    // waits for an answer being written
+    Window copy;
+    {
+        std::lock_guard lock(history.mutex);
+        const auto& level = history.levels[level_index];
+        int64_t start = 0;
+        int64_t end = 0;
+        if (level.steps->current >= 0) {
+            start = std::max(level.steps->first, level.steps->current - static_cast<int64_t>(resolution.length) + 1);
+            end = level.steps->current + 1;
+        }
+        copy = copy_window(history, level, resolution.length, 0, history.fields.size(), start, end);
+    }
+
+    JsonWriter writer(out);
+    writer.raw(R"({"topic":")");
+    writer.raw(format_topic(topic));
+    writer.raw(R"(","step":)");
+    writer.number(static_cast<uint64_t>(resolution.step.count()));
+    writer.raw(R"(,"start":)");
+    writer.number(static_cast<uint64_t>(copy.begin * resolution.step.count()));
+    writer.raw(R"(,"count":)");
+    writer.number(static_cast<uint64_t>(copy.end - copy.begin));
+    writer.raw(R"(,"history":)");
+
+    // Writes the series of a row as an object of arrays, keyed like the
+    // fields of a keyframe.
+    auto write_series = [&](size_t row) {
+        writer.raw('{');
+        size_t skip = 1;
+        for (size_t field = 0; field < history.fields.size(); ++field) {
+            writer.raw(history.schema->fields[history.fields[field]].json_key.substr(skip));
+            skip = 0;
+            char separator = '[';
+            for (auto point : copy.series(row, field)) {
+                writer.raw(separator);
+                separator = ',';
+                writer.number(point);
+            }
+            writer.raw(separator == '[' ? "[]" : "]");
+        }
+        writer.raw('}');
+    };
+
+    if (!history.schema->has_rows()) {
+        if (copy.row_count == 0) {
+            writer.raw("{}");
+        } else {
+            write_series(0);
+        }
+    } else {
+        char separator = '{';
+        for (size_t row = 0; row < copy.row_count; ++row) {
+            writer.raw(separator);
+            separator = ',';
+            writer.string(copy.keys[row]);
+            writer.raw(':');
+            write_series(row);
+        }
+        writer.raw(separator == '{' ? "{}" : "}");
+    }
+    writer.raw('}');
+    return {};
+}
+
+// aggregates written per step by write_query_json(), in output order
+static constexpr std::array<std::string_view, 6> AGGREGATES = {"min", "max", "mean", "p50", "p95", "p99"};
+
+auto HistoryStore::write_query_json(fmt::memory_buffer& out,
+                                    Topic topic,
+                                    std::string_view field,
+                                    std::chrono::milliseconds window,
+                                    std::chrono::milliseconds step) const -> ErrorOr<void> {
+    const auto* history_pointer = topics_[static_cast<size_t>(topic)].get();
+    if (history_pointer == nullptr) {
+        return {Error::from_string("no history kept")};
+    }
+    const auto& history = *history_pointer;
+    auto field_it = std::find_if(history.fields.begin(), history.fields.end(), [&](size_t index) {
+        return history.schema->fields[index].name == field;
+    });
+    if (field_it == history.fields.end()) {
+        return {Error::from_string("unknown field")};
+    }
+    auto field_index = static_cast<size_t>(field_it - history.fields.begin());
+    if (step.count() <= 0 || window < step) {
+        return {Error::from_string("invalid window")};
+    }
+    auto step_count = (window + step - std::chrono::milliseconds(1)) / step;
+    auto level_index = static_cast<size_t>(
+        std::find_if(resolutions_.begin(),
+                     resolutions_.end(),
+                     [&](const auto& r) {
+                         return step % r.step == std::chrono::milliseconds(0) &&
+                                r.step * static_cast<int64_t>(r.length) >= step * step_count;
+                     }) -
+        resolutions_.begin());
+    if (level_index == resolutions_.size()) {
+        return {Error::from_string("no history at that window and step")};
+    }
+    const auto& resolution = resolutions_[level_index];
+    auto points_per_step = step / resolution.step;
+
+    // in steps of the query; the last one holds the step in progress
+    int64_t first = 0;
+    int64_t count = 0;
+    // only the copy is made under the lock, so recording the topic never
+    // waits for the aggregates being computed
+    Window copy;
+    {
+        std::lock_guard lock(history.mutex);
+        const auto& level = history.levels[level_index];
+        int64_t begin = 0;
+        int64_t end = 0;
+        if (level.steps->current >= 0) {
+            first = level.steps->current / points_per_step - step_count + 1;
+            count = step_count;
+            // in steps of the resolution, from the oldest point still kept
+            auto oldest =
+                std::max(level.steps->first, level.steps->current - static_cast<int64_t>(resolution.length) + 1);
+            begin = std::max(first * points_per_step, oldest);
+            end = level.steps->current + 1;
+        }
+        copy = copy_window(history, level, resolution.length, field_index, 1, begin, end);
+    }
+
+    JsonWriter writer(out);
+    writer.raw(R"({"topic":")");
+    writer.raw(format_topic(topic));
+    writer.raw(R"(","field":)");
+    writer.string(field);
+    writer.raw(R"(,"step":)");
+    writer.number(static_cast<uint64_t>(step.count()));
+    writer.raw(R"(,"start":)");
+    writer.number(static_cast<uint64_t>(std::max(first, int64_t{0}) * step.count()));
+    writer.raw(R"(,"count":)");
+    writer.number(static_cast<uint64_t>(count));
+    writer.raw(R"(,"query":)");
+
+    QuantileSketch sketch;
+    std::vector<std::array<double, AGGREGATES.size()>> aggregates(static_cast<size_t>(count));
+    auto write_aggregates = [&](size_t row) {
+        auto points = copy.series(row, 0);
+        for (int64_t i = 0; i < count; ++i) {
+            // the kept points of the step, the last one's including the mean
+            // of the step in progress
+            auto begin = std::max((first + i) * points_per_step, copy.begin);
+            auto end = std::min((first + i + 1) * points_per_step, copy.end);
+            reductions::Summary summary;
+            sketch.clear();
+            if (begin < end) {
+                auto span = points.subspan(static_cast<size_t>(begin - copy.begin), static_cast<size_t>(end - begin));
+                summary = reductions::summarize(span);
+                for (auto point : span) {
+                    sketch.add(point);
+                }
+            }
+            if (summary.count == 0) {
+                aggregates[static_cast<size_t>(i)].fill(EMPTY);
+                continue;
+            }
+            aggregates[static_cast<size_t>(i)] = {
+                summary.min,
+                summary.max,
+                summary.mean(),
+                sketch.quantile(0.5),
+                sketch.quantile(0.95),
+                sketch.quantile(0.99),
+            };
+        }
+
+        char separator = '{';
+        for (size_t aggregate = 0; aggregate < AGGREGATES.size(); ++aggregate) {
+            writer.raw(separator);
+            separator = ',';
+            writer.raw('"');
+            writer.raw(AGGREGATES[aggregate]);
+            writer.raw(R"(":[)");
+            for (size_t i = 0; i < aggregates.size(); ++i) {
+                if (i > 0) {
+                    writer.raw(',');
+                }
+                writer.number(aggregates[i][aggregate]);
+            }
+            writer.raw(']');
+        }
+        writer.raw('}');
+    };
+
+    if (!history.schema->has_rows()) {
+        if (copy.row_count == 0) {
+            writer.raw("{}");
+        } else {
+            write_aggregates(0);
+        }
+    } else {
+        char separator = '{';
+        for (size_t row = 0; row < copy.row_count; ++row) {
+            writer.raw(separator);
+            separator = ',';
+            writer.string(copy.keys[row]);
+            writer.raw(':');
+            write_aggregates(row);
+        }
+        writer.raw(separator == '{' ? "{}" : "}");
+    }
+    writer.raw('}');
+    return {};
+}
@@ -0,0 +1,226 @@
+#pragma once
+
+#include "../Common/Error.h"
+#include "HistorySegment.h"
+#include "Snapshot.h"
+#include "Topic.h"
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <fmt/format.h>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+namespace metrics {
+
+// HistoryStore keeps the recent past of topics at several resolutions, so
+// that a dashboard connecting now can draw its graphs from the start rather
+// than from the next sample on.
+//
+// Every numeric field of every kept row is a series. A resolution holds a
+// ring of points per series, each the mean of the samples taken during a
+// step; samples are added to every resolution as they are recorded, so the
+// coarser ones are downsampled incrementally rather than recomputed. Points
+// are stored column-wise, one contiguous ring per field and row, so reading
+// a series walks memory in order.
+//
+// All memory is allocated by add_topic(): it depends only on the
+// resolutions, the number of numeric fields and the row limit, see
+// memory_size(). Rows beyond the limit are not kept; once a kept row is
+// gone, its place goes to the next new row.
+//
+// Everything about a topic, points, the steps in progress and the keys of
+// the kept rows, lives in one HistorySegment of fixed layout. Given a
+// directory, the segments are files mapped from it: samples are written in
+// place as they are recorded, and a store created after a restart maps the
+// files back and carries on from where they left off, without reading or
+// replaying anything. The page cache is then all the memory they take.
+//
+// Recording and reading may happen on different threads.
+class HistoryStore final {
+public:
+    struct Resolution {
+        std::chrono::milliseconds step;
+        // number of points kept
+        size_t length;
+    };
+
+    // 1 s for 10 minutes, 10 s for 6 hours and 1 min for 7 days
+    static constexpr std::array DEFAULT_RESOLUTIONS = {
+        Resolution{std::chrono::seconds(1), 600},
+        Resolution{std::chrono::seconds(10), 2160},
+        Resolution{std::chrono::minutes(1), 10080},
+    };
+
+    // rows with longer keys are not kept
+    static constexpr size_t MAX_KEY_LENGTH = 116;
+
+    // Resolutions must be ordered from fine to coarse. Without a directory
+    // the history is kept in anonymous memory and lost with the store.
+    explicit HistoryStore(std::span<const Resolution> resolutions = DEFAULT_RESOLUTIONS, std::string directory = {});
+
+    HistoryStore(const HistoryStore&) = delete;
+    HistoryStore(HistoryStore&&) noexcept = delete;
+    ~HistoryStore() noexcept = default;
+
+    auto operator=(const HistoryStore&) -> HistoryStore& = delete;
+    auto operator=(HistoryStore&&) noexcept -> HistoryStore& = delete;
+
+    // Keeps the history of up to max_rows rows of the topic of given
+    // schema, which must outlive the store. Must be called before anything
+    // is recorded. With a directory, takes over the history in the topic's
+    // file if it was written for the same resolutions, fields and row limit,
+    // and starts it anew otherwise.
+    auto add_topic(const Schema& schema, size_t max_rows) -> common::ErrorOr<void>;
+
+    [[nodiscard]] auto is_kept(Topic topic) const -> bool { return topics_[static_cast<size_t>(topic)] != nullptr; }
+    [[nodiscard]] auto resolutions() const -> std::span<const Resolution> { return resolutions_; }
+    [[nodiscard]] auto directory() const -> const std::string& { return directory_; }
+    // Returns true when the history of the topic was taken over from its
+    // file rather than started anew.
+    [[nodiscard]] auto is_restored(Topic topic) const -> bool;
+    // Bytes taken by the segments of all topics.
+    [[nodiscard]] auto memory_size() const -> size_t;
+
+    // Adds a published snapshot of a kept topic; ignores other topics.
+    auto record(const Snapshot& snapshot) -> void;
+
+    // Appends the history of given topic at the finest resolution whose step
+    // is at least the given one:
+    //
+    //   {"topic":"net","step":1000,"start":1700000000000,"count":600,
+    //    "history":{"eth0":{"rx_bytes":[1234,null,...],...},...}}
+    //
+    // Points are oldest first, the first one for the step starting at start
+    // and the last one for the step in progress. Steps without samples are
+    // null. Single row topics have their fields directly under "history".
+    // Fails when the topic isn't kept or the step is too coarse.
+    auto write_json(fmt::memory_buffer& out, Topic topic, std::chrono::milliseconds step) const
+        -> common::ErrorOr<void>;
+
+    // Appends the minimum, maximum, mean and 50th, 95th and 99th percentile
+    // of a field of every kept row per step of a window ending with the step
+    // in progress:
+    //
+    //   {"topic":"cpu.per_core","field":"usage","step":10000,
+    //    "start":1700000000000,"count":30,"query":{"cpu0":{"min":[0.5,...],
+    //    "max":[...],"mean":[...],"p50":[...],"p95":[...],"p99":[...]},...}}
+    //
+    // Aggregates the points of the finest resolution whose step divides the
+    // given one and which covers the window; percentiles are estimated by a
+    // QuantileSketch. Steps without points are null. Fails when the topic or
+    // field isn't kept or no resolution fits.
+    auto write_query_json(fmt::memory_buffer& out,
+                          Topic topic,
+                          std::string_view field,
+                          std::chrono::milliseconds window,
+                          std::chrono::milliseconds step) const -> common::ErrorOr<void>;
+
+private:
+    // The numbers of the step in progress and of the first one recorded;
+    // -1 until something is.
+    struct LevelSteps {
+        int64_t current;
+        int64_t first;
+    };
+
+    // A kept row; the key is the first key_length characters.
+    struct SlotEntry {
+        int64_t last_seen;
+        uint32_t key_length;
+        std::array<char, MAX_KEY_LENGTH> key;
+    };
+
+    // The parts of a segment for one resolution.
+    struct Level {
+        // per numeric field, per row slot, a ring of length points indexed
+        // by step number modulo length
+        std::span<double> points;
+        // sums per numeric field and slot, sample counts per slot of the
+        // step in progress
+        std::span<double> sums;
+        std::span<uint32_t> counts;
+        LevelSteps* steps{nullptr};
+    };
+
+    struct TopicHistory {
+        const Schema* schema{nullptr};
+        // schema indices of the numeric fields
+        std::vector<size_t> fields;
+        size_t max_rows{0};
+        std::optional<HistorySegment> segment;
+        // the number of slots taken, and the slots in the segment
+        uint64_t* slot_count{nullptr};
+        std::span<SlotEntry> slot_entries;
+        // keys of the rows in slot order, as in the segment
+        std::vector<std::string> keys;
+        std::unordered_map<std::string, uint32_t> slots;
+        // slot of each row of the snapshot being recorded
+        std::vector<std::optional<uint32_t>> row_slots;
+        std::vector<Level> levels;
+        bool is_restored{false};
+        mutable std::mutex mutex;
+    };
+
+    // Points of a level copied out under the topic's lock, so that answers
+    // are formatted without holding it.
+    struct Window {
+        // in steps of the level; the step in progress holds its mean so far
+        int64_t begin{0};
+        int64_t end{0};
+        size_t field_count{0};
+        size_t row_count{0};
+        // keys of the rows in output order; empty for single row topics
+        std::vector<std::string> keys;
+        // per row and field, the points of the steps in [begin, end)
+        std::vector<double> points;
+
+        [[nodiscard]] auto series(size_t row, size_t field) const -> std::span<const double> {
+            auto length = static_cast<size_t>(end - begin);
+            return std::span(points).subspan((row * field_count + field) * length, length);
+        }
+    };
+
+    // Maps the segment of a topic and points the history at its parts.
+    auto map_segment(TopicHistory& history) const -> common::ErrorOr<void>;
+    // Returns a number identifying the layout of the segment of a topic.
+    [[nodiscard]] auto segment_layout(const TopicHistory& history) const -> uint64_t;
+    // Fills a new segment with empty steps and no rows.
+    auto initialize_segment(TopicHistory& history) const -> void;
+    // Takes over the rows of a segment mapped back.
+    static auto restore_slots(TopicHistory& history) -> void;
+    // Returns a slot for a row not kept so far, taking over the slot of the
+    // row gone longest when all are taken; nullopt when every kept row was
+    // seen at given time.
+    auto take_slot(TopicHistory& history, const std::string& key, std::chrono::milliseconds timestamp) const
+        -> std::optional<uint32_t>;
+    // Empties the series of given slot in every level.
+    auto clear_slot(TopicHistory& history, uint32_t slot) const -> void;
+    // Moves given level of length points on to given step, storing the means
+    // of the step in progress and marking the steps skipped empty.
+    static auto advance(const TopicHistory& history, Level& level, size_t length, int64_t step) -> void;
+    static auto sorted_slots(const TopicHistory& history) -> std::vector<uint32_t>;
+    // Copies field_count numeric fields starting at first_field of every row
+    // over steps [begin, end) of given level of length points. Called with
+    // the topic locked.
+    static auto copy_window(const TopicHistory& history,
+                            const Level& level,
+                            size_t length,
+                            size_t first_field,
+                            size_t field_count,
+                            int64_t begin,
+                            int64_t end) -> Window;
+
+    std::vector<Resolution> resolutions_;
+    std::string directory_;
+    std::array<std::unique_ptr<TopicHistory>, TOPIC_COUNT> topics_;
+};
+
+} // namespace metrics
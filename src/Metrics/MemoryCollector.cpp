@@ -0,0 +1,54 @@
+#include "MemoryCollector.h"
+#include "ProcFs.h"
+#include <array>
+
+using namespace common;
+using namespace metrics;
+
+namespace {
+
+// in schema order
+constexpr std::array<std::string_view, 7> MEMINFO_NAMES = {
+    "MemTotal:", "MemFree:", "MemAvailable:", "Buffers:", "Cached:", "SwapTotal:", "SwapFree:",
+};
+
+constexpr std::array<FieldDescriptor, MEMINFO_NAMES.size()> FIELDS = {{
+    field<"total">(FieldType::UINT),
+    field<"free">(FieldType::UINT),
+    field<"available">(FieldType::UINT),
+    field<"buffers">(FieldType::UINT),
+    field<"cached">(FieldType::UINT),
+    field<"swap_total">(FieldType::UINT),
+    field<"swap_free">(FieldType::UINT),
+}};
+constexpr Schema SCHEMA = {Topic::MEMORY, {}, FIELDS};
+
+} // namespace
+
+MemoryCollector::MemoryCollector(std::string meminfo_path) :
+    meminfo_file_(std::move(meminfo_path)) {}
+
+auto MemoryCollector::schema() const -> const Schema& {
+    return SCHEMA;
+}
+
+auto MemoryCollector::collect(Snapshot& snapshot) -> ErrorOr<void> {
+    auto text = TRY(meminfo_file_.read());
+
+    auto& row = snapshot.add_row();
+    // the names looked for are among the first lines of some fifty
+    size_t found = 0;
+    while (!text.empty() && found < MEMINFO_NAMES.size()) {
+        auto line = procfs::next_line(text);
+        auto name = procfs::next_field(line);
+        for (size_t i = 0; i < MEMINFO_NAMES.size(); ++i) {
+            if (MEMINFO_NAMES[i] == name) {
+                // reported in KiB
+                row.values[i] = procfs::next_uint(line) * 1024;
+                ++found;
+                break;
+            }
+        }
+    }
+    return {};
+}
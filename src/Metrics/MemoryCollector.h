@@ -0,0 +1,21 @@
+#pragma once
+
+#include "Collector.h"
+#include "ProcFs.h"
+#include <string>
+
+namespace metrics {
+
+// MemoryCollector reports memory and swap usage from /proc/meminfo, in bytes.
+class MemoryCollector final : public Collector {
+public:
+    explicit MemoryCollector(std::string meminfo_path = "/proc/meminfo");
+
+    [[nodiscard]] auto schema() const -> const Schema& override;
+    auto collect(Snapshot& snapshot) -> common::ErrorOr<void> override;
+
+private:
+    procfs::ProcFile meminfo_file_;
+};
+
+} // namespace metrics
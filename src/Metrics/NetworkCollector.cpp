@@ -0,0 +1,130 @@
+#include "NetworkCollector.h"
+#include "ProcFs.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+using namespace common;
+using namespace metrics;
+
+namespace {
+
+enum NetworkField : size_t {
+    RX_BYTES,
+    RX_PACKETS,
+    RX_ERRORS,
+    TX_BYTES,
+    TX_PACKETS,
+    TX_ERRORS,
+    RX_BYTES_PER_S,
+    RX_PACKETS_PER_S,
+    TX_BYTES_PER_S,
+    TX_PACKETS_PER_S,
+    SPEED,
+    UTILIZATION,
+};
+
+constexpr std::array<FieldDescriptor, 12> FIELDS = {{
+    field<"rx_bytes">(FieldType::UINT),
+    field<"rx_packets">(FieldType::UINT),
+    field<"rx_errors">(FieldType::UINT),
+    field<"tx_bytes">(FieldType::UINT),
+    field<"tx_packets">(FieldType::UINT),
+    field<"tx_errors">(FieldType::UINT),
+    field<"rx_bytes_per_s">(FieldType::UINT),
+    field<"rx_packets_per_s">(FieldType::UINT),
+    field<"tx_bytes_per_s">(FieldType::UINT),
+    field<"tx_packets_per_s">(FieldType::UINT),
+    field<"speed_mbps">(FieldType::UINT),
+    field<"utilization">(FieldType::FLOAT),
+}};
+constexpr Schema SCHEMA = {Topic::NETWORK, "interface", FIELDS};
+
+// the counters kept per interface to compute rates
+enum RateCounter : size_t { RATE_RX_BYTES, RATE_RX_PACKETS, RATE_TX_BYTES, RATE_TX_PACKETS, RATE_COUNTER_COUNT };
+
+} // namespace
+
+NetworkCollector::NetworkCollector(std::string dev_path, std::string sys_class_net_path, RateClock clock) :
+    dev_file_(std::move(dev_path)),
+    sys_class_net_path_(std::move(sys_class_net_path)),
+    devices_(RATE_COUNTER_COUNT, std::move(clock)) {}
+
+auto NetworkCollector::schema() const -> const Schema& {
+    return SCHEMA;
+}
+
+auto NetworkCollector::read_speed(std::string_view name) -> uint64_t {
+    path_buffer_.assign(sys_class_net_path_);
+    path_buffer_.push_back('/');
+    path_buffer_.append(name);
+    path_buffer_.append("/speed");
+    // fails with EINVAL for interfaces without a link speed
+    if (procfs::read_file(path_buffer_.c_str(), speed_buffer_).is_error() || speed_buffer_.starts_with('-')) {
+        return 0;
+    }
+    std::string_view text = speed_buffer_;
+    return procfs::next_uint(text);
+}
+
+auto NetworkCollector::collect(Snapshot& snapshot) -> ErrorOr<void> {
+    auto text = TRY(dev_file_.read());
+    devices_.begin_sample();
+    ++sample_;
+
+    // two header lines
+    procfs::next_line(text);
+    procfs::next_line(text);
+
+    while (!text.empty()) {
+        auto line = procfs::next_line(text);
+        // large counters may follow the colon without a space
+        auto colon = line.find(':');
+        if (colon == std::string_view::npos) {
+            continue;
+        }
+        auto name = line.substr(0, colon);
+        name.remove_prefix(std::min(name.find_first_not_of(' '), name.size()));
+        line.remove_prefix(colon + 1);
+
+        // 8 receive counters followed by 8 transmit counters
+        std::array<uint64_t, 16> fields{};
+        for (auto& field : fields) {
+            field = procfs::next_uint(line);
+        }
+
+        auto id = devices_.see(name);
+        if (id >= speeds_.size()) {
+            speeds_.resize(id + 1);
+        }
+        if (devices_.is_new(id) || (sample_ + id) % SPEED_REFRESH_SAMPLES == 0) {
+            speeds_[id] = read_speed(name);
+        }
+        auto rx_bytes_per_s = devices_.rate(id, RATE_RX_BYTES, fields[0]);
+        auto rx_packets_per_s = devices_.rate(id, RATE_RX_PACKETS, fields[1]);
+        auto tx_bytes_per_s = devices_.rate(id, RATE_TX_BYTES, fields[8]);
+        auto tx_packets_per_s = devices_.rate(id, RATE_TX_PACKETS, fields[9]);
+        // links are full duplex; the busier direction is what saturates
+        auto utilization = speeds_[id] == 0 ? 0.0
+                                            : std::max(rx_bytes_per_s, tx_bytes_per_s) * 8.0 /
+                                                  (static_cast<double>(speeds_[id]) * 1e6);
+
+        auto& row = snapshot.add_row(std::string(name));
+        row.values[RX_BYTES] = fields[0];
+        row.values[RX_PACKETS] = fields[1];
+        row.values[RX_ERRORS] = fields[2];
+        row.values[TX_BYTES] = fields[8];
+        row.values[TX_PACKETS] = fields[9];
+        row.values[TX_ERRORS] = fields[10];
+        row.values[RX_BYTES_PER_S] = whole_rate(rx_bytes_per_s);
+        row.values[RX_PACKETS_PER_S] = whole_rate(rx_packets_per_s);
+        row.values[TX_BYTES_PER_S] = whole_rate(tx_bytes_per_s);
+        row.values[TX_PACKETS_PER_S] = whole_rate(tx_packets_per_s);
+        row.values[SPEED] = speeds_[id];
+        // in percent, rounded to a tenth so that noise doesn't defeat delta
+        // encoding
+        row.values[UTILIZATION] = std::round(utilization * 1000.0) / 10.0;
+    }
+    devices_.end_sample();
+    return {};
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "Collector.h"
+#include "DeviceTable.h"
+#include "ProcFs.h"
+#include <string>
+#include <vector>
+
+namespace metrics {
+
+// NetworkCollector reports the traffic counters of every network interface
+// from /proc/net/dev, their rates per second since the previous sample and
+// how much of the link speed they use.
+//
+// Link speeds come from /sys/class/net/<interface>/speed, read when an
+// interface shows up and then once a minute at one sample a second,
+// staggered so that hosts with hundreds of virtual interfaces don't read
+// them all in the same sample. Interfaces without a speed, such as
+// loopback, report a utilization of zero.
+class NetworkCollector final : public Collector {
+public:
+    // samples between reads of the speed of an interface
+    static constexpr uint32_t SPEED_REFRESH_SAMPLES = 60;
+
+    explicit NetworkCollector(std::string dev_path = "/proc/net/dev",
+                              std::string sys_class_net_path = "/sys/class/net",
+                              RateClock clock = std::chrono::steady_clock::now);
+
+    [[nodiscard]] auto schema() const -> const Schema& override;
+    auto collect(Snapshot& snapshot) -> common::ErrorOr<void> override;
+
+private:
+    // Returns the link speed of given interface in Mbit/s; zero if unknown.
+    auto read_speed(std::string_view name) -> uint64_t;
+
+    procfs::ProcFile dev_file_;
+    std::string sys_class_net_path_;
+    DeviceTable devices_;
+    // by device id
+    std::vector<uint64_t> speeds_;
+    uint32_t sample_{0};
+    std::string path_buffer_;
+    std::string speed_buffer_;
+};
+
+} // namespace metrics
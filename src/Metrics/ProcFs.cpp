@@ -0,0 +1,223 @@
+#include "ProcFs.h"
+#include <algorithm>
+#include <cerrno>
+#include <charconv>
+#include <cmath>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace common;
+using namespace metrics;
+
+auto procfs::read_file(const char* path, std::string& buffer) -> ErrorOr<void> {
+    auto fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return {Error::from_errno(errno, fmt::format("open({})", path), ErrorDomain::FILE)};
+    }
+
+    buffer.clear();
+    if (buffer.capacity() < 4096) {
+        buffer.reserve(4096);
+    }
+    while (true) {
+        auto size = buffer.size();
+        buffer.resize(buffer.capacity());
+        auto bytes_read = ::read(fd, buffer.data() + size, buffer.size() - size);
+        if (bytes_read < 0) {
+            if (errno == EINTR) {
+                buffer.resize(size);
+                continue;
+            }
+            auto error = Error::from_errno(errno, fmt::format("read({})", path), ErrorDomain::FILE);
+            ::close(fd);
+            buffer.clear();
+            return {std::move(error)};
+        }
+        buffer.resize(size + static_cast<size_t>(bytes_read));
+        if (bytes_read == 0) {
+            break;
+        }
+        if (buffer.size() == buffer.capacity()) {
+            buffer.reserve(buffer.capacity() * 2);
+        }
+    }
+    ::close(fd);
+    return {};
+}
+
+procfs::ProcFile::ProcFile(std::string path) :
+    path_(std::move(path)),
+    buffer_(INITIAL_BUFFER_SIZE) {}
+
+procfs::ProcFile::~ProcFile() noexcept {
+    close();
+}
+
+auto procfs::ProcFile::close() noexcept -> void {
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+auto procfs::ProcFile::read() -> ErrorOr<std::string_view> {
+    if (fd_ < 0) {
+        fd_ = ::open(path_.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd_ < 0) {
+            return {Error::from_errno(errno, fmt::format("open({})", path_), ErrorDomain::FILE)};
+        }
+    }
+
+    auto text_or_error = read_file(fd_, buffer_);
+    if (text_or_error.is_error()) {
+        close();
+    }
+    return text_or_error;
+}
+
+auto procfs::read_file(int fd, std::span<char> buffer) -> ErrorOr<std::string_view> {
+    while (true) {
+        auto bytes_read = ::pread(fd, buffer.data(), buffer.size(), 0);
+        if (bytes_read < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return {Error::from_errno(errno, "pread()", ErrorDomain::FILE)};
+        }
+        if (static_cast<size_t>(bytes_read) == buffer.size()) {
+            return {Error::from_string("pread() filled the whole buffer, the file may be cut short",
+                                       ErrorDomain::FILE)};
+        }
+        return std::string_view(buffer.data(), static_cast<size_t>(bytes_read));
+    }
+}
+
+auto procfs::read_file(int fd, std::vector<char>& buffer) -> ErrorOr<std::string_view> {
+    // the kernel fills the buffer as far as it can, so the final read
+    // returning zero is the only extra one unless the file has grown
+    size_t size = 0;
+    while (true) {
+        if (size == buffer.size()) {
+            buffer.resize(std::max(buffer.size() * 2, ProcFile::INITIAL_BUFFER_SIZE));
+        }
+        auto bytes_read = ::pread(fd, buffer.data() + size, buffer.size() - size, static_cast<off_t>(size));
+        if (bytes_read < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return {Error::from_errno(errno, "pread()", ErrorDomain::FILE)};
+        }
+        if (bytes_read == 0) {
+            return std::string_view(buffer.data(), size);
+        }
+        size += static_cast<size_t>(bytes_read);
+    }
+}
+
+auto procfs::for_each_entry(const char* path, const std::function<void(std::string_view name)>& callback)
+    -> ErrorOr<void> {
+    auto* directory = ::opendir(path);
+    if (directory == nullptr) {
+        return {Error::from_errno(errno, fmt::format("opendir({})", path), ErrorDomain::FILE)};
+    }
+    while (auto* entry = ::readdir(directory)) {
+        auto name = std::string_view(entry->d_name);
+        if (name != "." && name != "..") {
+            callback(name);
+        }
+    }
+    ::closedir(directory);
+    return {};
+}
+
+auto procfs::next_line(std::string_view& text) -> std::string_view {
+    auto end = text.find('\n');
+    auto line = text.substr(0, end);
+    text.remove_prefix(end == std::string_view::npos ? text.size() : end + 1);
+    return line;
+}
+
+auto procfs::next_field(std::string_view& line) -> std::string_view {
+    auto begin = line.find_first_not_of(" \t");
+    if (begin == std::string_view::npos) {
+        line = {};
+        return {};
+    }
+    line.remove_prefix(begin);
+    auto end = std::min(line.find_first_of(" \t"), line.size());
+    auto field = line.substr(0, end);
+    line.remove_prefix(end);
+    return field;
+}
+
+auto procfs::parse_uint(std::string_view field) -> uint64_t {
+    uint64_t value = 0;
+    std::from_chars(field.data(), field.data() + field.size(), value);
+    return value;
+}
+
+static auto is_space(char c) -> bool {
+    return c == ' ' || c == '\t';
+}
+
+// Returns the value of given character as a decimal digit; above 9 when it
+// isn't one.
+static auto digit_value(char c) -> unsigned int {
+    return static_cast<unsigned int>(static_cast<unsigned char>(c)) - '0';
+}
+
+// Accumulates the digits at position into value and advances past them.
+// Returns the number of digits.
+static auto scan_digits(const char*& position, const char* end, uint64_t& value) -> size_t {
+    const auto* begin = position;
+    for (; position != end && digit_value(*position) <= 9; ++position) {
+        value = value * 10 + digit_value(*position);
+    }
+    return static_cast<size_t>(position - begin);
+}
+
+static auto skip_spaces(const char*& position, const char* end) -> void {
+    while (position != end && is_space(*position)) {
+        ++position;
+    }
+}
+
+// Advances past the rest of the field at position.
+static auto skip_field(const char*& position, const char* end) -> void {
+    while (position != end && !is_space(*position)) {
+        ++position;
+    }
+}
+
+auto procfs::next_uint(std::string_view& line) -> uint64_t {
+    const auto* position = line.data();
+    const auto* end = position + line.size();
+    skip_spaces(position, end);
+    uint64_t value = 0;
+    scan_digits(position, end, value);
+    skip_field(position, end);
+    line.remove_prefix(static_cast<size_t>(position - line.data()));
+    return value;
+}
+
+auto procfs::next_decimal(std::string_view& line) -> double {
+    const auto* position = line.data();
+    const auto* end = position + line.size();
+    skip_spaces(position, end);
+    uint64_t integer = 0;
+    scan_digits(position, end, integer);
+    double value = static_cast<double>(integer);
+    if (position != end && *position == '.') {
+        ++position;
+        uint64_t fraction = 0;
+        // more digits than a uint64_t holds are beyond a double's precision
+        auto digits = scan_digits(position, end, fraction);
+        if (digits > 0 && digits < 20) {
+            value += static_cast<double>(fraction) / std::pow(10.0, static_cast<double>(digits));
+        }
+    }
+    skip_field(position, end);
+    line.remove_prefix(static_cast<size_t>(position - line.data()));
+    return value;
+}
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "../Common/Error.h"
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace metrics::procfs {
+
+// ProcFile is a file in /proc or /sys that is read at every sample, such as
+// /proc/stat. It is opened once and re-read with pread() from offset zero,
+// which has the kernel generate its contents anew, into a buffer that is
+// allocated once and only grows should the file outgrow it. When reading
+// fails, e.g. because the file went away, the next read() reopens it.
+class ProcFile final {
+public:
+    static constexpr size_t INITIAL_BUFFER_SIZE = 4096;
+
+    explicit ProcFile(std::string path);
+
+    ProcFile(const ProcFile&) = delete;
+    ProcFile(ProcFile&&) noexcept = delete;
+    ~ProcFile() noexcept;
+
+    auto operator=(const ProcFile&) -> ProcFile& = delete;
+    auto operator=(ProcFile&&) noexcept -> ProcFile& = delete;
+
+    // Returns the file's current contents, valid until the next read().
+    auto read() -> common::ErrorOr<std::string_view>;
+
+    [[nodiscard]] auto path() const -> const std::string& { return path_; }
+
+private:
+    auto close() noexcept -> void;
+
+    std::string path_;
+    int fd_{-1};
+    std::vector<char> buffer_;
+};
+
+// Reads the whole file into given buffer, replacing its contents. Files in
+// /proc and /sys report a size of zero, so this reads until EOF instead of
+// relying on fstat(); the buffer keeps its capacity between calls.
+auto read_file(const char* path, std::string& buffer) -> common::ErrorOr<void>;
+
+// Reads an open file from its start into given buffer with pread(), so
+// that the file can be kept open and read again. The kernel fills the buffer
+// as far as the file goes, for regular files and files of /proc and /sys
+// alike, so a single pread() does rather than reading on until one returns
+// zero. Contents filling the whole buffer may have been cut short and are
+// reported as an error; files that may outgrow it take the overload below.
+auto read_file(int fd, std::span<char> buffer) -> common::ErrorOr<std::string_view>;
+
+// Like above but grows the buffer until the whole file fits, keeping its
+// capacity between calls.
+auto read_file(int fd, std::vector<char>& buffer) -> common::ErrorOr<std::string_view>;
+
+// Calls given callback with the name of every entry in given directory,
+// skipping "." and "..".
+auto for_each_entry(const char* path, const std::function<void(std::string_view name)>& callback)
+    -> common::ErrorOr<void>;
+
+// Splits off the next line of given text; the line excludes the newline.
+auto next_line(std::string_view& text) -> std::string_view;
+
+// Splits off the next whitespace separated field of given line.
+auto next_field(std::string_view& line) -> std::string_view;
+
+// Parses a decimal number; zero when the field isn't one.
+auto parse_uint(std::string_view field) -> uint64_t;
+
+// Splits off the next whitespace separated field of given line and parses
+// the number it starts with in the same pass; zero when there is none.
+// Cheaper than next_field() and parse_uint() for lines of numbers.
+auto next_uint(std::string_view& line) -> uint64_t;
+
+// Like next_uint() for numbers with a fraction, such as 0.52.
+auto next_decimal(std::string_view& line) -> double;
+
+} // namespace metrics::procfs
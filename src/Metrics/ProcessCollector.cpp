@@ -0,0 +1,322 @@
+#include "ProcessCollector.h"
+#include <algorithm>
+#include <array>
+#include <cerrno>
+#include <cmath>
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+using namespace common;
+using namespace metrics;
+
+namespace {
+
+enum ProcessField : size_t { NAME, STATE, CPU_TICKS, RSS, CPU, THREADS, SHARED, UID };
+
+constexpr std::array<FieldDescriptor, 8> FIELDS = {{
+    field<"name">(FieldType::TEXT),
+    field<"state">(FieldType::TEXT),
+    field<"cpu_ticks">(FieldType::UINT),
+    field<"rss">(FieldType::UINT),
+    field<"cpu">(FieldType::FLOAT),
+    field<"threads">(FieldType::UINT),
+    field<"shared">(FieldType::UINT),
+    field<"uid">(FieldType::UINT),
+}};
+constexpr Schema SCHEMA = {Topic::PROCESSES, "pid", FIELDS};
+
+// stat and statm of a process
+constexpr size_t FILES_PER_PROCESS = 2;
+// stat lines are a few hundred bytes, status files not much over a kilobyte
+constexpr size_t READ_BUFFER_SIZE = 4096;
+
+using ReadBuffer = std::array<char, READ_BUFFER_SIZE>;
+
+auto open_file(const std::string& proc_root, uint32_t pid, std::string_view name) -> int {
+    std::array<char, 256> path{};
+    auto result = fmt::format_to_n(path.data(), path.size() - 1, "{}/{}/{}", proc_root, pid, name);
+    if (result.size >= path.size()) {
+        errno = ENAMETOOLONG;
+        return -1;
+    }
+    return ::open(path.data(), O_RDONLY | O_CLOEXEC);
+}
+
+auto read_file(const std::string& proc_root, uint32_t pid, std::string_view name, ReadBuffer& buffer)
+    -> ErrorOr<std::string_view> {
+    auto fd = open_file(proc_root, pid, name);
+    if (fd < 0) {
+        return {Error::from_errno(errno, "open()", ErrorDomain::FILE)};
+    }
+    // fails with ESRCH once the process is gone
+    auto text = procfs::read_file(fd, buffer);
+    ::close(fd);
+    return text;
+}
+
+// Leaves room for the server's connections; raising the soft limit, as
+// main() does, lets more processes keep their files open.
+auto max_open_files() -> size_t {
+    rlimit limit{};
+    if (::getrlimit(RLIMIT_NOFILE, &limit) != 0 || limit.rlim_cur == RLIM_INFINITY) {
+        return 1024;
+    }
+    return static_cast<size_t>(limit.rlim_cur) / 2;
+}
+
+} // namespace
+
+struct ProcessCollector::Process {
+    explicit Process(uint32_t pid) :
+        pid(pid),
+        key(fmt::format("{}", pid)) {}
+
+    Process(const Process&) = delete;
+    Process(Process&&) noexcept = delete;
+    ~Process() noexcept { close_files(); }
+
+    auto operator=(const Process&) -> Process& = delete;
+    auto operator=(Process&&) noexcept -> Process& = delete;
+
+    auto close_files() noexcept -> void {
+        for (auto* fd : {&stat_fd, &statm_fd}) {
+            if (*fd >= 0) {
+                ::close(*fd);
+                *fd = -1;
+            }
+        }
+    }
+
+    uint32_t pid;
+    std::string key;
+    // whether this process may keep its files open
+    bool keeps_files_open{false};
+    int stat_fd{-1};
+    int statm_fd{-1};
+
+    // whether the latest scan found the process; reset when it went away
+    bool alive{false};
+    // in clock ticks since boot; zero until first scanned
+    uint64_t start_time{0};
+    std::string name;
+    char state{'?'};
+    uint64_t cpu_ticks{0};
+    // share of a core in percent since the previous scan
+    double cpu{0.0};
+    uint64_t threads{0};
+    uint64_t rss{0};
+    uint64_t shared{0};
+    uint64_t uid{0};
+};
+
+ProcessCollector::ProcessCollector(std::string proc_root, std::optional<size_t> thread_count) :
+    proc_root_(std::move(proc_root)),
+    page_size_(static_cast<uint64_t>(::sysconf(_SC_PAGESIZE))),
+    ticks_per_second_(static_cast<uint64_t>(::sysconf(_SC_CLK_TCK))),
+    max_open_files_(max_open_files()),
+    uptime_file_(proc_root_ + "/uptime"),
+    workers_(thread_count.value_or(WorkerPool::default_thread_count())) {}
+
+ProcessCollector::~ProcessCollector() noexcept = default;
+
+auto ProcessCollector::schema() const -> const Schema& {
+    return SCHEMA;
+}
+
+auto ProcessCollector::update_table() -> ErrorOr<void> {
+    pids_.clear();
+    TRY(procfs::for_each_entry(proc_root_.c_str(), [this](std::string_view name) {
+        if (!name.empty() && name.find_first_not_of("0123456789") == std::string_view::npos) {
+            pids_.push_back(static_cast<uint32_t>(procfs::parse_uint(name)));
+        }
+    }));
+    std::sort(pids_.begin(), pids_.end());
+
+    // merge with the table, both sorted by pid; processes scanned but gone
+    // by now are dropped along with those no longer listed
+    std::vector<std::unique_ptr<Process>> processes;
+    processes.reserve(pids_.size());
+    size_t i = 0;
+    for (auto pid : pids_) {
+        while (i < processes_.size() && processes_[i]->pid < pid) {
+            ++i;
+        }
+        if (i < processes_.size() && processes_[i]->pid == pid &&
+            (processes_[i]->alive || processes_[i]->start_time == 0)) {
+            processes.push_back(std::move(processes_[i++]));
+            continue;
+        }
+        processes.push_back(std::make_unique<Process>(pid));
+    }
+    processes_.swap(processes);
+
+    // hand out the open files budget, first come first served
+    open_file_count_ = 0;
+    for (auto& process : processes_) {
+        if (process->keeps_files_open) {
+            open_file_count_ += FILES_PER_PROCESS;
+        }
+    }
+    for (auto& process : processes_) {
+        if (!process->keeps_files_open && open_file_count_ + FILES_PER_PROCESS <= max_open_files_) {
+            process->keeps_files_open = true;
+            open_file_count_ += FILES_PER_PROCESS;
+        }
+    }
+    return {};
+}
+
+// Parses the fields of /proc/[pid]/stat the table needs. Returns false when
+// the contents don't look like a stat file.
+static auto parse_stat(std::string_view stat, std::string_view& name, char& state, uint64_t& cpu_ticks,
+                       uint64_t& threads, uint64_t& start_time) -> bool {
+    // the command name is in parentheses and may contain anything,
+    // including spaces and parentheses; the fields follow the last ')'
+    auto open = stat.find('(');
+    auto close = stat.rfind(')');
+    if (open == std::string_view::npos || close == std::string_view::npos || close < open) {
+        return false;
+    }
+    name = stat.substr(open + 1, close - open - 1);
+    auto line = stat.substr(close + 1);
+    // field 3
+    auto state_field = procfs::next_field(line);
+    if (state_field.empty()) {
+        return false;
+    }
+    state = state_field[0];
+    // fields 4 to 13
+    for (size_t i = 4; i <= 13; ++i) {
+        procfs::next_uint(line);
+    }
+    // utime and stime
+    cpu_ticks = procfs::next_uint(line);
+    cpu_ticks += procfs::next_uint(line);
+    // fields 16 to 19
+    for (size_t i = 16; i <= 19; ++i) {
+        procfs::next_uint(line);
+    }
+    threads = procfs::next_uint(line);
+    procfs::next_uint(line);
+    start_time = procfs::next_uint(line);
+    return true;
+}
+
+auto ProcessCollector::scan(Process& process, double elapsed_ticks) const -> void {
+    ReadBuffer buffer;
+    process.alive = false;
+
+    // through the descriptor kept in fd when the process keeps its files open
+    auto read_process_file = [&](int& fd, std::string_view name) -> ErrorOr<std::string_view> {
+        if (!process.keeps_files_open) {
+            return read_file(proc_root_, process.pid, name, buffer);
+        }
+        if (fd < 0) {
+            fd = open_file(proc_root_, process.pid, name);
+            if (fd < 0) {
+                return {Error::from_errno(errno, "open()", ErrorDomain::FILE)};
+            }
+        }
+        return procfs::read_file(fd, buffer);
+    };
+
+    auto stat_or_error = read_process_file(process.stat_fd, "stat");
+    if (stat_or_error.is_error() && process.keeps_files_open) {
+        // the files kept open belong to a process that is gone; the pid may
+        // have been reused since
+        process.close_files();
+        stat_or_error = read_process_file(process.stat_fd, "stat");
+    }
+    if (stat_or_error.is_error()) {
+        // exited meanwhile
+        return;
+    }
+
+    std::string_view name;
+    char state = '?';
+    uint64_t cpu_ticks = 0;
+    uint64_t threads = 0;
+    uint64_t start_time = 0;
+    if (!parse_stat(stat_or_error.value(), name, state, cpu_ticks, threads, start_time)) {
+        return;
+    }
+    bool is_new = process.start_time != start_time;
+    if (is_new) {
+        process.start_time = start_time;
+        process.cpu_ticks = cpu_ticks;
+    }
+    process.cpu = is_new || elapsed_ticks <= 0.0 || cpu_ticks < process.cpu_ticks
+                      ? 0.0
+                      : std::round(static_cast<double>(cpu_ticks - process.cpu_ticks) * 1000.0 / elapsed_ticks) / 10.0;
+    process.cpu_ticks = cpu_ticks;
+    process.state = state;
+    process.threads = threads;
+    // the owner only changes along with the name, through exec() of a set
+    // user id program; re-read it then
+    if (is_new || process.name != name) {
+        process.name = name;
+        auto status_or_error = read_file(proc_root_, process.pid, "status", buffer);
+        if (status_or_error.is_error()) {
+            return;
+        }
+        auto status = status_or_error.value();
+        while (!status.empty()) {
+            auto line = procfs::next_line(status);
+            if (procfs::next_field(line) == "Uid:") {
+                // real, effective, saved and file system user id
+                process.uid = procfs::next_uint(line);
+                break;
+            }
+        }
+    }
+
+    auto statm_or_error = read_process_file(process.statm_fd, "statm");
+    if (statm_or_error.is_error()) {
+        return;
+    }
+    // size resident shared text lib data dt, in pages
+    auto statm = statm_or_error.value();
+    procfs::next_uint(statm);
+    process.rss = procfs::next_uint(statm) * page_size_;
+    process.shared = procfs::next_uint(statm) * page_size_;
+    process.alive = true;
+}
+
+auto ProcessCollector::collect(Snapshot& snapshot) -> ErrorOr<void> {
+    TRY(update_table());
+
+    // seconds since boot; how much time passed since the previous sample,
+    // measured on the same clock process start times are on
+    auto text = TRY(uptime_file_.read());
+    auto uptime = procfs::next_decimal(text);
+    auto elapsed_ticks = previous_uptime_ > 0.0 ? (uptime - previous_uptime_) * static_cast<double>(ticks_per_second_)
+                                                : 0.0;
+    previous_uptime_ = uptime;
+
+    auto task_count = (processes_.size() + PROCESSES_PER_TASK - 1) / PROCESSES_PER_TASK;
+    workers_.run(task_count, [this, elapsed_ticks](size_t task) {
+        auto begin = task * PROCESSES_PER_TASK;
+        auto end = std::min(begin + PROCESSES_PER_TASK, processes_.size());
+        for (auto i = begin; i < end; ++i) {
+            scan(*processes_[i], elapsed_ticks);
+        }
+    });
+
+    for (const auto& process : processes_) {
+        if (!process->alive) {
+            continue;
+        }
+        auto& row = snapshot.add_row(process->key);
+        row.values[NAME] = process->name;
+        row.values[STATE] = std::string(1, process->state);
+        row.values[CPU_TICKS] = process->cpu_ticks;
+        row.values[RSS] = process->rss;
+        row.values[CPU] = process->cpu;
+        row.values[THREADS] = process->threads;
+        row.values[SHARED] = process->shared;
+        row.values[UID] = process->uid;
+    }
+    return {};
+}
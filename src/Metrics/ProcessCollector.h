@@ -0,0 +1,60 @@
+#pragma once
+
+#include "../Common/WorkerPool.h"
+#include "Collector.h"
+#include "ProcFs.h"
+#include <memory>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace metrics {
+
+// ProcessCollector reports every process found in /proc, like top does:
+// its state, the CPU time consumed so far and the share of a core used
+// since the previous sample, its thread count, memory and owner.
+//
+// Processes are tracked from one sample to the next by pid and start time,
+// which tells a reused pid apart. The files of known processes are kept
+// open, as many as the open files limit leaves room for, so that sampling
+// a process that is still around costs a pread() of its stat and statm
+// files; its status file is only read when it shows up or exec()s. The
+// processes are split into batches scanned by a small pool of threads.
+class ProcessCollector final : public Collector {
+public:
+    // processes scanned by one task of the worker pool
+    static constexpr size_t PROCESSES_PER_TASK = 256;
+
+    // Picks a small worker pool for the machine's core count when no thread
+    // count is given.
+    explicit ProcessCollector(std::string proc_root = "/proc", std::optional<size_t> thread_count = {});
+
+    ~ProcessCollector() noexcept override;
+
+    [[nodiscard]] auto schema() const -> const Schema& override;
+    auto collect(Snapshot& snapshot) -> common::ErrorOr<void> override;
+
+    // Number of files currently kept open; exposed for testing.
+    [[nodiscard]] auto open_file_count() const -> size_t { return open_file_count_; }
+
+private:
+    struct Process;
+
+    // Brings the table in line with the pids now in /proc.
+    auto update_table() -> common::ErrorOr<void>;
+    auto scan(Process& process, double elapsed_ticks) const -> void;
+
+    std::string proc_root_;
+    uint64_t page_size_;
+    uint64_t ticks_per_second_;
+    size_t max_open_files_;
+    size_t open_file_count_{0};
+    procfs::ProcFile uptime_file_;
+    double previous_uptime_{0.0};
+    // sorted by pid
+    std::vector<std::unique_ptr<Process>> processes_;
+    std::vector<uint32_t> pids_;
+    common::WorkerPool workers_;
+};
+
+} // namespace metrics
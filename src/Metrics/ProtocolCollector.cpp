@@ -0,0 +1,120 @@
+#include "ProtocolCollector.h"
+#include "ProcFs.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+
+using namespace common;
+using namespace metrics;
+
+namespace {
+
+constexpr std::array<FieldDescriptor, 16> FIELDS = {{
+    field<"tcp_active_opens_per_s">(FieldType::UINT),
+    field<"tcp_passive_opens_per_s">(FieldType::UINT),
+    field<"tcp_attempt_fails_per_s">(FieldType::UINT),
+    field<"tcp_established_resets_per_s">(FieldType::UINT),
+    field<"tcp_established">(FieldType::UINT),
+    field<"tcp_in_segments_per_s">(FieldType::UINT),
+    field<"tcp_out_segments_per_s">(FieldType::UINT),
+    field<"tcp_retransmitted_segments_per_s">(FieldType::UINT),
+    field<"tcp_in_errors_per_s">(FieldType::UINT),
+    field<"tcp_out_resets_per_s">(FieldType::UINT),
+    field<"udp_in_datagrams_per_s">(FieldType::UINT),
+    field<"udp_out_datagrams_per_s">(FieldType::UINT),
+    field<"udp_no_ports_per_s">(FieldType::UINT),
+    field<"udp_in_errors_per_s">(FieldType::UINT),
+    field<"udp_receive_buffer_errors_per_s">(FieldType::UINT),
+    field<"udp_send_buffer_errors_per_s">(FieldType::UINT),
+}};
+constexpr Schema SCHEMA = {Topic::NET_PROTOCOLS, {}, FIELDS};
+
+// The column of /proc/net/snmp feeding each field, in field order.
+struct Column {
+    std::string_view protocol;
+    std::string_view name;
+    // a count of the moment rather than a counter
+    bool is_gauge;
+};
+
+constexpr std::array<Column, FIELDS.size()> COLUMNS = {{
+    {"Tcp:", "ActiveOpens", false},
+    {"Tcp:", "PassiveOpens", false},
+    {"Tcp:", "AttemptFails", false},
+    {"Tcp:", "EstabResets", false},
+    {"Tcp:", "CurrEstab", true},
+    {"Tcp:", "InSegs", false},
+    {"Tcp:", "OutSegs", false},
+    {"Tcp:", "RetransSegs", false},
+    {"Tcp:", "InErrs", false},
+    {"Tcp:", "OutRsts", false},
+    {"Udp:", "InDatagrams", false},
+    {"Udp:", "OutDatagrams", false},
+    {"Udp:", "NoPorts", false},
+    {"Udp:", "InErrors", false},
+    {"Udp:", "RcvbufErrors", false},
+    {"Udp:", "SndbufErrors", false},
+}};
+
+} // namespace
+
+ProtocolCollector::ProtocolCollector(std::string snmp_path, RateClock clock) :
+    snmp_file_(std::move(snmp_path)),
+    counters_(FIELDS.size(), std::move(clock)) {}
+
+auto ProtocolCollector::schema() const -> const Schema& {
+    return SCHEMA;
+}
+
+auto ProtocolCollector::update_columns(Columns& columns, std::string_view names) -> void {
+    if (columns.names == names) {
+        return;
+    }
+    columns.names.assign(names);
+    columns.fields.clear();
+    auto protocol = procfs::next_field(names);
+    while (!names.empty()) {
+        auto name = procfs::next_field(names);
+        auto it = std::find_if(COLUMNS.begin(), COLUMNS.end(), [&](const auto& column) {
+            return column.protocol == protocol && column.name == name;
+        });
+        columns.fields.push_back(it == COLUMNS.end() ? -1 : static_cast<int>(it - COLUMNS.begin()));
+    }
+}
+
+auto ProtocolCollector::collect(Snapshot& snapshot) -> ErrorOr<void> {
+    auto text = TRY(snmp_file_.read());
+    counters_.begin_sample();
+    // a single device holding every counter
+    auto id = counters_.see("snmp");
+
+    auto& row = snapshot.add_row();
+    for (size_t i = 0; i < FIELDS.size(); ++i) {
+        row.values[i] = uint64_t{0};
+    }
+    for (size_t pair = 0; !text.empty(); ++pair) {
+        auto names = procfs::next_line(text);
+        auto values = procfs::next_line(text);
+        if (pair == columns_.size()) {
+            columns_.emplace_back();
+        }
+        auto& columns = columns_[pair];
+        update_columns(columns, names);
+
+        procfs::next_field(values);
+        for (auto field : columns.fields) {
+            if (values.empty()) {
+                break;
+            }
+            if (field < 0) {
+                procfs::next_field(values);
+                continue;
+            }
+            auto value = procfs::next_uint(values);
+            auto index = static_cast<size_t>(field);
+            row.values[index] = COLUMNS[index].is_gauge ? value : whole_rate(counters_.rate(id, index, value));
+        }
+    }
+    counters_.end_sample();
+    return {};
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Collector.h"
+#include "DeviceTable.h"
+#include "ProcFs.h"
+#include <string>
+#include <vector>
+
+namespace metrics {
+
+// ProtocolCollector reports the TCP and UDP counters of the whole host from
+// /proc/net/snmp as rates per second since the previous sample: connections
+// opened and failing, segments and datagrams in and out, retransmissions and
+// errors, along with the number of established connections.
+//
+// The file holds a line of column names followed by a line of values per
+// protocol. Which column feeds which field is worked out once per names line
+// and kept for as long as the line reads the same, which it does for the
+// lifetime of the kernel; values are then picked by column as they are
+// scanned.
+class ProtocolCollector final : public Collector {
+public:
+    explicit ProtocolCollector(std::string snmp_path = "/proc/net/snmp",
+                               RateClock clock = std::chrono::steady_clock::now);
+
+    [[nodiscard]] auto schema() const -> const Schema& override;
+    auto collect(Snapshot& snapshot) -> common::ErrorOr<void> override;
+
+private:
+    // The names line of a protocol and the field of each column, or -1.
+    struct Columns {
+        std::string names;
+        std::vector<int> fields;
+    };
+
+    static auto update_columns(Columns& columns, std::string_view names) -> void;
+
+    procfs::ProcFile snmp_file_;
+    DeviceTable counters_;
+    // by pair of lines
+    std::vector<Columns> columns_;
+};
+
+} // namespace metrics
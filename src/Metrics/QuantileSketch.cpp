@@ -0,0 +1,117 @@
+#include "QuantileSketch.h"
+#include "../Common/Assertions.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <utility>
+
+using namespace metrics;
+
+QuantileSketch::QuantileSketch(double relative_accuracy) :
+    gamma_((1 + relative_accuracy) / (1 - relative_accuracy)),
+    log_gamma_(std::log(gamma_)) {
+    VERIFY(relative_accuracy > 0 && relative_accuracy < 1);
+}
+
+auto QuantileSketch::add(double value) -> void {
+    if (std::isnan(value)) {
+        return;
+    }
+    if (value >= MIN_MAGNITUDE) {
+        positive_.add(index_of(value));
+    } else if (value <= -MIN_MAGNITUDE) {
+        negative_.add(index_of(-value));
+    } else {
+        ++zero_count_;
+    }
+}
+
+auto QuantileSketch::clear() -> void {
+    negative_.clear();
+    zero_count_ = 0;
+    positive_.clear();
+}
+
+auto QuantileSketch::quantile(double q) const -> double {
+    auto total = count();
+    if (total == 0) {
+        return std::numeric_limits<double>::quiet_NaN();
+    }
+    auto rank = static_cast<uint64_t>(std::clamp(q, 0.0, 1.0) * static_cast<double>(total - 1));
+    if (rank < negative_.count) {
+        return -value_of(negative_.index_at(rank, true));
+    }
+    rank -= negative_.count;
+    if (rank < zero_count_) {
+        return 0.0;
+    }
+    rank -= zero_count_;
+    return value_of(positive_.index_at(rank, false));
+}
+
+// Bin i holds the magnitudes in (gamma^(i-1), gamma^i].
+auto QuantileSketch::index_of(double magnitude) const -> int32_t {
+    return static_cast<int32_t>(std::ceil(std::log(magnitude) / log_gamma_));
+}
+
+// The point of bin i within the relative accuracy of both its bounds.
+auto QuantileSketch::value_of(int32_t index) const -> double {
+    return 2 * std::exp(index * log_gamma_) / (gamma_ + 1);
+}
+
+auto QuantileSketch::Store::add(int32_t index) -> void {
+    if (count == 0) {
+        min_index = index;
+        max_index = index;
+    }
+    auto low = std::min(min_index, index);
+    auto high = std::max(max_index, index);
+    if (high - low >= static_cast<int32_t>(MAX_BINS)) {
+        // keep the largest magnitudes, merging the rest into the lowest bin
+        low = high - static_cast<int32_t>(MAX_BINS) + 1;
+        index = std::max(index, low);
+    }
+    if (low > min_index || low < offset || high >= offset + static_cast<int32_t>(bins.size())) {
+        rebuild(low, high);
+    }
+    min_index = low;
+    max_index = high;
+    ++bins[static_cast<size_t>(index - offset)];
+    ++count;
+}
+
+auto QuantileSketch::Store::clear() -> void {
+    if (count > 0) {
+        std::fill(bins.begin() + (min_index - offset), bins.begin() + (max_index - offset + 1), 0);
+    }
+    count = 0;
+}
+
+// Moves the bins to cover the indices from low to high with room to spare on
+// both sides, merging those below low into it.
+auto QuantileSketch::Store::rebuild(int32_t low, int32_t high) -> void {
+    auto needed = static_cast<size_t>(high - low + 1);
+    auto size = std::min(MAX_BINS, std::max({needed, 2 * bins.size(), MIN_STORE_BINS}));
+    auto new_offset = low - static_cast<int32_t>((size - needed) / 2);
+    std::vector<uint64_t> new_bins(size, 0);
+    if (count > 0) {
+        for (auto index = min_index; index <= max_index; ++index) {
+            auto bin = bins[static_cast<size_t>(index - offset)];
+            new_bins[static_cast<size_t>(std::max(index, low) - new_offset)] += bin;
+        }
+    }
+    bins = std::move(new_bins);
+    offset = new_offset;
+}
+
+auto QuantileSketch::Store::index_at(uint64_t rank, bool descending) const -> int32_t {
+    uint64_t seen = 0;
+    for (auto i = min_index; i <= max_index; ++i) {
+        auto index = descending ? min_index + max_index - i : i;
+        seen += bins[static_cast<size_t>(index - offset)];
+        if (seen > rank) {
+            return index;
+        }
+    }
+    VERIFY_NOT_REACHED();
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace metrics {
+
+// QuantileSketch estimates quantiles of a stream of values in one pass and
+// bounded memory, with a relative error guarantee (DDSketch). Values are
+// counted in bins whose bounds grow by a factor of gamma = (1 + a) / (1 - a)
+// for relative accuracy a, and a quantile is estimated by the bin it falls
+// in, which is within a of the exact value.
+//
+// Each sign keeps at most MAX_BINS bins, covering over eight orders of
+// magnitude at 1% accuracy; past that the bins of the values closest to zero
+// are merged, trading accuracy where it matters least. Clearing keeps the
+// memory, so a sketch reused for many series allocates only while growing.
+class QuantileSketch final {
+public:
+    static constexpr double DEFAULT_RELATIVE_ACCURACY = 0.01;
+    static constexpr size_t MAX_BINS = 1024;
+    // values closer to zero than this count as zero
+    static constexpr double MIN_MAGNITUDE = 1e-9;
+
+    explicit QuantileSketch(double relative_accuracy = DEFAULT_RELATIVE_ACCURACY);
+
+    // Adds a value; ignores NaN.
+    auto add(double value) -> void;
+    auto clear() -> void;
+
+    [[nodiscard]] auto count() const -> uint64_t { return negative_.count + zero_count_ + positive_.count; }
+    // Returns the estimated q-quantile for q in [0, 1]; NaN when empty.
+    [[nodiscard]] auto quantile(double q) const -> double;
+
+private:
+    // bins a store starts with, doubling as it needs more
+    static constexpr size_t MIN_STORE_BINS = 64;
+
+    // Bins of the values of one sign by the index of their magnitude,
+    // the first bin counting those of index offset. Only the bins from
+    // min_index to max_index are used; the others are zero, and are kept
+    // through clear() so that similar streams don't move the bins again.
+    struct Store {
+        std::vector<uint64_t> bins;
+        int32_t offset{0};
+        int32_t min_index{0};
+        int32_t max_index{0};
+        uint64_t count{0};
+
+        auto add(int32_t index) -> void;
+        auto clear() -> void;
+        auto rebuild(int32_t low, int32_t high) -> void;
+        // Returns the index of the bin holding the value of given rank,
+        // counting from the smallest index, or from the largest when
+        // descending.
+        [[nodiscard]] auto index_at(uint64_t rank, bool descending) const -> int32_t;
+    };
+
+    [[nodiscard]] auto index_of(double magnitude) const -> int32_t;
+    [[nodiscard]] auto value_of(int32_t index) const -> double;
+
+    double gamma_;
+    double log_gamma_;
+    // by magnitude, so the most negative values have the largest indices
+    Store negative_;
+    uint64_t zero_count_{0};
+    Store positive_;
+};
+
+} // namespace metrics
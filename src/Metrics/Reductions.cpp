@@ -0,0 +1,192 @@
+#include "Reductions.h"
+#include "../Common/Assertions.h"
+#include <algorithm>
+
+#ifdef COMMON_SIMD_X86
+#include <immintrin.h>
+#endif
+
+using namespace common;
+using namespace metrics;
+using namespace metrics::reductions;
+
+using SummarizeFunction = Summary (*)(const double* points, size_t length);
+
+auto Summary::operator+=(const Summary& rhs) -> Summary& {
+    min = std::min(min, rhs.min);
+    max = std::max(max, rhs.max);
+    sum += rhs.sum;
+    count += rhs.count;
+    return *this;
+}
+
+// Adds the points to summary one at a time. Inlined into the vector kernels
+// for their tails, so that these are compiled for the same instruction set
+// and don't pay for switching between SSE and AVX encodings.
+__attribute__((always_inline)) static inline auto add_points(Summary& summary, const double* points, size_t length)
+    -> void {
+    for (size_t i = 0; i < length; ++i) {
+        auto point = points[i];
+        // false for NaN
+        if (point == point) {
+            summary.min = std::min(summary.min, point);
+            summary.max = std::max(summary.max, point);
+            summary.sum += point;
+            ++summary.count;
+        }
+    }
+}
+
+static auto summarize_scalar(const double* points, size_t length) -> Summary {
+    Summary summary;
+    add_points(summary, points, length);
+    return summary;
+}
+
+#ifdef COMMON_SIMD_X86
+
+// The vector kernels mask NaN lanes out instead of branching: a lane
+// compared ordered with itself is all ones unless it is NaN. Masked lanes
+// take the neutral element of each reduction, and subtracting a mask, -1 as
+// an integer, counts its lanes.
+
+struct Accumulators128 {
+    __m128d min;
+    __m128d max;
+    __m128d sum;
+    __m128i count;
+};
+
+__attribute__((target("sse2"), always_inline)) static inline auto accumulate_sse2(Accumulators128& accumulators,
+                                                                                  __m128d point) -> void {
+    const __m128d infinity = _mm_set1_pd(std::numeric_limits<double>::infinity());
+    const __m128d negative_infinity = _mm_set1_pd(-std::numeric_limits<double>::infinity());
+    auto is_number = _mm_cmpord_pd(point, point);
+    auto number = _mm_and_pd(is_number, point);
+    // SSE2 has no blend; or in the neutral element where the mask is clear
+    accumulators.min = _mm_min_pd(accumulators.min, _mm_or_pd(number, _mm_andnot_pd(is_number, infinity)));
+    accumulators.max = _mm_max_pd(accumulators.max, _mm_or_pd(number, _mm_andnot_pd(is_number, negative_infinity)));
+    accumulators.sum = _mm_add_pd(accumulators.sum, number);
+    accumulators.count = _mm_sub_epi64(accumulators.count, _mm_castpd_si128(is_number));
+}
+
+__attribute__((target("sse2"))) static auto summarize_sse2(const double* points, size_t length) -> Summary {
+    const __m128d infinity = _mm_set1_pd(std::numeric_limits<double>::infinity());
+    const __m128d negative_infinity = _mm_set1_pd(-std::numeric_limits<double>::infinity());
+    // two sets of accumulators so that consecutive vectors don't wait for
+    // each other's additions
+    Accumulators128 accumulators[2];
+    for (auto& set : accumulators) {
+        set = {infinity, negative_infinity, _mm_setzero_pd(), _mm_setzero_si128()};
+    }
+    size_t i = 0;
+    for (; i + 4 <= length; i += 4) {
+        accumulate_sse2(accumulators[0], _mm_loadu_pd(points + i));
+        accumulate_sse2(accumulators[1], _mm_loadu_pd(points + i + 2));
+    }
+    if (i + 2 <= length) {
+        accumulate_sse2(accumulators[0], _mm_loadu_pd(points + i));
+        i += 2;
+    }
+
+    alignas(16) double mins[2];
+    alignas(16) double maxs[2];
+    alignas(16) double sums[2];
+    alignas(16) uint64_t counts[2];
+    _mm_store_pd(mins, _mm_min_pd(accumulators[0].min, accumulators[1].min));
+    _mm_store_pd(maxs, _mm_max_pd(accumulators[0].max, accumulators[1].max));
+    _mm_store_pd(sums, _mm_add_pd(accumulators[0].sum, accumulators[1].sum));
+    _mm_store_si128(reinterpret_cast<__m128i*>(counts), _mm_add_epi64(accumulators[0].count, accumulators[1].count));
+    Summary summary{std::min(mins[0], mins[1]), std::max(maxs[0], maxs[1]), sums[0] + sums[1], counts[0] + counts[1]};
+    add_points(summary, points + i, length - i);
+    return summary;
+}
+
+struct Accumulators256 {
+    __m256d min;
+    __m256d max;
+    __m256d sum;
+    __m256i count;
+};
+
+__attribute__((target("avx2"), always_inline)) static inline auto accumulate_avx2(Accumulators256& accumulators,
+                                                                                  __m256d point) -> void {
+    const __m256d infinity = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+    const __m256d negative_infinity = _mm256_set1_pd(-std::numeric_limits<double>::infinity());
+    auto is_number = _mm256_cmp_pd(point, point, _CMP_ORD_Q);
+    accumulators.min = _mm256_min_pd(accumulators.min, _mm256_blendv_pd(infinity, point, is_number));
+    accumulators.max = _mm256_max_pd(accumulators.max, _mm256_blendv_pd(negative_infinity, point, is_number));
+    accumulators.sum = _mm256_add_pd(accumulators.sum, _mm256_and_pd(point, is_number));
+    accumulators.count = _mm256_sub_epi64(accumulators.count, _mm256_castpd_si256(is_number));
+}
+
+__attribute__((target("avx2"))) static auto summarize_avx2(const double* points, size_t length) -> Summary {
+    const __m256d infinity = _mm256_set1_pd(std::numeric_limits<double>::infinity());
+    const __m256d negative_infinity = _mm256_set1_pd(-std::numeric_limits<double>::infinity());
+    // two sets of accumulators so that consecutive vectors don't wait for
+    // each other's additions
+    Accumulators256 accumulators[2];
+    for (auto& set : accumulators) {
+        set = {infinity, negative_infinity, _mm256_setzero_pd(), _mm256_setzero_si256()};
+    }
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        accumulate_avx2(accumulators[0], _mm256_loadu_pd(points + i));
+        accumulate_avx2(accumulators[1], _mm256_loadu_pd(points + i + 4));
+    }
+    if (i + 4 <= length) {
+        accumulate_avx2(accumulators[0], _mm256_loadu_pd(points + i));
+        i += 4;
+    }
+
+    // fold the halves down to 128 bits, so that nothing past the zeroupper
+    // below touches the upper lanes again
+    auto min = _mm256_min_pd(accumulators[0].min, accumulators[1].min);
+    auto max = _mm256_max_pd(accumulators[0].max, accumulators[1].max);
+    auto sum = _mm256_add_pd(accumulators[0].sum, accumulators[1].sum);
+    auto count = _mm256_add_epi64(accumulators[0].count, accumulators[1].count);
+    alignas(16) double mins[2];
+    alignas(16) double maxs[2];
+    alignas(16) double sums[2];
+    alignas(16) uint64_t counts[2];
+    _mm_store_pd(mins, _mm_min_pd(_mm256_castpd256_pd128(min), _mm256_extractf128_pd(min, 1)));
+    _mm_store_pd(maxs, _mm_max_pd(_mm256_castpd256_pd128(max), _mm256_extractf128_pd(max, 1)));
+    _mm_store_pd(sums, _mm_add_pd(_mm256_castpd256_pd128(sum), _mm256_extractf128_pd(sum, 1)));
+    _mm_store_si128(reinterpret_cast<__m128i*>(counts),
+                    _mm_add_epi64(_mm256_castsi256_si128(count), _mm256_extracti128_si256(count, 1)));
+    // see Simd.h
+    _mm256_zeroupper();
+    Summary summary{std::min(mins[0], mins[1]), std::max(maxs[0], maxs[1]), sums[0] + sums[1], counts[0] + counts[1]};
+    add_points(summary, points + i, length - i);
+    return summary;
+}
+
+#endif
+
+static auto summarize_function(Implementation implementation) -> SummarizeFunction {
+    switch (implementation) {
+    case Implementation::SCALAR:
+        return summarize_scalar;
+#ifdef COMMON_SIMD_X86
+    case Implementation::SSE2:
+        return summarize_sse2;
+    case Implementation::AVX2:
+        return summarize_avx2;
+#else
+    case Implementation::SSE2:
+    case Implementation::AVX2:
+        break;
+#endif
+    }
+    VERIFY_NOT_REACHED();
+}
+
+auto reductions::summarize(std::span<const double> points) -> Summary {
+    static const SummarizeFunction function = summarize_function(simd::best_implementation());
+    return function(points.data(), points.size());
+}
+
+auto reductions::summarize_using(Implementation implementation, std::span<const double> points) -> Summary {
+    VERIFY(simd::is_supported(implementation));
+    return summarize_function(implementation)(points.data(), points.size());
+}
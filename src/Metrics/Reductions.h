@@ -0,0 +1,37 @@
+#pragma once
+
+#include "../Common/Simd.h"
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include <span>
+
+// Reductions of series of doubles as stored by HistoryStore, where NaN marks
+// a missing point. The kernels are vectorized with SSE2 or AVX2 when the CPU
+// has them; see Simd.h.
+namespace metrics::reductions {
+
+using common::simd::Implementation;
+
+// Minimum, maximum, sum and number of the points that aren't NaN.
+struct Summary {
+    double min{std::numeric_limits<double>::infinity()};
+    double max{-std::numeric_limits<double>::infinity()};
+    double sum{0.0};
+    uint64_t count{0};
+
+    auto operator+=(const Summary& rhs) -> Summary&;
+    // NaN when there are no points
+    [[nodiscard]] auto mean() const -> double {
+        return count == 0 ? std::numeric_limits<double>::quiet_NaN() : sum / static_cast<double>(count);
+    }
+};
+
+auto summarize(std::span<const double> points) -> Summary;
+
+// Same as above with given implementation, which must be supported. Meant
+// for tests and benchmarks; sums may differ in the last bits between
+// implementations since they add in different orders.
+auto summarize_using(Implementation implementation, std::span<const double> points) -> Summary;
+
+} // namespace metrics::reductions
@@ -0,0 +1,119 @@
+#include "Sampler.h"
+#include "../Common/Logging.h"
+#include <algorithm>
+#include <ctime>
+
+using namespace common;
+using namespace metrics;
+
+Sampler::Sampler(DemandFunction demand_function, PublishFunction publish_function) :
+    demand_function_(std::move(demand_function)),
+    publish_function_(std::move(publish_function)) {}
+
+Sampler::~Sampler() noexcept {
+    shutdown();
+}
+
+auto Sampler::add_collector(std::unique_ptr<Collector> collector) -> void {
+    VERIFY(!thread_.joinable());
+    auto& state = topics_[static_cast<size_t>(collector->topic())];
+    VERIFY(state.collector == nullptr);
+    state.collector = std::move(collector);
+}
+
+auto Sampler::start() -> void {
+    VERIFY(!thread_.joinable());
+    thread_ = std::jthread([this](std::stop_token stop_token) { thread_main(std::move(stop_token)); });
+}
+
+auto Sampler::shutdown() noexcept -> void {
+    if (thread_.joinable()) {
+        thread_.request_stop();
+        thread_.join();
+    }
+}
+
+auto Sampler::sample_count(Topic topic) const -> uint64_t {
+    return topics_[static_cast<size_t>(topic)].sample_count.load(std::memory_order_relaxed);
+}
+
+auto Sampler::sample_cost(Topic topic) const -> const SampleCost& {
+    return topics_[static_cast<size_t>(topic)].cost;
+}
+
+auto Sampler::thread_main(std::stop_token stop_token) -> void {
+    LOG_DEBUG("Sampler::thread_main(): start");
+    while (!stop_token.stop_requested()) {
+        auto next_due = sample_due_topics(Clock::now());
+        std::unique_lock lock(mutex_);
+        stop_condition_.wait_until(lock, stop_token, next_due, [] { return false; });
+    }
+    LOG_DEBUG("Sampler::thread_main(): exit");
+}
+
+auto Sampler::sample_due_topics(Clock::time_point now) -> Clock::time_point {
+    auto next_wakeup = now + DEMAND_POLL_INTERVAL;
+    for (size_t i = 0; i < TOPIC_COUNT; ++i) {
+        auto topic = static_cast<Topic>(i);
+        auto& state = topics_[i];
+        if (state.collector == nullptr) {
+            continue;
+        }
+        auto interval = demand_function_(topic);
+        if (interval.count() <= 0) {
+            // idle; sample right away once somebody subscribes
+            state.next_due = {};
+            continue;
+        }
+        // a subscriber asking for a shorter interval than the one scheduled
+        // shouldn't have to wait for the slower schedule to come around
+        if (state.next_due > now + interval) {
+            state.next_due = now + interval;
+        }
+        if (now >= state.next_due) {
+            sample(topic, state);
+            // keep the pace unless sampling fell behind by a whole interval
+            state.next_due = now - state.next_due > interval ? now + interval : state.next_due + interval;
+        }
+        next_wakeup = std::min(next_wakeup, state.next_due);
+    }
+    return next_wakeup;
+}
+
+// Returns the CPU time the calling thread has used so far.
+static auto thread_cpu_time() -> std::chrono::nanoseconds {
+    timespec time{};
+    ::clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+    return std::chrono::seconds(time.tv_sec) + std::chrono::nanoseconds(time.tv_nsec);
+}
+
+auto Sampler::sample(Topic topic, TopicState& state) -> void {
+    auto snapshot = std::make_shared<Snapshot>(state.collector->schema());
+    auto cpu_start = thread_cpu_time();
+    auto wall_start = Clock::now();
+    auto error_or_void = state.collector->collect(*snapshot);
+    state.cost.wall_time = Clock::now() - wall_start;
+    state.cost.cpu_time = thread_cpu_time() - cpu_start;
+    state.cost.total_cpu_time += state.cost.cpu_time;
+    if (error_or_void.is_error()) {
+        // report once per failure streak rather than at every interval
+        if (!state.failing) {
+            LOG_WARN("Sampling topic {} failed: {}", format_topic(topic), error_or_void.error().error_message());
+            state.failing = true;
+        }
+        return;
+    }
+    state.failing = false;
+
+    auto timestamp = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch());
+    snapshot->finish(++state.version, timestamp);
+
+    publish_function_(snapshot, state.history);
+    state.sample_count.fetch_add(1, std::memory_order_relaxed);
+
+    if (state.history.size() == HISTORY_LENGTH) {
+        state.history.erase(state.history.begin());
+    }
+    state.history.push_back(std::move(snapshot));
+}
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "Collector.h"
+#include "Snapshot.h"
+#include "Topic.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <thread>
+#include <vector>
+
+namespace metrics {
+
+// Sampler runs the collectors on a thread of its own. Every topic is sampled
+// only as often as its fastest subscriber needs and not at all while nobody
+// subscribed to it, so an idle topic costs nothing however expensive its
+// collector is.
+//
+// Demand is polled rather than pushed: the sampler asks for every topic's
+// interval whenever it wakes up, at least every DEMAND_POLL_INTERVAL, which
+// keeps it decoupled from where subscriptions are tracked.
+//
+// Every sample becomes an immutable Snapshot numbered by a per-topic
+// version. The sampler keeps the last HISTORY_LENGTH snapshots of each topic
+// around so that whoever publishes them can encode a sample as a delta
+// against any of the versions its subscribers still hold.
+//
+// The sampler measures what every sample costs it, which the sampler topic
+// reports through SamplerCollector.
+class Sampler final {
+public:
+    using Clock = std::chrono::steady_clock;
+    // Returns the interval given topic is wanted at; zero when it isn't.
+    using DemandFunction = std::function<std::chrono::milliseconds(Topic topic)>;
+    using SnapshotPointer = std::shared_ptr<const Snapshot>;
+    // Receives a sample along with the previous samples of its topic, oldest
+    // first. A gap in the versions means sampling failed in between.
+    using PublishFunction = std::function<void(SnapshotPointer snapshot, std::span<const SnapshotPointer> history)>;
+
+    static constexpr auto DEMAND_POLL_INTERVAL = std::chrono::milliseconds(100);
+    static constexpr size_t HISTORY_LENGTH = 16;
+
+    // What sampling a topic costs the sampler thread.
+    struct SampleCost {
+        // of the latest sample
+        std::chrono::nanoseconds cpu_time{0};
+        std::chrono::nanoseconds wall_time{0};
+        // of every sample so far, failed ones included
+        std::chrono::nanoseconds total_cpu_time{0};
+    };
+
+    Sampler(DemandFunction demand_function, PublishFunction publish_function);
+
+    Sampler(const Sampler&) = delete;
+    Sampler(Sampler&&) noexcept = delete;
+    ~Sampler() noexcept;
+
+    auto operator=(const Sampler&) -> Sampler& = delete;
+    auto operator=(Sampler&&) noexcept -> Sampler& = delete;
+
+    // Adds the collector of a topic; must be called before start().
+    auto add_collector(std::unique_ptr<Collector> collector) -> void;
+
+    auto start() -> void;
+    auto shutdown() noexcept -> void;
+
+    // Samples every topic that is due by now and returns when the next one
+    // will be due. Called by the sampler thread; exposed for testing.
+    auto sample_due_topics(Clock::time_point now) -> Clock::time_point;
+
+    // How many samples of given topic were published so far.
+    [[nodiscard]] auto sample_count(Topic topic) const -> uint64_t;
+    // Only to be called from the sampler thread, as collectors are, or while
+    // it isn't running.
+    [[nodiscard]] auto sample_cost(Topic topic) const -> const SampleCost&;
+
+private:
+    struct TopicState {
+        std::unique_ptr<Collector> collector;
+        Clock::time_point next_due{};
+        bool failing{false};
+        uint64_t version{0};
+        // oldest first, at most HISTORY_LENGTH
+        std::vector<SnapshotPointer> history;
+        std::atomic<uint64_t> sample_count{0};
+        SampleCost cost;
+    };
+
+    auto thread_main(std::stop_token stop_token) -> void;
+    auto sample(Topic topic, TopicState& state) -> void;
+
+    DemandFunction demand_function_;
+    PublishFunction publish_function_;
+    std::array<TopicState, TOPIC_COUNT> topics_;
+
+    std::mutex mutex_;
+    std::condition_variable_any stop_condition_;
+    std::jthread thread_{};
+};
+
+} // namespace metrics
@@ -0,0 +1,50 @@
+#include "SamplerCollector.h"
+#include "Sampler.h"
+#include <array>
+#include <chrono>
+#include <string>
+
+using namespace common;
+using namespace metrics;
+
+namespace {
+
+enum SamplerField : size_t { SAMPLES, CPU_TIME_US, WALL_TIME_US, TOTAL_CPU_TIME_MS };
+
+constexpr std::array<FieldDescriptor, 4> FIELDS = {{
+    field<"samples">(FieldType::UINT),
+    field<"cpu_time_us">(FieldType::UINT),
+    field<"wall_time_us">(FieldType::UINT),
+    field<"total_cpu_time_ms">(FieldType::UINT),
+}};
+constexpr Schema SCHEMA = {Topic::SAMPLER, "topic", FIELDS};
+
+} // namespace
+
+SamplerCollector::SamplerCollector(const Sampler& sampler) :
+    sampler_(sampler) {}
+
+auto SamplerCollector::schema() const -> const Schema& {
+    return SCHEMA;
+}
+
+template <typename Unit>
+static auto count_of(std::chrono::nanoseconds duration) -> uint64_t {
+    return static_cast<uint64_t>(std::chrono::duration_cast<Unit>(duration).count());
+}
+
+auto SamplerCollector::collect(Snapshot& snapshot) -> ErrorOr<void> {
+    for (size_t i = 0; i < TOPIC_COUNT; ++i) {
+        auto topic = static_cast<Topic>(i);
+        const auto& cost = sampler_.sample_cost(topic);
+        if (cost.total_cpu_time.count() == 0 && cost.wall_time.count() == 0) {
+            continue;
+        }
+        auto& row = snapshot.add_row(std::string(format_topic(topic)));
+        row.values[SAMPLES] = sampler_.sample_count(topic);
+        row.values[CPU_TIME_US] = count_of<std::chrono::microseconds>(cost.cpu_time);
+        row.values[WALL_TIME_US] = count_of<std::chrono::microseconds>(cost.wall_time);
+        row.values[TOTAL_CPU_TIME_MS] = count_of<std::chrono::milliseconds>(cost.total_cpu_time);
+    }
+    return {};
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include "Collector.h"
+
+namespace metrics {
+
+class Sampler;
+
+// SamplerCollector reports what sampling every other topic costs, as
+// measured by the sampler: the CPU and wall clock time of the latest sample
+// in microseconds and the CPU time of all samples so far in milliseconds.
+// Topics never sampled are left out.
+class SamplerCollector final : public Collector {
+public:
+    explicit SamplerCollector(const Sampler& sampler);
+
+    [[nodiscard]] auto schema() const -> const Schema& override;
+    auto collect(Snapshot& snapshot) -> common::ErrorOr<void> override;
+
+private:
+    const Sampler& sampler_;
+};
+
+} // namespace metrics
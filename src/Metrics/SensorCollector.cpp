@@ -0,0 +1,246 @@
+#include "SensorCollector.h"
+#include "ProcFs.h"
+#include "../Common/Assertions.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <fcntl.h>
+#include <fmt/format.h>
+#include <tuple>
+#include <unistd.h>
+#include <utility>
+
+using namespace common;
+using namespace metrics;
+
+namespace {
+
+enum SensorField : size_t { CHIP, LABEL, KIND, VALUE };
+
+constexpr std::array<FieldDescriptor, 4> FIELDS = {{
+    field<"chip">(FieldType::TEXT),
+    field<"label">(FieldType::TEXT),
+    field<"kind">(FieldType::TEXT),
+    field<"value">(FieldType::FLOAT),
+}};
+// keyed by hwmon directory and input, e.g. "hwmon0/temp1", since several
+// chips may well have the same name, by thermal zone and by CPU
+constexpr Schema SCHEMA = {Topic::SENSORS, "sensor", FIELDS};
+
+// a sensor file holds a single number
+constexpr size_t READ_BUFFER_SIZE = 64;
+
+} // namespace
+
+// Returns the file's contents without the trailing newline; empty on errors.
+static auto read_value(const std::string& path, std::string& buffer) -> std::string_view {
+    if (procfs::read_file(path.c_str(), buffer).is_error()) {
+        return {};
+    }
+    std::string_view value = buffer;
+    return procfs::next_line(value);
+}
+
+// Returns the number the name of an entry like "temp12_input" or "cpu3"
+// has after given prefix and before given suffix; empty if it has none.
+static auto entry_number(std::string_view name, std::string_view prefix, std::string_view suffix)
+    -> std::string_view {
+    if (!name.starts_with(prefix) || !name.ends_with(suffix) || name.size() <= prefix.size() + suffix.size()) {
+        return {};
+    }
+    auto number = name.substr(prefix.size(), name.size() - prefix.size() - suffix.size());
+    return number.find_first_not_of("0123456789") == std::string_view::npos ? number : std::string_view();
+}
+
+SensorCollector::SensorCollector(std::string hwmon_root, std::string thermal_root, std::string cpu_root) :
+    hwmon_root_(std::move(hwmon_root)),
+    thermal_root_(std::move(thermal_root)),
+    cpu_root_(std::move(cpu_root)) {}
+
+SensorCollector::~SensorCollector() noexcept {
+    for (auto& sensor : sensors_) {
+        ::close(sensor.fd);
+    }
+}
+
+auto SensorCollector::schema() const -> const Schema& {
+    return SCHEMA;
+}
+
+auto SensorCollector::format_kind(Kind kind) -> std::string_view {
+    switch (kind) {
+    case Kind::TEMPERATURE:
+        return "temperature";
+    case Kind::FAN:
+        return "fan";
+    case Kind::POWER:
+        return "power";
+    case Kind::FREQUENCY:
+        return "frequency";
+    }
+    VERIFY_NOT_REACHED();
+}
+
+auto SensorCollector::find_hwmon_sensors() -> void {
+    std::vector<std::string> chips;
+    // not an error; the machine just has no sensors
+    [[maybe_unused]] auto error_or_void = procfs::for_each_entry(hwmon_root_.c_str(), [&chips](std::string_view name) {
+        chips.emplace_back(name);
+    });
+
+    // the inputs of every chip, with the attribute read for each
+    struct Input {
+        std::string name;
+        std::string attribute;
+        Kind kind;
+    };
+    std::vector<Input> inputs;
+    for (const auto& chip : chips) {
+        auto chip_path = fmt::format("{}/{}", hwmon_root_, chip);
+        auto chip_name = std::string(read_value(chip_path + "/name", buffer_));
+
+        inputs.clear();
+        error_or_void = procfs::for_each_entry(chip_path.c_str(), [&inputs](std::string_view name) {
+            // power meters report either an instant value or an average
+            constexpr std::array<std::tuple<std::string_view, std::string_view, Kind>, 4> ATTRIBUTES = {{
+                {"temp", "_input", Kind::TEMPERATURE},
+                {"fan", "_input", Kind::FAN},
+                {"power", "_input", Kind::POWER},
+                {"power", "_average", Kind::POWER},
+            }};
+            for (const auto& [prefix, suffix, kind] : ATTRIBUTES) {
+                if (auto number = entry_number(name, prefix, suffix); !number.empty()) {
+                    inputs.push_back({fmt::format("{}{}", prefix, number), std::string(name), kind});
+                    return;
+                }
+            }
+        });
+        // "_average" sorts before "_input"; keep the instant value of inputs
+        // having both
+        std::sort(inputs.begin(), inputs.end(), [](const Input& lhs, const Input& rhs) {
+            return lhs.name != rhs.name ? lhs.name < rhs.name : lhs.attribute > rhs.attribute;
+        });
+        inputs.erase(std::unique(inputs.begin(),
+                                 inputs.end(),
+                                 [](const Input& lhs, const Input& rhs) { return lhs.name == rhs.name; }),
+                     inputs.end());
+
+        for (const auto& input : inputs) {
+            auto label = read_value(fmt::format("{}/{}_label", chip_path, input.name), buffer_);
+            found_.push_back({fmt::format("{}/{}", chip, input.name),
+                              fmt::format("{}/{}", chip_path, input.attribute),
+                              chip_name,
+                              std::string(label.empty() ? std::string_view(input.name) : label),
+                              input.kind});
+        }
+    }
+}
+
+auto SensorCollector::find_thermal_zones() -> void {
+    std::vector<std::string> zones;
+    auto add_zone = [&zones](std::string_view name) {
+        if (!entry_number(name, "thermal_zone", "").empty()) {
+            zones.emplace_back(name);
+        }
+    };
+    // not an error either
+    [[maybe_unused]] auto error_or_void = procfs::for_each_entry(thermal_root_.c_str(), add_zone);
+    for (const auto& zone : zones) {
+        auto zone_path = fmt::format("{}/{}", thermal_root_, zone);
+        auto type = read_value(zone_path + "/type", buffer_);
+        found_.push_back({zone,
+                          zone_path + "/temp",
+                          "thermal",
+                          std::string(type.empty() ? std::string_view(zone) : type),
+                          Kind::TEMPERATURE});
+    }
+}
+
+auto SensorCollector::find_cpu_frequencies() -> void {
+    [[maybe_unused]] auto error_or_void = procfs::for_each_entry(cpu_root_.c_str(), [this](std::string_view name) {
+        // offline CPUs and machines without cpufreq have no such file,
+        // which opening it in discover() tells
+        if (!entry_number(name, "cpu", "").empty()) {
+            found_.push_back({fmt::format("{}/frequency", name),
+                              fmt::format("{}/{}/cpufreq/scaling_cur_freq", cpu_root_, name),
+                              "cpufreq",
+                              std::string(name),
+                              Kind::FREQUENCY});
+        }
+    });
+}
+
+auto SensorCollector::discover() -> void {
+    found_.clear();
+    find_hwmon_sensors();
+    find_thermal_zones();
+    find_cpu_frequencies();
+    std::sort(found_.begin(), found_.end(), [](const Sensor& lhs, const Sensor& rhs) { return lhs.key < rhs.key; });
+
+    // take over the files of the sensors known already, both sorted by key,
+    // unless reading them failed
+    auto known = sensors_.begin();
+    for (auto& sensor : found_) {
+        while (known != sensors_.end() && known->key < sensor.key) {
+            ++known;
+        }
+        if (known != sensors_.end() && known->key == sensor.key && !known->failed && known->path == sensor.path) {
+            sensor.fd = std::exchange(known->fd, -1);
+        } else {
+            sensor.fd = ::open(sensor.path.c_str(), O_RDONLY | O_CLOEXEC);
+        }
+    }
+    for (auto& sensor : sensors_) {
+        if (sensor.fd >= 0) {
+            ::close(sensor.fd);
+        }
+    }
+    std::erase_if(found_, [](const Sensor& sensor) { return sensor.fd < 0; });
+    sensors_.swap(found_);
+}
+
+auto SensorCollector::collect(Snapshot& snapshot) -> ErrorOr<void> {
+    if (sample_++ % DISCOVERY_SAMPLES == 0) {
+        discover();
+    }
+
+    std::array<char, READ_BUFFER_SIZE> buffer;
+    for (auto& sensor : sensors_) {
+        auto text_or_error = procfs::read_file(sensor.fd, buffer);
+        // e.g. a CPU gone offline, or a driver failing to reach the chip
+        sensor.failed = text_or_error.is_error() || text_or_error.value().empty();
+        if (sensor.failed) {
+            continue;
+        }
+        auto text = text_or_error.value();
+        // temperatures in millidegrees Celsius, power in microwatts, CPU
+        // frequencies in kHz; temperatures below zero start with a minus
+        auto is_negative = text.front() == '-';
+        if (is_negative) {
+            text.remove_prefix(1);
+        }
+        auto raw = static_cast<double>(procfs::next_uint(text)) * (is_negative ? -1.0 : 1.0);
+        double value = 0.0;
+        switch (sensor.kind) {
+        case Kind::TEMPERATURE:
+            value = std::round(raw / 100.0) / 10.0;
+            break;
+        case Kind::FAN:
+            value = raw;
+            break;
+        case Kind::POWER:
+            value = std::round(raw / 10000.0) / 100.0;
+            break;
+        case Kind::FREQUENCY:
+            value = std::round(raw / 1000.0);
+            break;
+        }
+
+        auto& row = snapshot.add_row(sensor.key);
+        row.values[CHIP] = sensor.chip;
+        row.values[LABEL] = sensor.label;
+        row.values[KIND] = std::string(format_kind(sensor.kind));
+        row.values[VALUE] = value;
+    }
+    return {};
+}
@@ -0,0 +1,86 @@
+#pragma once
+
+#include "Collector.h"
+#include <string>
+#include <vector>
+
+namespace metrics {
+
+// SensorCollector reports the hardware sensors exposed in sysfs: the
+// temperatures, fan speeds and power draw of the hwmon drivers, the
+// temperatures of the thermal zones and the frequency every CPU currently
+// runs at according to cpufreq. Machines without any, like most virtual
+// machines, report none.
+//
+// Every sensor is a tiny file, and a many-core machine has hundreds of
+// them. They are found and opened once, then read in a single sweep over a
+// flat table, a pread() each, without building paths or listing
+// directories. The table is rebuilt every DISCOVERY_SAMPLES samples to pick
+// up sensors coming and going, such as those of CPUs brought online or
+// offline, keeping the files of the sensors still around open.
+class SensorCollector final : public Collector {
+public:
+    // samples between looking for sensors anew
+    static constexpr uint32_t DISCOVERY_SAMPLES = 60;
+
+    explicit SensorCollector(std::string hwmon_root = "/sys/class/hwmon",
+                             std::string thermal_root = "/sys/class/thermal",
+                             std::string cpu_root = "/sys/devices/system/cpu");
+
+    SensorCollector(const SensorCollector&) = delete;
+    SensorCollector(SensorCollector&&) noexcept = delete;
+    ~SensorCollector() noexcept override;
+
+    auto operator=(const SensorCollector&) -> SensorCollector& = delete;
+    auto operator=(SensorCollector&&) noexcept -> SensorCollector& = delete;
+
+    [[nodiscard]] auto schema() const -> const Schema& override;
+    auto collect(Snapshot& snapshot) -> common::ErrorOr<void> override;
+
+    // Number of sensors found, each with its file open; exposed for testing.
+    [[nodiscard]] auto sensor_count() const -> size_t { return sensors_.size(); }
+
+private:
+    enum class Kind : uint8_t {
+        // in degrees Celsius
+        TEMPERATURE,
+        // in revolutions per minute
+        FAN,
+        // in watts
+        POWER,
+        // in MHz
+        FREQUENCY,
+    };
+
+    struct Sensor {
+        // e.g. "hwmon0/temp1", "thermal_zone0" or "cpu0/frequency"
+        std::string key;
+        std::string path;
+        std::string chip;
+        std::string label;
+        Kind kind;
+        int fd{-1};
+        // whether the latest read failed; the file is opened anew at the
+        // next discovery
+        bool failed{false};
+    };
+
+    static auto format_kind(Kind kind) -> std::string_view;
+
+    // Rebuilds the table of sensors, sorted by key.
+    auto discover() -> void;
+    auto find_hwmon_sensors() -> void;
+    auto find_thermal_zones() -> void;
+    auto find_cpu_frequencies() -> void;
+
+    std::string hwmon_root_;
+    std::string thermal_root_;
+    std::string cpu_root_;
+    uint32_t sample_{0};
+    std::vector<Sensor> sensors_;
+    // the sensors found by discover(), before taking over open files
+    std::vector<Sensor> found_;
+    std::string buffer_;
+};
+
+} // namespace metrics
@@ -0,0 +1,39 @@
+#include "Snapshot.h"
+#include <algorithm>
+
+using namespace metrics;
+
+auto Snapshot::add_row(std::string key) -> Row& {
+    auto& row = rows_.emplace_back();
+    row.key = std::move(key);
+    row.values.reserve(schema_->fields.size());
+    for (const auto& field : schema_->fields) {
+        switch (field.type) {
+        case FieldType::UINT:
+            row.values.emplace_back(uint64_t{0});
+            break;
+        case FieldType::FLOAT:
+            row.values.emplace_back(0.0);
+            break;
+        case FieldType::TEXT:
+            row.values.emplace_back(std::string());
+            break;
+        }
+    }
+    return row;
+}
+
+auto Snapshot::find_row(std::string_view key) const -> const Row* {
+    auto it = std::lower_bound(
+        rows_.begin(), rows_.end(), key, [](const Row& row, std::string_view key) { return row.key < key; });
+    if (it == rows_.end() || it->key != key) {
+        return nullptr;
+    }
+    return &*it;
+}
+
+auto Snapshot::finish(uint64_t version, std::chrono::milliseconds timestamp) -> void {
+    std::sort(rows_.begin(), rows_.end(), [](const Row& lhs, const Row& rhs) { return lhs.key < rhs.key; });
+    version_ = version;
+    timestamp_ = timestamp;
+}
@@ -0,0 +1,128 @@
+#pragma once
+
+#include "Topic.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <string>
+#include <string_view>
+#include <variant>
+#include <vector>
+
+namespace metrics {
+
+enum class FieldType : uint8_t {
+    UINT = 1,
+    FLOAT = 2,
+    TEXT = 3,
+};
+
+struct FieldDescriptor {
+    std::string_view name;
+    FieldType type;
+    // the name as a JSON object member with the separator in front,
+    // ,"name": -- encoded at compile time by field()
+    std::string_view json_key;
+};
+
+// FieldName carries a field's name as a template argument, so that field()
+// can encode it at compile time. Names must need no escaping in JSON; those
+// that do fail to compile.
+template <size_t N>
+struct FieldName {
+    consteval FieldName(const char (&name)[N]) {
+        for (size_t i = 0; i + 1 < N; ++i) {
+            if (static_cast<unsigned char>(name[i]) < 0x20 || name[i] == '"' || name[i] == '\\') {
+                // not a constant expression
+                invalid_field_name();
+            }
+            chars[i] = name[i];
+        }
+    }
+
+    [[nodiscard]] constexpr auto view() const -> std::string_view { return {chars, N - 1}; }
+
+    static auto invalid_field_name() -> void;
+
+    char chars[N]{};
+};
+
+namespace detail {
+
+template <FieldName Name>
+inline constexpr auto JSON_KEY = [] {
+    constexpr auto name = Name.view();
+    std::array<char, name.size() + 4> key{};
+    key[0] = ',';
+    key[1] = '"';
+    std::copy(name.begin(), name.end(), key.begin() + 2);
+    key[name.size() + 2] = '"';
+    key[name.size() + 3] = ':';
+    return key;
+}();
+
+} // namespace detail
+
+// Describes a field of given name and type, e.g. field<"rss">(FieldType::UINT).
+template <FieldName Name>
+constexpr auto field(FieldType type) -> FieldDescriptor {
+    return {Name.view(), type, {detail::JSON_KEY<Name>.data(), detail::JSON_KEY<Name>.size()}};
+}
+
+// Schema describes the snapshots of a topic. A snapshot is a table of rows
+// identified by a key, such as an interface name or a process id, holding
+// one value per field. Topics describing the machine as a whole have a
+// single row with an empty key.
+struct Schema {
+    Topic topic;
+    // what the row keys stand for; empty for single row topics
+    std::string_view key_name;
+    std::span<const FieldDescriptor> fields;
+
+    [[nodiscard]] auto has_rows() const -> bool { return !key_name.empty(); }
+};
+
+using Value = std::variant<uint64_t, double, std::string>;
+
+struct Row {
+    std::string key;
+    // one per schema field, in schema order
+    std::vector<Value> values;
+};
+
+// Snapshot is one sample of a topic. Snapshots are filled in by a collector
+// and immutable once published, so that any number of connections and
+// delta computations can share them across threads.
+class Snapshot final {
+public:
+    explicit Snapshot(const Schema& schema) :
+        schema_(&schema) {}
+
+    [[nodiscard]] auto schema() const -> const Schema& { return *schema_; }
+    [[nodiscard]] auto topic() const -> Topic { return schema_->topic; }
+    // Increases by one with every published snapshot of a topic; zero until
+    // published.
+    [[nodiscard]] auto version() const -> uint64_t { return version_; }
+    [[nodiscard]] auto timestamp() const -> std::chrono::milliseconds { return timestamp_; }
+    [[nodiscard]] auto rows() const -> std::span<const Row> { return rows_; }
+
+    // Appends a row with every value zero or empty.
+    auto add_row(std::string key = {}) -> Row&;
+    // Returns the row with given key; nullptr when there is none. Only valid
+    // once finish() sorted the rows.
+    [[nodiscard]] auto find_row(std::string_view key) const -> const Row*;
+
+    // Sorts the rows by key, which lets deltas be computed by merging, and
+    // stamps the snapshot for publication.
+    auto finish(uint64_t version, std::chrono::milliseconds timestamp) -> void;
+
+private:
+    const Schema* schema_;
+    uint64_t version_{0};
+    std::chrono::milliseconds timestamp_{0};
+    std::vector<Row> rows_;
+};
+
+} // namespace metrics
@@ -0,0 +1,289 @@
+#include "SnapshotBinary.h"
+#include <algorithm>
+#include <bit>
+#include <cstring>
+
+using namespace common;
+using namespace metrics;
+using namespace metrics::binary;
+
+// versions a consumer that never acknowledges keeps at most
+static constexpr size_t MAX_DECODER_VERSIONS = 64;
+
+static_assert(std::endian::native == std::endian::little, "the wire format is little-endian");
+
+template <typename T>
+static auto write_fixed(std::vector<uint8_t>& out, T value) -> void {
+    auto offset = out.size();
+    out.resize(offset + sizeof(T));
+    std::memcpy(out.data() + offset, &value, sizeof(T));
+}
+
+template <typename T>
+static auto read_fixed(std::span<const uint8_t> input, size_t offset) -> T {
+    T value;
+    std::memcpy(&value, input.data() + offset, sizeof(T));
+    return value;
+}
+
+static auto write_bytes(std::vector<uint8_t>& out, std::string_view bytes) -> void {
+    write_varint(out, bytes.size());
+    out.insert(out.end(), bytes.begin(), bytes.end());
+}
+
+static auto read_bytes(std::span<const uint8_t>& input) -> ErrorOr<std::string_view> {
+    auto length = TRY(read_varint(input));
+    if (length > input.size()) {
+        return {Error::from_string("truncated message")};
+    }
+    auto bytes = std::string_view(reinterpret_cast<const char*>(input.data()), length);
+    input = input.subspan(length);
+    return bytes;
+}
+
+static auto tag(size_t field_id, WireType wire_type) -> uint64_t {
+    return (uint64_t{field_id} << 2) | static_cast<uint64_t>(wire_type);
+}
+
+// Writes the header with a row count of zero; patched once the rows are
+// written.
+static auto write_header(std::vector<uint8_t>& out, const Snapshot& snapshot, uint64_t base) -> size_t {
+    auto offset = out.size();
+    out.push_back(WIRE_VERSION);
+    out.push_back(base == 0 ? FLAG_KEYFRAME : 0);
+    out.push_back(static_cast<uint8_t>(snapshot.topic()));
+    out.push_back(0);
+    write_fixed<uint32_t>(out, 0);
+    write_fixed<uint64_t>(out, snapshot.version());
+    write_fixed<uint64_t>(out, base);
+    write_fixed<uint64_t>(out, static_cast<uint64_t>(snapshot.timestamp().count()));
+    return offset;
+}
+
+static auto patch_row_count(std::vector<uint8_t>& out, size_t header_offset, uint32_t row_count) -> void {
+    std::memcpy(out.data() + header_offset + 4, &row_count, sizeof(row_count));
+}
+
+// Writes the row's fields, only those differing from base when given.
+static auto write_row(std::vector<uint8_t>& out, const Schema& schema, const Row& row, const Row* base) -> void {
+    write_bytes(out, row.key);
+    size_t field_count = 0;
+    for (size_t i = 0; i < schema.fields.size(); ++i) {
+        if (base == nullptr || base->values[i] != row.values[i]) {
+            ++field_count;
+        }
+    }
+    write_varint(out, field_count);
+    for (size_t i = 0; i < schema.fields.size(); ++i) {
+        if (base != nullptr && base->values[i] == row.values[i]) {
+            continue;
+        }
+        const auto& value = row.values[i];
+        if (const auto* number = std::get_if<uint64_t>(&value)) {
+            if (base != nullptr) {
+                // wraps around for decreasing values, and back when decoding
+                auto difference = static_cast<int64_t>(*number - std::get<uint64_t>(base->values[i]));
+                write_varint(out, tag(i, WireType::VARINT_DIFFERENCE));
+                write_varint(out, zigzag_encode(difference));
+            } else {
+                write_varint(out, tag(i, WireType::VARINT));
+                write_varint(out, *number);
+            }
+        } else if (const auto* real = std::get_if<double>(&value)) {
+            write_varint(out, tag(i, WireType::FLOAT64));
+            write_fixed<double>(out, *real);
+        } else {
+            write_varint(out, tag(i, WireType::BYTES));
+            write_bytes(out, std::get<std::string>(value));
+        }
+    }
+}
+
+auto binary::write_varint(std::vector<uint8_t>& out, uint64_t value) -> void {
+    while (value >= 0x80) {
+        out.push_back(static_cast<uint8_t>(value | 0x80));
+        value >>= 7;
+    }
+    out.push_back(static_cast<uint8_t>(value));
+}
+
+auto binary::read_varint(std::span<const uint8_t>& input) -> ErrorOr<uint64_t> {
+    uint64_t value = 0;
+    for (size_t i = 0; i < std::min(input.size(), MAX_VARINT_SIZE); ++i) {
+        auto byte = input[i];
+        value |= uint64_t{byte & 0x7FU} << (7 * i);
+        if ((byte & 0x80) == 0) {
+            input = input.subspan(i + 1);
+            return value;
+        }
+    }
+    return {Error::from_string(input.size() < MAX_VARINT_SIZE ? "truncated message" : "invalid varint")};
+}
+
+auto binary::write_keyframe(std::vector<uint8_t>& out, const Snapshot& snapshot) -> void {
+    auto header_offset = write_header(out, snapshot, 0);
+    for (const auto& row : snapshot.rows()) {
+        write_row(out, snapshot.schema(), row, nullptr);
+    }
+    patch_row_count(out, header_offset, static_cast<uint32_t>(snapshot.rows().size()));
+    write_varint(out, 0);
+}
+
+auto binary::write_delta(std::vector<uint8_t>& out, const Snapshot& base, const Snapshot& snapshot) -> void {
+    auto header_offset = write_header(out, snapshot, base.version());
+
+    // both sides are sorted by key; merge them
+    auto rows = snapshot.rows();
+    auto base_rows = base.rows();
+    uint32_t row_count = 0;
+    size_t j = 0;
+    for (const auto& row : rows) {
+        while (j < base_rows.size() && base_rows[j].key < row.key) {
+            ++j;
+        }
+        const Row* base_row = j < base_rows.size() && base_rows[j].key == row.key ? &base_rows[j] : nullptr;
+        if (base_row != nullptr && base_row->values == row.values) {
+            continue;
+        }
+        write_row(out, snapshot.schema(), row, base_row);
+        ++row_count;
+    }
+    patch_row_count(out, header_offset, row_count);
+
+    std::vector<std::string_view> removed;
+    size_t i = 0;
+    for (const auto& base_row : base_rows) {
+        while (i < rows.size() && rows[i].key < base_row.key) {
+            ++i;
+        }
+        if (i == rows.size() || rows[i].key != base_row.key) {
+            removed.push_back(base_row.key);
+        }
+    }
+    write_varint(out, removed.size());
+    for (auto key : removed) {
+        write_bytes(out, key);
+    }
+}
+
+auto binary::read_header(std::span<const uint8_t> message) -> ErrorOr<Header> {
+    if (message.size() < HEADER_SIZE) {
+        return {Error::from_string("truncated message")};
+    }
+    Header header;
+    header.wire_version = message[0];
+    header.flags = message[1];
+    header.topic = message[2];
+    header.row_count = read_fixed<uint32_t>(message, 4);
+    header.version = read_fixed<uint64_t>(message, 8);
+    header.base = read_fixed<uint64_t>(message, 16);
+    header.timestamp = read_fixed<uint64_t>(message, 24);
+    if (header.wire_version != WIRE_VERSION) {
+        return {Error::from_string("unsupported wire version")};
+    }
+    if (header.topic >= TOPIC_COUNT) {
+        return {Error::from_string("unknown topic")};
+    }
+    if (header.is_keyframe() != (header.base == 0)) {
+        return {Error::from_string("invalid base version")};
+    }
+    return header;
+}
+
+static auto read_field(std::span<const uint8_t>& input, std::vector<Value>& values) -> ErrorOr<void> {
+    auto field_tag = TRY(read_varint(input));
+    auto field_id = field_tag >> 2;
+    auto wire_type = static_cast<WireType>(field_tag & 3);
+    // schemas are small; anything else is garbage rather than a new field
+    if (field_id >= 256) {
+        return {Error::from_string("invalid field id")};
+    }
+    if (field_id >= values.size()) {
+        values.resize(field_id + 1);
+    }
+    auto& value = values[field_id];
+    switch (wire_type) {
+    case WireType::VARINT:
+        value = TRY(read_varint(input));
+        return {};
+    case WireType::VARINT_DIFFERENCE: {
+        auto difference = zigzag_decode(TRY(read_varint(input)));
+        const auto* base = std::get_if<uint64_t>(&value);
+        if (base == nullptr) {
+            return {Error::from_string("difference to a value that isn't a number")};
+        }
+        value = *base + static_cast<uint64_t>(difference);
+        return {};
+    }
+    case WireType::FLOAT64:
+        if (input.size() < sizeof(double)) {
+            return {Error::from_string("truncated message")};
+        }
+        value = read_fixed<double>(input, 0);
+        input = input.subspan(sizeof(double));
+        return {};
+    case WireType::BYTES:
+        value = std::string(TRY(read_bytes(input)));
+        return {};
+    }
+    VERIFY_NOT_REACHED();
+}
+
+auto Decoder::decode(std::span<const uint8_t> message) -> ErrorOr<const Table*> {
+    auto header = TRY(read_header(message));
+    auto& tables = tables_[header.topic];
+
+    Table table;
+    if (!header.is_keyframe()) {
+        auto it = tables.find(header.base);
+        if (it == tables.end()) {
+            return {Error::from_string("unknown base version")};
+        }
+        table = it->second;
+    }
+    table.topic = static_cast<Topic>(header.topic);
+    table.version = header.version;
+    table.timestamp = std::chrono::milliseconds(header.timestamp);
+
+    auto input = message.subspan(HEADER_SIZE);
+    for (uint32_t i = 0; i < header.row_count; ++i) {
+        auto key = TRY(read_bytes(input));
+        auto it = table.rows.find(key);
+        if (it == table.rows.end()) {
+            it = table.rows.emplace(std::string(key), std::vector<Value>()).first;
+        }
+        auto field_count = TRY(read_varint(input));
+        for (uint64_t field = 0; field < field_count; ++field) {
+            TRY(read_field(input, it->second));
+        }
+    }
+    auto removed_count = TRY(read_varint(input));
+    for (uint64_t i = 0; i < removed_count; ++i) {
+        auto key = TRY(read_bytes(input));
+        auto it = table.rows.find(key);
+        if (it != table.rows.end()) {
+            table.rows.erase(it);
+        }
+    }
+    if (!input.empty()) {
+        return {Error::from_string("trailing bytes after message")};
+    }
+
+    // make room before storing, since a replayed or late message may well be
+    // the oldest version kept
+    if (!tables.contains(header.version) && tables.size() >= MAX_DECODER_VERSIONS) {
+        tables.erase(tables.begin());
+    }
+    auto& stored = tables[header.version] = std::move(table);
+    return &stored;
+}
+
+auto Decoder::acknowledge(Topic topic, uint64_t version) -> void {
+    auto& tables = tables_[static_cast<size_t>(topic)];
+    tables.erase(tables.begin(), tables.lower_bound(version));
+}
+
+auto Decoder::latest(Topic topic) const -> const Table* {
+    const auto& tables = tables_[static_cast<size_t>(topic)];
+    return tables.empty() ? nullptr : &tables.rbegin()->second;
+}
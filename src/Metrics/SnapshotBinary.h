@@ -0,0 +1,127 @@
+#pragma once
+
+#include "../Common/Error.h"
+#include "Snapshot.h"
+#include "Topic.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <span>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// Compact binary encoding of snapshots, sent to connections that negotiated
+// the "wstop.binary" subprotocol. All integers are little-endian.
+//
+// Every message starts with a fixed 32 byte header:
+//
+//   offset  size  field
+//        0     1  wire version, WIRE_VERSION
+//        1     1  flags, FLAG_KEYFRAME
+//        2     1  topic, see metrics::Topic
+//        3     1  reserved, zero
+//        4     4  number of rows that follow
+//        8     8  version
+//       16     8  base version; zero in keyframes
+//       24     8  timestamp in milliseconds since the epoch
+//
+// followed by the rows, each being
+//
+//   varint key length, key bytes (UTF-8; empty for single row topics)
+//   varint number of fields that follow
+//   per field: varint tag, value
+//
+// and finally a varint count of removed rows followed by their keys, each as
+// varint length and bytes. Keyframes never remove rows.
+//
+// A field's tag is its id shifted left by two bits or'ed with its wire type.
+// Field ids are the positions of the fields in the topic's schema; fields
+// are only ever appended and every value says how long it is, so decoders
+// may skip ids they don't know. Deltas carry only the fields that changed
+// since the base version, and counters as the zigzag encoded difference to
+// the base version's value, which is a single byte for most counters sampled
+// at a second's interval.
+namespace metrics::binary {
+
+constexpr uint8_t WIRE_VERSION = 1;
+constexpr uint8_t FLAG_KEYFRAME = 0x01;
+constexpr size_t HEADER_SIZE = 32;
+// longest encoding of a 64 bit varint
+constexpr size_t MAX_VARINT_SIZE = 10;
+
+enum class WireType : uint8_t {
+    // unsigned varint
+    VARINT = 0,
+    // zigzag varint to add to the base version's value
+    VARINT_DIFFERENCE = 1,
+    // IEEE 754 double
+    FLOAT64 = 2,
+    // varint length followed by as many bytes
+    BYTES = 3,
+};
+
+struct Header {
+    uint8_t wire_version{WIRE_VERSION};
+    uint8_t flags{0};
+    uint8_t topic{0};
+    uint32_t row_count{0};
+    uint64_t version{0};
+    uint64_t base{0};
+    uint64_t timestamp{0};
+
+    [[nodiscard]] auto is_keyframe() const -> bool { return (flags & FLAG_KEYFRAME) != 0; }
+};
+
+constexpr auto zigzag_encode(int64_t value) -> uint64_t {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+constexpr auto zigzag_decode(uint64_t value) -> int64_t {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+auto write_varint(std::vector<uint8_t>& out, uint64_t value) -> void;
+// Reads a varint from the front of input and advances past it. Fails on
+// truncated or overlong input.
+auto read_varint(std::span<const uint8_t>& input) -> common::ErrorOr<uint64_t>;
+
+// Appends a keyframe holding the whole snapshot.
+auto write_keyframe(std::vector<uint8_t>& out, const Snapshot& snapshot) -> void;
+// Appends what changed from base to snapshot, like json::write_delta().
+auto write_delta(std::vector<uint8_t>& out, const Snapshot& base, const Snapshot& snapshot) -> void;
+
+auto read_header(std::span<const uint8_t> message) -> common::ErrorOr<Header>;
+
+// Table is what a consumer knows of a topic at some version: every row with
+// its field values indexed by field id. Fields never received are zero.
+struct Table {
+    Topic topic{Topic::CPU};
+    uint64_t version{0};
+    std::chrono::milliseconds timestamp{0};
+    std::map<std::string, std::vector<Value>, std::less<>> rows;
+};
+
+// Decoder is the reference decoder of the format. It keeps the tables of
+// the versions a delta may still be based on, which are those from the
+// latest acknowledged one on, so a consumer acknowledges what it decoded
+// through both acknowledge() and an "ack" command to the server.
+class Decoder final {
+public:
+    // Decodes a keyframe or applies a delta to the table of its base version
+    // and returns the resulting table, valid until its version is forgotten.
+    auto decode(std::span<const uint8_t> message) -> common::ErrorOr<const Table*>;
+
+    // Forgets the versions of given topic older than given one.
+    auto acknowledge(Topic topic, uint64_t version) -> void;
+
+    [[nodiscard]] auto latest(Topic topic) const -> const Table*;
+
+private:
+    // per topic, by version
+    std::array<std::map<uint64_t, Table>, TOPIC_COUNT> tables_;
+};
+
+} // namespace metrics::binary
@@ -0,0 +1,139 @@
+#include "SnapshotJson.h"
+#include "../Common/JsonWriter.h"
+
+using namespace common;
+using namespace metrics;
+
+static auto write_value(JsonWriter& writer, const Value& value) -> void {
+    if (const auto* number = std::get_if<uint64_t>(&value)) {
+        writer.number(*number);
+    } else if (const auto* real = std::get_if<double>(&value)) {
+        writer.number(*real);
+    } else {
+        writer.string(std::get<std::string>(value));
+    }
+}
+
+// Writes the row's fields as an object, only those differing from base
+// when given. Field keys come with their separator encoded by field(), so
+// the first one is written without it.
+static auto write_fields(JsonWriter& writer, const Schema& schema, const Row& row, const Row* base) -> void {
+    writer.raw('{');
+    size_t skip = 1;
+    for (size_t i = 0; i < schema.fields.size(); ++i) {
+        if (base != nullptr && base->values[i] == row.values[i]) {
+            continue;
+        }
+        writer.raw(schema.fields[i].json_key.substr(skip));
+        skip = 0;
+        write_value(writer, row.values[i]);
+    }
+    writer.raw('}');
+}
+
+static auto write_header(JsonWriter& writer, const Snapshot& snapshot) -> void {
+    writer.raw(R"({"topic":")");
+    writer.raw(format_topic(snapshot.topic()));
+    writer.raw(R"(","version":)");
+    writer.number(snapshot.version());
+}
+
+static auto write_timestamp(JsonWriter& writer, const Snapshot& snapshot) -> void {
+    writer.raw(R"(,"timestamp":)");
+    writer.number(static_cast<uint64_t>(snapshot.timestamp().count()));
+}
+
+auto json::write_keyframe(fmt::memory_buffer& out, const Snapshot& snapshot) -> void {
+    JsonWriter writer(out);
+    write_header(writer, snapshot);
+    write_timestamp(writer, snapshot);
+    writer.raw(R"(,"keyframe":true,"data":)");
+
+    const auto& schema = snapshot.schema();
+    if (!schema.has_rows()) {
+        if (snapshot.rows().empty()) {
+            writer.raw("{}");
+        } else {
+            write_fields(writer, schema, snapshot.rows().front(), nullptr);
+        }
+    } else {
+        char separator = '{';
+        for (const auto& row : snapshot.rows()) {
+            writer.raw(separator);
+            separator = ',';
+            writer.string(row.key);
+            writer.raw(':');
+            write_fields(writer, schema, row, nullptr);
+        }
+        writer.raw(separator == '{' ? "{}" : "}");
+    }
+    writer.raw('}');
+}
+
+auto json::write_delta(fmt::memory_buffer& out, const Snapshot& base, const Snapshot& snapshot) -> void {
+    JsonWriter writer(out);
+    write_header(writer, snapshot);
+    writer.raw(R"(,"base":)");
+    writer.number(base.version());
+    write_timestamp(writer, snapshot);
+    writer.raw(R"(,"data":)");
+
+    const auto& schema = snapshot.schema();
+    if (!schema.has_rows()) {
+        if (snapshot.rows().empty()) {
+            writer.raw("{}");
+        } else {
+            const auto* base_row = base.rows().empty() ? nullptr : &base.rows().front();
+            write_fields(writer, schema, snapshot.rows().front(), base_row);
+        }
+        writer.raw('}');
+        return;
+    }
+
+    // both sides are sorted by key; merge them
+    auto rows = snapshot.rows();
+    auto base_rows = base.rows();
+    size_t i = 0;
+    size_t j = 0;
+    char separator = '{';
+    while (i < rows.size()) {
+        while (j < base_rows.size() && base_rows[j].key < rows[i].key) {
+            ++j;
+        }
+        const Row* base_row = j < base_rows.size() && base_rows[j].key == rows[i].key ? &base_rows[j] : nullptr;
+        if (base_row != nullptr && base_row->values == rows[i].values) {
+            ++i;
+            continue;
+        }
+        writer.raw(separator);
+        separator = ',';
+        writer.string(rows[i].key);
+        writer.raw(':');
+        write_fields(writer, schema, rows[i], base_row);
+        ++i;
+    }
+    writer.raw(separator == '{' ? "{}" : "}");
+
+    // rows of base missing from snapshot
+    i = 0;
+    bool first = true;
+    for (const auto& base_row : base_rows) {
+        while (i < rows.size() && rows[i].key < base_row.key) {
+            ++i;
+        }
+        if (i < rows.size() && rows[i].key == base_row.key) {
+            continue;
+        }
+        writer.raw(first ? R"(,"removed":[)" : ",");
+        first = false;
+        writer.string(base_row.key);
+    }
+    if (!first) {
+        writer.raw(']');
+    }
+    writer.raw('}');
+}
+
+auto json::write_string(fmt::memory_buffer& out, std::string_view string) -> void {
+    JsonWriter(out).string(string);
+}
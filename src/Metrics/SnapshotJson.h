@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Snapshot.h"
+#include <fmt/format.h>
+#include <string_view>
+
+// The writers append to out through common::JsonWriter with the field keys
+// encoded at compile time by field(); they don't allocate unless out has to
+// grow, so callers encoding many messages reuse one buffer.
+namespace metrics::json {
+
+// Appends a keyframe holding the whole snapshot:
+//
+//   {"topic":"net","version":7,"timestamp":1700000000000,"keyframe":true,
+//    "data":{"eth0":{"rx_bytes":1234,...},...}}
+//
+// Topics with a single row have its fields directly under "data".
+auto write_keyframe(fmt::memory_buffer& out, const Snapshot& snapshot) -> void;
+
+// Appends what changed from base to snapshot: the changed fields of rows
+// present in both, every field of new rows and the keys of removed rows.
+//
+//   {"topic":"net","version":9,"base":7,"timestamp":1700000000000,
+//    "data":{"eth0":{"rx_bytes":2345}},"removed":["eth1"]}
+//
+// Applying it to the keyframe or delta of version base yields version.
+auto write_delta(fmt::memory_buffer& out, const Snapshot& base, const Snapshot& snapshot) -> void;
+
+// Appends given string as a quoted JSON string, escaping as necessary.
+auto write_string(fmt::memory_buffer& out, std::string_view string) -> void;
+
+} // namespace metrics::json
@@ -0,0 +1,76 @@
+#include "SnapshotMessage.h"
+#include "../WebSocket/FrameCodec.h"
+#include "SnapshotBinary.h"
+#include "SnapshotJson.h"
+#include <fmt/format.h>
+#include <vector>
+
+using namespace common;
+using namespace metrics;
+
+// Encodes the snapshot relative to base, or as a keyframe when there is
+// none, in given wire format. Payloads are written to per thread buffers
+// which keep their capacity, so the frame is the only allocation.
+static auto encode(const Snapshot& snapshot, const Snapshot* base, ws::WireFormat wire_format) -> SharedBuffer {
+    switch (wire_format) {
+    case ws::WireFormat::JSON: {
+        thread_local fmt::memory_buffer payload;
+        payload.clear();
+        if (base == nullptr) {
+            json::write_keyframe(payload, snapshot);
+        } else {
+            json::write_delta(payload, *base, snapshot);
+        }
+        return ws::make_frame(ws::Opcode::TEXT, {reinterpret_cast<const uint8_t*>(payload.data()), payload.size()});
+    }
+    case ws::WireFormat::BINARY: {
+        thread_local std::vector<uint8_t> payload;
+        payload.clear();
+        if (base == nullptr) {
+            binary::write_keyframe(payload, snapshot);
+        } else {
+            binary::write_delta(payload, *base, snapshot);
+        }
+        return ws::make_frame(ws::Opcode::BINARY, payload);
+    }
+    }
+    VERIFY_NOT_REACHED();
+}
+
+SnapshotMessage::SnapshotMessage(SnapshotPointer snapshot, std::span<const SnapshotPointer> history) :
+    snapshot_(std::move(snapshot)),
+    history_(history.begin(), history.end()) {}
+
+auto SnapshotMessage::find_base(uint64_t base) const -> const Snapshot* {
+    if (base == 0 || base >= snapshot_->version()) {
+        return nullptr;
+    }
+    for (const auto& snapshot : history_) {
+        if (snapshot->version() == base) {
+            return snapshot.get();
+        }
+    }
+    return nullptr;
+}
+
+auto SnapshotMessage::frame_for(uint64_t base, ws::WireFormat wire_format) -> SharedBuffer {
+    const auto* base_snapshot = find_base(base);
+
+    // encoding while holding the lock is deliberate: reactors asking for
+    // the same frame concurrently would only duplicate the work otherwise
+    std::lock_guard lock(mutex_);
+    if (base_snapshot == nullptr) {
+        auto& keyframe = keyframes_[static_cast<size_t>(wire_format)];
+        if (keyframe.is_empty()) {
+            keyframe = encode(*snapshot_, nullptr, wire_format);
+        }
+        return keyframe;
+    }
+    for (const auto& delta : deltas_) {
+        if (delta.base == base && delta.wire_format == wire_format) {
+            return delta.frame;
+        }
+    }
+    deltas_.push_back({base, wire_format, encode(*snapshot_, base_snapshot, wire_format)});
+    return deltas_.back().frame;
+}
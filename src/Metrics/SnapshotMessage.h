@@ -0,0 +1,49 @@
+#pragma once
+
+#include "../Common/SharedBuffer.h"
+#include "../WebSocket/VersionedMessage.h"
+#include "Snapshot.h"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <span>
+#include <vector>
+
+namespace metrics {
+
+// SnapshotMessage broadcasts a snapshot as JSON text frames or binary
+// frames: a keyframe for connections without a usable base and a delta for
+// the others. Frames are encoded lazily, once per wire format and base
+// version however many connections on however many reactors ask for them,
+// and kept for the lifetime of the message.
+class SnapshotMessage final : public ws::VersionedMessage {
+public:
+    using SnapshotPointer = std::shared_ptr<const Snapshot>;
+
+    // history holds the snapshots deltas may be based on.
+    SnapshotMessage(SnapshotPointer snapshot, std::span<const SnapshotPointer> history);
+
+    [[nodiscard]] auto version() const -> uint64_t override { return snapshot_->version(); }
+    [[nodiscard]] auto has_base(uint64_t base) const -> bool override { return find_base(base) != nullptr; }
+    auto frame_for(uint64_t base, ws::WireFormat wire_format) -> common::SharedBuffer override;
+
+private:
+    [[nodiscard]] auto find_base(uint64_t base) const -> const Snapshot*;
+
+    SnapshotPointer snapshot_;
+    std::vector<SnapshotPointer> history_;
+
+    struct Delta {
+        uint64_t base;
+        ws::WireFormat wire_format;
+        common::SharedBuffer frame;
+    };
+
+    std::mutex mutex_;
+    std::array<common::SharedBuffer, ws::WIRE_FORMAT_COUNT> keyframes_;
+    // few enough to search linearly
+    std::vector<Delta> deltas_;
+};
+
+} // namespace metrics
@@ -0,0 +1,40 @@
+#include "Topic.h"
+#include "../Common/Assertions.h"
+
+using namespace metrics;
+
+auto metrics::format_topic(Topic topic) -> std::string_view {
+    switch (topic) {
+    case Topic::CPU:
+        return "cpu";
+    case Topic::CPU_PER_CORE:
+        return "cpu.per_core";
+    case Topic::MEMORY:
+        return "mem";
+    case Topic::NETWORK:
+        return "net";
+    case Topic::DISK:
+        return "disk";
+    case Topic::PROCESSES:
+        return "procs";
+    case Topic::SENSORS:
+        return "sensors";
+    case Topic::SAMPLER:
+        return "sampler";
+    case Topic::NET_PROTOCOLS:
+        return "net.protocols";
+    case Topic::CGROUPS:
+        return "cgroups";
+    }
+    VERIFY_NOT_REACHED();
+}
+
+auto metrics::parse_topic(std::string_view name) -> std::optional<Topic> {
+    for (size_t i = 0; i < TOPIC_COUNT; ++i) {
+        auto topic = static_cast<Topic>(i);
+        if (format_topic(topic) == name) {
+            return topic;
+        }
+    }
+    return {};
+}
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace metrics {
+
+// Streams of samples clients can subscribe to. The values double as the
+// topic ids used on the wire and by the send queues.
+enum class Topic : uint8_t {
+    CPU = 0,
+    CPU_PER_CORE = 1,
+    MEMORY = 2,
+    NETWORK = 3,
+    DISK = 4,
+    PROCESSES = 5,
+    SENSORS = 6,
+    // what sampling the other topics costs
+    SAMPLER = 7,
+    // TCP and UDP counters of the whole host
+    NET_PROTOCOLS = 8,
+    // every populated cgroup of the cgroup v2 hierarchy
+    CGROUPS = 9,
+};
+
+constexpr size_t TOPIC_COUNT = 10;
+
+// Returns the name clients use for given topic, e.g. "cpu.per_core".
+auto format_topic(Topic topic) -> std::string_view;
+auto parse_topic(std::string_view name) -> std::optional<Topic>;
+
+} // namespace metrics
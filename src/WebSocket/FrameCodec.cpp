@@ -0,0 +1,131 @@
+#include "FrameCodec.h"
+#include "../Common/Assertions.h"
+#include <cstring>
+
+using namespace ws;
+
+auto ws::format_opcode(Opcode opcode) -> std::string_view {
+    switch (opcode) {
+    case Opcode::CONTINUATION:
+        return "continuation";
+    case Opcode::TEXT:
+        return "text";
+    case Opcode::BINARY:
+        return "binary";
+    case Opcode::CLOSE:
+        return "close";
+    case Opcode::PING:
+        return "ping";
+    case Opcode::PONG:
+        return "pong";
+    }
+    return "reserved";
+}
+
+auto ws::frame_header_length(uint8_t /* first_byte */, uint8_t second_byte) -> size_t {
+    size_t length = 2;
+    auto length_code = second_byte & 0x7F;
+    if (length_code == 126) {
+        length += 2;
+    } else if (length_code == 127) {
+        length += 8;
+    }
+    if ((second_byte & 0x80) != 0) {
+        length += 4;
+    }
+    return length;
+}
+
+auto ws::parse_frame_header(std::span<const uint8_t> data) -> FrameHeader {
+    VERIFY(data.size() >= 2 && data.size() >= frame_header_length(data[0], data[1]));
+
+    FrameHeader header;
+    header.fin = (data[0] & 0x80) != 0;
+    header.reserved = (data[0] >> 4) & 0x7;
+    header.opcode = static_cast<Opcode>(data[0] & 0x0F);
+    header.masked = (data[1] & 0x80) != 0;
+
+    size_t position = 2;
+    auto length_code = data[1] & 0x7F;
+    if (length_code == 126) {
+        header.payload_length = (uint64_t{data[2]} << 8) | data[3];
+        position += 2;
+    } else if (length_code == 127) {
+        for (size_t i = 0; i < 8; ++i) {
+            header.payload_length = (header.payload_length << 8) | data[position + i];
+        }
+        position += 8;
+    } else {
+        header.payload_length = length_code;
+    }
+
+    if (header.masked) {
+        std::memcpy(header.mask_key.data(), data.data() + position, header.mask_key.size());
+    }
+    return header;
+}
+
+auto ws::encoded_frame_header_length(const FrameHeader& header) -> size_t {
+    size_t length = 2;
+    if (header.payload_length > 0xFFFF) {
+        length += 8;
+    } else if (header.payload_length > 125) {
+        length += 2;
+    }
+    return header.masked ? length + 4 : length;
+}
+
+auto ws::write_frame_header(const FrameHeader& header, std::span<uint8_t> output) -> size_t {
+    VERIFY(output.size() >= encoded_frame_header_length(header));
+
+    auto* out = output.data();
+    *out++ = static_cast<uint8_t>((header.fin ? 0x80 : 0) | ((header.reserved & 0x7) << 4) |
+                                  static_cast<uint8_t>(header.opcode));
+    const uint8_t mask_bit = header.masked ? 0x80 : 0;
+    if (header.payload_length > 0xFFFF) {
+        *out++ = mask_bit | 127;
+        for (int shift = 56; shift >= 0; shift -= 8) {
+            *out++ = static_cast<uint8_t>(header.payload_length >> shift);
+        }
+    } else if (header.payload_length > 125) {
+        *out++ = mask_bit | 126;
+        *out++ = static_cast<uint8_t>(header.payload_length >> 8);
+        *out++ = static_cast<uint8_t>(header.payload_length);
+    } else {
+        *out++ = mask_bit | static_cast<uint8_t>(header.payload_length);
+    }
+    if (header.masked) {
+        std::memcpy(out, header.mask_key.data(), header.mask_key.size());
+        out += header.mask_key.size();
+    }
+    return static_cast<size_t>(out - output.data());
+}
+
+auto ws::write_frame(const FrameHeader& header, std::span<const uint8_t> payload, std::span<uint8_t> output)
+    -> size_t {
+    VERIFY(header.payload_length == payload.size());
+    auto header_length = write_frame_header(header, output);
+    VERIFY(output.size() >= header_length + payload.size());
+    unmask_payload(header, payload, output.subspan(header_length), 0);
+    return header_length + payload.size();
+}
+
+auto ws::make_frame(Opcode opcode, std::span<const uint8_t> payload) -> common::SharedBuffer {
+    FrameHeader header{.opcode = opcode, .payload_length = payload.size()};
+    auto frame_length = encoded_frame_header_length(header) + payload.size();
+    return common::SharedBuffer::create(frame_length, [&](std::span<uint8_t> frame) {
+        write_frame(header, payload, frame);
+    });
+}
+
+auto ws::unmask_payload(const FrameHeader& header,
+                        std::span<const uint8_t> input,
+                        std::span<uint8_t> output,
+                        uint64_t payload_offset) -> void {
+    if (header.masked) {
+        masking::apply_mask(input, output, header.mask_key, static_cast<size_t>(payload_offset & 3));
+    } else if (input.data() != output.data()) {
+        VERIFY(output.size() >= input.size());
+        std::memcpy(output.data(), input.data(), input.size());
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "../Common/SharedBuffer.h"
+#include "Masking.h"
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace ws {
+
+enum class Opcode : uint8_t {
+    CONTINUATION = 0x0,
+    TEXT = 0x1,
+    BINARY = 0x2,
+    CLOSE = 0x8,
+    PING = 0x9,
+    PONG = 0xA,
+};
+
+auto format_opcode(Opcode opcode) -> std::string_view;
+
+constexpr auto is_control_opcode(Opcode opcode) -> bool {
+    return (static_cast<uint8_t>(opcode) & 0x8) != 0;
+}
+
+// status codes sent in close frames (RFC 6455 section 7.4.1)
+enum class CloseCode : uint16_t {
+    NORMAL = 1000,
+    GOING_AWAY = 1001,
+    PROTOCOL_ERROR = 1002,
+    UNSUPPORTED_DATA = 1003,
+    NO_STATUS = 1005,
+    INVALID_PAYLOAD = 1007,
+    POLICY_VIOLATION = 1008,
+    MESSAGE_TOO_BIG = 1009,
+    INTERNAL_ERROR = 1011,
+};
+
+// control frames must fit a 7-bit payload length (RFC 6455 section 5.5)
+constexpr size_t MAX_CONTROL_PAYLOAD_SIZE = 125;
+// 2 fixed bytes, up to 8 bytes of extended payload length and the mask key
+constexpr size_t MAX_FRAME_HEADER_SIZE = 14;
+
+struct FrameHeader {
+    bool fin{true};
+    // RSV1-3 in the low bits; non-zero only with negotiated extensions
+    uint8_t reserved{0};
+    Opcode opcode{Opcode::BINARY};
+    bool masked{false};
+    masking::MaskKey mask_key{};
+    uint64_t payload_length{0};
+};
+
+// Returns the length of a frame header given its first two bytes.
+auto frame_header_length(uint8_t first_byte, uint8_t second_byte) -> size_t;
+
+// Parses a frame header from data, which must hold at least
+// frame_header_length() bytes. Only decodes; the caller validates.
+auto parse_frame_header(std::span<const uint8_t> data) -> FrameHeader;
+
+// Returns the encoded length of given header.
+auto encoded_frame_header_length(const FrameHeader& header) -> size_t;
+
+// Writes the header into output which must hold at least
+// encoded_frame_header_length() bytes. Returns the number of bytes written.
+auto write_frame_header(const FrameHeader& header, std::span<uint8_t> output) -> size_t;
+
+// Writes a complete frame with given payload into output, masking the
+// payload when the header says so. Returns the number of bytes written.
+auto write_frame(const FrameHeader& header, std::span<const uint8_t> payload, std::span<uint8_t> output) -> size_t;
+
+// Encodes a single unmasked, unfragmented frame (as sent by servers) into a
+// shared buffer that can be queued on any number of connections.
+auto make_frame(Opcode opcode, std::span<const uint8_t> payload) -> common::SharedBuffer;
+
+// Unmasks a slice of a masked frame's payload from input into output (which
+// may be input itself). payload_offset is the position of the slice within
+// the payload. Unmasked frames are copied as is.
+auto unmask_payload(const FrameHeader& header,
+                    std::span<const uint8_t> input,
+                    std::span<uint8_t> output,
+                    uint64_t payload_offset) -> void;
+
+} // namespace ws
@@ -0,0 +1,180 @@
+#include "FrameDecoder.h"
+#include <algorithm>
+#include <cstring>
+
+using namespace common;
+using namespace ws;
+
+static auto is_known_opcode(Opcode opcode) -> bool {
+    switch (opcode) {
+    case Opcode::CONTINUATION:
+    case Opcode::TEXT:
+    case Opcode::BINARY:
+    case Opcode::CLOSE:
+    case Opcode::PING:
+    case Opcode::PONG:
+        return true;
+    }
+    return false;
+}
+
+auto FrameDecoder::reset() -> void {
+    state_ = State::HEADER;
+    close_code_ = CloseCode::NORMAL;
+    header_size_ = 0;
+    frame_ = {};
+    payload_offset_ = 0;
+    message_in_progress_ = false;
+    message_size_ = 0;
+}
+
+auto FrameDecoder::fail(CloseCode close_code, const char* message) -> Error {
+    state_ = State::FAILED;
+    close_code_ = close_code;
+    return Error::from_string(message, ErrorDomain::NET);
+}
+
+auto FrameDecoder::decode(std::span<uint8_t> data, Handler& handler) -> ErrorOr<void> {
+    while (!data.empty()) {
+        switch (state_) {
+        case State::HEADER:
+            data = data.subspan(TRY(decode_header(data)));
+            // a frame without payload is complete as soon as its header is
+            if (state_ == State::PAYLOAD && frame_.payload_length == 0) {
+                TRY(end_frame(handler));
+            }
+            break;
+        case State::PAYLOAD:
+            data = data.subspan(TRY(decode_payload(data, handler)));
+            break;
+        case State::CLOSED:
+            return {};
+        case State::FAILED:
+            return {Error::from_string("decoding after a protocol error", ErrorDomain::NET)};
+        }
+    }
+    return {};
+}
+
+auto FrameDecoder::decode_header(std::span<const uint8_t> data) -> ErrorOr<size_t> {
+    // fast path: the whole header is in this read
+    if (header_size_ == 0 && data.size() >= 2) {
+        auto header_length = frame_header_length(data[0], data[1]);
+        if (data.size() >= header_length) {
+            TRY(begin_frame(parse_frame_header(data)));
+            return header_length;
+        }
+    }
+
+    size_t consumed = 0;
+    auto needed = header_size_ < 2 ? size_t{2} : frame_header_length(header_bytes_[0], header_bytes_[1]);
+    while (consumed < data.size()) {
+        auto count = std::min(needed - header_size_, data.size() - consumed);
+        std::memcpy(header_bytes_.data() + header_size_, data.data() + consumed, count);
+        header_size_ += count;
+        consumed += count;
+        if (header_size_ < needed) {
+            break;
+        }
+        if (header_size_ == 2) {
+            needed = frame_header_length(header_bytes_[0], header_bytes_[1]);
+            if (needed > header_size_) {
+                continue;
+            }
+        }
+        auto header = parse_frame_header(std::span<const uint8_t>(header_bytes_.data(), header_size_));
+        header_size_ = 0;
+        TRY(begin_frame(header));
+        break;
+    }
+    return consumed;
+}
+
+auto FrameDecoder::begin_frame(const FrameHeader& header) -> ErrorOr<void> {
+    if (header.reserved != 0) {
+        return {fail(CloseCode::PROTOCOL_ERROR, "frame has reserved bits set")};
+    }
+    if (!is_known_opcode(header.opcode)) {
+        return {fail(CloseCode::PROTOCOL_ERROR, "frame has a reserved opcode")};
+    }
+    if (require_masked_ && !header.masked) {
+        return {fail(CloseCode::PROTOCOL_ERROR, "client frame is not masked")};
+    }
+    if ((header.payload_length >> 63) != 0) {
+        return {fail(CloseCode::PROTOCOL_ERROR, "frame payload length has the most significant bit set")};
+    }
+
+    if (is_control_opcode(header.opcode)) {
+        if (!header.fin) {
+            return {fail(CloseCode::PROTOCOL_ERROR, "control frame is fragmented")};
+        }
+        if (header.payload_length > MAX_CONTROL_PAYLOAD_SIZE) {
+            return {fail(CloseCode::PROTOCOL_ERROR, "control frame payload is too large")};
+        }
+    } else if (header.opcode == Opcode::CONTINUATION) {
+        if (!message_in_progress_) {
+            return {fail(CloseCode::PROTOCOL_ERROR, "continuation frame without a message in progress")};
+        }
+    } else {
+        if (message_in_progress_) {
+            return {fail(CloseCode::PROTOCOL_ERROR, "new data frame while a fragmented message is in progress")};
+        }
+        message_in_progress_ = true;
+        message_opcode_ = header.opcode;
+        message_size_ = 0;
+    }
+
+    if (!is_control_opcode(header.opcode)) {
+        message_size_ += header.payload_length;
+        if (message_size_ > max_message_size_) {
+            return {fail(CloseCode::MESSAGE_TOO_BIG, "message is too large")};
+        }
+    }
+
+    frame_ = header;
+    payload_offset_ = 0;
+    state_ = State::PAYLOAD;
+    return {};
+}
+
+auto FrameDecoder::decode_payload(std::span<uint8_t> data, Handler& handler) -> ErrorOr<size_t> {
+    auto remaining = frame_.payload_length - payload_offset_;
+    auto count = static_cast<size_t>(std::min<uint64_t>(remaining, data.size()));
+    auto slice = data.first(count);
+
+    if (is_control_opcode(frame_.opcode)) {
+        auto destination = std::span<uint8_t>(control_payload_).subspan(static_cast<size_t>(payload_offset_), count);
+        unmask_payload(frame_, slice, destination, payload_offset_);
+        payload_offset_ += count;
+    } else {
+        unmask_payload(frame_, slice, slice, payload_offset_);
+        payload_offset_ += count;
+        auto message_complete = frame_.fin && payload_offset_ == frame_.payload_length;
+        if (message_complete) {
+            message_in_progress_ = false;
+        }
+        TRY(handler.on_message_data(message_opcode_, slice, message_complete));
+    }
+
+    if (payload_offset_ == frame_.payload_length) {
+        TRY(end_frame(handler));
+    }
+    return count;
+}
+
+auto FrameDecoder::end_frame(Handler& handler) -> ErrorOr<void> {
+    state_ = State::HEADER;
+    if (is_control_opcode(frame_.opcode)) {
+        auto payload = std::span<const uint8_t>(control_payload_.data(), static_cast<size_t>(frame_.payload_length));
+        if (frame_.opcode == Opcode::CLOSE) {
+            // nothing may follow a close frame
+            state_ = State::CLOSED;
+        }
+        TRY(handler.on_control_frame(frame_.opcode, payload));
+    } else if (frame_.fin && message_in_progress_) {
+        // final frame without payload
+        message_in_progress_ = false;
+        TRY(handler.on_message_data(message_opcode_, {}, true));
+    }
+    return {};
+}
@@ -0,0 +1,94 @@
+#pragma once
+
+#include "../Common/Error.h"
+#include "FrameCodec.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace ws {
+
+// FrameDecoder is a resumable RFC 6455 frame decoder. It is fed whatever
+// the socket returned, keeps its state across partial reads and hands data
+// message payloads to its handler slice by slice as they arrive, unmasked
+// in place in the caller's buffer. Nothing is buffered except partial frame
+// headers and control frame payloads, both of which have a small fixed
+// maximum size, so memory per connection stays bounded however large a
+// message is and decoding never allocates.
+class FrameDecoder final {
+public:
+    class Handler {
+    public:
+        virtual ~Handler() = default;
+
+        // Called with consecutive slices of a data message's payload. opcode
+        // is the opcode of the message's first frame (TEXT or BINARY) and
+        // message_complete is set on the last slice; an empty final frame
+        // results in an empty slice with message_complete set.
+        virtual auto on_message_data(Opcode opcode, std::span<const uint8_t> data, bool message_complete)
+            -> common::ErrorOr<void> = 0;
+
+        // Called once a control frame has arrived in full. Control frames
+        // may arrive between the frames of a fragmented message.
+        virtual auto on_control_frame(Opcode opcode, std::span<const uint8_t> payload) -> common::ErrorOr<void> = 0;
+    };
+
+    static constexpr uint64_t DEFAULT_MAX_MESSAGE_SIZE = 1024 * 1024;
+
+    // Frames from clients must be masked (RFC 6455 section 5.1); decoding
+    // frames sent by a server needs require_masked set to false.
+    explicit FrameDecoder(uint64_t max_message_size = DEFAULT_MAX_MESSAGE_SIZE, bool require_masked = true) :
+        max_message_size_(max_message_size),
+        require_masked_(require_masked) {}
+
+    // Decodes given bytes, unmasking payloads in place. After an error the
+    // decoder stays failed and close_code() tells what to send the peer.
+    // Bytes following a close frame are ignored.
+    auto decode(std::span<uint8_t> data, Handler& handler) -> common::ErrorOr<void>;
+
+    auto reset() -> void;
+
+    [[nodiscard]] auto is_failed() const -> bool { return state_ == State::FAILED; }
+    [[nodiscard]] auto is_closed() const -> bool { return state_ == State::CLOSED; }
+    [[nodiscard]] auto close_code() const -> CloseCode { return close_code_; }
+    [[nodiscard]] auto is_message_in_progress() const -> bool { return message_in_progress_; }
+
+private:
+    enum class State : int {
+        HEADER = 1,
+        PAYLOAD = 2,
+        CLOSED = 3,
+        FAILED = 4,
+    };
+
+    // Consumes header bytes; returns the number of bytes consumed.
+    auto decode_header(std::span<const uint8_t> data) -> common::ErrorOr<size_t>;
+    auto begin_frame(const FrameHeader& header) -> common::ErrorOr<void>;
+    // Consumes payload bytes; returns the number of bytes consumed.
+    auto decode_payload(std::span<uint8_t> data, Handler& handler) -> common::ErrorOr<size_t>;
+    auto end_frame(Handler& handler) -> common::ErrorOr<void>;
+    auto fail(CloseCode close_code, const char* message) -> common::Error;
+
+    uint64_t max_message_size_;
+    bool require_masked_;
+
+    State state_{State::HEADER};
+    CloseCode close_code_{CloseCode::NORMAL};
+
+    // a header split across reads is collected here
+    std::array<uint8_t, MAX_FRAME_HEADER_SIZE> header_bytes_{};
+    size_t header_size_{0};
+
+    FrameHeader frame_{};
+    uint64_t payload_offset_{0};
+
+    bool message_in_progress_{false};
+    Opcode message_opcode_{Opcode::BINARY};
+    uint64_t message_size_{0};
+
+    // control frames are delivered whole; their payload is tiny
+    std::array<uint8_t, MAX_CONTROL_PAYLOAD_SIZE> control_payload_{};
+};
+
+} // namespace ws
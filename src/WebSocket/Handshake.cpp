@@ -0,0 +1,99 @@
+#include "Handshake.h"
+#include "../Common/Base64.h"
+#include "../Common/Sha1.h"
+#include <cstring>
+
+using namespace common;
+using namespace ws;
+
+static constexpr std::string_view WEBSOCKET_GUID = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+// RFC 6455 keys are base64 encoded 16 byte nonces
+static constexpr size_t CLIENT_KEY_LENGTH = 24;
+
+auto handshake::compute_accept_key(std::string_view client_key) -> AcceptKey {
+    // concatenate on the stack; with a valid key this is exactly 60 bytes
+    std::array<uint8_t, 128> message;
+    VERIFY(client_key.size() + WEBSOCKET_GUID.size() <= message.size());
+    std::memcpy(message.data(), client_key.data(), client_key.size());
+    std::memcpy(message.data() + client_key.size(), WEBSOCKET_GUID.data(), WEBSOCKET_GUID.size());
+
+    auto digest = Sha1::digest(std::span(message.data(), client_key.size() + WEBSOCKET_GUID.size()));
+
+    AcceptKey accept_key;
+    static_assert(base64::encoded_length(Sha1::DIGEST_SIZE) == ACCEPT_KEY_LENGTH);
+    base64::encode(digest, accept_key);
+    return accept_key;
+}
+
+auto handshake::is_unsupported_version(const HttpRequestParser& request) -> bool {
+    auto version = request.header("Sec-WebSocket-Version");
+    return !version.empty() && version != "13";
+}
+
+auto handshake::validate_upgrade_request(const HttpRequestParser& request) -> ErrorOr<std::string_view> {
+    if (request.method() != "GET") {
+        return {Error::from_string("WebSocket handshake requires GET method", ErrorDomain::NET)};
+    }
+    if (request.version() != "HTTP/1.1") {
+        return {Error::from_string("WebSocket handshake requires HTTP/1.1", ErrorDomain::NET)};
+    }
+    if (request.header("Host").empty()) {
+        return {Error::from_string("WebSocket handshake is missing Host header", ErrorDomain::NET)};
+    }
+    if (!contains_token(request.header("Upgrade"), "websocket")) {
+        return {Error::from_string("WebSocket handshake is missing Upgrade: websocket", ErrorDomain::NET)};
+    }
+    if (!contains_token(request.header("Connection"), "upgrade")) {
+        return {Error::from_string("WebSocket handshake is missing Connection: Upgrade", ErrorDomain::NET)};
+    }
+    if (request.header("Sec-WebSocket-Version") != "13") {
+        return {Error::from_string("WebSocket handshake requires Sec-WebSocket-Version 13", ErrorDomain::NET)};
+    }
+
+    auto client_key = request.header("Sec-WebSocket-Key");
+    std::array<uint8_t, 16> nonce;
+    auto nonce_length = base64::decode(client_key, nonce);
+    if (client_key.size() != CLIENT_KEY_LENGTH || !nonce_length.has_value() || nonce_length.value() != nonce.size()) {
+        return {Error::from_string("WebSocket handshake has an invalid Sec-WebSocket-Key", ErrorDomain::NET)};
+    }
+    return client_key;
+}
+
+auto handshake::select_wire_format(const HttpRequestParser& request) -> std::optional<WireFormat> {
+    auto subprotocols = request.header("Sec-WebSocket-Protocol");
+    for (auto wire_format : {WireFormat::BINARY, WireFormat::JSON}) {
+        if (contains_token(subprotocols, format_wire_format(wire_format))) {
+            return wire_format;
+        }
+    }
+    return std::nullopt;
+}
+
+auto handshake::write_accept_response(const AcceptKey& accept_key, std::span<char> output, std::string_view subprotocol)
+    -> size_t {
+    static constexpr std::string_view head = "HTTP/1.1 101 Switching Protocols\r\n"
+                                             "Upgrade: websocket\r\n"
+                                             "Connection: Upgrade\r\n"
+                                             "Sec-WebSocket-Accept: ";
+    static constexpr std::string_view protocol_header = "\r\nSec-WebSocket-Protocol: ";
+    static constexpr std::string_view tail = "\r\n\r\n";
+    static_assert(head.size() + ACCEPT_KEY_LENGTH + protocol_header.size() + MAX_SUBPROTOCOL_LENGTH + tail.size() <=
+                  MAX_RESPONSE_SIZE);
+    VERIFY(output.size() >= MAX_RESPONSE_SIZE);
+    VERIFY(subprotocol.size() <= MAX_SUBPROTOCOL_LENGTH);
+
+    auto* out = output.data();
+    auto append = [&out](std::string_view string) {
+        std::memcpy(out, string.data(), string.size());
+        out += string.size();
+    };
+    append(head);
+    append({accept_key.data(), accept_key.size()});
+    if (!subprotocol.empty()) {
+        append(protocol_header);
+        append(subprotocol);
+    }
+    append(tail);
+    return static_cast<size_t>(out - output.data());
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "../Common/BufferPool.h"
+#include "../Common/Error.h"
+#include "HttpRequestParser.h"
+#include "WireFormat.h"
+#include <array>
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <string_view>
+
+namespace ws::handshake {
+
+// requests with a longer head are rejected; a request is collected in a
+// chunk of the buffer pool along with the parser reading it
+constexpr size_t MAX_REQUEST_SIZE = common::buffer_pool::CHUNK_SIZE - sizeof(HttpRequestParser);
+
+constexpr size_t ACCEPT_KEY_LENGTH = 28;
+using AcceptKey = std::array<char, ACCEPT_KEY_LENGTH>;
+
+// large enough for any response written by write_accept_response()
+constexpr size_t MAX_RESPONSE_SIZE = 256;
+constexpr size_t MAX_SUBPROTOCOL_LENGTH = 32;
+
+constexpr std::string_view BAD_REQUEST_RESPONSE = "HTTP/1.1 400 Bad Request\r\n"
+                                                  "Sec-WebSocket-Version: 13\r\n"
+                                                  "Content-Length: 0\r\n"
+                                                  "Connection: close\r\n\r\n";
+
+constexpr std::string_view UPGRADE_REQUIRED_RESPONSE = "HTTP/1.1 426 Upgrade Required\r\n"
+                                                       "Upgrade: websocket\r\n"
+                                                       "Sec-WebSocket-Version: 13\r\n"
+                                                       "Content-Length: 0\r\n"
+                                                       "Connection: close\r\n\r\n";
+
+constexpr std::string_view REQUEST_TOO_LARGE_RESPONSE = "HTTP/1.1 431 Request Header Fields Too Large\r\n"
+                                                        "Content-Length: 0\r\n"
+                                                        "Connection: close\r\n\r\n";
+
+// Computes the Sec-WebSocket-Accept value for given Sec-WebSocket-Key, that
+// is base64(SHA-1(key + GUID)) as specified by RFC 6455 section 4.2.2.
+auto compute_accept_key(std::string_view client_key) -> AcceptKey;
+
+// Checks that a parsed request is a valid WebSocket upgrade request
+// (RFC 6455 section 4.2.1) and returns its Sec-WebSocket-Key. Callers answer
+// failures with BAD_REQUEST_RESPONSE, or with UPGRADE_REQUIRED_RESPONSE when
+// is_unsupported_version() holds.
+auto validate_upgrade_request(const HttpRequestParser& request) -> common::ErrorOr<std::string_view>;
+
+// Returns true when the request asks for a WebSocket version other than 13.
+auto is_unsupported_version(const HttpRequestParser& request) -> bool;
+
+// Returns the wire format to use for the connection given the subprotocols
+// the client offered in Sec-WebSocket-Protocol; the most compact one when
+// several are offered. Empty when the client offered none we speak.
+auto select_wire_format(const HttpRequestParser& request) -> std::optional<WireFormat>;
+
+// Writes the 101 Switching Protocols response into given buffer, which must
+// hold at least MAX_RESPONSE_SIZE bytes, confirming given subprotocol unless
+// it is empty. Returns the response length.
+auto write_accept_response(const AcceptKey& accept_key, std::span<char> output, std::string_view subprotocol = {})
+    -> size_t;
+
+} // namespace ws::handshake
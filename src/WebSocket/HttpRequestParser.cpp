@@ -0,0 +1,154 @@
+#include "HttpRequestParser.h"
+#include <cstring>
+
+using namespace ws;
+
+static inline auto to_lower(char c) -> char {
+    return (c >= 'A' && c <= 'Z') ? static_cast<char>(c - 'A' + 'a') : c;
+}
+
+static auto trim(std::string_view value) -> std::string_view {
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) {
+        value.remove_prefix(1);
+    }
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\t')) {
+        value.remove_suffix(1);
+    }
+    return value;
+}
+
+// RFC 9110 token characters
+static auto is_token_char(char c) -> bool {
+    if ((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9')) {
+        return true;
+    }
+    return c != 0 && std::strchr("!#$%&'*+-.^_`|~", c) != nullptr;
+}
+
+auto ws::equals_ignore_case(std::string_view lhs, std::string_view rhs) -> bool {
+    if (lhs.size() != rhs.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < lhs.size(); ++i) {
+        if (to_lower(lhs[i]) != to_lower(rhs[i])) {
+            return false;
+        }
+    }
+    return true;
+}
+
+auto ws::contains_token(std::string_view header_value, std::string_view token) -> bool {
+    while (!header_value.empty()) {
+        auto comma = header_value.find(',');
+        auto element = trim(header_value.substr(0, comma));
+        if (equals_ignore_case(element, token)) {
+            return true;
+        }
+        if (comma == std::string_view::npos) {
+            break;
+        }
+        header_value.remove_prefix(comma + 1);
+    }
+    return false;
+}
+
+auto HttpRequestParser::reset() -> void {
+    *this = HttpRequestParser{};
+}
+
+auto HttpRequestParser::header(std::string_view name) const -> std::string_view {
+    for (size_t i = 0; i < header_count_; ++i) {
+        if (equals_ignore_case(headers_[i].name, name)) {
+            return headers_[i].value;
+        }
+    }
+    return {};
+}
+
+auto HttpRequestParser::parse(std::string_view buffer) -> Status {
+    if (status_ != Status::INCOMPLETE) {
+        return status_;
+    }
+
+    while (true) {
+        auto* begin = buffer.data() + scan_position_;
+        auto* line_feed = static_cast<const char*>(std::memchr(begin, '\n', buffer.size() - scan_position_));
+        if (line_feed == nullptr) {
+            // don't search the same bytes again on the next call
+            scan_position_ = buffer.size();
+            return status_;
+        }
+
+        auto line_end = static_cast<size_t>(line_feed - buffer.data());
+        auto line = buffer.substr(line_start_, line_end - line_start_);
+        // lines end with CRLF; a bare LF is tolerated (RFC 9112 section 2.2)
+        if (!line.empty() && line.back() == '\r') {
+            line.remove_suffix(1);
+        }
+        line_start_ = line_end + 1;
+        scan_position_ = line_start_;
+
+        if (!request_line_parsed_) {
+            if (line.empty()) {
+                // empty lines before the request line are ignored
+                continue;
+            }
+            if (!parse_request_line(line)) {
+                return status_ = Status::INVALID;
+            }
+            request_line_parsed_ = true;
+            continue;
+        }
+
+        if (line.empty()) {
+            return status_ = Status::COMPLETE;
+        }
+        if (!parse_header_line(line)) {
+            return status_ = Status::INVALID;
+        }
+    }
+}
+
+auto HttpRequestParser::parse_request_line(std::string_view line) -> bool {
+    auto first_space = line.find(' ');
+    if (first_space == std::string_view::npos || first_space == 0) {
+        return false;
+    }
+    auto second_space = line.find(' ', first_space + 1);
+    if (second_space == std::string_view::npos || second_space == first_space + 1) {
+        return false;
+    }
+
+    method_ = line.substr(0, first_space);
+    target_ = line.substr(first_space + 1, second_space - first_space - 1);
+    version_ = line.substr(second_space + 1);
+
+    for (auto c : method_) {
+        if (!is_token_char(c)) {
+            return false;
+        }
+    }
+    return version_.size() == 8 && version_.starts_with("HTTP/");
+}
+
+auto HttpRequestParser::parse_header_line(std::string_view line) -> bool {
+    if (line.front() == ' ' || line.front() == '\t') {
+        // obsolete line folding is not accepted (RFC 9112 section 5.2)
+        return false;
+    }
+    auto colon = line.find(':');
+    if (colon == std::string_view::npos || colon == 0) {
+        return false;
+    }
+    auto name = line.substr(0, colon);
+    for (auto c : name) {
+        if (!is_token_char(c)) {
+            return false;
+        }
+    }
+    if (header_count_ == MAX_HEADERS) {
+        return false;
+    }
+    headers_[header_count_++] = {name, trim(line.substr(colon + 1))};
+    return true;
+}
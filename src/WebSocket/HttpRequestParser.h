@@ -0,0 +1,77 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace ws {
+
+struct HttpHeader {
+    std::string_view name;
+    std::string_view value;
+};
+
+// HttpRequestParser parses the head (request line and headers) of an
+// HTTP/1.1 request incrementally and in place. It never copies or allocates;
+// the parsed method, target and headers are views into the caller's buffer.
+//
+// The caller appends received bytes to a buffer that must not move while
+// parsing and passes the whole buffer to parse() after every read. The
+// parser resumes from where it stopped, so a request split across any number
+// of reads is scanned only once.
+class HttpRequestParser final {
+public:
+    static constexpr size_t MAX_HEADERS = 32;
+
+    enum class Status : int {
+        INCOMPLETE = 1,
+        COMPLETE = 2,
+        INVALID = 3,
+    };
+
+    auto parse(std::string_view buffer) -> Status;
+    auto reset() -> void;
+
+    [[nodiscard]] auto status() const -> Status { return status_; }
+    [[nodiscard]] auto method() const -> std::string_view { return method_; }
+    [[nodiscard]] auto target() const -> std::string_view { return target_; }
+    [[nodiscard]] auto version() const -> std::string_view { return version_; }
+    [[nodiscard]] auto header_count() const -> size_t { return header_count_; }
+    [[nodiscard]] auto header(size_t index) const -> const HttpHeader& { return headers_[index]; }
+
+    // Returns the value of the first header with given name compared case
+    // insensitively, or an empty view when there is none.
+    [[nodiscard]] auto header(std::string_view name) const -> std::string_view;
+
+    // Number of bytes making up the request head including the terminating
+    // empty line. Anything after that in the buffer belongs to the next
+    // protocol layer. Only meaningful once parse() returned COMPLETE.
+    [[nodiscard]] auto head_length() const -> size_t { return line_start_; }
+
+private:
+    auto parse_request_line(std::string_view line) -> bool;
+    auto parse_header_line(std::string_view line) -> bool;
+
+    Status status_{Status::INCOMPLETE};
+    // start of the first line not parsed yet
+    size_t line_start_{0};
+    // position up to which the current line has been searched for its end
+    size_t scan_position_{0};
+    bool request_line_parsed_{false};
+
+    std::string_view method_;
+    std::string_view target_;
+    std::string_view version_;
+    std::array<HttpHeader, MAX_HEADERS> headers_{};
+    size_t header_count_{0};
+};
+
+// Returns true when given characters are equal ignoring ASCII case.
+auto equals_ignore_case(std::string_view lhs, std::string_view rhs) -> bool;
+
+// Returns true when a comma separated header value such as "keep-alive,
+// Upgrade" contains given token, compared case insensitively.
+auto contains_token(std::string_view header_value, std::string_view token) -> bool;
+
+} // namespace ws
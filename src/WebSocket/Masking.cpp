@@ -0,0 +1,169 @@
+#include "Masking.h"
+#include "../Common/Assertions.h"
+#include <cstring>
+
+#ifdef COMMON_SIMD_X86
+#include <immintrin.h>
+#endif
+
+using namespace common;
+using namespace ws;
+using namespace ws::masking;
+
+using MaskFunction = void (*)(const uint8_t* input, uint8_t* output, size_t length, uint32_t key);
+
+// Returns the key as a native endian word whose first byte in memory is the
+// key byte for given payload offset.
+static auto rotated_key(const MaskKey& key, size_t key_offset) -> uint32_t {
+    std::array<uint8_t, 4> rotated{};
+    for (size_t i = 0; i < rotated.size(); ++i) {
+        rotated[i] = key[(key_offset + i) & 3];
+    }
+    uint32_t word;
+    std::memcpy(&word, rotated.data(), sizeof(word));
+    return word;
+}
+
+static auto mask_bytes(const uint8_t* input, uint8_t* output, size_t length, uint32_t key) -> void {
+    uint8_t key_bytes[4];
+    std::memcpy(key_bytes, &key, sizeof(key));
+    for (size_t i = 0; i < length; ++i) {
+        output[i] = input[i] ^ key_bytes[i & 3];
+    }
+}
+
+static auto mask_scalar(const uint8_t* input, uint8_t* output, size_t length, uint32_t key) -> void {
+    const uint64_t key64 = (static_cast<uint64_t>(key) << 32) | key;
+    size_t i = 0;
+    for (; i + 8 <= length; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, input + i, sizeof(word));
+        word ^= key64;
+        std::memcpy(output + i, &word, sizeof(word));
+    }
+    mask_bytes(input + i, output + i, length - i, key);
+}
+
+#ifdef COMMON_SIMD_X86
+
+// Advances a rotated key past given number of payload bytes.
+static auto advance_key(uint32_t key, size_t bytes) -> uint32_t {
+    auto shift = static_cast<unsigned>((bytes & 3) * 8);
+    if (shift == 0) {
+        return key;
+    }
+    // on little endian the byte first in memory is the least significant one
+    return (key >> shift) | (key << (32 - shift));
+}
+
+// payloads shorter than this are masked with unaligned stores only; the
+// bytewise head would cost more than the aligned stores save
+static constexpr size_t ALIGN_THRESHOLD = 256;
+
+// Masks bytes one at a time until output is aligned to given vector width.
+// Returns the number of bytes handled.
+static auto mask_head(const uint8_t* input, uint8_t* output, size_t length, uint32_t key, size_t alignment) -> size_t {
+    if (length < ALIGN_THRESHOLD) {
+        return 0;
+    }
+    auto misalignment = reinterpret_cast<uintptr_t>(output) & (alignment - 1);
+    auto head = misalignment == 0 ? 0 : alignment - misalignment;
+    mask_bytes(input, output, head, key);
+    return head;
+}
+
+__attribute__((target("sse2"))) static auto mask_sse2(const uint8_t* input,
+                                                      uint8_t* output,
+                                                      size_t length,
+                                                      uint32_t key) -> void {
+    auto i = mask_head(input, output, length, key, 16);
+    key = advance_key(key, i);
+
+    const __m128i key128 = _mm_set1_epi32(static_cast<int>(key));
+    for (; i + 64 <= length; i += 64) {
+        auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+        auto b = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i + 16));
+        auto c = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i + 32));
+        auto d = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i + 48));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_xor_si128(a, key128));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i + 16), _mm_xor_si128(b, key128));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i + 32), _mm_xor_si128(c, key128));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i + 48), _mm_xor_si128(d, key128));
+    }
+    for (; i + 16 <= length; i += 16) {
+        auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_xor_si128(a, key128));
+    }
+    mask_scalar(input + i, output + i, length - i, key);
+}
+
+__attribute__((target("avx2"))) static auto mask_avx2(const uint8_t* input,
+                                                      uint8_t* output,
+                                                      size_t length,
+                                                      uint32_t key) -> void {
+    auto i = mask_head(input, output, length, key, 32);
+    key = advance_key(key, i);
+
+    const __m256i key256 = _mm256_set1_epi32(static_cast<int>(key));
+    for (; i + 128 <= length; i += 128) {
+        auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i));
+        auto b = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i + 32));
+        auto c = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i + 64));
+        auto d = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i + 96));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), _mm256_xor_si256(a, key256));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i + 32), _mm256_xor_si256(b, key256));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i + 64), _mm256_xor_si256(c, key256));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i + 96), _mm256_xor_si256(d, key256));
+    }
+    for (; i + 32 <= length; i += 32) {
+        auto a = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(input + i));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(output + i), _mm256_xor_si256(a, key256));
+    }
+    // at most 31 bytes left; finish them with 16 byte vectors
+    const __m128i key128 = _mm256_castsi256_si128(key256);
+    if (i + 16 <= length) {
+        auto a = _mm_loadu_si128(reinterpret_cast<const __m128i*>(input + i));
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(output + i), _mm_xor_si128(a, key128));
+        i += 16;
+    }
+    mask_scalar(input + i, output + i, length - i, key);
+}
+
+#endif
+
+static auto mask_function(Implementation implementation) -> MaskFunction {
+    switch (implementation) {
+    case Implementation::SCALAR:
+        return mask_scalar;
+#ifdef COMMON_SIMD_X86
+    case Implementation::SSE2:
+        return mask_sse2;
+    case Implementation::AVX2:
+        return mask_avx2;
+#else
+    case Implementation::SSE2:
+    case Implementation::AVX2:
+        break;
+#endif
+    }
+    VERIFY_NOT_REACHED();
+}
+
+auto masking::apply_mask(std::span<const uint8_t> input,
+                         std::span<uint8_t> output,
+                         const MaskKey& key,
+                         size_t key_offset) -> void {
+    static const MaskFunction function = mask_function(simd::best_implementation());
+    VERIFY(output.size() >= input.size());
+    function(input.data(), output.data(), input.size(), rotated_key(key, key_offset));
+}
+
+auto masking::apply_mask_using(Implementation implementation,
+                               std::span<const uint8_t> input,
+                               std::span<uint8_t> output,
+                               const MaskKey& key,
+                               size_t key_offset) -> void {
+    VERIFY(simd::is_supported(implementation));
+    VERIFY(output.size() >= input.size());
+    mask_function(implementation)(input.data(), output.data(), input.size(), rotated_key(key, key_offset));
+}
@@ -0,0 +1,37 @@
+#pragma once
+
+#include "../Common/Simd.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+
+namespace ws::masking {
+
+// The 4-byte key client-to-server frame payloads are XOR-masked with
+// (RFC 6455 section 5.3).
+using MaskKey = std::array<uint8_t, 4>;
+
+using common::simd::Implementation;
+
+// XORs input with the mask key into output, which may be the same memory as
+// input but must not otherwise overlap it. key_offset is the position of the
+// first byte within the payload, which lets a payload arriving in pieces be
+// unmasked piece by piece. Works on any length and alignment.
+auto apply_mask(std::span<const uint8_t> input, std::span<uint8_t> output, const MaskKey& key, size_t key_offset = 0)
+    -> void;
+
+// Masks or unmasks given data in place.
+inline auto apply_mask(std::span<uint8_t> data, const MaskKey& key, size_t key_offset = 0) -> void {
+    apply_mask(data, data, key, key_offset);
+}
+
+// Same as apply_mask() but with an explicitly chosen implementation, which
+// must be supported. For tests and benchmarks.
+auto apply_mask_using(Implementation implementation,
+                      std::span<const uint8_t> input,
+                      std::span<uint8_t> output,
+                      const MaskKey& key,
+                      size_t key_offset = 0) -> void;
+
+} // namespace ws::masking
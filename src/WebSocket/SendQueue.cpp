@@ -0,0 +1,269 @@
+#include "SendQueue.h"
+#include "../Common/Assertions.h"
+#include "../Common/BufferPool.h"
+#include <algorithm>
+#include <new>
+#include <utility>
+
+using namespace common;
+using namespace ws;
+
+auto ws::format_overflow_policy(OverflowPolicy policy) -> std::string_view {
+    switch (policy) {
+    case OverflowPolicy::CONFLATE:
+        return "conflate";
+    case OverflowPolicy::DROP_OLDEST:
+        return "drop-oldest";
+    case OverflowPolicy::DISCONNECT:
+        return "disconnect";
+    }
+    VERIFY_NOT_REACHED();
+}
+
+auto SendQueueStatistics::operator+=(const SendQueueStatistics& rhs) -> SendQueueStatistics& {
+    conflated += rhs.conflated;
+    dropped += rhs.dropped;
+    disconnected += rhs.disconnected;
+    return *this;
+}
+
+auto ws::snapshot(const SendQueueCounters& counters) -> SendQueueStatistics {
+    return {.conflated = counters.conflated.load(std::memory_order_relaxed),
+            .dropped = counters.dropped.load(std::memory_order_relaxed),
+            .disconnected = counters.disconnected.load(std::memory_order_relaxed)};
+}
+
+auto SendQueue::push_control(SharedBuffer buffer) -> bool {
+    if (buffer.is_empty()) {
+        return true;
+    }
+    if (control_bytes_ + buffer.size() > limits_.max_bytes) {
+        count(&SendQueueCounters::disconnected);
+        return false;
+    }
+    control_bytes_ += buffer.size();
+    append(std::move(buffer), NO_TOPIC, false, Clock::now());
+    return true;
+}
+
+auto SendQueue::push(SharedBuffer buffer, TopicId topic, Clock::time_point now) -> bool {
+    VERIFY(topic == NO_TOPIC || topic < MAX_TOPICS);
+    if (buffer.is_empty()) {
+        return true;
+    }
+
+    switch (limits_.policy) {
+    case OverflowPolicy::CONFLATE: {
+        auto* queued = conflation_target(topic);
+        auto replaced_bytes = queued == nullptr ? 0 : queued->buffer.size();
+        if (queued_bytes_ - replaced_bytes + buffer.size() > limits_.max_bytes) {
+            count(&SendQueueCounters::disconnected);
+            return false;
+        }
+        if (queued == nullptr) {
+            append(std::move(buffer), topic, true, now);
+            return true;
+        }
+        queued_bytes_ = queued_bytes_ - replaced_bytes + buffer.size();
+        // keeps its place in the queue and its age; only the bytes are newer
+        queued->buffer = std::move(buffer);
+        count(&SendQueueCounters::conflated);
+        return true;
+    }
+    case OverflowPolicy::DROP_OLDEST:
+        append(std::move(buffer), topic, true, now);
+        while (drop_oldest(now)) {
+            count(&SendQueueCounters::dropped);
+        }
+        return true;
+    case OverflowPolicy::DISCONNECT:
+        // a front message that has been waiting too long means the peer
+        // stopped reading
+        if (queued_bytes_ + buffer.size() > limits_.max_bytes ||
+            (!is_empty() && now - entries_.front().queued_at > limits_.max_age)) {
+            count(&SendQueueCounters::disconnected);
+            return false;
+        }
+        append(std::move(buffer), topic, true, now);
+        return true;
+    }
+    VERIFY_NOT_REACHED();
+}
+
+auto SendQueue::front() const -> std::span<const uint8_t> {
+    VERIFY(!is_empty());
+    return entries_.front().buffer.bytes().subspan(front_offset_);
+}
+
+auto SendQueue::on_sent(size_t bytes_sent) -> void {
+    front_offset_ += bytes_sent;
+    VERIFY(front_offset_ <= entries_.front().buffer.size());
+    if (front_offset_ == entries_.front().buffer.size()) {
+        pop_front();
+    }
+}
+
+auto SendQueue::append(SharedBuffer&& buffer, TopicId topic, bool droppable, Clock::time_point now) -> void {
+    queued_bytes_ += buffer.size();
+    ++message_count_;
+    entries_.push_back({.buffer = std::move(buffer), .queued_at = now, .topic = topic, .droppable = droppable});
+    if (topic != NO_TOPIC) {
+        entries_.latest_by_topic()[topic] = front_sequence_ + entries_.size() - 1;
+    }
+}
+
+auto SendQueue::conflation_target(TopicId topic) -> Entry* {
+    if (topic == NO_TOPIC || entries_.empty()) {
+        return nullptr;
+    }
+    auto sequence = entries_.latest_by_topic()[topic];
+    // the front message may already be on its way
+    if (sequence <= front_sequence_) {
+        return nullptr;
+    }
+    return &entry(sequence);
+}
+
+auto SendQueue::oldest_droppable() -> Entry* {
+    // the front message may already be on its way
+    drop_cursor_ = std::max(drop_cursor_, front_sequence_ + 1);
+    for (; drop_cursor_ < front_sequence_ + entries_.size(); ++drop_cursor_) {
+        auto& oldest = entry(drop_cursor_);
+        if (oldest.droppable && !oldest.dropped) {
+            return &oldest;
+        }
+    }
+    return nullptr;
+}
+
+auto SendQueue::drop_oldest(Clock::time_point now) -> bool {
+    auto* oldest = oldest_droppable();
+    if (oldest == nullptr) {
+        return false;
+    }
+    if (queued_bytes_ <= limits_.max_bytes && now - oldest->queued_at <= limits_.max_age) {
+        return false;
+    }
+    queued_bytes_ -= oldest->buffer.size();
+    --message_count_;
+    oldest->buffer = SharedBuffer();
+    oldest->dropped = true;
+    if (oldest->topic != NO_TOPIC && entries_.latest_by_topic()[oldest->topic] == drop_cursor_) {
+        entries_.latest_by_topic()[oldest->topic] = 0;
+    }
+    return true;
+}
+
+auto SendQueue::pop_front() -> void {
+    // dropped messages are skipped so that the front is always sendable
+    do {
+        auto& front = entries_.front();
+        if (!front.dropped) {
+            queued_bytes_ -= front.buffer.size();
+            control_bytes_ -= front.droppable ? 0 : front.buffer.size();
+            --message_count_;
+        }
+        entries_.pop_front();
+        ++front_sequence_;
+    } while (!entries_.empty() && entries_.front().dropped);
+    front_offset_ = 0;
+}
+
+auto SendQueue::count(std::atomic<uint64_t> SendQueueCounters::*counter) -> void {
+    if (counters_ != nullptr) {
+        // only the owning reactor thread writes; no read-modify-write needed
+        auto& value = counters_->*counter;
+        value.store(value.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+}
+
+SendQueue::Entries::Entries(Entries&& other) noexcept :
+    latest_by_topic_(std::exchange(other.latest_by_topic_, nullptr)),
+    slots_(std::exchange(other.slots_, nullptr)),
+    capacity_(std::exchange(other.capacity_, 0)),
+    head_(std::exchange(other.head_, 0)),
+    size_(std::exchange(other.size_, 0)) {}
+
+auto SendQueue::Entries::operator=(Entries&& rhs) noexcept -> Entries& {
+    if (this != &rhs) {
+        release();
+        latest_by_topic_ = std::exchange(rhs.latest_by_topic_, nullptr);
+        slots_ = std::exchange(rhs.slots_, nullptr);
+        capacity_ = std::exchange(rhs.capacity_, 0);
+        head_ = std::exchange(rhs.head_, 0);
+        size_ = std::exchange(rhs.size_, 0);
+    }
+    return *this;
+}
+
+auto SendQueue::Entries::push_back(Entry&& entry) -> void {
+    if (size_ == capacity_) {
+        grow();
+    }
+    new (&slots_[slot(size_)]) Entry(std::move(entry));
+    ++size_;
+}
+
+auto SendQueue::Entries::pop_front() -> void {
+    VERIFY(size_ > 0);
+    slots_[head_].~Entry();
+    head_ = head_ + 1 == capacity_ ? 0 : head_ + 1;
+    if (--size_ == 0) {
+        release();
+    }
+}
+
+// the first ring of a queue fills a chunk of the buffer pool, behind the
+// newest message per topic
+template <typename Entry>
+static constexpr size_t POOLED_CAPACITY =
+    (buffer_pool::CHUNK_SIZE - sizeof(std::array<uint64_t, MAX_TOPICS>)) / sizeof(Entry);
+
+template <typename Entry>
+static auto storage_size(size_t capacity) -> size_t {
+    return sizeof(std::array<uint64_t, MAX_TOPICS>) + capacity * sizeof(Entry);
+}
+
+template <typename Entry>
+static auto deallocate(void* storage, size_t capacity) -> void {
+    if (capacity == POOLED_CAPACITY<Entry>) {
+        buffer_pool::release(storage);
+    } else {
+        ::operator delete(storage);
+    }
+}
+
+auto SendQueue::Entries::grow() -> void {
+    static_assert(sizeof(LatestByTopic) % alignof(Entry) == 0);
+    auto capacity = capacity_ == 0 ? POOLED_CAPACITY<Entry> : capacity_ * 2;
+    auto* storage = capacity == POOLED_CAPACITY<Entry> ? buffer_pool::allocate()
+                                                       : ::operator new(storage_size<Entry>(capacity));
+    auto* latest_by_topic = new (storage) LatestByTopic(latest_by_topic_ == nullptr ? LatestByTopic{}
+                                                                                     : *latest_by_topic_);
+    auto* slots = reinterpret_cast<Entry*>(latest_by_topic + 1);
+    for (size_t index = 0; index < size_; ++index) {
+        auto& entry = (*this)[index];
+        new (&slots[index]) Entry(std::move(entry));
+        entry.~Entry();
+    }
+    if (latest_by_topic_ != nullptr) {
+        deallocate<Entry>(latest_by_topic_, capacity_);
+    }
+    latest_by_topic_ = latest_by_topic;
+    slots_ = slots;
+    capacity_ = capacity;
+    head_ = 0;
+}
+
+auto SendQueue::Entries::release() noexcept -> void {
+    if (latest_by_topic_ == nullptr) {
+        return;
+    }
+    for (size_t index = 0; index < size_; ++index) {
+        (*this)[index].~Entry();
+    }
+    deallocate<Entry>(std::exchange(latest_by_topic_, nullptr), std::exchange(capacity_, 0));
+    slots_ = nullptr;
+    head_ = 0;
+    size_ = 0;
+}
@@ -0,0 +1,194 @@
+#pragma once
+
+#include "../Common/SharedBuffer.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string_view>
+
+namespace ws {
+
+// Identifies the stream a broadcast message belongs to; conflation keeps
+// only the newest queued message per topic.
+using TopicId = uint8_t;
+constexpr TopicId NO_TOPIC = 0xFF;
+constexpr size_t MAX_TOPICS = 32;
+
+// What a send queue does once a connection falls behind.
+enum class OverflowPolicy : int {
+    // only the newest message per topic is kept queued; a connection whose
+    // queue still exceeds the byte budget is disconnected
+    CONFLATE = 1,
+    // the oldest messages are dropped until the queue fits its byte and age
+    // budgets again
+    DROP_OLDEST = 2,
+    // the connection is disconnected as soon as either budget is exceeded
+    DISCONNECT = 3,
+};
+
+auto format_overflow_policy(OverflowPolicy policy) -> std::string_view;
+
+struct SendQueueLimits {
+    OverflowPolicy policy{OverflowPolicy::CONFLATE};
+    size_t max_bytes{4 * 1024 * 1024};
+    std::chrono::milliseconds max_age{10000};
+};
+
+// How often the policies fired; shared by all queues of a reactor and
+// written only by the reactor thread, read by anyone.
+struct SendQueueCounters {
+    std::atomic<uint64_t> conflated{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint64_t> disconnected{0};
+};
+
+// Plain snapshot of SendQueueCounters, summable across reactors.
+struct SendQueueStatistics {
+    uint64_t conflated{0};
+    uint64_t dropped{0};
+    uint64_t disconnected{0};
+
+    auto operator+=(const SendQueueStatistics& rhs) -> SendQueueStatistics&;
+};
+
+auto snapshot(const SendQueueCounters& counters) -> SendQueueStatistics;
+
+// SendQueue is the bounded outbound queue of a connection. Broadcast
+// messages are subject to the overflow policy; control output (handshake
+// responses, pongs, close frames) is never dropped or conflated, but a peer
+// whose control output alone exceeds the byte budget is disconnected.
+//
+// The front message is never replaced or dropped since its bytes may be
+// owned by the kernel (io_uring sends) until on_sent() consumes them.
+// Dropped messages further back are released at once and skipped later, so
+// both conflating and dropping are O(1).
+//
+// A queue holds no memory while it is empty. The queued messages are kept in
+// a ring taken from the buffer pool with the first message and handed back
+// once the last one has been sent, so the thousands of connections which are
+// idle between broadcasts hold no buffers.
+class SendQueue final {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // counters may be null when nobody is interested in them
+    explicit SendQueue(const SendQueueLimits& limits = {}, SendQueueCounters* counters = nullptr) :
+        limits_(limits),
+        counters_(counters) {}
+
+    // Queues control output, bypassing the overflow policy. Returns false
+    // when the control output queued would exceed the byte budget by itself,
+    // as it does for a peer that keeps asking and never reads; the
+    // connection has to be disconnected then and the queue is left as it is.
+    [[nodiscard]] auto push_control(common::SharedBuffer buffer) -> bool;
+
+    // Queues a broadcast message of given topic. Returns false when the
+    // connection has to be disconnected according to the policy; the queue
+    // is left as it is in that case.
+    [[nodiscard]] auto push(common::SharedBuffer buffer, TopicId topic, Clock::time_point now) -> bool;
+
+    [[nodiscard]] auto is_empty() const -> bool { return entries_.empty(); }
+    [[nodiscard]] auto queued_bytes() const -> size_t { return queued_bytes_; }
+    // number of queued messages, not counting dropped ones
+    [[nodiscard]] auto message_count() const -> size_t { return message_count_; }
+    // number of messages the queue has room for before it allocates again;
+    // 0 while it is empty
+    [[nodiscard]] auto capacity() const -> size_t { return entries_.capacity(); }
+
+    // Returns the unsent part of the front message.
+    [[nodiscard]] auto front() const -> std::span<const uint8_t>;
+
+    // Marks given amount of bytes from front() sent.
+    auto on_sent(size_t bytes_sent) -> void;
+
+private:
+    struct Entry {
+        common::SharedBuffer buffer;
+        Clock::time_point queued_at;
+        TopicId topic{NO_TOPIC};
+        bool droppable{false};
+        bool dropped{false};
+    };
+
+    // sequence of the newest queued message per topic, 0 if none
+    using LatestByTopic = std::array<uint64_t, MAX_TOPICS>;
+
+    // Entries is a ring of entries growing by doubling. Its storage starts
+    // out as a chunk of the buffer pool, moves to the heap once that is too
+    // small and is released whenever the ring becomes empty. The storage
+    // begins with the newest message per topic, which like the entries only
+    // means anything while the queue holds some, so that an idle connection
+    // doesn't carry it around.
+    class Entries final {
+    public:
+        Entries() = default;
+        Entries(const Entries&) = delete;
+        Entries(Entries&& other) noexcept;
+        ~Entries() noexcept { release(); }
+
+        auto operator=(const Entries&) -> Entries& = delete;
+        auto operator=(Entries&& rhs) noexcept -> Entries&;
+
+        [[nodiscard]] auto empty() const -> bool { return size_ == 0; }
+        [[nodiscard]] auto size() const -> size_t { return size_; }
+        [[nodiscard]] auto capacity() const -> size_t { return capacity_; }
+
+        // the capacity need not be a power of two, so that the entries fill
+        // what the pooled chunk leaves after latest_by_topic()
+        auto operator[](size_t index) -> Entry& { return slots_[slot(index)]; }
+        auto operator[](size_t index) const -> const Entry& { return slots_[slot(index)]; }
+        auto front() -> Entry& { return (*this)[0]; }
+        [[nodiscard]] auto front() const -> const Entry& { return (*this)[0]; }
+
+        // only valid while not empty; all zero when the ring is allocated
+        auto latest_by_topic() -> LatestByTopic& { return *latest_by_topic_; }
+
+        auto push_back(Entry&& entry) -> void;
+        auto pop_front() -> void;
+
+    private:
+        [[nodiscard]] auto slot(size_t index) const -> size_t {
+            auto position = head_ + index;
+            return position < capacity_ ? position : position - capacity_;
+        }
+        auto grow() -> void;
+        auto release() noexcept -> void;
+
+        LatestByTopic* latest_by_topic_{nullptr};
+        Entry* slots_{nullptr};
+        size_t capacity_{0};
+        size_t head_{0};
+        size_t size_{0};
+    };
+
+    auto append(common::SharedBuffer&& buffer, TopicId topic, bool droppable, Clock::time_point now) -> void;
+    auto entry(uint64_t sequence) -> Entry& { return entries_[sequence - front_sequence_]; }
+    // Returns the queued message of given topic a newer one may replace.
+    auto conflation_target(TopicId topic) -> Entry*;
+    // Returns the oldest droppable message behind the front one, if any.
+    auto oldest_droppable() -> Entry*;
+    // Drops the oldest droppable message if the queue exceeds its byte or
+    // age budget; returns false when nothing was dropped.
+    auto drop_oldest(Clock::time_point now) -> bool;
+    auto pop_front() -> void;
+    auto count(std::atomic<uint64_t> SendQueueCounters::*counter) -> void;
+
+    SendQueueLimits limits_;
+    SendQueueCounters* counters_;
+
+    Entries entries_;
+    // sequence number of entries_.front(); entries are numbered in order
+    uint64_t front_sequence_{1};
+    size_t front_offset_{0};
+    size_t queued_bytes_{0};
+    // the part of queued_bytes_ that is control output
+    size_t control_bytes_{0};
+    size_t message_count_{0};
+    // messages before this one are known not to be droppable anymore
+    uint64_t drop_cursor_{1};
+};
+
+} // namespace ws
@@ -0,0 +1,303 @@
+#include "Subscriptions.h"
+#include "../Common/Assertions.h"
+#include "../Metrics/Topic.h"
+#include <algorithm>
+#include <bit>
+#include <charconv>
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+using namespace common;
+using namespace ws;
+
+// Splits off the next space separated word; empty once the input is used up.
+static auto next_word(std::string_view& input) -> std::string_view {
+    auto begin = input.find_first_not_of(' ');
+    if (begin == std::string_view::npos) {
+        input = {};
+        return {};
+    }
+    input.remove_prefix(begin);
+    auto end = std::min(input.find(' '), input.size());
+    auto word = input.substr(0, end);
+    input.remove_prefix(end);
+    return word;
+}
+
+// Parses a positive decimal number taking up the whole word.
+template <typename T>
+static auto parse_number(std::string_view word, T& value) -> bool {
+    auto [end, error] = std::from_chars(word.data(), word.data() + word.size(), value);
+    return error == std::errc{} && end == word.data() + word.size() && value != 0;
+}
+
+auto ws::parse_subscription_command(std::string_view command) -> ErrorOr<SubscriptionCommand> {
+    SubscriptionCommand result;
+    auto action = next_word(command);
+    if (action == "subscribe") {
+        result.action = SubscriptionCommand::Action::SUBSCRIBE;
+    } else if (action == "unsubscribe") {
+        result.action = SubscriptionCommand::Action::UNSUBSCRIBE;
+    } else if (action == "ack") {
+        result.action = SubscriptionCommand::Action::ACK;
+    } else if (action == "keyframe") {
+        result.action = SubscriptionCommand::Action::KEYFRAME;
+    } else if (action == "history") {
+        result.action = SubscriptionCommand::Action::HISTORY;
+    } else if (action == "query") {
+        result.action = SubscriptionCommand::Action::QUERY;
+    } else {
+        return {Error::from_string("unknown command")};
+    }
+
+    auto topic = metrics::parse_topic(next_word(command));
+    if (!topic.has_value()) {
+        return {Error::from_string("unknown topic")};
+    }
+    result.topic = static_cast<TopicId>(topic.value());
+
+    auto argument = next_word(command);
+    switch (result.action) {
+    case SubscriptionCommand::Action::SUBSCRIBE:
+        if (!argument.empty() && argument != "delta") {
+            uint32_t milliseconds = 0;
+            if (!parse_number(argument, milliseconds)) {
+                return {Error::from_string("invalid interval")};
+            }
+            result.interval = std::chrono::milliseconds(milliseconds);
+            argument = next_word(command);
+        }
+        if (argument == "delta") {
+            result.delta = true;
+            argument = next_word(command);
+        }
+        break;
+    case SubscriptionCommand::Action::ACK:
+        if (!parse_number(argument, result.version)) {
+            return {Error::from_string("invalid version")};
+        }
+        argument = next_word(command);
+        break;
+    case SubscriptionCommand::Action::HISTORY:
+        if (!argument.empty()) {
+            uint32_t milliseconds = 0;
+            if (!parse_number(argument, milliseconds)) {
+                return {Error::from_string("invalid step")};
+            }
+            result.step = std::chrono::milliseconds(milliseconds);
+            argument = next_word(command);
+        }
+        break;
+    case SubscriptionCommand::Action::QUERY: {
+        result.field = argument;
+        uint32_t window = 0;
+        uint32_t step = 0;
+        if (result.field.empty() || !parse_number(next_word(command), window) ||
+            !parse_number(next_word(command), step)) {
+            return {Error::from_string("invalid query")};
+        }
+        result.window = std::chrono::milliseconds(window);
+        result.step = std::chrono::milliseconds(step);
+        argument = next_word(command);
+        break;
+    }
+    case SubscriptionCommand::Action::UNSUBSCRIBE:
+    case SubscriptionCommand::Action::KEYFRAME:
+        break;
+    }
+    if (!argument.empty()) {
+        return {Error::from_string("unexpected argument")};
+    }
+    return result;
+}
+
+auto Subscriptions::find(TopicId topic) const -> Entry* {
+    // the entries of every topic fit a chunk, and are moved and dropped as
+    // plain bytes
+    static_assert(MAX_TOPICS * sizeof(Entry) <= buffer_pool::CHUNK_SIZE);
+    static_assert(std::is_trivially_copyable_v<Entry> && std::is_trivially_destructible_v<Entry>);
+    if (!is_subscribed(topic)) {
+        return nullptr;
+    }
+    auto* entries = reinterpret_cast<Entry*>(chunk_.bytes().data());
+    return entries + std::popcount(mask_ & (bit(topic) - 1));
+}
+
+auto Subscriptions::subscribe(TopicId topic, std::chrono::milliseconds interval, bool delta) -> void {
+    VERIFY(topic < MAX_TOPICS);
+    auto* entry = find(topic);
+    if (entry == nullptr) {
+        if (chunk_.is_null()) {
+            chunk_ = buffer_pool::Chunk::allocate();
+        }
+        // make room behind the entries of the topics below; new subscribers
+        // get the next sample right away
+        auto* entries = reinterpret_cast<Entry*>(chunk_.bytes().data());
+        auto position = static_cast<size_t>(std::popcount(mask_ & (bit(topic) - 1)));
+        auto count = static_cast<size_t>(std::popcount(mask_));
+        std::memmove(entries + position + 1, entries + position, (count - position) * sizeof(Entry));
+        entry = new (entries + position) Entry{};
+        mask_ |= bit(topic);
+    }
+    entry->interval = std::clamp(interval, MIN_INTERVAL, MAX_INTERVAL);
+    if (entry->delta != delta) {
+        // whatever the peer acknowledged, it asked to start over
+        entry->delta = delta;
+        entry->acknowledged_version = 0;
+    }
+}
+
+auto Subscriptions::unsubscribe(TopicId topic) -> void {
+    auto* entry = find(topic);
+    if (entry == nullptr) {
+        return;
+    }
+    auto* end = reinterpret_cast<Entry*>(chunk_.bytes().data()) + std::popcount(mask_);
+    std::memmove(entry, entry + 1, static_cast<size_t>(end - entry - 1) * sizeof(Entry));
+    mask_ &= ~bit(topic);
+    if (mask_ == 0) {
+        chunk_.reset();
+    }
+}
+
+auto Subscriptions::acknowledge(TopicId topic, uint64_t version) -> bool {
+    auto* entry = find(topic);
+    if (entry == nullptr || !entry->delta) {
+        return false;
+    }
+    // acknowledgements may cross newer ones on the way; only ever move forward
+    entry->acknowledged_version = std::max(entry->acknowledged_version, version);
+    return true;
+}
+
+auto Subscriptions::request_keyframe(TopicId topic) -> bool {
+    auto* entry = find(topic);
+    if (entry == nullptr) {
+        return false;
+    }
+    entry->keyframe_requested = true;
+    return true;
+}
+
+auto Subscriptions::interval(TopicId topic) const -> std::chrono::milliseconds {
+    const auto* entry = find(topic);
+    return entry != nullptr ? entry->interval : std::chrono::milliseconds(0);
+}
+
+auto Subscriptions::take_due(TopicId topic, Clock::time_point now) -> bool {
+    auto* entry = find(topic);
+    if (entry == nullptr) {
+        return false;
+    }
+    // samples don't arrive exactly on time; accept them slightly early rather
+    // than skipping to the next one
+    auto slack = entry->interval / 8;
+    if (now + slack < entry->next_due) {
+        return false;
+    }
+    // keep the average pace unless delivery fell behind by a whole interval
+    entry->next_due =
+        now - entry->next_due > entry->interval ? now + entry->interval : entry->next_due + entry->interval;
+    return true;
+}
+
+auto Subscriptions::delta_base(TopicId topic) const -> uint64_t {
+    const auto* entry = find(topic);
+    if (entry == nullptr) {
+        return 0;
+    }
+    if (!entry->delta || entry->keyframe_requested || entry->deltas_since_keyframe >= KEYFRAME_INTERVAL) {
+        return 0;
+    }
+    return entry->acknowledged_version;
+}
+
+auto Subscriptions::on_delivered(TopicId topic, uint64_t base) -> void {
+    auto* entry = find(topic);
+    if (entry == nullptr) {
+        return;
+    }
+    if (base == 0) {
+        entry->keyframe_requested = false;
+        entry->deltas_since_keyframe = 0;
+    } else {
+        ++entry->deltas_since_keyframe;
+    }
+}
+
+auto SubscriptionIndex::update(uint64_t token, Membership& membership, const Subscriptions& subscriptions) -> void {
+    for (auto changed = membership.mask | subscriptions.mask(); changed != 0; changed &= changed - 1) {
+        auto topic = static_cast<TopicId>(std::countr_zero(changed));
+        if ((membership.mask & (uint32_t{1} << topic)) != 0) {
+            remove(topic, membership);
+        }
+        if (subscriptions.is_subscribed(topic)) {
+            add(topic, token, membership, subscriptions.interval(topic));
+        }
+    }
+}
+
+auto SubscriptionIndex::remove(Membership& membership) -> void {
+    while (membership.mask != 0) {
+        remove(static_cast<TopicId>(std::countr_zero(membership.mask)), membership);
+    }
+}
+
+auto SubscriptionIndex::subscribers(TopicId topic) const -> std::span<const uint64_t> {
+    if (topic >= MAX_TOPICS) {
+        return {};
+    }
+    return topics_[topic].tokens;
+}
+
+auto SubscriptionIndex::fastest_interval(TopicId topic) const -> std::chrono::milliseconds {
+    if (topic >= MAX_TOPICS || topics_[topic].interval_counts.empty()) {
+        return std::chrono::milliseconds(0);
+    }
+    return topics_[topic].interval_counts.front().first;
+}
+
+auto SubscriptionIndex::add(TopicId topic, uint64_t token, Membership& membership, std::chrono::milliseconds interval)
+    -> void {
+    auto& subscribers = topics_[topic];
+    membership.positions[topic] = static_cast<uint32_t>(subscribers.tokens.size());
+    membership.mask |= uint32_t{1} << topic;
+    subscribers.tokens.push_back(token);
+    subscribers.members.push_back(&membership);
+    subscribers.intervals.push_back(interval);
+    count_interval(subscribers, interval, 1);
+}
+
+auto SubscriptionIndex::remove(TopicId topic, Membership& membership) -> void {
+    auto& subscribers = topics_[topic];
+    auto position = membership.positions[topic];
+    VERIFY(position < subscribers.tokens.size() && subscribers.members[position] == &membership);
+    count_interval(subscribers, subscribers.intervals[position], -1);
+    // order doesn't matter; the last one takes the place of the leaving one
+    subscribers.tokens[position] = subscribers.tokens.back();
+    subscribers.members[position] = subscribers.members.back();
+    subscribers.intervals[position] = subscribers.intervals.back();
+    subscribers.members[position]->positions[topic] = position;
+    subscribers.tokens.pop_back();
+    subscribers.members.pop_back();
+    subscribers.intervals.pop_back();
+    membership.mask &= ~(uint32_t{1} << topic);
+}
+
+auto SubscriptionIndex::count_interval(TopicSubscribers& subscribers, std::chrono::milliseconds interval, int change)
+    -> void {
+    auto& counts = subscribers.interval_counts;
+    auto it = std::lower_bound(counts.begin(), counts.end(), interval, [](const auto& count, auto value) {
+        return count.first < value;
+    });
+    if (it == counts.end() || it->first != interval) {
+        VERIFY(change > 0);
+        counts.insert(it, {interval, 1});
+        return;
+    }
+    it->second = static_cast<uint32_t>(static_cast<int>(it->second) + change);
+    if (it->second == 0) {
+        counts.erase(it);
+    }
+}
@@ -0,0 +1,176 @@
+#pragma once
+
+#include "../Common/BufferPool.h"
+#include "../Common/Error.h"
+#include "SendQueue.h"
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <span>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+namespace ws {
+
+// A request sent by a client as a text message, one of
+//
+//   subscribe <topic> [<interval in ms>] [delta]
+//   unsubscribe <topic>
+//   ack <topic> <version>
+//   keyframe <topic>
+//   history <topic> [<step in ms>]
+//   query <topic> <field> <window in ms> <step in ms>
+//
+// where topic is one of the names from metrics::format_topic(). Delta
+// subscribers acknowledge the versions they hold with ack and receive what
+// changed since the latest one acknowledged; keyframe asks for the next
+// sample in full. history asks for the past of a topic at the finest kept
+// resolution of at least the given step, by default the finest there is.
+// query asks for the minimum, maximum, mean and percentiles of a field per
+// step over the given window, computed from the history by the server.
+struct SubscriptionCommand {
+    enum class Action : int {
+        SUBSCRIBE = 1,
+        UNSUBSCRIBE = 2,
+        ACK = 3,
+        KEYFRAME = 4,
+        HISTORY = 5,
+        QUERY = 6,
+    };
+
+    static constexpr auto DEFAULT_INTERVAL = std::chrono::milliseconds(1000);
+
+    Action action{Action::SUBSCRIBE};
+    TopicId topic{NO_TOPIC};
+    std::chrono::milliseconds interval{DEFAULT_INTERVAL};
+    bool delta{false};
+    uint64_t version{0};
+    // zero for the finest
+    std::chrono::milliseconds step{0};
+    std::chrono::milliseconds window{0};
+    // points into the parsed command
+    std::string_view field;
+};
+
+auto parse_subscription_command(std::string_view command) -> common::ErrorOr<SubscriptionCommand>;
+
+// Subscriptions holds the topics a single connection asked for, each with
+// the interval the peer wants to receive samples at and, for delta
+// subscriptions, the version the peer acknowledged last.
+//
+// Most connections subscribe to a few topics, if any, so state is only kept
+// for the topics subscribed to, in a chunk of the buffer pool taken on the
+// first subscription and handed back after the last one.
+class Subscriptions final {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    // 100 Hz; collectors keep their files open to afford it
+    static constexpr auto MIN_INTERVAL = std::chrono::milliseconds(10);
+    static constexpr auto MAX_INTERVAL = std::chrono::milliseconds(3600 * 1000);
+    // delta subscribers get a keyframe after this many deltas in a row,
+    // which bounds how long a peer that lost track stays out of sync
+    static constexpr uint32_t KEYFRAME_INTERVAL = 30;
+
+    // Subscribes to given topic or changes the interval and mode of an
+    // existing subscription. The interval is clamped to [MIN_INTERVAL,
+    // MAX_INTERVAL].
+    auto subscribe(TopicId topic, std::chrono::milliseconds interval, bool delta = false) -> void;
+    auto unsubscribe(TopicId topic) -> void;
+    // Records that the peer holds given version of a delta subscription.
+    // Returns false when the topic isn't subscribed to in delta mode.
+    auto acknowledge(TopicId topic, uint64_t version) -> bool;
+    // Makes the next sample of given topic a keyframe. Returns false when
+    // the topic isn't subscribed to.
+    auto request_keyframe(TopicId topic) -> bool;
+
+    [[nodiscard]] auto is_subscribed(TopicId topic) const -> bool { return (mask_ & bit(topic)) != 0; }
+    // Returns bit n set for every subscribed topic n.
+    [[nodiscard]] auto mask() const -> uint32_t { return mask_; }
+    // Returns the subscription's interval; zero when not subscribed.
+    [[nodiscard]] auto interval(TopicId topic) const -> std::chrono::milliseconds;
+
+    // Returns whether a sample of given topic arriving now is due for this
+    // connection and if so, accounts for its delivery. Samples arrive at the
+    // pace of the topic's fastest subscriber; slower ones skip samples so
+    // that they receive one per interval on average.
+    auto take_due(TopicId topic, Clock::time_point now) -> bool;
+
+    // Returns the version the next sample of given topic should be encoded
+    // relative to; zero when it has to be a keyframe.
+    [[nodiscard]] auto delta_base(TopicId topic) const -> uint64_t;
+    // Accounts for the delivery of a sample encoded relative to given base.
+    auto on_delivered(TopicId topic, uint64_t base) -> void;
+
+private:
+    struct Entry {
+        std::chrono::milliseconds interval{0};
+        Clock::time_point next_due{};
+        uint64_t acknowledged_version{0};
+        uint32_t deltas_since_keyframe{0};
+        bool delta{false};
+        bool keyframe_requested{false};
+    };
+
+    static constexpr auto bit(TopicId topic) -> uint32_t { return topic < MAX_TOPICS ? uint32_t{1} << topic : 0; }
+
+    // Returns the entry of given topic; null when not subscribed.
+    [[nodiscard]] auto find(TopicId topic) const -> Entry*;
+
+    // entries of the subscribed topics in topic order, so the entry of a
+    // topic follows those of the subscribed topics below it
+    common::buffer_pool::Chunk chunk_;
+    uint32_t mask_{0};
+};
+
+// SubscriptionIndex maps every topic to the connections of a reactor
+// subscribed to it, so that a sample is only handed to its subscribers, and
+// tracks each topic's fastest interval. Connections are identified by the
+// reactor's tokens.
+//
+// Where a connection is recorded is kept in a Membership the connection
+// owns, so that recording and forgetting it takes constant time and never
+// allocates once the index has grown to its peak size, however many
+// connections come and go.
+//
+// Instances must only be used from a single thread.
+class SubscriptionIndex final {
+public:
+    struct Membership {
+        // bit n set for every topic n the connection is recorded under
+        uint32_t mask{0};
+        // index among the subscribers of every topic in mask
+        std::array<uint32_t, MAX_TOPICS> positions{};
+    };
+
+    // Replaces whatever was recorded for the connection of given token and
+    // membership. The membership must stay in place until the connection is
+    // removed.
+    auto update(uint64_t token, Membership& membership, const Subscriptions& subscriptions) -> void;
+    auto remove(Membership& membership) -> void;
+
+    [[nodiscard]] auto subscribers(TopicId topic) const -> std::span<const uint64_t>;
+    // Returns the shortest interval any connection subscribed to given topic
+    // with; zero when the topic has no subscribers.
+    [[nodiscard]] auto fastest_interval(TopicId topic) const -> std::chrono::milliseconds;
+
+private:
+    struct TopicSubscribers {
+        std::vector<uint64_t> tokens;
+        // parallel to tokens
+        std::vector<Membership*> members;
+        std::vector<std::chrono::milliseconds> intervals;
+        // the distinct intervals subscribed with, shortest first, and the
+        // number of subscribers using each; a handful at most in practice
+        std::vector<std::pair<std::chrono::milliseconds, uint32_t>> interval_counts;
+    };
+
+    auto add(TopicId topic, uint64_t token, Membership& membership, std::chrono::milliseconds interval) -> void;
+    auto remove(TopicId topic, Membership& membership) -> void;
+    static auto count_interval(TopicSubscribers& subscribers, std::chrono::milliseconds interval, int change) -> void;
+
+    std::array<TopicSubscribers, MAX_TOPICS> topics_;
+};
+
+} // namespace ws
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "../Common/SharedBuffer.h"
+#include "WireFormat.h"
+#include <cstdint>
+
+namespace ws {
+
+// VersionedMessage is a broadcast whose encoding depends on what the
+// receiving connection already holds: a connection that acknowledged an
+// earlier version of the topic gets a frame relative to it, any other one
+// a frame standing on its own (a keyframe).
+//
+// One instance is shared by every reactor the message is broadcast to, so
+// implementations must be thread-safe. They are expected to encode each
+// frame once and hand the same buffer to every connection asking for it.
+class VersionedMessage {
+public:
+    VersionedMessage(const VersionedMessage&) = delete;
+    VersionedMessage(VersionedMessage&&) noexcept = delete;
+    virtual ~VersionedMessage() noexcept = default;
+
+    auto operator=(const VersionedMessage&) -> VersionedMessage& = delete;
+    auto operator=(VersionedMessage&&) noexcept -> VersionedMessage& = delete;
+
+    [[nodiscard]] virtual auto version() const -> uint64_t = 0;
+    // Returns whether a frame relative to given version can be encoded.
+    [[nodiscard]] virtual auto has_base(uint64_t base) const -> bool = 0;
+
+    // Returns the frame for a connection holding given version, encoded in
+    // the connection's wire format; a keyframe when base is zero or
+    // has_base() doesn't hold for it.
+    virtual auto frame_for(uint64_t base, WireFormat wire_format) -> common::SharedBuffer = 0;
+
+protected:
+    VersionedMessage() = default;
+};
+
+} // namespace ws
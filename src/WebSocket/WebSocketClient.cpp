@@ -1,53 +1,431 @@
 #include "WebSocketClient.h"
 #include "../Common/Logging.h"
+#include "Handshake.h"
+#include <algorithm>
+#include <new>
+#include <type_traits>
 
+using namespace common;
 using namespace common::net;
 using namespace ws;
 
-auto WebSocketClient::create(ClientSocket&& client_socket) -> WebSocketClient {
-    return {std::move(client_socket)};
+// the parser and the whole upgrade request have to fit a chunk, which is
+// handed back without destroying the parser
+static_assert(sizeof(HttpRequestParser) + handshake::MAX_REQUEST_SIZE <= buffer_pool::CHUNK_SIZE);
+static_assert(std::is_trivially_destructible_v<HttpRequestParser>);
+// an idle connection keeps well under a kilobyte; the handshake, its output
+// and its per-topic state take chunks of the buffer pool only while in use.
+// Most of what is left are the frame decoder with its buffer for a control
+// payload, the positions in the subscription index and the socket address.
+static_assert(sizeof(WebSocketClient) <= 832);
+
+static auto as_bytes(std::string_view string) -> std::span<const uint8_t> {
+    return {reinterpret_cast<const uint8_t*>(string.data()), string.size()};
 }
 
-WebSocketClient::WebSocketClient(ClientSocket&& client_socket) :
-    client_socket_(std::move(client_socket)) {
-    thread_ = std::jthread(&WebSocketClient::thread_main, this);
+auto WebSocketClient::create(ClientSocket&& client_socket,
+                             const ConnectionSettings& connection_settings,
+                             SendQueueCounters* send_queue_counters) -> WebSocketClient {
+    return {std::move(client_socket),
+            SendQueue(connection_settings.send_queue, send_queue_counters),
+            connection_settings.timeouts,
+            static_cast<bool>(connection_settings.query_function)};
 }
 
+WebSocketClient::WebSocketClient(ClientSocket&& client_socket,
+                                 SendQueue&& send_queue,
+                                 const ConnectionTimeouts& timeouts,
+                                 bool accepts_queries) :
+    client_socket_(std::move(client_socket)),
+    accepts_queries_(accepts_queries),
+    send_queue_(std::move(send_queue)),
+    timeouts_(timeouts),
+    created_at_(Clock::now()),
+    last_received_at_(created_at_),
+    last_message_at_(created_at_) {}
+
 WebSocketClient::~WebSocketClient() noexcept {
     shutdown();
 }
 
 auto WebSocketClient::shutdown() noexcept -> void {
-    // swap this instances main_thread_ with a local dummy/empty thread;
-    // this makes the shutdown process a bit more thread-safe
-    std::jthread actual_thread;
-    actual_thread.swap(thread_);
+    client_socket_.close();
+}
+
+auto WebSocketClient::on_received(std::span<uint8_t> data) -> ErrorOr<void> {
+    // whatever the peer sends proves it is alive, not just pongs
+    last_received_at_ = Clock::now();
+    ping_sent_at_.reset();
+
+    switch (state_) {
+    case State::HANDSHAKE:
+        return handle_handshake(data);
+    case State::OPEN:
+        return handle_frames(data);
+    case State::CLOSING:
+        // whatever the peer sends after we decided to close is dropped
+        return {};
+    }
+    VERIFY_NOT_REACHED();
+}
+
+auto WebSocketClient::handshake_parser() -> HttpRequestParser& {
+    return *std::launder(reinterpret_cast<HttpRequestParser*>(handshake_chunk_.bytes().data()));
+}
+
+auto WebSocketClient::handshake_request() -> std::span<uint8_t> {
+    return handshake_chunk_.bytes().subspan(sizeof(HttpRequestParser), handshake::MAX_REQUEST_SIZE);
+}
 
-    if (actual_thread.joinable()) {
-        LOG_INFO("Shutting down client");
-        stop_requested_ = true;
-        client_socket_.close();
-        try {
-            actual_thread.join();
-        } catch (const std::exception& e) {
-            LOG_ERROR("join() failed: ", e.what());
+auto WebSocketClient::handle_handshake(std::span<uint8_t> data) -> ErrorOr<void> {
+    if (handshake_chunk_.is_null()) {
+        handshake_chunk_ = buffer_pool::Chunk::allocate();
+        new (handshake_chunk_.bytes().data()) HttpRequestParser();
+    }
+    // frames may follow the request in the same read, so only what fits is
+    // buffered and the limit applies to the head alone
+    auto handshake_buffer = handshake_request();
+    auto copied = std::min(data.size(), handshake::MAX_REQUEST_SIZE - handshake_size_);
+    std::copy_n(data.begin(), copied, handshake_buffer.begin() + static_cast<ptrdiff_t>(handshake_size_));
+    handshake_size_ += copied;
+
+    auto request = std::string_view(reinterpret_cast<const char*>(handshake_buffer.data()), handshake_size_);
+    auto& parser = handshake_parser();
+    switch (parser.parse(request)) {
+    case HttpRequestParser::Status::INCOMPLETE:
+        if (handshake_size_ == handshake::MAX_REQUEST_SIZE) {
+            LOG_WARN("Client ({}) sent a too large handshake request", client_socket_.remote_address().to_string());
+            reject_handshake(handshake::REQUEST_TOO_LARGE_RESPONSE);
         }
+        return {};
+    case HttpRequestParser::Status::INVALID:
+        LOG_WARN("Client ({}) sent a malformed handshake request", client_socket_.remote_address().to_string());
+        reject_handshake(handshake::BAD_REQUEST_RESPONSE);
+        return {};
+    case HttpRequestParser::Status::COMPLETE:
+        break;
+    }
+
+    auto error_or_client_key = handshake::validate_upgrade_request(parser);
+    if (error_or_client_key.is_error()) {
+        LOG_WARN("Client ({}) handshake rejected: {}",
+                 client_socket_.remote_address().to_string(),
+                 error_or_client_key.error().error_message());
+        reject_handshake(handshake::is_unsupported_version(parser)
+                             ? handshake::UPGRADE_REQUIRED_RESPONSE
+                             : handshake::BAD_REQUEST_RESPONSE);
+        return {};
     }
+
+    // without a subprotocol we speak, the client gets JSON and no
+    // Sec-WebSocket-Protocol header, as RFC 6455 section 4.2.2 asks for
+    auto wire_format = handshake::select_wire_format(parser);
+    wire_format_ = wire_format.value_or(WireFormat::JSON);
+    auto accept_key = handshake::compute_accept_key(error_or_client_key.value());
+    std::array<char, handshake::MAX_RESPONSE_SIZE> response;
+    auto response_length = handshake::write_accept_response(
+        accept_key, response, wire_format.has_value() ? format_wire_format(wire_format.value()) : std::string_view());
+    queue_output({reinterpret_cast<const uint8_t*>(response.data()), response_length});
+    state_ = State::OPEN;
+    LOG_INFO("Client ({}) upgraded to WebSocket (wire format: {})",
+             client_socket_.remote_address().to_string(),
+             format_wire_format(wire_format_));
+
+    // clients may send their first frames right behind the request
+    auto head_length = parser.head_length();
+    auto handshake_chunk = std::move(handshake_chunk_);
+    auto request_size = std::exchange(handshake_size_, 0);
+    if (head_length < request_size) {
+        TRY(handle_frames(handshake_buffer.subspan(head_length, request_size - head_length)));
+    }
+    // the rest of the read did not fit the handshake buffer
+    if (copied < data.size() && state_ == State::OPEN) {
+        return handle_frames(data.subspan(copied));
+    }
+    return {};
 }
 
-auto WebSocketClient::thread_main() -> void {
-    const auto client_id = client_socket_.remote_address().to_string();
+auto WebSocketClient::handle_frames(std::span<uint8_t> data) -> ErrorOr<void> {
+    auto error_or_void = frame_decoder_.decode(data, *this);
+    if (error_or_void.is_error() && frame_decoder_.is_failed()) {
+        // protocol errors are the peer's fault; tell it why before closing
+        LOG_WARN("Client ({}) violated the protocol: {}",
+                 client_socket_.remote_address().to_string(),
+                 error_or_void.error().error_message());
+        close(frame_decoder_.close_code());
+        return {};
+    }
+    return error_or_void;
+}
 
-    try {
-        while (stop_requested_) {
-            LOG_INFO("Waiting client ({}) to send something", client_id);
-            std::array<uint8_t, 1024> buffer;
-            auto bytes_read = TRY_OR_THROW(client_socket_.read(buffer, 30000));
-            LOG_INFO("Client ({}) sent {} bytes", client_id, bytes_read);
+auto WebSocketClient::on_message_data(Opcode opcode, std::span<const uint8_t> data, bool message_complete)
+    -> ErrorOr<void> {
+    message_size_ += data.size();
+    if (opcode == Opcode::TEXT) {
+        if (command_.size() + data.size() > MAX_COMMAND_SIZE) {
+            command_too_large_ = true;
+        } else {
+            command_.append(reinterpret_cast<const char*>(data.data()), data.size());
         }
-    } catch (const std::exception& e) {
-        LOG_ERROR("Communication with client ({}) failed: {}", client_id, e.what());
     }
+    if (message_complete) {
+        LOG_DEBUG("Client ({}) sent a {} message ({} bytes)",
+                  client_socket_.remote_address().to_string(),
+                  format_opcode(opcode),
+                  message_size_);
+        message_size_ = 0;
+        last_message_at_ = last_received_at_;
+        if (opcode == Opcode::TEXT) {
+            if (command_too_large_) {
+                queue_frame(Opcode::TEXT, as_bytes(R"({"error":"command too large"})"));
+            } else {
+                handle_command(command_);
+            }
+            command_.clear();
+            command_too_large_ = false;
+        }
+    }
+    return {};
+}
 
-    client_socket_.close();
+auto WebSocketClient::handle_command(std::string_view command) -> void {
+    auto error_or_command = parse_subscription_command(command);
+    if (error_or_command.is_error()) {
+        auto response = fmt::format(R"({{"error":"{}"}})", error_or_command.error().error_message());
+        queue_frame(Opcode::TEXT, as_bytes(response));
+        return;
+    }
+    const auto& subscription_command = error_or_command.value();
+    auto topic = subscription_command.topic;
+    switch (subscription_command.action) {
+    case SubscriptionCommand::Action::SUBSCRIBE:
+        subscriptions_.subscribe(topic, subscription_command.interval, subscription_command.delta);
+        subscriptions_changed_ = true;
+        return;
+    case SubscriptionCommand::Action::UNSUBSCRIBE:
+        subscriptions_.unsubscribe(topic);
+        subscriptions_changed_ = true;
+        return;
+    case SubscriptionCommand::Action::ACK:
+        if (!subscriptions_.acknowledge(topic, subscription_command.version)) {
+            queue_frame(Opcode::TEXT, as_bytes(R"({"error":"not subscribed in delta mode"})"));
+        }
+        return;
+    case SubscriptionCommand::Action::KEYFRAME:
+        if (!subscriptions_.request_keyframe(topic)) {
+            queue_frame(Opcode::TEXT, as_bytes(R"({"error":"not subscribed"})"));
+        }
+        return;
+    case SubscriptionCommand::Action::HISTORY:
+    case SubscriptionCommand::Action::QUERY:
+        if (!accepts_queries_) {
+            queue_frame(Opcode::TEXT, as_bytes(R"({"error":"no history kept"})"));
+            return;
+        }
+        // answering may take milliseconds; the reactor hands the query to
+        // its query thread and the answer back via queue_answer()
+        queries_.emplace_back(command);
+        return;
+    }
+    VERIFY_NOT_REACHED();
+}
+
+auto WebSocketClient::on_control_frame(Opcode opcode, std::span<const uint8_t> payload) -> ErrorOr<void> {
+    switch (opcode) {
+    case Opcode::PING:
+        queue_frame(Opcode::PONG, payload);
+        return {};
+    case Opcode::PONG:
+        return {};
+    case Opcode::CLOSE:
+        if (payload.size() == 1) {
+            close(CloseCode::PROTOCOL_ERROR);
+        } else if (state_ == State::OPEN) {
+            // echo the peer's status code, or none if it sent none
+            queue_frame(Opcode::CLOSE, payload.first(std::min<size_t>(payload.size(), 2)));
+            set_closing();
+        }
+        return {};
+    default:
+        VERIFY_NOT_REACHED();
+    }
+}
+
+auto WebSocketClient::queue_frame(Opcode opcode, std::span<const uint8_t> payload) -> void {
+    if (payload.size() + MAX_FRAME_HEADER_SIZE <= SharedBuffer::MAX_POOLED_SIZE) {
+        push_control(make_frame(opcode, payload));
+        return;
+    }
+    // large answers, such as history, go out as a chain of pooled chunks;
+    // control output is sent in order, so the chunks end up back to back
+    FrameHeader header{.opcode = opcode, .payload_length = payload.size()};
+    std::array<uint8_t, MAX_FRAME_HEADER_SIZE> header_bytes;
+    auto header_length = write_frame_header(header, header_bytes);
+    SharedBuffer::chain_of({std::span<const uint8_t>(header_bytes).first(header_length), payload},
+                           [this](SharedBuffer chunk) { push_control(std::move(chunk)); });
+}
+
+auto WebSocketClient::queue_answer(std::string_view answer) -> void {
+    if (state_ == State::OPEN) {
+        queue_frame(Opcode::TEXT, as_bytes(answer));
+    }
+}
+
+auto WebSocketClient::close(CloseCode close_code) -> void {
+    if (state_ != State::OPEN) {
+        return;
+    }
+    auto code = static_cast<uint16_t>(close_code);
+    std::array<uint8_t, 2> payload = {static_cast<uint8_t>(code >> 8), static_cast<uint8_t>(code)};
+    queue_frame(Opcode::CLOSE, payload);
+    set_closing();
+}
+
+auto WebSocketClient::reject_handshake(std::string_view response) -> void {
+    queue_output({reinterpret_cast<const uint8_t*>(response.data()), response.size()});
+    set_closing();
+    handshake_chunk_.reset();
+    handshake_size_ = 0;
+}
+
+auto WebSocketClient::set_closing() -> void {
+    state_ = State::CLOSING;
+    closing_since_ = Clock::now();
+}
+
+auto WebSocketClient::abort(std::string_view reason) -> void {
+    LOG_WARN("Client ({}) {}, disconnecting", client_socket_.remote_address().to_string(), reason);
+    state_ = State::CLOSING;
+    aborted_ = true;
+}
+
+auto WebSocketClient::next_deadline() const -> Clock::time_point {
+    switch (state_) {
+    case State::HANDSHAKE:
+        return created_at_ + timeouts_.handshake_timeout;
+    case State::OPEN: {
+        auto deadline = Clock::time_point::max();
+        if (ping_sent_at_.has_value()) {
+            deadline = ping_sent_at_.value() + timeouts_.pong_timeout;
+        } else if (timeouts_.ping_interval.count() > 0) {
+            deadline = last_received_at_ + timeouts_.ping_interval;
+        }
+        if (timeouts_.idle_timeout.count() > 0) {
+            deadline = std::min(deadline, last_message_at_ + timeouts_.idle_timeout);
+        }
+        return deadline;
+    }
+    case State::CLOSING:
+        return closing_since_ + timeouts_.pong_timeout;
+    }
+    VERIFY_NOT_REACHED();
+}
+
+auto WebSocketClient::on_timeout(Clock::time_point now) -> void {
+    if (aborted_ || now < next_deadline()) {
+        return;
+    }
+    switch (state_) {
+    case State::HANDSHAKE:
+        abort("did not complete the handshake in time");
+        return;
+    case State::OPEN:
+        if (timeouts_.idle_timeout.count() > 0 && now >= last_message_at_ + timeouts_.idle_timeout) {
+            LOG_INFO("Client ({}) has been idle for too long", client_socket_.remote_address().to_string());
+            close(CloseCode::POLICY_VIOLATION);
+        } else if (ping_sent_at_.has_value()) {
+            abort("did not answer a ping in time");
+        } else {
+            queue_frame(Opcode::PING, {});
+            ping_sent_at_ = now;
+        }
+        return;
+    case State::CLOSING:
+        abort("did not finish the closing handshake in time");
+        return;
+    }
+    VERIFY_NOT_REACHED();
+}
+
+auto WebSocketClient::on_readable(std::span<uint8_t> scratch_buffer) -> ErrorOr<void> {
+    while (true) {
+        auto bytes_read = TRY(client_socket_.receive(scratch_buffer));
+        if (bytes_read == 0) {
+            // drained; wait for the next edge
+            return {};
+        }
+        TRY(on_received(scratch_buffer.first(bytes_read)));
+    }
+}
+
+auto WebSocketClient::on_writable() -> ErrorOr<void> {
+    while (has_pending_output()) {
+        auto bytes_sent = TRY(client_socket_.send(pending_output()));
+        if (bytes_sent == 0) {
+            // socket buffer full; wait for the next edge
+            return {};
+        }
+        on_sent(bytes_sent);
+    }
+    return {};
+}
+
+auto WebSocketClient::queue_output(std::span<const uint8_t> data) -> void {
+    SharedBuffer::chain_of({data}, [this](SharedBuffer chunk) { push_control(std::move(chunk)); });
+}
+
+auto WebSocketClient::queue_message(SharedBuffer frame, TopicId topic, SendQueue::Clock::time_point now) -> void {
+    if (state_ != State::OPEN || (topic != NO_TOPIC && !subscriptions_.take_due(topic, now))) {
+        return;
+    }
+    push_message(std::move(frame), topic, now);
+}
+
+auto WebSocketClient::queue_message(const std::shared_ptr<VersionedMessage>& message,
+                                    TopicId topic,
+                                    SendQueue::Clock::time_point now) -> void {
+    if (state_ != State::OPEN || !subscriptions_.take_due(topic, now)) {
+        return;
+    }
+    auto base = subscriptions_.delta_base(topic);
+    if (base != 0 && !message->has_base(base)) {
+        // acknowledged too long ago
+        base = 0;
+    }
+    subscriptions_.on_delivered(topic, base);
+    // conflating is still fine: every frame queued since the acknowledgement
+    // is relative to the same base
+    push_message(message->frame_for(base, wire_format_), topic, now);
+}
+
+auto WebSocketClient::push_message(SharedBuffer frame, TopicId topic, SendQueue::Clock::time_point now) -> void {
+    if (!send_queue_.push(std::move(frame), topic, now)) {
+        LOG_WARN("Client ({}) is not keeping up ({} bytes in {} messages queued), disconnecting",
+                 client_socket_.remote_address().to_string(),
+                 send_queue_.queued_bytes(),
+                 send_queue_.message_count());
+        state_ = State::CLOSING;
+        aborted_ = true;
+    }
+}
+
+auto WebSocketClient::push_control(SharedBuffer buffer) -> void {
+    if (aborted_) {
+        return;
+    }
+    if (!send_queue_.push_control(std::move(buffer))) {
+        LOG_WARN("Client ({}) does not read what it asked for ({} bytes queued), disconnecting",
+                 client_socket_.remote_address().to_string(),
+                 send_queue_.queued_bytes());
+        state_ = State::CLOSING;
+        aborted_ = true;
+    }
+}
+
+auto WebSocketClient::pending_output() const -> std::span<const uint8_t> {
+    return send_queue_.front();
+}
+
+auto WebSocketClient::on_sent(size_t bytes_sent) -> void {
+    send_queue_.on_sent(bytes_sent);
 }
@@ -1,33 +1,238 @@
 #pragma once
 
+#include "../Common/BufferPool.h"
+#include "../Common/Error.h"
 #include "../Common/Net/ClientSocket.h"
-#include <thread>
+#include "../Common/SharedBuffer.h"
+#include "../Common/TimerWheel.h"
+#include "FrameCodec.h"
+#include "FrameDecoder.h"
+#include "HttpRequestParser.h"
+#include "SendQueue.h"
+#include "Subscriptions.h"
+#include "VersionedMessage.h"
+#include "WireFormat.h"
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
 
 namespace ws {
 
-class WebSocketClient final {
+// Deadlines enforced on every connection. A zero ping interval or idle
+// timeout disables pings or the idle timeout respectively.
+struct ConnectionTimeouts {
+    // time a client has to complete the upgrade handshake
+    std::chrono::milliseconds handshake_timeout{5000};
+    // an open connection is pinged after being quiet for this long
+    std::chrono::milliseconds ping_interval{20000};
+    // time the peer has to answer a ping, or to finish the closing handshake
+    std::chrono::milliseconds pong_timeout{10000};
+    // an open connection is closed when the peer sent no data message for
+    // this long, however often it answers pings
+    std::chrono::milliseconds idle_timeout{0};
+};
+
+// Answers a command asking for stored data rather than for samples, such as
+// history, with the text to send back. Called on a query thread of every
+// reactor, never on the reactor threads themselves, so possibly concurrently.
+using QueryFunction = std::function<common::ErrorOr<std::string>(const SubscriptionCommand& command)>;
+
+struct ConnectionSettings {
+    SendQueueLimits send_queue;
+    ConnectionTimeouts timeouts;
+    // such commands are refused when not set
+    QueryFunction query_function;
+};
+
+// WebSocketClient holds the state of a single accepted connection. It owns no
+// thread; the reactor which accepted the connection feeds it received bytes
+// and drains its pending output whenever the socket allows.
+class WebSocketClient final : private FrameDecoder::Handler {
 public:
-    static auto create(common::net::ClientSocket&& client_socket) -> WebSocketClient;
+    using Clock = std::chrono::steady_clock;
+
+    enum class State : int {
+        HANDSHAKE = 1,
+        OPEN = 2,
+        CLOSING = 3,
+    };
+
+    static auto create(common::net::ClientSocket&& client_socket,
+                       const ConnectionSettings& connection_settings = {},
+                       SendQueueCounters* send_queue_counters = nullptr) -> WebSocketClient;
 
     WebSocketClient(const WebSocketClient&) = delete;
     WebSocketClient(WebSocketClient&&) noexcept = default;
-    ~WebSocketClient() noexcept;
+    ~WebSocketClient() noexcept override;
 
     auto operator=(const WebSocketClient&) -> WebSocketClient& = delete;
     auto operator=(WebSocketClient&&) noexcept -> WebSocketClient& = default;
 
-    [[nodiscard]] auto is_running() const -> bool { return thread_.joinable(); }
+    [[nodiscard]] auto client_socket() const -> const common::net::ClientSocket& { return client_socket_; }
+    [[nodiscard]] auto file_descriptor() const -> int { return client_socket_.socket().file_descriptor(); }
+    [[nodiscard]] auto state() const -> State { return state_; }
+    // Encoding of metric samples negotiated during the handshake.
+    [[nodiscard]] auto wire_format() const -> WireFormat { return wire_format_; }
+
+    // Handles bytes received from the peer, however the reactor got them.
+    // The bytes are modified in place (frame payloads are unmasked).
+    auto on_received(std::span<uint8_t> data) -> common::ErrorOr<void>;
+
+    // Called by readiness based reactors when the socket became readable.
+    // Since the socket is registered edge-triggered this drains it until
+    // recv() would block. The given buffer is scratch space shared with
+    // other connections of the reactor.
+    auto on_readable(std::span<uint8_t> scratch_buffer) -> common::ErrorOr<void>;
+
+    // Called by readiness based reactors when the socket became writable.
+    // Sends pending output until send() would block.
+    auto on_writable() -> common::ErrorOr<void>;
+
+    // Queues bytes to be sent to the peer.
+    auto queue_output(std::span<const uint8_t> data) -> void;
+
+    // Queues a broadcast frame by reference so that its bytes exist only
+    // once however many connections it goes to. Subject to the send queue's
+    // overflow policy; a connection that falls too far behind is closed.
+    // Ignored unless the connection is open. Frames of a topic are only
+    // queued when the connection subscribed to it and its interval passed.
+    auto queue_message(common::SharedBuffer frame, TopicId topic, SendQueue::Clock::time_point now) -> void;
+    // Same as above for a message of a topic encoded in the connection's wire
+    // format for whichever version it acknowledged: delta subscribers get a
+    // delta relative to it, or a keyframe when one is due, other subscribers
+    // a keyframe.
+    auto queue_message(const std::shared_ptr<VersionedMessage>& message,
+                       TopicId topic,
+                       SendQueue::Clock::time_point now) -> void;
+
+    // Queues a single unfragmented frame with given payload.
+    auto queue_frame(Opcode opcode, std::span<const uint8_t> payload) -> void;
+
+    // Starts the closing handshake by sending a close frame; the connection
+    // is closed once it has been sent.
+    auto close(CloseCode close_code) -> void;
+
+    // Queues the answer to a query the peer sent; ignored unless the
+    // connection is open.
+    auto queue_answer(std::string_view answer) -> void;
+    // Returns the queries, such as history, the peer sent since the previous
+    // call, for the reactor to answer off its thread.
+    [[nodiscard]] auto has_queries() const -> bool { return !queries_.empty(); }
+    [[nodiscard]] auto take_queries() -> std::vector<std::string> { return std::exchange(queries_, {}); }
+
+    [[nodiscard]] auto subscriptions() const -> const Subscriptions& { return subscriptions_; }
+    // Returns whether the peer changed its subscriptions since the previous
+    // call, so that the reactor can update its index.
+    [[nodiscard]] auto take_subscriptions_changed() -> bool { return std::exchange(subscriptions_changed_, false); }
+    // Where the reactor's subscription index records the connection.
+    [[nodiscard]] auto index_membership() -> SubscriptionIndex::Membership& { return index_membership_; }
+
+    [[nodiscard]] auto has_pending_output() const -> bool { return !send_queue_.is_empty(); }
+    [[nodiscard]] auto send_queue() const -> const SendQueue& { return send_queue_; }
+
+    // Returns the next contiguous chunk of pending output. The memory stays
+    // valid and in place until on_sent() has consumed it, even when more
+    // output is queued meanwhile, so completion based reactors can hand it
+    // to the kernel as is.
+    [[nodiscard]] auto pending_output() const -> std::span<const uint8_t>;
+
+    // Marks given amount of bytes from pending_output() sent.
+    auto on_sent(size_t bytes_sent) -> void;
+
+    // True once the connection is closing and everything queued has been
+    // sent, or right away when the peer fell too far behind; the reactor
+    // closes the socket then.
+    [[nodiscard]] auto should_close() const -> bool {
+        return aborted_ || (state_ == State::CLOSING && !has_pending_output());
+    }
+
+    // Timer the reactor arms at next_deadline(); embedded so that keeping
+    // one timer per connection never allocates.
+    [[nodiscard]] auto timer() -> common::Timer& { return timer_; }
+
+    // Returns when on_timeout() has to be called next given the current
+    // state: the handshake deadline, the next ping or the pong deadline, the
+    // idle deadline or the end of the closing handshake.
+    [[nodiscard]] auto next_deadline() const -> Clock::time_point;
+
+    // Enforces whichever deadline passed by now. Sends a ping, starts the
+    // closing handshake or gives up on the peer, in which case should_close()
+    // holds afterwards. Does nothing when called before next_deadline().
+    auto on_timeout(Clock::time_point now) -> void;
 
     auto shutdown() noexcept -> void;
 
 private:
-    WebSocketClient(common::net::ClientSocket&& client_socket);
+    WebSocketClient(common::net::ClientSocket&& client_socket,
+                    SendQueue&& send_queue,
+                    const ConnectionTimeouts& timeouts,
+                    bool accepts_queries);
+
+    auto handle_handshake(std::span<uint8_t> data) -> common::ErrorOr<void>;
+    // The parser and the request bytes kept in the handshake chunk.
+    auto handshake_parser() -> HttpRequestParser&;
+    auto handshake_request() -> std::span<uint8_t>;
+    auto handle_frames(std::span<uint8_t> data) -> common::ErrorOr<void>;
+    // Queues given response and closes the connection once it has been sent.
+    auto reject_handshake(std::string_view response) -> void;
+    auto set_closing() -> void;
+    // Gives up on the peer; the reactor closes the socket without sending
+    // whatever is still queued.
+    auto abort(std::string_view reason) -> void;
 
-    auto thread_main() -> void;
+    auto on_message_data(Opcode opcode, std::span<const uint8_t> data, bool message_complete)
+        -> common::ErrorOr<void> override;
+    auto on_control_frame(Opcode opcode, std::span<const uint8_t> payload) -> common::ErrorOr<void> override;
+    // Handles a text message received in full.
+    auto handle_command(std::string_view command) -> void;
+    auto push_message(common::SharedBuffer frame, TopicId topic, SendQueue::Clock::time_point now) -> void;
+    auto push_control(common::SharedBuffer buffer) -> void;
 
     common::net::ClientSocket client_socket_;
-    std::jthread thread_;
-    volatile bool stop_requested_ = false;
+    State state_{State::HANDSHAKE};
+    WireFormat wire_format_{WireFormat::JSON};
+
+    // the upgrade request is parsed in place so its bytes are kept until the
+    // handshake is done, in a chunk of the buffer pool taken when the first
+    // bytes arrive and handed back right after; the chunk holds the parser
+    // followed by the request and never moves so views into it stay valid
+    // between reads
+    common::buffer_pool::Chunk handshake_chunk_;
+    size_t handshake_size_{0};
+
+    FrameDecoder frame_decoder_;
+    // size of the data message currently being received
+    uint64_t message_size_{0};
+
+    // text messages are commands; longer ones are rejected
+    static constexpr size_t MAX_COMMAND_SIZE = 256;
+    std::string command_;
+    bool command_too_large_{false};
+    Subscriptions subscriptions_;
+    bool subscriptions_changed_{false};
+    SubscriptionIndex::Membership index_membership_;
+    // queries are refused unless the reactor has a query function
+    bool accepts_queries_;
+    std::vector<std::string> queries_;
+
+    SendQueue send_queue_;
+    bool aborted_{false};
+
+    ConnectionTimeouts timeouts_;
+    common::Timer timer_;
+    Clock::time_point created_at_;
+    Clock::time_point last_received_at_;
+    Clock::time_point last_message_at_;
+    Clock::time_point closing_since_;
+    // set while a ping sent by us awaits an answer
+    std::optional<Clock::time_point> ping_sent_at_;
 };
 
 } // namespace ws
@@ -0,0 +1,252 @@
+#include "WebSocketEpollReactor.h"
+#include "../Common/Logging.h"
+#include <algorithm>
+
+using namespace common;
+using namespace common::net;
+using namespace ws;
+
+auto WebSocketEpollReactor::create(size_t shard_id,
+                                   ServerSocket&& server_socket,
+                                   const ConnectionSettings& connection_settings)
+    -> ErrorOr<std::unique_ptr<WebSocketEpollReactor>> {
+    auto event_loop = TRY(EventLoop::create());
+    TRY(event_loop.add(server_socket.socket().file_descriptor(), EPOLLIN | EPOLLET, LISTENER_TOKEN));
+    auto* reactor =
+        new WebSocketEpollReactor(shard_id, std::move(server_socket), connection_settings, std::move(event_loop));
+    return {std::unique_ptr<WebSocketEpollReactor>(reactor)};
+}
+
+WebSocketEpollReactor::WebSocketEpollReactor(size_t shard_id,
+                                             ServerSocket&& server_socket,
+                                             const ConnectionSettings& connection_settings,
+                                             EventLoop&& event_loop) :
+    WebSocketReactor(shard_id, std::move(server_socket), connection_settings),
+    event_loop_(std::move(event_loop)) {
+    accept_retry_timer_.set_user_data(LISTENER_TOKEN);
+}
+
+WebSocketEpollReactor::~WebSocketEpollReactor() noexcept {
+    shutdown();
+}
+
+auto WebSocketEpollReactor::wakeup() noexcept -> void {
+    event_loop_.wakeup();
+}
+
+auto WebSocketEpollReactor::run() -> void {
+    while (!stop_requested()) {
+        // sleep until the next timer is due at most; shutdown() wakes us up
+        // through the eventfd
+        auto timeout = timer_wheel_.time_until_next_tick(TimerWheel::Clock::now());
+        auto event_count = TRY_OR_THROW(event_loop_.wait(events_, static_cast<int>(timeout.count())));
+        for (size_t i = 0; i < event_count; ++i) {
+            auto token = events_[i].data.u64;
+            if (token == EventLoop::WAKEUP_TOKEN) {
+                deliver_broadcasts();
+                continue;
+            }
+            if (token == LISTENER_TOKEN) {
+                accept_clients();
+                continue;
+            }
+            handle_client_event(token, events_[i].events);
+        }
+        timer_wheel_.advance(TimerWheel::Clock::now(), [this](Timer& timer) { handle_timeout(timer.user_data()); });
+    }
+
+    clients_.clear();
+}
+
+auto WebSocketEpollReactor::accept_clients() -> void {
+    // edge-triggered; accept until the backlog is drained
+    while (true) {
+        auto error_or_client_socket = server_socket_.try_accept();
+        if (error_or_client_socket.is_error()) {
+            // most likely out of descriptors or memory, which closing
+            // connections frees up; the shard keeps serving those it has
+            if (!accept_paused_) {
+                LOG_WARN("Accepting connections failed, retrying in a while (shard: {}): {}",
+                         shard_id_,
+                         error_or_client_socket.error().error_message());
+                accept_paused_ = true;
+            }
+            timer_wheel_.schedule(accept_retry_timer_, TimerWheel::Clock::now() + ACCEPT_RETRY_DELAY);
+            return;
+        }
+        if (accept_paused_) {
+            LOG_INFO("Accepting connections again (shard: {})", shard_id_);
+            accept_paused_ = false;
+            timer_wheel_.cancel(accept_retry_timer_);
+        }
+        auto maybe_client_socket = error_or_client_socket.release_value();
+        if (!maybe_client_socket.has_value()) {
+            return;
+        }
+
+        auto client_socket = std::move(maybe_client_socket.value());
+        LOG_INFO("Client connected from {} (shard: {})", client_socket.remote_address().to_string(), shard_id_);
+
+        auto [token, client] = clients_.emplace(create_client(std::move(client_socket)));
+        auto error_or_void =
+            event_loop_.add(client.file_descriptor(), EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, token);
+        if (error_or_void.is_error()) {
+            LOG_ERROR("Registering client ({}) failed: {}",
+                      client.client_socket().remote_address().to_string(),
+                      error_or_void.error().error_message());
+            clients_.erase(token);
+            continue;
+        }
+        client.timer().set_user_data(token);
+        schedule_timeout(client);
+        set_connection_count(clients_.size());
+    }
+}
+
+auto WebSocketEpollReactor::handle_client_event(uint64_t token, uint32_t events) -> void {
+    auto* client_or_null = clients_.find(token);
+    if (client_or_null == nullptr) {
+        // closed earlier during this same batch of events
+        return;
+    }
+    auto& client = *client_or_null;
+
+    if ((events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR)) != 0) {
+        auto error_or_void = client.on_readable(read_buffer_);
+        if (error_or_void.is_error()) {
+            if (!error_or_void.is_closed_error()) {
+                LOG_ERROR("Communication with client ({}) failed: {}",
+                          client.client_socket().remote_address().to_string(),
+                          error_or_void.error().error_message());
+            }
+            close_client(token);
+            return;
+        }
+        update_subscriptions(token, client);
+        dispatch_queries(token, client);
+    }
+
+    // output queued while handling input has to be flushed right away since
+    // an edge-triggered EPOLLOUT only fires once the socket buffer drains
+    if ((events & EPOLLOUT) != 0 || client.has_pending_output()) {
+        auto error_or_void = client.on_writable();
+        if (error_or_void.is_error()) {
+            LOG_ERROR("Communication with client ({}) failed: {}",
+                      client.client_socket().remote_address().to_string(),
+                      error_or_void.error().error_message());
+            close_client(token);
+            return;
+        }
+    }
+
+    if (client.should_close()) {
+        close_client(token);
+        return;
+    }
+    schedule_timeout(client);
+}
+
+auto WebSocketEpollReactor::handle_timeout(uint64_t token) -> void {
+    if (token == LISTENER_TOKEN) {
+        accept_clients();
+        return;
+    }
+    auto* client_or_null = clients_.find(token);
+    if (client_or_null == nullptr) {
+        return;
+    }
+    auto& client = *client_or_null;
+    client.on_timeout(TimerWheel::Clock::now());
+    if (client.should_close()) {
+        close_client(token);
+        return;
+    }
+    // flush the ping or close frame queued by the timeout
+    auto error_or_void = client.on_writable();
+    if (error_or_void.is_error()) {
+        LOG_ERROR("Communication with client ({}) failed: {}",
+                  client.client_socket().remote_address().to_string(),
+                  error_or_void.error().error_message());
+        close_client(token);
+        return;
+    }
+    if (client.should_close()) {
+        close_client(token);
+        return;
+    }
+    schedule_timeout(client);
+}
+
+auto WebSocketEpollReactor::deliver_broadcasts() -> void {
+    take_broadcasts(broadcasts_);
+    if (broadcasts_.empty()) {
+        return;
+    }
+
+    auto now = SendQueue::Clock::now();
+    for (const auto& broadcast : broadcasts_) {
+        if (broadcast.token != 0) {
+            if (auto* client = clients_.find(broadcast.token); client != nullptr) {
+                deliver(*client, broadcast, now);
+                clients_to_flush_.push_back(broadcast.token);
+            }
+            continue;
+        }
+        if (broadcast.topic == NO_TOPIC) {
+            clients_.for_each([&](uint64_t token, WebSocketClient& client) {
+                deliver(client, broadcast, now);
+                clients_to_flush_.push_back(token);
+            });
+            continue;
+        }
+        for (auto token : subscription_index_.subscribers(broadcast.topic)) {
+            if (auto* client = clients_.find(token); client != nullptr) {
+                deliver(*client, broadcast, now);
+                clients_to_flush_.push_back(token);
+            }
+        }
+    }
+    broadcasts_.clear();
+
+    // flush every connection once however many frames it got
+    std::sort(clients_to_flush_.begin(), clients_to_flush_.end());
+    clients_to_flush_.erase(std::unique(clients_to_flush_.begin(), clients_to_flush_.end()), clients_to_flush_.end());
+    for (auto token : clients_to_flush_) {
+        auto* client_or_null = clients_.find(token);
+        if (client_or_null == nullptr) {
+            continue;
+        }
+        auto& client = *client_or_null;
+        if (client.should_close()) {
+            close_client(token);
+            continue;
+        }
+        auto error_or_void = client.on_writable();
+        if (error_or_void.is_error()) {
+            LOG_ERROR("Communication with client ({}) failed: {}",
+                      client.client_socket().remote_address().to_string(),
+                      error_or_void.error().error_message());
+            close_client(token);
+        }
+    }
+    clients_to_flush_.clear();
+}
+
+auto WebSocketEpollReactor::close_client(uint64_t token) -> void {
+    auto* client = clients_.find(token);
+    if (client == nullptr) {
+        return;
+    }
+    LOG_INFO("Client ({}) disconnected", client->client_socket().remote_address().to_string());
+    // closing the descriptor removes it from the epoll set as well but be
+    // explicit about it in case the descriptor has been duplicated
+    [[maybe_unused]] auto error_or_void = event_loop_.remove(client->file_descriptor());
+    remove_subscriptions(*client);
+    clients_.erase(token);
+    set_connection_count(clients_.size());
+    if (accept_paused_) {
+        // the descriptor just freed may be what accepting lacked; retried on
+        // the next tick rather than here, where callers may be iterating
+        timer_wheel_.schedule(accept_retry_timer_, TimerWheel::Clock::now());
+    }
+}
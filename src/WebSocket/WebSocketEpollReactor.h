@@ -0,0 +1,65 @@
+#pragma once
+
+#include "../Common/Error.h"
+#include "../Common/Net/EventLoop.h"
+#include "../Common/Net/ServerSocket.h"
+#include "../Common/Slab.h"
+#include "WebSocketClient.h"
+#include "WebSocketReactor.h"
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <sys/epoll.h>
+#include <vector>
+
+namespace ws {
+
+// WebSocketEpollReactor waits for readiness of the listener and every
+// connection in an edge-triggered epoll loop and performs the I/O itself with
+// non-blocking recv() and send() calls.
+class WebSocketEpollReactor final : public WebSocketReactor {
+public:
+    static auto create(size_t shard_id,
+                       common::net::ServerSocket&& server_socket,
+                       const ConnectionSettings& connection_settings = {})
+        -> common::ErrorOr<std::unique_ptr<WebSocketEpollReactor>>;
+
+    ~WebSocketEpollReactor() noexcept override;
+
+    [[nodiscard]] auto io_backend() const -> IoBackend override { return IoBackend::EPOLL; }
+
+private:
+    // token used for the listening socket; client tokens are their handles
+    // in clients_, which are never zero
+    static constexpr uint64_t LISTENER_TOKEN = common::Slab<WebSocketClient>::NO_HANDLE;
+
+    WebSocketEpollReactor(size_t shard_id,
+                          common::net::ServerSocket&& server_socket,
+                          const ConnectionSettings& connection_settings,
+                          common::net::EventLoop&& event_loop);
+
+    auto run() -> void override;
+    auto wakeup() noexcept -> void override;
+
+    auto accept_clients() -> void;
+    auto handle_client_event(uint64_t token, uint32_t events) -> void;
+    auto handle_timeout(uint64_t token) -> void;
+    auto deliver_broadcasts() -> void;
+    auto close_client(uint64_t token) -> void;
+
+    common::net::EventLoop event_loop_;
+    common::Slab<WebSocketClient> clients_;
+    std::array<struct epoll_event, 256> events_{};
+    // scratch buffer shared by all connections of this reactor; connections
+    // only keep the bytes they could not consume yet
+    std::array<uint8_t, 16384> read_buffer_{};
+    // reused between wakeups so delivering broadcasts doesn't allocate
+    std::vector<Broadcast> broadcasts_;
+    std::vector<uint64_t> clients_to_flush_;
+    // set while accepting is paused after it failed; the connections left in
+    // the backlog raise no new edge, so accept_retry_timer_ retries
+    bool accept_paused_{false};
+    common::Timer accept_retry_timer_;
+};
+
+} // namespace ws
@@ -0,0 +1,286 @@
+#include "WebSocketReactor.h"
+#include "../Common/Logging.h"
+#include "WebSocketEpollReactor.h"
+#include "WebSocketUringReactor.h"
+#include <bit>
+#include <pthread.h>
+#include <sched.h>
+
+using namespace common;
+using namespace common::net;
+using namespace ws;
+
+static_assert(MAX_TOPICS <= 32, "published_topics_ has a bit per topic");
+
+auto ws::format_io_backend(IoBackend io_backend) -> std::string_view {
+    switch (io_backend) {
+    case IoBackend::EPOLL:
+        return "epoll";
+    case IoBackend::IO_URING:
+        return "io_uring";
+    }
+    VERIFY_NOT_REACHED();
+}
+
+auto WebSocketReactor::create(IoBackend io_backend,
+                              size_t shard_id,
+                              ServerSocket&& server_socket,
+                              const ConnectionSettings& connection_settings)
+    -> ErrorOr<std::unique_ptr<WebSocketReactor>> {
+    if (io_backend == IoBackend::IO_URING) {
+        // server_socket is only moved from once the io_uring resources have
+        // been set up so it is still ours to use when this fails
+        auto error_or_reactor = WebSocketUringReactor::create(shard_id, std::move(server_socket), connection_settings);
+        if (error_or_reactor.is_value()) {
+            return {error_or_reactor.release_value()};
+        }
+        LOG_WARN("io_uring not available, falling back to epoll (shard: {}): {}",
+                 shard_id,
+                 error_or_reactor.error().error_message());
+    }
+    return {TRY(WebSocketEpollReactor::create(shard_id, std::move(server_socket), connection_settings))};
+}
+
+WebSocketReactor::WebSocketReactor(size_t shard_id,
+                                   ServerSocket&& server_socket,
+                                   const ConnectionSettings& connection_settings) :
+    shard_id_(shard_id),
+    server_socket_(std::move(server_socket)),
+    connection_settings_(connection_settings) {}
+
+auto WebSocketReactor::attach_publications(std::span<const std::unique_ptr<MessagePublication>> publications)
+    -> void {
+    VERIFY(!is_running());
+    VERIFY(publications.size() <= MAX_TOPICS);
+    for (const auto& publication : publications) {
+        VERIFY(publication->reader_count() > shard_id_);
+    }
+    publications_ = publications;
+}
+
+auto WebSocketReactor::start(std::optional<unsigned int> cpu) -> void {
+    if (connection_settings_.query_function) {
+        query_thread_ = std::jthread([this](std::stop_token stop_token) { query_thread_main(std::move(stop_token)); });
+    }
+    thread_ = std::jthread(&WebSocketReactor::thread_main, this, cpu);
+}
+
+auto WebSocketReactor::shutdown() noexcept -> void {
+    // swap this instances thread_ with a local dummy/empty thread;
+    // this makes the shutdown process a bit more thread-safe
+    std::jthread actual_thread;
+    actual_thread.swap(thread_);
+
+    // answers wake the reactor up, which has to be in place until the query
+    // thread is gone
+    std::jthread query_thread;
+    query_thread.swap(query_thread_);
+    if (query_thread.joinable()) {
+        query_thread.request_stop();
+        try {
+            query_thread.join();
+        } catch (const std::exception& e) {
+            LOG_ERROR("join() failed: {}", e.what());
+        }
+    }
+
+    if (actual_thread.joinable()) {
+        LOG_INFO("Shutting down reactor (shard: {})", shard_id_);
+        stop_requested_ = true;
+        wakeup();
+        try {
+            actual_thread.join();
+        } catch (const std::exception& e) {
+            LOG_ERROR("join() failed: {}", e.what());
+        }
+    }
+}
+
+auto WebSocketReactor::broadcast(const SharedBuffer& frame, TopicId topic) -> void {
+    push_broadcast({frame, nullptr, topic});
+}
+
+auto WebSocketReactor::notify_published(TopicId topic) -> void {
+    VERIFY(topic < publications_.size());
+    // a wakeup is already on its way when other topics were published to
+    if (published_topics_.fetch_or(uint32_t{1} << topic, std::memory_order_acq_rel) == 0) {
+        wakeup();
+    }
+}
+
+auto WebSocketReactor::push_broadcast(Broadcast&& broadcast) -> void {
+    bool was_idle;
+    {
+        std::lock_guard lock(broadcasts_mutex_);
+        was_idle = pending_broadcasts_.empty();
+        pending_broadcasts_.push_back(std::move(broadcast));
+        has_pending_broadcasts_.store(true, std::memory_order_release);
+    }
+    // a wakeup is already on its way when frames were pending
+    if (was_idle) {
+        wakeup();
+    }
+}
+
+auto WebSocketReactor::take_broadcasts(std::vector<Broadcast>& broadcasts) -> void {
+    VERIFY(broadcasts.empty());
+    // frames pushed after the flag was cleared set it again, and wake the
+    // reactor up should none have been pending
+    if (has_pending_broadcasts_.exchange(false, std::memory_order_acquire)) {
+        std::lock_guard lock(broadcasts_mutex_);
+        broadcasts.swap(pending_broadcasts_);
+    }
+
+    auto topics = published_topics_.exchange(0, std::memory_order_acq_rel);
+    for (; topics != 0; topics &= topics - 1) {
+        auto topic = static_cast<TopicId>(std::countr_zero(topics));
+        const auto& publication = *publications_[topic];
+        // notified twice for a message taken already
+        if (publication.version() == taken_versions_[topic]) {
+            continue;
+        }
+        auto published = publication.load(shard_id_);
+        taken_versions_[topic] = published.version;
+        broadcasts.push_back({{}, std::move(published.value), topic});
+    }
+}
+
+auto WebSocketReactor::deliver(WebSocketClient& client,
+                               const Broadcast& broadcast,
+                               SendQueue::Clock::time_point now) -> void {
+    if (broadcast.token != 0) {
+        client.queue_answer(broadcast.answer);
+    } else if (broadcast.message != nullptr) {
+        client.queue_message(broadcast.message, broadcast.topic, now);
+    } else {
+        client.queue_message(broadcast.frame, broadcast.topic, now);
+    }
+}
+
+auto WebSocketReactor::create_client(ClientSocket&& client_socket) -> WebSocketClient {
+    return WebSocketClient::create(std::move(client_socket), connection_settings_, &send_queue_counters_);
+}
+
+auto WebSocketReactor::schedule_timeout(WebSocketClient& client) -> void {
+    auto deadline = client.next_deadline();
+    if (deadline == WebSocketClient::Clock::time_point::max()) {
+        // pings and the idle timeout are disabled
+        timer_wheel_.cancel(client.timer());
+        return;
+    }
+    timer_wheel_.schedule(client.timer(), deadline);
+}
+
+auto WebSocketReactor::topic_interval(TopicId topic) const -> std::chrono::milliseconds {
+    if (topic >= MAX_TOPICS) {
+        return std::chrono::milliseconds(0);
+    }
+    return std::chrono::milliseconds(topic_intervals_[topic].load(std::memory_order_relaxed));
+}
+
+auto WebSocketReactor::update_subscriptions(uint64_t token, WebSocketClient& client) -> void {
+    if (!client.take_subscriptions_changed()) {
+        return;
+    }
+    // topics the connection left or joined; the others can't have changed
+    auto& membership = client.index_membership();
+    auto changed = membership.mask | client.subscriptions().mask();
+    subscription_index_.update(token, membership, client.subscriptions());
+    for (; changed != 0; changed &= changed - 1) {
+        publish_topic_interval(static_cast<TopicId>(std::countr_zero(changed)));
+    }
+}
+
+auto WebSocketReactor::remove_subscriptions(WebSocketClient& client) -> void {
+    auto mask = client.index_membership().mask;
+    subscription_index_.remove(client.index_membership());
+    for (; mask != 0; mask &= mask - 1) {
+        publish_topic_interval(static_cast<TopicId>(std::countr_zero(mask)));
+    }
+}
+
+auto WebSocketReactor::dispatch_queries(uint64_t token, WebSocketClient& client) -> void {
+    if (!client.has_queries()) {
+        return;
+    }
+    size_t refused = 0;
+    {
+        std::lock_guard lock(queries_mutex_);
+        for (auto& command : client.take_queries()) {
+            if (queued_queries_.size() == MAX_QUEUED_QUERIES) {
+                ++refused;
+                continue;
+            }
+            queued_queries_.push_back({token, std::move(command)});
+        }
+    }
+    queries_condition_.notify_one();
+    for (; refused > 0; --refused) {
+        client.queue_answer(R"({"error":"too many queries"})");
+    }
+}
+
+auto WebSocketReactor::query_thread_main(std::stop_token stop_token) -> void {
+    LOG_DEBUG("WebSocketReactor::query_thread_main(): start (shard: {})", shard_id_);
+    while (true) {
+        Query query;
+        {
+            std::unique_lock lock(queries_mutex_);
+            if (!queries_condition_.wait(lock, stop_token, [this] { return !queued_queries_.empty(); })) {
+                break;
+            }
+            query = std::move(queued_queries_.front());
+            queued_queries_.pop_front();
+        }
+        // a query failing takes the thread down for no other one
+        try {
+            push_broadcast({{}, nullptr, NO_TOPIC, answer_query(query.command), query.token});
+        } catch (const std::exception& e) {
+            LOG_ERROR("Exception in query_thread_main(): {}", e.what());
+        }
+    }
+    LOG_DEBUG("WebSocketReactor::query_thread_main(): exit (shard: {})", shard_id_);
+}
+
+auto WebSocketReactor::answer_query(std::string_view query) const -> std::string {
+    // the connection parsed the command successfully before queuing it
+    auto command = MUST(parse_subscription_command(query));
+    auto error_or_answer = connection_settings_.query_function(command);
+    if (error_or_answer.is_error()) {
+        return fmt::format(R"({{"error":"{}"}})", error_or_answer.error().error_message());
+    }
+    return error_or_answer.release_value();
+}
+
+auto WebSocketReactor::publish_topic_interval(TopicId topic) -> void {
+    auto interval = subscription_index_.fastest_interval(topic);
+    topic_intervals_[topic].store(static_cast<uint32_t>(interval.count()), std::memory_order_relaxed);
+}
+
+auto WebSocketReactor::thread_main(std::optional<unsigned int> cpu) -> void {
+    LOG_DEBUG("WebSocketReactor::thread_main(): start (shard: {}, backend: {})",
+              shard_id_,
+              format_io_backend(io_backend()));
+
+    if (cpu.has_value()) {
+        cpu_set_t cpu_set;
+        CPU_ZERO(&cpu_set);
+        CPU_SET(cpu.value(), &cpu_set);
+        // not fatal; the shard just floats between cores like any other thread
+        auto rc = ::pthread_setaffinity_np(::pthread_self(), sizeof(cpu_set), &cpu_set);
+        if (rc != 0) {
+            auto error = Error::from_errno(rc, "pthread_setaffinity_np()", ErrorDomain::CORE);
+            LOG_WARN("Pinning reactor (shard: {}) to CPU {} failed: {}", shard_id_, cpu.value(), error.error_message());
+        }
+    }
+
+    try {
+        run();
+    } catch (const std::exception& e) {
+        LOG_ERROR("Exception in thread_main(): {}", e.what());
+    }
+
+    server_socket_.close(); // stop accepting incoming connections
+    set_connection_count(0);
+    LOG_DEBUG("WebSocketReactor::thread_main(): exit (shard: {})", shard_id_);
+}
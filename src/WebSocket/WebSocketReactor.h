@@ -0,0 +1,217 @@
+#pragma once
+
+#include "../Common/Error.h"
+#include "../Common/Net/ServerSocket.h"
+#include "../Common/Publication.h"
+#include "../Common/SharedBuffer.h"
+#include "../Common/TimerWheel.h"
+#include "SendQueue.h"
+#include "Subscriptions.h"
+#include "VersionedMessage.h"
+#include "WebSocketClient.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <span>
+#include <stop_token>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace ws {
+
+enum class IoBackend : int {
+    EPOLL = 1,
+    IO_URING = 2,
+};
+
+auto format_io_backend(IoBackend io_backend) -> std::string_view;
+
+// The latest message of a topic, published by the server and read by every
+// reactor with the reader index of its shard.
+using MessagePublication = common::Publication<VersionedMessage>;
+
+// WebSocketReactor drives a listening socket and all connections accepted
+// from it with a single thread. Reactors share nothing with each other; a
+// server runs one reactor per shard, each with its own SO_REUSEPORT listener,
+// and lets the kernel spread incoming connections across them.
+//
+// How the reactor waits for and performs I/O is left to the subclasses:
+// WebSocketEpollReactor uses readiness notifications from epoll while
+// WebSocketUringReactor hands the I/O itself to io_uring.
+//
+// Instances are not movable since the reactor thread holds a pointer to the
+// instance for its whole lifetime; owners keep them behind a std::unique_ptr.
+class WebSocketReactor {
+public:
+    // Creates a reactor using given I/O backend. When io_uring is requested
+    // but not usable on this host the epoll backend is used instead.
+    static auto create(IoBackend io_backend,
+                       size_t shard_id,
+                       common::net::ServerSocket&& server_socket,
+                       const ConnectionSettings& connection_settings = {})
+        -> common::ErrorOr<std::unique_ptr<WebSocketReactor>>;
+
+    WebSocketReactor(const WebSocketReactor&) = delete;
+    WebSocketReactor(WebSocketReactor&&) noexcept = delete;
+    virtual ~WebSocketReactor() noexcept = default;
+
+    auto operator=(const WebSocketReactor&) -> WebSocketReactor& = delete;
+    auto operator=(WebSocketReactor&&) noexcept -> WebSocketReactor& = delete;
+
+    [[nodiscard]] virtual auto io_backend() const -> IoBackend = 0;
+    [[nodiscard]] auto is_running() const -> bool { return thread_.joinable(); }
+    [[nodiscard]] auto server_socket() const -> const common::net::ServerSocket& { return server_socket_; }
+    [[nodiscard]] auto shard_id() const -> size_t { return shard_id_; }
+    // Number of connections currently owned by this reactor. Safe to call
+    // from any thread.
+    [[nodiscard]] auto connection_count() const -> size_t {
+        return connection_count_.load(std::memory_order_relaxed);
+    }
+    // How often the send queue policies fired on this reactor's connections.
+    // Safe to call from any thread.
+    [[nodiscard]] auto send_queue_statistics() const -> SendQueueStatistics { return snapshot(send_queue_counters_); }
+    // Shortest interval any connection of this reactor subscribed to given
+    // topic with; zero when the topic has no subscribers here. Safe to call
+    // from any thread.
+    [[nodiscard]] auto topic_interval(TopicId topic) const -> std::chrono::milliseconds;
+
+    // Makes the reactor deliver the messages published to given
+    // publications, one per topic indexed by topic id. Must be called before
+    // start(); the publications must outlive the reactor.
+    auto attach_publications(std::span<const std::unique_ptr<MessagePublication>> publications) -> void;
+
+    // Starts the reactor thread. When cpu is given the thread is pinned to
+    // that CPU so the connections of this shard stay on a single core.
+    auto start(std::optional<unsigned int> cpu = std::nullopt) -> void;
+
+    // Queues an encoded frame on every open connection of this reactor, or
+    // only on the topic's subscribers when a topic is given. The frame is
+    // queued by reference, never copied. Safe to call from any thread; the
+    // reactor thread picks the frame up on its next wakeup.
+    auto broadcast(const common::SharedBuffer& frame, TopicId topic = NO_TOPIC) -> void;
+    // Tells the reactor that a message was published for given topic. On its
+    // next wakeup the reactor hands the latest message of the topic to its
+    // subscribers, see WebSocketClient::queue_message(); messages superseded
+    // by then are skipped. Wait-free and safe to call from any thread.
+    auto notify_published(TopicId topic) -> void;
+
+    // Stops and joins the reactor thread. Subclasses must call this from
+    // their destructor so that the thread is gone before their state is.
+    auto shutdown() noexcept -> void;
+
+protected:
+    struct Broadcast {
+        // either frame or message is set, or answer for the answer to a
+        // query, which only goes to the connection of given token
+        common::SharedBuffer frame;
+        std::shared_ptr<VersionedMessage> message;
+        TopicId topic;
+        std::string answer{};
+        // zero unless answer is set; tokens never are
+        uint64_t token{0};
+    };
+
+    // after accepting failed, say for want of descriptors or memory, it is
+    // retried this much later, or as soon as a connection closes
+    static constexpr auto ACCEPT_RETRY_DELAY = std::chrono::milliseconds(250);
+
+    WebSocketReactor(size_t shard_id,
+                     common::net::ServerSocket&& server_socket,
+                     const ConnectionSettings& connection_settings);
+
+    // Runs the event loop until stop_requested() holds. Called on the reactor
+    // thread; connections must be closed before returning.
+    virtual auto run() -> void = 0;
+
+    // Wakes up the reactor thread blocked in run(). Called from other threads.
+    virtual auto wakeup() noexcept -> void = 0;
+
+    [[nodiscard]] auto stop_requested() const -> bool { return stop_requested_.load(std::memory_order_relaxed); }
+    auto set_connection_count(size_t count) -> void { connection_count_.store(count, std::memory_order_relaxed); }
+
+    // Moves frames broadcast since the previous call into given (empty)
+    // vector, followed by the latest message of every topic published to
+    // since. Swapping vectors keeps their capacity, so a reactor passing the
+    // same vector every time doesn't allocate in the steady state. Only
+    // takes a lock when frames were broadcast.
+    auto take_broadcasts(std::vector<Broadcast>& broadcasts) -> void;
+
+    // Queues given broadcast on the client.
+    static auto deliver(WebSocketClient& client, const Broadcast& broadcast, SendQueue::Clock::time_point now) -> void;
+
+    // Creates the state of a newly accepted connection.
+    auto create_client(common::net::ClientSocket&& client_socket) -> WebSocketClient;
+
+    // Arms the client's timer at its next deadline; the timer's user data
+    // must identify the connection to the subclass.
+    auto schedule_timeout(WebSocketClient& client) -> void;
+
+    // Records the client's subscriptions in the index if the peer changed
+    // them since the previous call.
+    auto update_subscriptions(uint64_t token, WebSocketClient& client) -> void;
+    auto remove_subscriptions(WebSocketClient& client) -> void;
+    // Hands the queries the client received to the query thread. Answers
+    // come back as broadcasts to given token.
+    auto dispatch_queries(uint64_t token, WebSocketClient& client) -> void;
+
+    size_t shard_id_;
+    common::net::ServerSocket server_socket_;
+    ConnectionSettings connection_settings_;
+    SendQueueCounters send_queue_counters_;
+    // one timer per connection, re-armed to its next deadline whenever it
+    // fires; bounds how long the event loop may block
+    common::TimerWheel timer_wheel_;
+    SubscriptionIndex subscription_index_;
+
+private:
+    struct Query {
+        uint64_t token;
+        std::string command;
+    };
+
+    // queries beyond this many waiting are refused
+    static constexpr size_t MAX_QUEUED_QUERIES = 64;
+
+    auto thread_main(std::optional<unsigned int> cpu) -> void;
+    // Publishes the topic's fastest interval for topic_interval().
+    auto publish_topic_interval(TopicId topic) -> void;
+    auto push_broadcast(Broadcast&& broadcast) -> void;
+    // Answers queries with the query function until asked to stop, so that
+    // answers taking milliseconds hold up neither the connections of the
+    // shard nor the sampler recording the history.
+    auto query_thread_main(std::stop_token stop_token) -> void;
+    auto answer_query(std::string_view query) const -> std::string;
+
+    std::atomic<size_t> connection_count_{0};
+    std::atomic<bool> stop_requested_{false};
+    // in milliseconds
+    std::array<std::atomic<uint32_t>, MAX_TOPICS> topic_intervals_{};
+
+    std::mutex broadcasts_mutex_;
+    std::vector<Broadcast> pending_broadcasts_;
+    // set along with pending_broadcasts_ growing, under the lock
+    std::atomic<bool> has_pending_broadcasts_{false};
+
+    std::span<const std::unique_ptr<MessagePublication>> publications_;
+    // a bit per topic published to since take_broadcasts() last looked
+    std::atomic<uint32_t> published_topics_{0};
+    // version of the publication last taken, per topic
+    std::array<uint64_t, MAX_TOPICS> taken_versions_{};
+
+    std::mutex queries_mutex_;
+    std::condition_variable_any queries_condition_;
+    std::deque<Query> queued_queries_;
+    std::jthread query_thread_{};
+
+    std::jthread thread_{};
+};
+
+} // namespace ws
@@ -1,102 +1,158 @@
 #include "WebSocketServer.h"
 #include "../Common/Logging.h"
-#include <chrono>
+#include <algorithm>
+#include <sched.h>
+#include <thread>
 
 using namespace common;
 using namespace common::net;
 using namespace ws;
 
-auto WebSocketServer::create(uint16_t port, const std::string& address) -> ErrorOr<WebSocketServer> {
-    auto listen_address = IpSocketAddress::from_ipv4_address(address, port);
-    auto server_socket = TRY(ServerSocket::listen(listen_address));
-    auto server_socket_ptr = std::make_unique<ServerSocket>(std::move(server_socket));
-    WebSocketServer server{std::move(server_socket_ptr)};
-    server.start_threads();
-    return {std::move(server)};
+// Returns the CPUs this process may run on, which a cpuset or taskset may
+// narrow down to fewer than the machine has, and which need not be numbered
+// from zero.
+static auto allowed_cpus() -> std::vector<unsigned int> {
+    std::vector<unsigned int> cpus;
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    if (::sched_getaffinity(0, sizeof(cpu_set), &cpu_set) == 0) {
+        cpus.reserve(static_cast<size_t>(CPU_COUNT(&cpu_set)));
+        for (unsigned int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+            if (CPU_ISSET(cpu, &cpu_set)) {
+                cpus.push_back(cpu);
+            }
+        }
+    }
+    if (cpus.empty()) {
+        // more CPUs than a cpu_set_t holds; hardware_concurrency() may
+        // return 0 when it can't tell either
+        for (unsigned int cpu = 0; cpu < std::max(1U, std::thread::hardware_concurrency()); ++cpu) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
 }
 
-WebSocketServer::WebSocketServer(std::unique_ptr<ServerSocket>&& server_socket) :
-    server_socket_(std::move(server_socket)),
-    clients_(std::make_unique<std::vector<WebSocketClient>>()),
-    stop_requested_(std::make_unique<bool>(false)) {}
+auto WebSocketServer::create(uint16_t port,
+                             const std::string& address,
+                             size_t reactor_count,
+                             IoBackend io_backend,
+                             const ConnectionSettings& connection_settings) -> ErrorOr<WebSocketServer> {
+    const auto pin_to_cpus = reactor_count == 0;
+    std::vector<unsigned int> cpus;
+    if (pin_to_cpus) {
+        cpus = allowed_cpus();
+        reactor_count = cpus.size();
+    }
 
-WebSocketServer::~WebSocketServer() noexcept {
-    // shutdown();
-}
+    auto listen_address = IpSocketAddress::from_ipv4_address(address, port);
 
-auto WebSocketServer::shutdown() noexcept -> void {
-    LOG_INFO("Server shutdown requested");
+    // bind all listeners before starting any reactor so that a failing bind()
+    // doesn't leave a partially running server behind
+    std::vector<std::unique_ptr<WebSocketReactor>> reactors;
+    reactors.reserve(reactor_count);
+    for (size_t shard_id = 0; shard_id < reactor_count; ++shard_id) {
+        auto server_socket = TRY(ServerSocket::listen(listen_address));
+        reactors.push_back(
+            TRY(WebSocketReactor::create(io_backend, shard_id, std::move(server_socket), connection_settings)));
+    }
 
-    // swap this instances main_thread_ with a local dummy/empty thread;
-    // this makes the shutdown process a bit more thread-safe
-    std::jthread actual_main_thread;
-    actual_main_thread.swap(main_thread_);
+    std::vector<std::unique_ptr<MessagePublication>> publications;
+    for (size_t topic = 0; topic < MAX_TOPICS; ++topic) {
+        publications.push_back(std::make_unique<MessagePublication>(reactor_count));
+    }
+    for (auto& reactor : reactors) {
+        reactor->attach_publications(publications);
+        auto cpu = pin_to_cpus ? std::optional<unsigned int>(cpus[reactor->shard_id()]) : std::nullopt;
+        reactor->start(cpu);
+    }
+    LOG_INFO("Started {} reactor shard(s) using {} (send queue policy: {}, {} bytes, {} ms)",
+             reactors.size(),
+             format_io_backend(reactors.front()->io_backend()),
+             format_overflow_policy(connection_settings.send_queue.policy),
+             connection_settings.send_queue.max_bytes,
+             connection_settings.send_queue.max_age.count());
+    LOG_INFO("Connection timeouts: handshake {} ms, ping interval {} ms, pong {} ms, idle {} ms",
+             connection_settings.timeouts.handshake_timeout.count(),
+             connection_settings.timeouts.ping_interval.count(),
+             connection_settings.timeouts.pong_timeout.count(),
+             connection_settings.timeouts.idle_timeout.count());
+
+    return {WebSocketServer(std::move(publications), std::move(reactors))};
+}
 
-    std::jthread actual_recycle_clients_thread;
-    actual_recycle_clients_thread.swap(recycle_clients_thread_);
+WebSocketServer::WebSocketServer(std::vector<std::unique_ptr<MessagePublication>>&& publications,
+                                 std::vector<std::unique_ptr<WebSocketReactor>>&& reactors) :
+    publications_(std::move(publications)),
+    reactors_(std::move(reactors)) {}
 
-    if (actual_main_thread.joinable()) {
-        LOG_INFO("Shutting down server");
+WebSocketServer::~WebSocketServer() noexcept {
+    shutdown();
+}
 
-        *stop_requested_ = true;
-        server_socket_->close(); // stop accepting incoming connections
-        try {
-            actual_main_thread.join();
-        } catch (const std::exception& e) {
-            LOG_ERROR("join() failed: ", e.what());
-        }
+auto WebSocketServer::is_running() const -> bool {
+    return std::any_of(reactors_.begin(), reactors_.end(), [](const auto& reactor) { return reactor->is_running(); });
+}
 
-        try {
-            actual_recycle_clients_thread.join();
-        } catch (const std::exception& e) {
-            LOG_ERROR("join() failed: ", e.what());
-        }
+auto WebSocketServer::connection_counts() const -> std::vector<size_t> {
+    std::vector<size_t> counts;
+    counts.reserve(reactors_.size());
+    for (const auto& reactor : reactors_) {
+        counts.push_back(reactor->connection_count());
     }
+    return counts;
 }
 
-auto WebSocketServer::start_threads() -> void {
-    // FIXME using this doesn't work
-    main_thread_ = std::jthread(&WebSocketServer::thread_main, this);
-    recycle_clients_thread_ = std::jthread(&WebSocketServer::thread_recycle_clients, this);
+auto WebSocketServer::broadcast(Opcode opcode, std::span<const uint8_t> payload, TopicId topic) -> void {
+    broadcast(make_frame(opcode, payload), topic);
 }
 
-auto WebSocketServer::thread_main() -> void {
-    LOG_DEBUG("WebSocketServer::thread_main(): start");
-    try {
-        LOG_DEBUG("WebSocketServer::thread_main(): stop_requested_={}", stop_requested_);
-        while (!stop_requested_) {
-            LOG_DEBUG("Waiting for next client connection");
-            auto error_or_client_socket = server_socket_->accept(1000);
-            if (error_or_client_socket.is_timeout_error()) {
-                continue;
-            }
-            if (error_or_client_socket.is_error()) {
-                RAISE(error_or_client_socket.error());
-            }
-
-            auto client_socket = error_or_client_socket.release_value();
-            LOG_INFO("Client connected from {}", client_socket.remote_address().to_string());
+auto WebSocketServer::broadcast(const SharedBuffer& frame, TopicId topic) -> void {
+    // one hand-off per shard; each reactor fans out to its own connections
+    for (auto& reactor : reactors_) {
+        // don't wake up shards without subscribers
+        if (topic != NO_TOPIC && reactor->topic_interval(topic).count() == 0) {
+            continue;
+        }
+        reactor->broadcast(frame, topic);
+    }
+}
 
-            auto ws_client = WebSocketClient::create(std::move(client_socket));
-            clients_.push_back(std::move(ws_client));
+auto WebSocketServer::broadcast(const std::shared_ptr<VersionedMessage>& message, TopicId topic) -> void {
+    VERIFY(topic < publications_.size());
+    publications_[topic]->publish(message);
+    for (auto& reactor : reactors_) {
+        if (reactor->topic_interval(topic).count() == 0) {
+            continue;
         }
-    } catch (const std::exception& e) {
-        LOG_ERROR("Exception in thread_main(): {}", e.what());
+        reactor->notify_published(topic);
     }
+}
 
-    // shutdown();
-    LOG_DEBUG("WebSocketServer::thread_main(): exit");
+auto WebSocketServer::topic_interval(TopicId topic) const -> std::chrono::milliseconds {
+    auto fastest = std::chrono::milliseconds(0);
+    for (const auto& reactor : reactors_) {
+        auto interval = reactor->topic_interval(topic);
+        if (interval.count() > 0 && (fastest.count() == 0 || interval < fastest)) {
+            fastest = interval;
+        }
+    }
+    return fastest;
 }
 
-auto WebSocketServer::thread_recycle_clients() -> void {
-    using namespace std::chrono_literals;
+auto WebSocketServer::send_queue_statistics() const -> SendQueueStatistics {
+    SendQueueStatistics statistics;
+    for (const auto& reactor : reactors_) {
+        statistics += reactor->send_queue_statistics();
+    }
+    return statistics;
+}
 
-    while (!stop_requested_) {
-        try {
-            // TODO implement me
-            std::this_thread::sleep_for(1000ms);
-        } catch (const std::exception& e) {
-            LOG_ERROR("Exception in thread_recycle_clients(): {}", e.what());
+auto WebSocketServer::shutdown() noexcept -> void {
+    if (is_running()) {
+        LOG_INFO("Server shutdown requested");
+        for (auto& reactor : reactors_) {
+            reactor->shutdown();
         }
     }
 }
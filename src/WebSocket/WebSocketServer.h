@@ -1,21 +1,31 @@
 #pragma once
 
 #include "../Common/Error.h"
-#include "../Common/Net/ClientSocket.h"
 #include "../Common/Net/IpSocketAddress.h"
 #include "../Common/Net/ServerSocket.h"
-#include "../Common/Thread.h"
-#include "WebSocketClient.h"
+#include "../Common/SharedBuffer.h"
+#include "FrameCodec.h"
+#include "WebSocketReactor.h"
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <span>
 #include <string>
-#include <thread>
 #include <vector>
 
 namespace ws {
 
 class WebSocketServer final {
 public:
-    static auto create(uint16_t port = 8080, const std::string& address = "0.0.0.0")
-        -> common::ErrorOr<WebSocketServer>;
+    // Creates a server running reactor_count reactor shards, each accepting
+    // connections from its own SO_REUSEPORT listener. Zero means one shard
+    // per CPU the process may run on, as its affinity mask tells, in which
+    // case every shard is pinned to its own one of those CPUs.
+    static auto create(uint16_t port = 8080,
+                       const std::string& address = "0.0.0.0",
+                       size_t reactor_count = 0,
+                       IoBackend io_backend = IoBackend::EPOLL,
+                       const ConnectionSettings& connection_settings = {}) -> common::ErrorOr<WebSocketServer>;
 
     WebSocketServer(const WebSocketServer&) = delete;
     WebSocketServer(WebSocketServer&&) noexcept = default;
@@ -24,24 +34,51 @@ public:
     auto operator=(const WebSocketServer&) -> WebSocketServer& = delete;
     auto operator=(WebSocketServer&&) noexcept -> WebSocketServer& = default;
 
-    [[nodiscard]] auto is_running() const -> bool { return main_thread_.joinable(); }
-    [[nodiscard]] auto server_socket() const -> const common::net::ServerSocket& { return *server_socket_; }
+    [[nodiscard]] auto is_running() const -> bool;
+    [[nodiscard]] auto server_socket() const -> const common::net::ServerSocket& {
+        return reactors_.front()->server_socket();
+    }
+    [[nodiscard]] auto reactor_count() const -> size_t { return reactors_.size(); }
 
-    auto shutdown() noexcept -> void;
+    // Number of connections currently owned by each shard, indexed by shard
+    // id. Useful for checking that the kernel balances accepts evenly.
+    [[nodiscard]] auto connection_counts() const -> std::vector<size_t>;
 
-private:
-    WebSocketServer(std::unique_ptr<common::net::ServerSocket>&& server_socket);
+    // How often the send queue overflow policies fired, summed over shards.
+    [[nodiscard]] auto send_queue_statistics() const -> SendQueueStatistics;
+
+    // Shortest interval any connection subscribed to given topic with; zero
+    // when nobody is subscribed. Lets producers sample a topic only as often
+    // as its fastest subscriber needs. Safe to call from any thread.
+    [[nodiscard]] auto topic_interval(TopicId topic) const -> std::chrono::milliseconds;
+
+    // Sends a message to every open connection, or only to the subscribers
+    // of given topic that are due for it. The frame is encoded once
+    // into an immutable shared buffer which every connection queues by
+    // reference, so the cost per connection is a reference count increment
+    // and the actual send. Connections that fall behind are handled by their
+    // send queue's overflow policy; with conflation only the newest message
+    // per topic is kept. Safe to call from any thread.
+    auto broadcast(Opcode opcode, std::span<const uint8_t> payload, TopicId topic = NO_TOPIC) -> void;
 
-    auto start_threads() -> void;
+    // Same as above for a frame already encoded with make_frame().
+    auto broadcast(const common::SharedBuffer& frame, TopicId topic = NO_TOPIC) -> void;
+    // Publishes a message encoded per connection as the latest of its topic,
+    // see WebSocketClient::queue_message(). The message is shared by all
+    // shards, which pick it up without taking a lock; a shard that only
+    // gets to a topic after several messages were published delivers the
+    // latest. Not to be called concurrently for the same topic.
+    auto broadcast(const std::shared_ptr<VersionedMessage>& message, TopicId topic) -> void;
 
-    auto thread_main() -> void;
-    auto thread_recycle_clients() -> void;
+    auto shutdown() noexcept -> void;
+
+private:
+    WebSocketServer(std::vector<std::unique_ptr<MessagePublication>>&& publications,
+                    std::vector<std::unique_ptr<WebSocketReactor>>&& reactors);
 
-    std::unique_ptr<common::net::ServerSocket> server_socket_;
-    std::unique_ptr<std::vector<WebSocketClient>> clients_;
-    std::unique_ptr<bool> stop_requested_;
-    std::jthread main_thread_{};
-    std::jthread recycle_clients_thread_{};
+    // one per topic; outlives the reactors reading them
+    std::vector<std::unique_ptr<MessagePublication>> publications_;
+    std::vector<std::unique_ptr<WebSocketReactor>> reactors_;
 };
 
 } // namespace ws
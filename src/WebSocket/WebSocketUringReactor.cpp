@@ -0,0 +1,394 @@
+#include "WebSocketUringReactor.h"
+#include "../Common/Logging.h"
+#include <cerrno>
+#include <sys/eventfd.h>
+#include <unistd.h>
+
+using namespace common;
+using namespace common::net;
+using namespace ws;
+
+static constexpr uint64_t TOKEN_MASK = (uint64_t{1} << 56) - 1;
+
+auto WebSocketUringReactor::create(size_t shard_id,
+                                   ServerSocket&& server_socket,
+                                   const ConnectionSettings& connection_settings)
+    -> ErrorOr<std::unique_ptr<WebSocketUringReactor>> {
+    auto io_uring = TRY(IoUring::create(RING_ENTRIES));
+    auto buffer_ring = TRY(IoUringBufferRing::create(io_uring, BUFFER_GROUP, BUFFER_COUNT, BUFFER_SIZE));
+
+    auto wakeup_fd = ::eventfd(0, EFD_CLOEXEC);
+    if (wakeup_fd < 0) {
+        return {Error::from_errno(errno, "eventfd()", ErrorDomain::NET)};
+    }
+
+    auto* reactor = new WebSocketUringReactor(shard_id,
+                                              std::move(server_socket),
+                                              connection_settings,
+                                              std::move(io_uring),
+                                              std::move(buffer_ring),
+                                              wakeup_fd);
+    return {std::unique_ptr<WebSocketUringReactor>(reactor)};
+}
+
+WebSocketUringReactor::WebSocketUringReactor(size_t shard_id,
+                                             ServerSocket&& server_socket,
+                                             const ConnectionSettings& connection_settings,
+                                             IoUring&& io_uring,
+                                             IoUringBufferRing&& buffer_ring,
+                                             int wakeup_fd) :
+    WebSocketReactor(shard_id, std::move(server_socket), connection_settings),
+    io_uring_(std::move(io_uring)),
+    buffer_ring_(std::move(buffer_ring)),
+    wakeup_fd_(wakeup_fd) {
+    accept_retry_timer_.set_user_data(LISTENER_TOKEN);
+}
+
+WebSocketUringReactor::~WebSocketUringReactor() noexcept {
+    shutdown();
+    ::close(wakeup_fd_);
+}
+
+auto WebSocketUringReactor::encode_user_data(Operation operation, uint64_t token) -> uint64_t {
+    return (static_cast<uint64_t>(operation) << 56) | (token & TOKEN_MASK);
+}
+
+auto WebSocketUringReactor::wakeup() noexcept -> void {
+    uint64_t one = 1;
+    [[maybe_unused]] auto rc = ::write(wakeup_fd_, &one, sizeof(one));
+}
+
+auto WebSocketUringReactor::run() -> void {
+    try {
+        arm_accept();
+        arm_wakeup();
+        while (!stop_requested()) {
+            submit_scheduled_sends();
+            // a single system call both submits everything queued while
+            // handling the previous round and waits for the next one
+            auto timeout = timer_wheel_.time_until_next_tick(TimerWheel::Clock::now());
+            TRY_OR_THROW(io_uring_.submit_and_wait(1, timeout));
+            io_uring_.for_each_completion([this](const auto& cqe) { handle_completion(cqe); });
+            timer_wheel_.advance(TimerWheel::Clock::now(), [this](Timer& timer) { handle_timeout(timer.user_data()); });
+        }
+    } catch (...) {
+        close_all_connections();
+        throw;
+    }
+    close_all_connections();
+}
+
+auto WebSocketUringReactor::handle_completion(const struct io_uring_cqe& cqe) -> void {
+    auto operation = static_cast<Operation>(cqe.user_data >> 56);
+    auto token = cqe.user_data & TOKEN_MASK;
+    switch (operation) {
+    case Operation::ACCEPT:
+        handle_accept(cqe.res, cqe.flags);
+        return;
+    case Operation::RECV:
+        handle_recv(token, cqe.res, cqe.flags);
+        return;
+    case Operation::SEND:
+        handle_send(token, cqe.res);
+        return;
+    case Operation::WAKEUP:
+        if (!stop_requested()) {
+            deliver_broadcasts();
+            arm_wakeup();
+        }
+        return;
+    case Operation::CANCEL:
+        return;
+    }
+    VERIFY_NOT_REACHED();
+}
+
+auto WebSocketUringReactor::handle_accept(int32_t result, uint32_t flags) -> void {
+    if ((flags & IORING_CQE_F_MORE) == 0) {
+        accept_armed_ = false;
+    }
+    if (result >= 0) {
+        if (accept_paused_) {
+            LOG_INFO("Accepting connections again (shard: {})", shard_id_);
+            accept_paused_ = false;
+            timer_wheel_.cancel(accept_retry_timer_);
+        }
+        auto error_or_client_socket = server_socket_.adopt(result);
+        if (error_or_client_socket.is_error()) {
+            LOG_ERROR("Adopting accepted connection failed: {}", error_or_client_socket.error().error_message());
+        } else {
+            auto client_socket = error_or_client_socket.release_value();
+            LOG_INFO("Client connected from {} (shard: {})", client_socket.remote_address().to_string(), shard_id_);
+
+            auto [token, connection] = connections_.emplace(Connection{create_client(std::move(client_socket))});
+            connection.client.timer().set_user_data(token);
+            schedule_timeout(connection.client);
+            set_connection_count(++open_connections_);
+            arm_recv(token, connection.client.file_descriptor());
+        }
+    } else if (result != -ECANCELED && result != -ECONNABORTED) {
+        // most likely out of descriptors or memory, which closing
+        // connections frees up; the shard keeps serving those it has
+        if (!accept_paused_) {
+            auto error = Error::from_errno(-result, "accept()", ErrorDomain::NET);
+            LOG_WARN("Accepting connections failed, retrying in a while (shard: {}): {}",
+                     shard_id_,
+                     error.error_message());
+            accept_paused_ = true;
+        }
+        timer_wheel_.schedule(accept_retry_timer_, TimerWheel::Clock::now() + ACCEPT_RETRY_DELAY);
+        return;
+    }
+
+    // the kernel terminates a multishot request on errors, such as a
+    // connection aborted in the backlog; start a new one
+    if (!accept_armed_ && !stop_requested()) {
+        arm_accept();
+    }
+}
+
+auto WebSocketUringReactor::handle_recv(uint64_t token, int32_t result, uint32_t flags) -> void {
+    const bool has_buffer = (flags & IORING_CQE_F_BUFFER) != 0;
+    const auto buffer_id = static_cast<uint16_t>(flags >> IORING_CQE_BUFFER_SHIFT);
+
+    auto* connection_or_null = connections_.find(token);
+    if (connection_or_null == nullptr || connection_or_null->closing) {
+        // late completion for a connection closed meanwhile
+        if (has_buffer) {
+            buffer_ring_.recycle(buffer_id);
+        }
+        return;
+    }
+    auto& connection = *connection_or_null;
+
+    if (result > 0) {
+        VERIFY(has_buffer);
+        auto error_or_void = connection.client.on_received(buffer_ring_.buffer(buffer_id, result));
+        buffer_ring_.recycle(buffer_id);
+        if (error_or_void.is_error()) {
+            LOG_ERROR("Communication with client ({}) failed: {}",
+                      connection.client.client_socket().remote_address().to_string(),
+                      error_or_void.error().error_message());
+            close_connection(token);
+            return;
+        }
+        if (connection.client.should_close()) {
+            close_connection(token);
+            return;
+        }
+        update_subscriptions(token, connection.client);
+        dispatch_queries(token, connection.client);
+        schedule_timeout(connection.client);
+        schedule_send(token);
+    } else if (result == 0) {
+        // orderly shutdown by the peer
+        close_connection(token);
+        return;
+    } else if (result != -ENOBUFS) {
+        auto error = Error::from_errno(-result, "recv()", ErrorDomain::NET);
+        LOG_ERROR("Communication with client ({}) failed: {}",
+                  connection.client.client_socket().remote_address().to_string(),
+                  error.error_message());
+        close_connection(token);
+        return;
+    }
+
+    // ran out of provided buffers or the kernel otherwise stopped the
+    // multishot request; the buffers recycled meanwhile let it continue
+    if ((flags & IORING_CQE_F_MORE) == 0) {
+        arm_recv(token, connection.client.file_descriptor());
+    }
+}
+
+auto WebSocketUringReactor::handle_send(uint64_t token, int32_t result) -> void {
+    --sends_in_flight_;
+    auto* connection_or_null = connections_.find(token);
+    if (connection_or_null == nullptr) {
+        return;
+    }
+    auto& connection = *connection_or_null;
+    connection.send_in_flight = false;
+
+    if (connection.closing) {
+        // the kernel is done with the send buffer
+        connections_.erase(token);
+        return;
+    }
+
+    if (result < 0) {
+        auto error = Error::from_errno(-result, "send()", ErrorDomain::NET);
+        LOG_ERROR("Communication with client ({}) failed: {}",
+                  connection.client.client_socket().remote_address().to_string(),
+                  error.error_message());
+        close_connection(token);
+        return;
+    }
+
+    connection.client.on_sent(static_cast<size_t>(result));
+    if (connection.client.should_close()) {
+        close_connection(token);
+        return;
+    }
+    schedule_send(token);
+}
+
+auto WebSocketUringReactor::handle_timeout(uint64_t token) -> void {
+    if (token == LISTENER_TOKEN) {
+        if (!accept_armed_ && !stop_requested()) {
+            arm_accept();
+        }
+        return;
+    }
+    auto* connection = connections_.find(token);
+    if (connection == nullptr || connection->closing) {
+        return;
+    }
+    auto& client = connection->client;
+    client.on_timeout(TimerWheel::Clock::now());
+    if (client.should_close()) {
+        close_connection(token);
+        return;
+    }
+    schedule_timeout(client);
+    schedule_send(token);
+}
+
+auto WebSocketUringReactor::arm_accept() -> void {
+    TRY_OR_THROW(io_uring_.prepare_multishot_accept(server_socket_.socket().file_descriptor(),
+                                                    encode_user_data(Operation::ACCEPT, LISTENER_TOKEN)));
+    accept_armed_ = true;
+}
+
+auto WebSocketUringReactor::arm_wakeup() -> void {
+    auto counter = std::span<uint8_t>(reinterpret_cast<uint8_t*>(&wakeup_counter_), sizeof(wakeup_counter_));
+    TRY_OR_THROW(io_uring_.prepare_read(wakeup_fd_, counter, encode_user_data(Operation::WAKEUP, 0)));
+}
+
+auto WebSocketUringReactor::arm_recv(uint64_t token, int fd) -> void {
+    TRY_OR_THROW(io_uring_.prepare_multishot_recv(fd, BUFFER_GROUP, encode_user_data(Operation::RECV, token)));
+}
+
+auto WebSocketUringReactor::schedule_send(uint64_t token) -> void {
+    auto* connection = connections_.find(token);
+    if (connection != nullptr && connection->client.has_pending_output()) {
+        scheduled_sends_.push_back(token);
+    }
+}
+
+auto WebSocketUringReactor::submit_scheduled_sends() -> void {
+    for (auto token : scheduled_sends_) {
+        auto* connection_or_null = connections_.find(token);
+        if (connection_or_null == nullptr) {
+            continue;
+        }
+        auto& connection = *connection_or_null;
+        if (connection.closing || connection.send_in_flight || !connection.client.has_pending_output()) {
+            continue;
+        }
+        TRY_OR_THROW(io_uring_.prepare_send(connection.client.file_descriptor(),
+                                            connection.client.pending_output(),
+                                            encode_user_data(Operation::SEND, token)));
+        connection.send_in_flight = true;
+        ++sends_in_flight_;
+    }
+    scheduled_sends_.clear();
+}
+
+auto WebSocketUringReactor::deliver_broadcasts() -> void {
+    take_broadcasts(broadcasts_);
+    if (broadcasts_.empty()) {
+        return;
+    }
+
+    auto now = SendQueue::Clock::now();
+    for (const auto& broadcast : broadcasts_) {
+        if (broadcast.token != 0) {
+            if (auto* connection = connections_.find(broadcast.token); connection != nullptr) {
+                queue_broadcast(broadcast.token, *connection, broadcast, now);
+            }
+            continue;
+        }
+        if (broadcast.topic == NO_TOPIC) {
+            connections_.for_each([&](uint64_t token, Connection& connection) {
+                queue_broadcast(token, connection, broadcast, now);
+            });
+            continue;
+        }
+        for (auto token : subscription_index_.subscribers(broadcast.topic)) {
+            if (auto* connection = connections_.find(token); connection != nullptr) {
+                queue_broadcast(token, *connection, broadcast, now);
+            }
+        }
+    }
+    broadcasts_.clear();
+
+    for (auto token : connections_to_close_) {
+        close_connection(token);
+    }
+    connections_to_close_.clear();
+}
+
+auto WebSocketUringReactor::queue_broadcast(uint64_t token,
+                                            Connection& connection,
+                                            const Broadcast& broadcast,
+                                            SendQueue::Clock::time_point now) -> void {
+    if (connection.closing) {
+        return;
+    }
+    deliver(connection.client, broadcast, now);
+    if (connection.client.should_close()) {
+        // closing may erase from connections_; defer until done iterating
+        connections_to_close_.push_back(token);
+        return;
+    }
+    // all sends go out with the next submission in one system call
+    schedule_send(token);
+}
+
+auto WebSocketUringReactor::close_connection(uint64_t token) -> void {
+    auto* connection_or_null = connections_.find(token);
+    if (connection_or_null == nullptr || connection_or_null->closing) {
+        return;
+    }
+    auto& connection = *connection_or_null;
+    LOG_INFO("Client ({}) disconnected", connection.client.client_socket().remote_address().to_string());
+
+    // shutting the socket down is what tells the peer and completes the
+    // in-flight multishot recv; the recv still holds a reference to the
+    // file, though, so it is cancelled, by user data since the descriptor is
+    // closed and may be reused before the cancellation gets submitted
+    connection.client.shutdown();
+    TRY_OR_THROW(io_uring_.prepare_cancel(encode_user_data(Operation::RECV, token),
+                                          encode_user_data(Operation::CANCEL, token)));
+    timer_wheel_.cancel(connection.client.timer());
+    remove_subscriptions(connection.client);
+    set_connection_count(--open_connections_);
+    if (accept_paused_) {
+        // the descriptor just freed may be what accepting lacked; retried on
+        // the next tick rather than here, where callers may be iterating
+        timer_wheel_.schedule(accept_retry_timer_, TimerWheel::Clock::now());
+    }
+
+    if (connection.send_in_flight) {
+        // the kernel may still read the send buffer; release the connection
+        // once the send completes
+        connection.closing = true;
+        return;
+    }
+    connections_.erase(token);
+}
+
+auto WebSocketUringReactor::close_all_connections() -> void {
+    // closing frees the slot of a connection unless a send is in flight,
+    // which the slab allows while iterating
+    connections_.for_each([this](uint64_t token, Connection&) { close_connection(token); });
+
+    // sends to shut down sockets complete promptly; wait for them so that no
+    // request refers to a send buffer once the connections are gone
+    while (sends_in_flight_ > 0) {
+        TRY_OR_THROW(io_uring_.submit_and_wait(1));
+        io_uring_.for_each_completion([this](const auto& cqe) { handle_completion(cqe); });
+    }
+    TRY_OR_THROW(io_uring_.submit());
+    connections_.clear();
+}
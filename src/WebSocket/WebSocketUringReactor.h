@@ -0,0 +1,111 @@
+#pragma once
+
+#include "../Common/Error.h"
+#include "../Common/Net/IoUring.h"
+#include "../Common/Net/ServerSocket.h"
+#include "../Common/Slab.h"
+#include "WebSocketClient.h"
+#include "WebSocketReactor.h"
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace ws {
+
+// WebSocketUringReactor hands all socket I/O to io_uring. The listener has a
+// single multishot accept in flight and every connection a single multishot
+// recv picking its buffers from a shared provided buffer ring, so receiving
+// costs no system calls of its own. Sends produced while handling a round of
+// completions are submitted together with the next io_uring_enter() call.
+class WebSocketUringReactor final : public WebSocketReactor {
+public:
+    static auto create(size_t shard_id,
+                       common::net::ServerSocket&& server_socket,
+                       const ConnectionSettings& connection_settings = {})
+        -> common::ErrorOr<std::unique_ptr<WebSocketUringReactor>>;
+
+    ~WebSocketUringReactor() noexcept override;
+
+    [[nodiscard]] auto io_backend() const -> IoBackend override { return IoBackend::IO_URING; }
+
+private:
+    static constexpr uint32_t RING_ENTRIES = 4096;
+    static constexpr uint16_t BUFFER_GROUP = 0;
+    static constexpr uint16_t BUFFER_COUNT = 1024;
+    static constexpr uint32_t BUFFER_SIZE = 4096;
+
+    // the operation of a request is stored in the top byte of its user data
+    // and the connection token, its handle in connections_, in the rest
+    enum class Operation : uint8_t {
+        ACCEPT = 1,
+        RECV = 2,
+        SEND = 3,
+        WAKEUP = 4,
+        CANCEL = 5,
+    };
+
+    struct Connection {
+        WebSocketClient client;
+        bool send_in_flight{false};
+        // socket already closed; kept around only until the kernel is done
+        // with the send buffer
+        bool closing{false};
+    };
+
+    // the token of the listener's retry timer, which no connection has
+    static constexpr uint64_t LISTENER_TOKEN = common::Slab<Connection>::NO_HANDLE;
+
+    WebSocketUringReactor(size_t shard_id,
+                          common::net::ServerSocket&& server_socket,
+                          const ConnectionSettings& connection_settings,
+                          common::net::IoUring&& io_uring,
+                          common::net::IoUringBufferRing&& buffer_ring,
+                          int wakeup_fd);
+
+    static auto encode_user_data(Operation operation, uint64_t token) -> uint64_t;
+
+    auto run() -> void override;
+    auto wakeup() noexcept -> void override;
+
+    auto handle_completion(const struct io_uring_cqe& cqe) -> void;
+    auto handle_accept(int32_t result, uint32_t flags) -> void;
+    auto handle_recv(uint64_t token, int32_t result, uint32_t flags) -> void;
+    auto handle_send(uint64_t token, int32_t result) -> void;
+    auto handle_timeout(uint64_t token) -> void;
+
+    auto arm_accept() -> void;
+    auto arm_wakeup() -> void;
+    auto arm_recv(uint64_t token, int fd) -> void;
+    auto schedule_send(uint64_t token) -> void;
+    auto submit_scheduled_sends() -> void;
+    auto deliver_broadcasts() -> void;
+    auto queue_broadcast(uint64_t token,
+                         Connection& connection,
+                         const Broadcast& broadcast,
+                         SendQueue::Clock::time_point now) -> void;
+    auto close_connection(uint64_t token) -> void;
+    auto close_all_connections() -> void;
+
+    common::net::IoUring io_uring_;
+    common::net::IoUringBufferRing buffer_ring_;
+    int wakeup_fd_;
+    uint64_t wakeup_counter_{0};
+    // completions of connections closed meanwhile carry stale handles,
+    // which find nothing
+    common::Slab<Connection> connections_;
+    size_t open_connections_{0};
+    // whether the multishot accept is in flight; it is not re-armed at once
+    // after failing for want of descriptors or memory, which would spin, but
+    // from accept_retry_timer_ while accept_paused_ is set
+    bool accept_armed_{false};
+    bool accept_paused_{false};
+    common::Timer accept_retry_timer_;
+    size_t sends_in_flight_{0};
+    // connections with output queued since the last submission
+    std::vector<uint64_t> scheduled_sends_;
+    // reused between wakeups so delivering broadcasts doesn't allocate
+    std::vector<Broadcast> broadcasts_;
+    std::vector<uint64_t> connections_to_close_;
+};
+
+} // namespace ws
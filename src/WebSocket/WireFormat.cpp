@@ -0,0 +1,14 @@
+#include "WireFormat.h"
+#include "../Common/Assertions.h"
+
+using namespace ws;
+
+auto ws::format_wire_format(WireFormat wire_format) -> std::string_view {
+    switch (wire_format) {
+    case WireFormat::JSON:
+        return "wstop.json";
+    case WireFormat::BINARY:
+        return "wstop.binary";
+    }
+    VERIFY_NOT_REACHED();
+}
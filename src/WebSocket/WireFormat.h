@@ -0,0 +1,25 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+namespace ws {
+
+// How metric samples are encoded for a connection, negotiated as a
+// WebSocket subprotocol during the handshake. Connections that don't ask
+// for a subprotocol get JSON.
+enum class WireFormat : uint8_t {
+    // text frames, see metrics::json
+    JSON = 0,
+    // binary frames, see metrics::binary
+    BINARY = 1,
+};
+
+constexpr size_t WIRE_FORMAT_COUNT = 2;
+
+// Returns the subprotocol name of given format, as used in the
+// Sec-WebSocket-Protocol header.
+auto format_wire_format(WireFormat wire_format) -> std::string_view;
+
+} // namespace ws
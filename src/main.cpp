@@ -1,30 +1,165 @@
+#include "Common/BufferPool.h"
 #include "Common/Error.h"
 #include "Common/Logging.h"
 #include "Common/Net/IpSocketAddress.h"
 #include "Common/Net/ServerSocket.h"
 #include "Common/Signal.h"
+#include "Metrics/CgroupCollector.h"
+#include "Metrics/CpuCollector.h"
+#include "Metrics/DiskCollector.h"
+#include "Metrics/HistoryStore.h"
+#include "Metrics/MemoryCollector.h"
+#include "Metrics/NetworkCollector.h"
+#include "Metrics/ProcessCollector.h"
+#include "Metrics/ProtocolCollector.h"
+#include "Metrics/Sampler.h"
+#include "Metrics/SamplerCollector.h"
+#include "Metrics/SensorCollector.h"
+#include "Metrics/SnapshotMessage.h"
 #include "WebSocket/WebSocketServer.h"
+#include <algorithm>
+#include <cerrno>
 #include <chrono>
+#include <fmt/format.h>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <sys/resource.h>
+#include <sys/stat.h>
 #include <thread>
 
-auto main([[maybe_unused]] int argc, [[maybe_unused]] char** argv) -> int {
+auto main(int argc, char** argv) -> int {
     using namespace common;
     using namespace ws;
     using namespace std::chrono_literals;
 
+    auto io_backend = IoBackend::EPOLL;
+    ConnectionSettings connection_settings;
+    std::string history_directory;
+    buffer_pool::Settings buffer_pool_settings;
+    for (int i = 1; i < argc; ++i) {
+        auto arg = std::string_view(argv[i]);
+        if (arg == "--io-backend=io_uring") {
+            io_backend = IoBackend::IO_URING;
+        } else if (arg == "--io-backend=epoll") {
+            io_backend = IoBackend::EPOLL;
+        } else if (arg == "--send-queue-policy=conflate") {
+            connection_settings.send_queue.policy = OverflowPolicy::CONFLATE;
+        } else if (arg == "--send-queue-policy=drop-oldest") {
+            connection_settings.send_queue.policy = OverflowPolicy::DROP_OLDEST;
+        } else if (arg == "--send-queue-policy=disconnect") {
+            connection_settings.send_queue.policy = OverflowPolicy::DISCONNECT;
+        } else if (arg == "--huge-pages") {
+            buffer_pool_settings.huge_pages = true;
+        } else if (arg.starts_with("--history-dir=")) {
+            history_directory = arg.substr(arg.find('=') + 1);
+        } else {
+            LOG_ERROR("Unknown argument: {}", arg);
+            return 1;
+        }
+    }
+
     LOG_INFO("Starting application");
+    buffer_pool::configure(buffer_pool_settings);
+    // connections and the process files kept open by the process collector
+    // both count against the open files limit; take what the hard limit
+    // allows
+    rlimit open_files{};
+    if (::getrlimit(RLIMIT_NOFILE, &open_files) == 0 && open_files.rlim_cur < open_files.rlim_max) {
+        open_files.rlim_cur = open_files.rlim_max;
+        if (::setrlimit(RLIMIT_NOFILE, &open_files) != 0) {
+            LOG_WARN("Raising the open files limit failed");
+        }
+    }
     try {
-        auto server = TRY_OR_THROW(WebSocketServer::create());
+        if (!history_directory.empty() && ::mkdir(history_directory.c_str(), 0755) != 0 && errno != EEXIST) {
+            Error::from_errno(errno, fmt::format("mkdir({})", history_directory), ErrorDomain::FILE)
+                .raise(__FILE__, __LINE__, __PRETTY_FUNCTION__);
+        }
+        // outlives the server and the sampler, which both use it
+        metrics::HistoryStore history(metrics::HistoryStore::DEFAULT_RESOLUTIONS, history_directory);
+        connection_settings.query_function = [&history](const SubscriptionCommand& command) -> ErrorOr<std::string> {
+            auto topic = static_cast<metrics::Topic>(command.topic);
+            fmt::memory_buffer out;
+            if (command.action == SubscriptionCommand::Action::QUERY) {
+                TRY(history.write_query_json(out, topic, command.field, command.window, command.step));
+            } else {
+                TRY(history.write_json(out, topic, command.step));
+            }
+            return fmt::to_string(out);
+        };
+
+        auto server = TRY_OR_THROW(WebSocketServer::create(8080, "0.0.0.0", 0, io_backend, connection_settings));
 
         register_signal_handler([&server]([[maybe_unused]] auto signal) -> void { server.shutdown(); },
                                 {SIGINT, SIGTERM});
 
         LOG_INFO("Listening address {}", server.server_socket().local_address().to_string());
 
-        while (server.is_running()) {
+        // samples are taken for topics somebody subscribed to, at the fastest
+        // interval asked for, and for topics whose history is kept at least
+        // once per step of its finest resolution
+        metrics::Sampler sampler(
+            [&server, &history](metrics::Topic topic) {
+                auto interval = server.topic_interval(static_cast<TopicId>(topic));
+                if (!history.is_kept(topic)) {
+                    return interval;
+                }
+                auto step = history.resolutions().front().step;
+                return interval.count() > 0 ? std::min(interval, step) : step;
+            },
+            [&server, &history](metrics::Sampler::SnapshotPointer snapshot,
+                                std::span<const metrics::Sampler::SnapshotPointer> previous_snapshots) {
+                history.record(*snapshot);
+                auto topic = static_cast<TopicId>(snapshot->topic());
+                server.broadcast(std::make_shared<metrics::SnapshotMessage>(std::move(snapshot), previous_snapshots),
+                                 topic);
+            });
+        // keeps the history of at most history_rows rows of the collector's
+        // topic; the process table changes too much to be worth keeping
+        auto add_collector = [&sampler, &history](std::unique_ptr<metrics::Collector> collector, size_t history_rows) {
+            if (history_rows > 0) {
+                TRY_OR_THROW(history.add_topic(collector->schema(), history_rows));
+                if (history.is_restored(collector->topic())) {
+                    LOG_INFO("Restored the history of {}", metrics::format_topic(collector->topic()));
+                }
+            }
+            sampler.add_collector(std::move(collector));
+        };
+        add_collector(std::make_unique<metrics::CpuCollector>(metrics::Topic::CPU), 1);
+        // the rollups of NUMA nodes and sockets besides the cores
+        add_collector(std::make_unique<metrics::CpuCollector>(metrics::Topic::CPU_PER_CORE),
+                      std::max(std::thread::hardware_concurrency(), 1U) + 16);
+        add_collector(std::make_unique<metrics::MemoryCollector>(), 1);
+        add_collector(std::make_unique<metrics::NetworkCollector>(), 16);
+        add_collector(std::make_unique<metrics::DiskCollector>(), 16);
+        add_collector(std::make_unique<metrics::ProcessCollector>(), 0);
+        // a frequency per core besides temperatures, fans and power meters
+        add_collector(std::make_unique<metrics::SensorCollector>(),
+                      std::max(std::thread::hardware_concurrency(), 1U) + 32);
+        add_collector(std::make_unique<metrics::ProtocolCollector>(), 1);
+        add_collector(std::make_unique<metrics::CgroupCollector>(), 64);
+        add_collector(std::make_unique<metrics::SamplerCollector>(sampler), metrics::TOPIC_COUNT);
+        if (history.directory().empty()) {
+            LOG_INFO("Keeping history in {} MiB", history.memory_size() >> 20);
+        } else {
+            LOG_INFO("Keeping history in {} MiB mapped from {}", history.memory_size() >> 20, history.directory());
+        }
+        sampler.start();
+
+        for (size_t tick = 1; server.is_running(); ++tick) {
             std::this_thread::sleep_for(1000ms);
+            if (tick % 60 == 0) {
+                auto statistics = server.send_queue_statistics();
+                LOG_DEBUG("Connections per shard: [{}], send queues conflated: {}, dropped: {}, disconnected: {}",
+                          fmt::join(server.connection_counts(), ", "),
+                          statistics.conflated,
+                          statistics.dropped,
+                          statistics.disconnected);
+            }
         }
 
+        sampler.shutdown();
         LOG_DEBUG("Exiting main thread");
     } catch (const std::exception& e) {
         LOG_ERROR("Exception: {}", e.what());
@@ -0,0 +1,73 @@
+#include "Common/Net/IoUring.h"
+#include <gtest/gtest.h>
+#include <string_view>
+#include <sys/socket.h>
+#include <unistd.h>
+
+using namespace common::net;
+
+class IoUringTest : public ::testing::Test {
+protected:
+    void SetUp() override {
+        auto error_or_io_uring = IoUring::create(64);
+        if (error_or_io_uring.is_error()) {
+            GTEST_SKIP() << "io_uring not available: " << error_or_io_uring.error().error_message();
+        }
+        io_uring_.emplace(error_or_io_uring.release_value());
+        ASSERT_EQ(::socketpair(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK, 0, fds_), 0);
+    }
+
+    void TearDown() override {
+        ::close(fds_[0]);
+        ::close(fds_[1]);
+    }
+
+    std::optional<IoUring> io_uring_;
+    int fds_[2]{-1, -1};
+};
+
+TEST_F(IoUringTest, MultishotRecvUsesProvidedBuffers) {
+    auto buffer_ring = MUST(IoUringBufferRing::create(*io_uring_, 7, 4, 64));
+    MUST(io_uring_->prepare_multishot_recv(fds_[0], buffer_ring.buffer_group(), 42));
+    MUST(io_uring_->submit());
+
+    std::string_view messages[] = {"first", "second"};
+    for (auto message : messages) {
+        ASSERT_EQ(::write(fds_[1], message.data(), message.size()), static_cast<ssize_t>(message.size()));
+
+        std::string received;
+        uint32_t flags = 0;
+        MUST(io_uring_->submit_and_wait(1));
+        auto count = io_uring_->for_each_completion([&](const auto& cqe) {
+            EXPECT_EQ(cqe.user_data, 42U);
+            ASSERT_GT(cqe.res, 0);
+            ASSERT_TRUE(cqe.flags & IORING_CQE_F_BUFFER);
+            auto buffer_id = static_cast<uint16_t>(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+            auto data = buffer_ring.buffer(buffer_id, cqe.res);
+            received.assign(data.begin(), data.end());
+            buffer_ring.recycle(buffer_id);
+            flags = cqe.flags;
+        });
+        EXPECT_EQ(count, 1U);
+        EXPECT_EQ(received, message);
+        // the request stays armed for the next message
+        EXPECT_TRUE(flags & IORING_CQE_F_MORE);
+    }
+}
+
+TEST_F(IoUringTest, SendsAreBatched) {
+    std::string_view first = "hello ";
+    std::string_view second = "world";
+    MUST(io_uring_->prepare_send(fds_[1], {reinterpret_cast<const uint8_t*>(first.data()), first.size()}, 1));
+    MUST(io_uring_->prepare_send(fds_[1], {reinterpret_cast<const uint8_t*>(second.data()), second.size()}, 2));
+    // both sends go to the kernel with a single io_uring_enter()
+    EXPECT_EQ(MUST(io_uring_->submit_and_wait(2)), 2U);
+
+    size_t bytes_sent = 0;
+    io_uring_->for_each_completion([&](const auto& cqe) { bytes_sent += cqe.res; });
+    EXPECT_EQ(bytes_sent, first.size() + second.size());
+
+    char buffer[32]{};
+    ASSERT_EQ(::read(fds_[0], buffer, sizeof(buffer)), 11);
+    EXPECT_EQ(std::string_view(buffer, 11), "hello world");
+}
@@ -0,0 +1,127 @@
+#include "Common/BufferPool.h"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <cstring>
+#include <set>
+#include <thread>
+#include <vector>
+
+using namespace common;
+
+TEST(BufferPool, ReusesTheChunkReleasedLast) {
+    auto* first = buffer_pool::allocate();
+    auto* second = buffer_pool::allocate();
+    EXPECT_NE(first, second);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(first) % buffer_pool::CHUNK_SIZE, 0U);
+    std::memset(first, 0xAB, buffer_pool::CHUNK_SIZE);
+
+    buffer_pool::release(first);
+    auto cached = buffer_pool::thread_cached_chunks();
+    EXPECT_EQ(buffer_pool::allocate(), first);
+    EXPECT_EQ(buffer_pool::thread_cached_chunks(), cached - 1);
+    buffer_pool::release(first);
+    buffer_pool::release(second);
+}
+
+TEST(BufferPool, ChunksHandThemselvesBack) {
+    auto chunk = buffer_pool::Chunk::allocate();
+    ASSERT_FALSE(chunk.is_null());
+    EXPECT_EQ(chunk.bytes().size(), buffer_pool::CHUNK_SIZE);
+    auto* memory = chunk.bytes().data();
+
+    auto moved = std::move(chunk);
+    EXPECT_TRUE(chunk.is_null()); // NOLINT(bugprone-use-after-move)
+    EXPECT_TRUE(chunk.bytes().empty());
+    EXPECT_EQ(moved.bytes().data(), memory);
+
+    moved.reset();
+    EXPECT_TRUE(moved.is_null());
+    EXPECT_EQ(buffer_pool::Chunk::allocate().bytes().data(), memory);
+}
+
+TEST(BufferPool, CarvesChunksFromArenasOnDemand) {
+    std::vector<buffer_pool::Chunk> chunks;
+    std::set<uint8_t*> distinct;
+    // more than an arena holds
+    for (size_t i = 0; i < 2 * buffer_pool::ARENA_SIZE / buffer_pool::CHUNK_SIZE; ++i) {
+        chunks.push_back(buffer_pool::Chunk::allocate());
+        distinct.insert(chunks.back().bytes().data());
+    }
+    EXPECT_EQ(distinct.size(), chunks.size());
+    auto statistics = buffer_pool::statistics();
+    EXPECT_GE(statistics.arenas, 2U);
+    EXPECT_EQ(statistics.chunks, statistics.arenas * buffer_pool::ARENA_SIZE / buffer_pool::CHUNK_SIZE);
+
+    // handing them back fills the thread's cache and then the shared list
+    chunks.clear();
+    EXPECT_GT(buffer_pool::statistics().free_chunks, statistics.free_chunks);
+    EXPECT_EQ(buffer_pool::statistics().chunks, statistics.chunks);
+}
+
+TEST(BufferPool, ChunksMayBeReleasedOnOtherThreads) {
+    constexpr size_t CHUNK_COUNT = 100000;
+    std::vector<void*> handed_over(CHUNK_COUNT);
+    std::atomic<size_t> produced{0};
+    std::thread consumer([&handed_over, &produced] {
+        for (size_t i = 0; i < CHUNK_COUNT; ++i) {
+            while (produced.load(std::memory_order_acquire) <= i) {
+                std::this_thread::yield();
+            }
+            EXPECT_EQ(*static_cast<size_t*>(handed_over[i]), i);
+            buffer_pool::release(handed_over[i]);
+        }
+    });
+    for (size_t i = 0; i < CHUNK_COUNT; ++i) {
+        handed_over[i] = buffer_pool::allocate();
+        *static_cast<size_t*>(handed_over[i]) = i;
+        produced.store(i + 1, std::memory_order_release);
+    }
+    consumer.join();
+    // the chunks went around rather than piling up in the consumer's cache
+    EXPECT_LT(buffer_pool::statistics().chunks, CHUNK_COUNT);
+}
+
+namespace {
+
+// takes a chunk when destroyed at thread exit, after the pool's cache of the
+// thread, which is constructed later, is gone
+struct LateUser {
+    std::atomic<void*>* taken{nullptr};
+
+    ~LateUser() noexcept {
+        auto* chunk = buffer_pool::allocate();
+        std::memset(chunk, 0, buffer_pool::CHUNK_SIZE);
+        taken->store(chunk);
+        buffer_pool::release(chunk);
+    }
+};
+
+thread_local LateUser late_user;
+
+} // namespace
+
+TEST(BufferPool, ServesThreadLocalsDestroyedAfterTheCache) {
+    std::atomic<void*> taken{nullptr};
+    std::thread thread([&taken] {
+        late_user.taken = &taken;
+        buffer_pool::release(buffer_pool::allocate());
+    });
+    thread.join();
+    ASSERT_NE(taken.load(), nullptr);
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(taken.load()) % buffer_pool::CHUNK_SIZE, 0U);
+    // went back to the shared list, which every other thread takes from
+    auto statistics = buffer_pool::statistics();
+    EXPECT_LE(statistics.free_chunks, statistics.chunks);
+}
+
+TEST(BufferPool, MapsRegionsWithOrWithoutHugePages) {
+    for (bool huge_pages : {false, true}) {
+        buffer_pool::configure({.huge_pages = huge_pages});
+        auto region = MUST(buffer_pool::map_region(3 * 1024 * 1024));
+        EXPECT_EQ(region.size(), 3U * 1024 * 1024);
+        EXPECT_EQ(reinterpret_cast<uintptr_t>(region.data()) % buffer_pool::ARENA_SIZE, 0U);
+        std::memset(region.data(), 1, region.size());
+        buffer_pool::unmap_region(region);
+    }
+    buffer_pool::configure({});
+}
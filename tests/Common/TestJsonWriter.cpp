@@ -0,0 +1,78 @@
+#include "Common/JsonWriter.h"
+#include <gtest/gtest.h>
+#include <limits>
+#include <string>
+#include <type_traits>
+
+using namespace common;
+
+namespace {
+
+template <typename Value>
+auto written(Value value) -> std::string {
+    fmt::memory_buffer out;
+    JsonWriter writer(out);
+    if constexpr (std::is_same_v<Value, std::string_view>) {
+        writer.string(value);
+    } else {
+        writer.number(value);
+    }
+    return fmt::to_string(out);
+}
+
+} // namespace
+
+TEST(JsonWriter, WritesIntegers) {
+    EXPECT_EQ(written(uint64_t{0}), "0");
+    EXPECT_EQ(written(uint64_t{7}), "7");
+    EXPECT_EQ(written(uint64_t{10}), "10");
+    EXPECT_EQ(written(uint64_t{999}), "999");
+    EXPECT_EQ(written(uint64_t{1000}), "1000");
+    EXPECT_EQ(written(uint64_t{1700000000000}), "1700000000000");
+    EXPECT_EQ(written(std::numeric_limits<uint64_t>::max()), "18446744073709551615");
+    // around every power of ten, where the length changes
+    uint64_t power = 10;
+    for (int i = 1; i < 20; ++i, power *= 10) {
+        EXPECT_EQ(written(power - 1), std::to_string(power - 1));
+        EXPECT_EQ(written(power), std::to_string(power));
+    }
+}
+
+TEST(JsonWriter, WritesShortestDoubles) {
+    EXPECT_EQ(written(0.5), "0.5");
+    EXPECT_EQ(written(0.1), "0.1");
+    EXPECT_EQ(written(42.0), "42");
+    EXPECT_EQ(written(-3.25), "-3.25");
+    EXPECT_EQ(written(1e21), "1e+21");
+    EXPECT_EQ(written(std::numeric_limits<double>::infinity()), "null");
+    EXPECT_EQ(written(std::numeric_limits<double>::quiet_NaN()), "null");
+}
+
+TEST(JsonWriter, EscapesStrings) {
+    EXPECT_EQ(written(std::string_view("eth0")), R"("eth0")");
+    EXPECT_EQ(written(std::string_view("")), R"("")");
+    // escapes found in the first and the last of several eight byte words
+    EXPECT_EQ(written(std::string_view("\"quoted\" name of a process")), R"("\"quoted\" name of a process")");
+    EXPECT_EQ(written(std::string_view("C:\\Program Files\\x\ty\n\x1f")), R"("C:\\Program Files\\x\ty\n\u001f")");
+    // UTF-8 is passed through
+    EXPECT_EQ(written(std::string_view("Temp °C")), "\"Temp °C\"");
+}
+
+TEST(JsonWriter, ReusesTheBuffer) {
+    fmt::memory_buffer out;
+    auto write = [&out] {
+        out.clear();
+        JsonWriter writer(out);
+        for (uint64_t i = 0; i < 1000; ++i) {
+            writer.raw(i == 0 ? R"({"value":)" : R"(,"value":)");
+            writer.number(i * 1000003);
+        }
+        writer.raw('}');
+    };
+    write();
+    const auto* data = out.data();
+    auto capacity = out.capacity();
+    write();
+    EXPECT_EQ(out.data(), data);
+    EXPECT_EQ(out.capacity(), capacity);
+}
@@ -0,0 +1,123 @@
+#include "Common/Publication.h"
+#include <atomic>
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace common;
+
+namespace {
+
+// A published value that knows its version, and counts how many are alive
+// to tell whether replaced values get freed.
+struct Value {
+    static inline std::atomic<int64_t> alive{0};
+
+    explicit Value(uint64_t version) :
+        version(version),
+        check(~version) {
+        alive.fetch_add(1, std::memory_order_relaxed);
+    }
+    Value(const Value&) = delete;
+    ~Value() {
+        // catches readers looking at freed memory along with ASan
+        check = 0;
+        alive.fetch_sub(1, std::memory_order_relaxed);
+    }
+
+    auto operator=(const Value&) -> Value& = delete;
+
+    uint64_t version;
+    uint64_t check;
+};
+
+} // namespace
+
+TEST(Publication, LoadsTheLatestValue) {
+    Publication<const Value> publication(2);
+    EXPECT_EQ(publication.version(), 0U);
+    auto published = publication.load(0);
+    EXPECT_EQ(published.value, nullptr);
+    EXPECT_EQ(published.version, 0U);
+
+    EXPECT_EQ(publication.publish(std::make_shared<const Value>(1)), 1U);
+    EXPECT_EQ(publication.publish(std::make_shared<const Value>(2)), 2U);
+    EXPECT_EQ(publication.version(), 2U);
+    for (size_t reader = 0; reader < 2; ++reader) {
+        published = publication.load(reader);
+        ASSERT_NE(published.value, nullptr);
+        EXPECT_EQ(published.value->version, 2U);
+        EXPECT_EQ(published.version, 2U);
+    }
+}
+
+TEST(Publication, ReadersKeepValuesAliveOnlyAsLongAsTheyHoldThem) {
+    {
+        Publication<const Value> publication(1);
+        publication.publish(std::make_shared<const Value>(1));
+        auto held = publication.load(0);
+        for (uint64_t version = 2; version <= 100; ++version) {
+            publication.publish(std::make_shared<const Value>(version));
+        }
+        // the held value and the latest one
+        EXPECT_EQ(Value::alive.load(), 2);
+        EXPECT_EQ(held.value->check, ~uint64_t{1});
+    }
+    EXPECT_EQ(Value::alive.load(), 0);
+}
+
+TEST(Publication, ManyReadersSeeConsistentIncreasingVersions) {
+    constexpr size_t READER_COUNT = 8;
+    constexpr uint64_t PUBLISH_COUNT = 100000;
+    {
+        Publication<const Value> publication(READER_COUNT);
+        std::atomic<bool> done{false};
+        std::atomic<size_t> failures{0};
+        std::atomic<uint64_t> loads{0};
+
+        std::vector<std::jthread> readers;
+        for (size_t reader = 0; reader < READER_COUNT; ++reader) {
+            readers.emplace_back([&, reader] {
+                uint64_t last_version = 0;
+                uint64_t count = 0;
+                // some readers hold on to the value they loaded until the
+                // next load, like a reactor queueing a message
+                Publication<const Value>::Published held;
+                while (!done.load(std::memory_order_relaxed)) {
+                    auto published = publication.load(reader);
+                    ++count;
+                    if (published.version < last_version ||
+                        (published.version > 0 && (published.value == nullptr ||
+                                                   published.value->version != published.version ||
+                                                   published.value->check != ~published.version))) {
+                        failures.fetch_add(1, std::memory_order_relaxed);
+                    }
+                    last_version = published.version;
+                    if (reader % 2 == 0) {
+                        held = std::move(published);
+                    }
+                }
+                loads.fetch_add(count, std::memory_order_relaxed);
+            });
+        }
+
+        for (uint64_t version = 1; version <= PUBLISH_COUNT; ++version) {
+            ASSERT_EQ(publication.publish(std::make_shared<const Value>(version)), version);
+            if (version % 1000 == 0) {
+                // give the readers a chance on machines with few cores
+                std::this_thread::yield();
+            }
+        }
+        done = true;
+        readers.clear();
+
+        EXPECT_EQ(failures.load(), 0U);
+        EXPECT_GT(loads.load(), 0U);
+        // the readers are gone; whatever the writer couldn't free yet goes
+        // with the publication
+        EXPECT_GE(Value::alive.load(), 1);
+    }
+    EXPECT_EQ(Value::alive.load(), 0);
+}
@@ -0,0 +1,80 @@
+#include "Common/SharedBuffer.h"
+#include <gtest/gtest.h>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+using namespace common;
+
+static auto bytes(std::string_view string) -> std::span<const uint8_t> {
+    return {reinterpret_cast<const uint8_t*>(string.data()), string.size()};
+}
+
+TEST(SharedBuffer, CopiesShareTheSameBytes) {
+    auto buffer = SharedBuffer::copy_of(bytes("snapshot"));
+    EXPECT_EQ(buffer.size(), 8U);
+    EXPECT_EQ(buffer.use_count(), 1U);
+
+    auto copy = buffer;
+    EXPECT_EQ(copy.bytes().data(), buffer.bytes().data());
+    EXPECT_EQ(buffer.use_count(), 2U);
+
+    auto moved = std::move(copy);
+    EXPECT_EQ(buffer.use_count(), 2U);
+    EXPECT_TRUE(copy.is_empty()); // NOLINT(bugprone-use-after-move)
+
+    moved = SharedBuffer();
+    EXPECT_EQ(buffer.use_count(), 1U);
+}
+
+TEST(SharedBuffer, CreateWritesInPlace) {
+    auto buffer = SharedBuffer::create(4, [](std::span<uint8_t> data) {
+        for (size_t i = 0; i < data.size(); ++i) {
+            data[i] = static_cast<uint8_t>('a' + i);
+        }
+    });
+    EXPECT_EQ(std::string_view(reinterpret_cast<const char*>(buffer.bytes().data()), buffer.size()), "abcd");
+    EXPECT_TRUE(SharedBuffer().bytes().empty());
+}
+
+TEST(SharedBuffer, ReferencesCanBeReleasedOnOtherThreads) {
+    auto buffer = SharedBuffer::copy_of(bytes("shared between threads"));
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; ++i) {
+        threads.emplace_back([buffer]() {
+            for (int j = 0; j < 10000; ++j) {
+                auto copy = buffer;
+                ASSERT_EQ(copy.size(), 22U);
+            }
+        });
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    EXPECT_EQ(buffer.use_count(), 1U);
+}
+
+TEST(SharedBuffer, ChainsLargeOutputInPooledChunks) {
+    std::string header = "head";
+    std::string payload(10000, 'x');
+    for (size_t i = 0; i < payload.size(); ++i) {
+        payload[i] = static_cast<char>('a' + i % 26);
+    }
+
+    std::vector<SharedBuffer> chain;
+    SharedBuffer::chain_of({bytes(header), bytes(payload)}, [&chain](SharedBuffer chunk) {
+        chain.push_back(std::move(chunk));
+    });
+    ASSERT_EQ(chain.size(), 3U);
+    std::string joined;
+    for (const auto& chunk : chain) {
+        EXPECT_LE(chunk.size(), SharedBuffer::MAX_POOLED_SIZE);
+        joined.append(reinterpret_cast<const char*>(chunk.bytes().data()), chunk.size());
+    }
+    EXPECT_EQ(chain[0].size(), SharedBuffer::MAX_POOLED_SIZE);
+    EXPECT_EQ(joined, header + payload);
+
+    size_t calls = 0;
+    SharedBuffer::chain_of({bytes(""), bytes("")}, [&calls](SharedBuffer) { ++calls; });
+    EXPECT_EQ(calls, 0U);
+}
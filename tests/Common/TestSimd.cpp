@@ -0,0 +1,16 @@
+#include "Common/Simd.h"
+#include <gtest/gtest.h>
+
+using namespace common::simd;
+
+TEST(Simd, PicksTheFastestSupportedImplementation) {
+    EXPECT_TRUE(is_supported(Implementation::SCALAR));
+    auto best = best_implementation();
+    EXPECT_TRUE(is_supported(best));
+    for (auto implementation : {Implementation::SSE2, Implementation::AVX2}) {
+        if (implementation > best) {
+            EXPECT_FALSE(is_supported(implementation)) << format_implementation(implementation);
+        }
+    }
+    EXPECT_EQ(format_implementation(Implementation::AVX2), "avx2");
+}
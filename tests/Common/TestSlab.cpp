@@ -0,0 +1,100 @@
+#include "Common/Slab.h"
+#include <gtest/gtest.h>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace common;
+
+TEST(Slab, FindsObjectsByHandle) {
+    Slab<std::string> slab;
+    auto [first, first_value] = slab.emplace("first");
+    auto [second, second_value] = slab.emplace(std::string(100, 'x'));
+    EXPECT_NE(first, Slab<std::string>::NO_HANDLE);
+    EXPECT_NE(first, second);
+    EXPECT_EQ(slab.size(), 2U);
+    EXPECT_EQ(first_value, "first");
+    ASSERT_NE(slab.find(second), nullptr);
+    EXPECT_EQ(slab.find(second), &second_value);
+    EXPECT_EQ(slab.find(Slab<std::string>::NO_HANDLE), nullptr);
+    // handles leave the top byte alone
+    EXPECT_EQ(first >> 56, 0U);
+    EXPECT_EQ(second >> 56, 0U);
+}
+
+TEST(Slab, StaleHandlesFindNothing) {
+    Slab<std::string> slab;
+    auto [handle, value] = slab.emplace("closed");
+    EXPECT_TRUE(slab.erase(handle));
+    EXPECT_FALSE(slab.erase(handle));
+    EXPECT_EQ(slab.find(handle), nullptr);
+    EXPECT_TRUE(slab.is_empty());
+
+    // the slot is reused, under a different handle
+    auto [reused, reused_value] = slab.emplace("opened");
+    EXPECT_NE(reused, handle);
+    EXPECT_EQ(static_cast<uint32_t>(reused), static_cast<uint32_t>(handle));
+    EXPECT_EQ(slab.find(handle), nullptr);
+    ASSERT_NE(slab.find(reused), nullptr);
+    EXPECT_EQ(*slab.find(reused), "opened");
+}
+
+TEST(Slab, NeverMovesLiveObjects) {
+    Slab<std::unique_ptr<int>> slab;
+    std::vector<std::pair<uint64_t, std::unique_ptr<int>*>> live;
+    for (int i = 0; i < 2000; ++i) {
+        auto [handle, value] = slab.emplace(std::make_unique<int>(i));
+        live.emplace_back(handle, &value);
+        // reap every third one along the way, as connections come and go
+        if (i % 3 == 0) {
+            EXPECT_TRUE(slab.erase(live[live.size() / 2].first));
+            live.erase(live.begin() + static_cast<ptrdiff_t>(live.size() / 2));
+        }
+    }
+    EXPECT_EQ(slab.size(), live.size());
+    for (auto [handle, address] : live) {
+        EXPECT_EQ(slab.find(handle), address);
+    }
+}
+
+TEST(Slab, ReusesSlotsWithoutGrowing) {
+    Slab<int> slab(1000);
+    auto capacity = slab.capacity();
+    EXPECT_GE(capacity, 1000U);
+    std::vector<uint64_t> handles;
+    for (int round = 0; round < 10; ++round) {
+        for (int i = 0; i < 1000; ++i) {
+            handles.push_back(slab.emplace(i).first);
+        }
+        for (auto handle : handles) {
+            EXPECT_TRUE(slab.erase(handle));
+        }
+        handles.clear();
+    }
+    EXPECT_EQ(slab.capacity(), capacity);
+    EXPECT_TRUE(slab.is_empty());
+}
+
+TEST(Slab, VisitsEveryObjectAndAllowsErasingIt) {
+    Slab<int> slab;
+    std::set<uint64_t> handles;
+    for (int i = 0; i < 600; ++i) {
+        handles.insert(slab.emplace(i).first);
+    }
+    std::set<uint64_t> visited;
+    slab.for_each([&](uint64_t handle, int& value) {
+        visited.insert(handle);
+        if (value % 2 == 0) {
+            slab.erase(handle);
+        }
+    });
+    EXPECT_EQ(visited, handles);
+    EXPECT_EQ(slab.size(), 300U);
+
+    slab.clear();
+    EXPECT_TRUE(slab.is_empty());
+    for (auto handle : handles) {
+        EXPECT_EQ(slab.find(handle), nullptr);
+    }
+}
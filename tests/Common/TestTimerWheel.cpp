@@ -0,0 +1,123 @@
+#include "Common/TimerWheel.h"
+#include <chrono>
+#include <gtest/gtest.h>
+#include <memory>
+#include <utility>
+#include <vector>
+
+using namespace common;
+using namespace std::chrono_literals;
+
+namespace {
+
+const auto EPOCH = TimerWheel::Clock::time_point{} + 1h;
+
+using FiredTimers = std::vector<std::pair<uint64_t, TimerWheel::Clock::time_point>>;
+
+// Advances the wheel in small steps and records when each timer fired.
+auto run_until(TimerWheel& wheel, TimerWheel::Clock::time_point end, FiredTimers& fired) -> void {
+    for (auto now = EPOCH; now <= end; now += 1ms) {
+        wheel.advance(now, [&](Timer& timer) { fired.emplace_back(timer.user_data(), now); });
+    }
+}
+
+} // namespace
+
+TEST(TimerWheel, FiresInOrderAndNeverEarly) {
+    TimerWheel wheel(EPOCH);
+    Timer a(1);
+    Timer b(2);
+    Timer c(3);
+    wheel.schedule(c, EPOCH + 95ms);
+    wheel.schedule(a, EPOCH + 15ms);
+    wheel.schedule(b, EPOCH + 40ms);
+    EXPECT_EQ(wheel.armed_count(), 3U);
+
+    FiredTimers fired;
+    run_until(wheel, EPOCH + 200ms, fired);
+
+    ASSERT_EQ(fired.size(), 3U);
+    EXPECT_EQ(fired[0].first, 1U);
+    EXPECT_EQ(fired[1].first, 2U);
+    EXPECT_EQ(fired[2].first, 3U);
+    EXPECT_GE(fired[0].second, EPOCH + 15ms);
+    EXPECT_LE(fired[0].second, EPOCH + 15ms + TimerWheel::TICK);
+    EXPECT_GE(fired[2].second, EPOCH + 95ms);
+    EXPECT_LE(fired[2].second, EPOCH + 95ms + TimerWheel::TICK);
+    EXPECT_FALSE(a.is_armed());
+    EXPECT_EQ(wheel.armed_count(), 0U);
+}
+
+TEST(TimerWheel, CascadesFromHigherLevels) {
+    TimerWheel wheel(EPOCH);
+    // beyond 64 and 4096 ticks; held in levels 1 and 2 first
+    Timer near(1);
+    Timer far(2);
+    wheel.schedule(near, EPOCH + 2s);
+    wheel.schedule(far, EPOCH + 50s);
+
+    size_t fired = 0;
+    EXPECT_EQ(wheel.advance(EPOCH + 2s - 1ms, [&](Timer&) { ++fired; }), 0U);
+    EXPECT_EQ(wheel.advance(EPOCH + 2s, [&](Timer& timer) { fired += timer.user_data(); }), 1U);
+    EXPECT_EQ(fired, 1U);
+    EXPECT_EQ(wheel.advance(EPOCH + 50s - 1ms, [&](Timer&) { ++fired; }), 0U);
+    EXPECT_EQ(wheel.advance(EPOCH + 50s, [&](Timer& timer) { fired += timer.user_data(); }), 1U);
+    EXPECT_EQ(fired, 3U);
+}
+
+TEST(TimerWheel, CancelledTimersDontFire) {
+    TimerWheel wheel(EPOCH);
+    Timer cancelled(1);
+    Timer kept(2);
+    wheel.schedule(cancelled, EPOCH + 30ms);
+    wheel.schedule(kept, EPOCH + 30ms);
+    wheel.cancel(cancelled);
+    {
+        // destroying an armed timer cancels it as well
+        Timer destroyed(3);
+        wheel.schedule(destroyed, EPOCH + 30ms);
+    }
+    EXPECT_EQ(wheel.armed_count(), 1U);
+
+    std::vector<uint64_t> fired;
+    wheel.advance(EPOCH + 1s, [&](Timer& timer) { fired.push_back(timer.user_data()); });
+    EXPECT_EQ(fired, std::vector<uint64_t>{2});
+}
+
+TEST(TimerWheel, CallbacksMayRescheduleAndCancel) {
+    TimerWheel wheel(EPOCH);
+    Timer periodic(1);
+    auto other = std::make_unique<Timer>(2);
+    wheel.schedule(periodic, EPOCH + 10ms);
+    wheel.schedule(*other, EPOCH + 10ms);
+
+    size_t periodic_count = 0;
+    auto now = EPOCH;
+    for (; now <= EPOCH + 100ms; now += 10ms) {
+        wheel.advance(now, [&](Timer& timer) {
+            if (timer.user_data() == 1) {
+                ++periodic_count;
+                wheel.schedule(timer, now + 10ms);
+                // the other timer is due in the same slot
+                other.reset();
+            }
+        });
+    }
+    EXPECT_EQ(periodic_count, 10U);
+    EXPECT_TRUE(periodic.is_armed());
+}
+
+TEST(TimerWheel, TimeUntilNextTick) {
+    TimerWheel wheel(EPOCH);
+    EXPECT_EQ(wheel.time_until_next_tick(EPOCH), -1ms);
+
+    Timer timer;
+    wheel.schedule(timer, EPOCH + 35ms);
+    EXPECT_EQ(wheel.time_until_next_tick(EPOCH), 40ms);
+    EXPECT_EQ(wheel.time_until_next_tick(EPOCH + 38ms), 2ms);
+    EXPECT_EQ(wheel.time_until_next_tick(EPOCH + 45ms), 0ms);
+
+    // far away timers only need the wheel to wake up for the cascade
+    wheel.schedule(timer, EPOCH + 10s);
+    EXPECT_EQ(wheel.time_until_next_tick(EPOCH), TimerWheel::TICK * TimerWheel::SLOTS);
+}
@@ -0,0 +1,36 @@
+#include "Common/WorkerPool.h"
+#include <atomic>
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace common;
+
+TEST(WorkerPool, RunsEveryTaskOnce) {
+    for (size_t thread_count : {size_t{0}, size_t{1}, size_t{3}}) {
+        WorkerPool pool(thread_count);
+        EXPECT_EQ(pool.thread_count(), thread_count);
+        // batches after batches, reusing the threads
+        for (size_t task_count : {size_t{0}, size_t{1}, size_t{5}, size_t{1000}}) {
+            std::vector<std::atomic<int>> runs(task_count);
+            pool.run(task_count, [&runs](size_t i) { runs[i].fetch_add(1, std::memory_order_relaxed); });
+            for (size_t i = 0; i < task_count; ++i) {
+                ASSERT_EQ(runs[i].load(), 1) << thread_count << " threads, task " << i << " of " << task_count;
+            }
+        }
+    }
+}
+
+TEST(WorkerPool, SpreadsTasksAcrossThreads) {
+    WorkerPool pool(3);
+    std::atomic<int> running{0};
+    std::atomic<int> most_running{0};
+    pool.run(8, [&](size_t) {
+        auto now_running = running.fetch_add(1) + 1;
+        auto most = most_running.load();
+        while (now_running > most && !most_running.compare_exchange_weak(most, now_running)) {
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        running.fetch_sub(1);
+    });
+    EXPECT_GT(most_running.load(), 1);
+}
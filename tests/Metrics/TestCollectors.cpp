@@ -0,0 +1,502 @@
+#include "Metrics/CgroupCollector.h"
+#include "Metrics/CpuCollector.h"
+#include "Metrics/DiskCollector.h"
+#include "Metrics/MemoryCollector.h"
+#include "Metrics/NetworkCollector.h"
+#include "Metrics/ProcessCollector.h"
+#include "Metrics/ProtocolCollector.h"
+#include "Metrics/SensorCollector.h"
+#include "Metrics/SnapshotJson.h"
+#include "TemporaryDirectory.h"
+#include <filesystem>
+#include <fmt/format.h>
+#include <gtest/gtest.h>
+#include <string>
+#include <unistd.h>
+
+using namespace metrics;
+using test::TemporaryDirectory;
+
+namespace {
+
+// Clock of the collectors reporting rates, moved on by hand.
+class FakeClock final {
+public:
+    [[nodiscard]] auto clock() -> RateClock {
+        return [this] { return now_; };
+    }
+    auto advance(std::chrono::milliseconds duration) -> void { now_ += duration; }
+
+private:
+    std::chrono::steady_clock::time_point now_;
+};
+
+// Returns the data of a keyframe of the collector's next sample.
+auto collect(Collector& collector) -> std::string {
+    Snapshot snapshot(collector.schema());
+    MUST(collector.collect(snapshot));
+    snapshot.finish(1, std::chrono::milliseconds(0));
+    fmt::memory_buffer out;
+    json::write_keyframe(out, snapshot);
+    auto keyframe = fmt::to_string(out);
+    auto data = keyframe.find(R"("data":)") + 7;
+    return keyframe.substr(data, keyframe.size() - data - 1);
+}
+
+} // namespace
+
+TEST(CpuCollector, ReportsUtilizationSincePreviousSample) {
+    TemporaryDirectory fs("collector-test");
+    fs.write("stat",
+             "cpu  100 0 100 800 0 0 0 0 0 0\n"
+             "cpu0 50 0 50 400 0 0 0 0 0 0\n"
+             "cpu1 50 0 50 400 0 0 0 0 0 0\n"
+             "intr 12345\n");
+    fs.write("loadavg", "0.52 0.58 1.5 2/1234 5678\n");
+    CpuCollector cpu(Topic::CPU, fs.path("stat"), fs.path("loadavg"));
+    CpuCollector per_core(Topic::CPU_PER_CORE, fs.path("stat"), fs.path("loadavg"), fs.path("node"));
+    collect(cpu);
+    collect(per_core);
+
+    fs.write("stat",
+             "cpu  200 0 150 850 0 0 0 0 0 0\n"
+             "cpu0 150 0 50 400 0 0 0 0 0 0\n"
+             "cpu1 50 0 100 450 0 0 0 0 0 0\n"
+             "intr 12345\n");
+    EXPECT_EQ(
+        collect(cpu),
+        R"({"usage":75,"user":50,"system":25,"iowait":0,"steal":0,"cores":2,"load1":0.52,"load5":0.58,"load15":1.5})");
+    EXPECT_EQ(collect(per_core),
+              R"({"0":{"usage":100,"user":100,"system":0,"iowait":0,"steal":0,"idle":0},)"
+              R"("1":{"usage":50,"user":0,"system":50,"iowait":0,"steal":0,"idle":50}})");
+}
+
+TEST(CpuCollector, RollsCoresUpByNodeAndSocket) {
+    TemporaryDirectory fs("collector-test");
+    // two nodes on a single socket, core 3 offline
+    fs.write("node/node0/cpulist", "0-1\n");
+    fs.write("node/node1/cpulist", "2,4\n");
+    for (std::string_view core : {"node0/cpu0", "node0/cpu1", "node1/cpu2", "node1/cpu4"}) {
+        fs.write(fmt::format("node/{}/topology/physical_package_id", core), "0\n");
+    }
+    fs.write("node/possible", "0-1\n");
+    fs.write("stat",
+             "cpu  0 0 0 0 0 0 0 0 0 0\n"
+             "cpu0 0 0 0 0 0 0 0 0 0 0\n"
+             "cpu1 0 0 0 0 0 0 0 0 0 0\n"
+             "cpu2 0 0 0 0 0 0 0 0 0 0\n"
+             "cpu4 0 0 0 0 0 0 0 0 0 0\n");
+    CpuCollector per_core(Topic::CPU_PER_CORE, fs.path("stat"), fs.path("loadavg"), fs.path("node"));
+    collect(per_core);
+
+    fs.write("stat",
+             "cpu  200 0 40 140 0 0 0 20 0 0\n"
+             "cpu0 100 0 0 0 0 0 0 0 0 0\n"
+             "cpu1 0 0 0 100 0 0 0 0 0 0\n"
+             "cpu2 100 0 0 0 0 0 0 0 0 0\n"
+             "cpu4 0 0 40 40 0 0 0 20 0 0\n");
+    EXPECT_EQ(collect(per_core),
+              R"({"0":{"usage":100,"user":100,"system":0,"iowait":0,"steal":0,"idle":0},)"
+              R"("1":{"usage":0,"user":0,"system":0,"iowait":0,"steal":0,"idle":100},)"
+              R"("2":{"usage":100,"user":100,"system":0,"iowait":0,"steal":0,"idle":0},)"
+              R"("4":{"usage":60,"user":0,"system":40,"iowait":0,"steal":20,"idle":40},)"
+              R"("node0":{"usage":50,"user":50,"system":0,"iowait":0,"steal":0,"idle":50},)"
+              R"("node1":{"usage":80,"user":50,"system":20,"iowait":0,"steal":10,"idle":20}})");
+}
+
+TEST(NetworkCollector, ReportsRatesAndUtilization) {
+    TemporaryDirectory fs("collector-test");
+    FakeClock clock;
+    constexpr std::string_view HEADER =
+        "Inter-|   Receive                                                |  Transmit\n"
+        " face |bytes    packets errs drop fifo frame compressed multicast|bytes    packets errs drop fifo colls "
+        "carrier compressed\n";
+    fs.write("dev",
+             fmt::format("{}"
+                         "    lo:    1000      10    0    0    0     0          0         0     1000      10    0 "
+                         "   0    0     0       0          0\n"
+                         "  eth0:4294967000  100    1    0    0     0          0         0     5000      50    0 "
+                         "   0    0     0       0          0\n",
+                         HEADER));
+    fs.write("net/eth0/speed", "1000\n");
+    NetworkCollector network(fs.path("dev"), fs.path("net"), clock.clock());
+    collect(network);
+
+    // the receive counter of eth0 wraps around 32 bits, eth1 shows up
+    clock.advance(std::chrono::seconds(2));
+    fs.write("dev",
+             fmt::format("{}"
+                         "    lo:    2000      20    0    0    0     0          0         0     2000      20    0 "
+                         "   0    0     0       0          0\n"
+                         "  eth0:     704  300    1    0    0     0          0         0 50005000    1050    0 "
+                         "   0    0     0       0          0\n"
+                         "  eth1:     100    1    0    0    0     0          0         0      100       1    0 "
+                         "   0    0     0       0          0\n",
+                         HEADER));
+    fs.write("net/eth1/speed", "-1\n");
+    EXPECT_EQ(collect(network),
+              R"({"eth0":{"rx_bytes":704,"rx_packets":300,"rx_errors":1,"tx_bytes":50005000,"tx_packets":1050,)"
+              R"("tx_errors":0,"rx_bytes_per_s":500,"rx_packets_per_s":100,"tx_bytes_per_s":25000000,)"
+              R"("tx_packets_per_s":500,"speed_mbps":1000,"utilization":20},)"
+              R"("eth1":{"rx_bytes":100,"rx_packets":1,"rx_errors":0,"tx_bytes":100,"tx_packets":1,"tx_errors":0,)"
+              R"("rx_bytes_per_s":0,"rx_packets_per_s":0,"tx_bytes_per_s":0,"tx_packets_per_s":0,"speed_mbps":0,)"
+              R"("utilization":0},)"
+              R"("lo":{"rx_bytes":2000,"rx_packets":20,"rx_errors":0,"tx_bytes":2000,"tx_packets":20,"tx_errors":0,)"
+              R"("rx_bytes_per_s":500,"rx_packets_per_s":5,"tx_bytes_per_s":500,"tx_packets_per_s":5,)"
+              R"("speed_mbps":0,"utilization":0}})");
+}
+
+TEST(DiskCollector, ReportsRatesAndUtilization) {
+    TemporaryDirectory fs("collector-test");
+    FakeClock clock;
+    fs.write("diskstats",
+             "   7       0 loop0 10 0 80 1 0 0 0 0 0 1 1 0 0 0 0\n"
+             " 259       0 nvme0n1 1000 0 8000 100 500 0 4000 50 0 200 150 0 0 0 0\n");
+    DiskCollector disks(fs.path("diskstats"), clock.clock());
+    collect(disks);
+
+    clock.advance(std::chrono::milliseconds(500));
+    fs.write("diskstats",
+             "   7       0 loop0 10 0 80 1 0 0 0 0 0 1 1 0 0 0 0\n"
+             " 259       0 nvme0n1 1100 0 10000 110 600 0 8000 60 1 450 170 0 0 0 0\n");
+    EXPECT_EQ(collect(disks),
+              R"({"nvme0n1":{"reads":1100,"read_bytes":5120000,"writes":600,"written_bytes":4096000,"io_ms":450,)"
+              R"("reads_per_s":200,"read_bytes_per_s":2048000,"writes_per_s":200,"written_bytes_per_s":4096000,)"
+              R"("utilization":50}})");
+}
+
+TEST(ProtocolCollector, ReportsTcpAndUdpRates) {
+    TemporaryDirectory fs("collector-test");
+    FakeClock clock;
+    auto snmp = [](uint64_t segments, uint64_t established) {
+        return fmt::format("Ip: Forwarding DefaultTTL\n"
+                           "Ip: 1 64\n"
+                           "Tcp: RtoAlgorithm RtoMin RtoMax MaxConn ActiveOpens PassiveOpens AttemptFails "
+                           "EstabResets CurrEstab InSegs OutSegs RetransSegs InErrs OutRsts InCsumErrors\n"
+                           "Tcp: 1 200 120000 -1 {0} {0} 0 0 {1} {2} {2} {0} 0 0 0\n"
+                           "Udp: InDatagrams NoPorts InErrors OutDatagrams RcvbufErrors SndbufErrors\n"
+                           "Udp: {2} 0 0 {2} {0} 0\n",
+                           segments / 100,
+                           established,
+                           segments);
+    };
+    fs.write("snmp", snmp(1000, 5));
+    ProtocolCollector protocols(fs.path("snmp"), clock.clock());
+    EXPECT_EQ(collect(protocols),
+              R"({"tcp_active_opens_per_s":0,"tcp_passive_opens_per_s":0,"tcp_attempt_fails_per_s":0,)"
+              R"("tcp_established_resets_per_s":0,"tcp_established":5,"tcp_in_segments_per_s":0,)"
+              R"("tcp_out_segments_per_s":0,"tcp_retransmitted_segments_per_s":0,"tcp_in_errors_per_s":0,)"
+              R"("tcp_out_resets_per_s":0,"udp_in_datagrams_per_s":0,"udp_out_datagrams_per_s":0,)"
+              R"("udp_no_ports_per_s":0,"udp_in_errors_per_s":0,"udp_receive_buffer_errors_per_s":0,)"
+              R"("udp_send_buffer_errors_per_s":0})");
+
+    clock.advance(std::chrono::seconds(1));
+    fs.write("snmp", snmp(3000, 7));
+    EXPECT_EQ(collect(protocols),
+              R"({"tcp_active_opens_per_s":20,"tcp_passive_opens_per_s":20,"tcp_attempt_fails_per_s":0,)"
+              R"("tcp_established_resets_per_s":0,"tcp_established":7,"tcp_in_segments_per_s":2000,)"
+              R"("tcp_out_segments_per_s":2000,"tcp_retransmitted_segments_per_s":20,"tcp_in_errors_per_s":0,)"
+              R"("tcp_out_resets_per_s":0,"udp_in_datagrams_per_s":2000,"udp_out_datagrams_per_s":2000,)"
+              R"("udp_no_ports_per_s":0,"udp_in_errors_per_s":0,"udp_receive_buffer_errors_per_s":20,)"
+              R"("udp_send_buffer_errors_per_s":0})");
+}
+
+// Writes the files of a cgroup beneath given directory of the fake tree.
+static auto write_cgroup(const TemporaryDirectory& fs,
+                         const std::string& directory,
+                         uint64_t usage_usec,
+                         bool populated) -> void {
+    fs.write(directory + "/cgroup.events", fmt::format("populated {}\nfrozen 0\n", populated ? 1 : 0));
+    fs.write(directory + "/cpu.stat",
+             fmt::format("usage_usec {}\nuser_usec 0\nsystem_usec 0\nnr_periods 0\nnr_throttled 0\n"
+                         "throttled_usec {}\n",
+                         usage_usec,
+                         usage_usec / 10));
+    fs.write(directory + "/memory.current", "1048576\n");
+    fs.write(directory + "/memory.max", "max\n");
+}
+
+TEST(CgroupCollector, ReportsUsageAndPressure) {
+    TemporaryDirectory fs("collector-test");
+    FakeClock clock;
+    fs.write("cgroup.controllers", "cpu io memory pids\n");
+    fs.write("cpu.stat", "usage_usec 0\n");
+    auto write_io = [&fs](uint64_t bytes) {
+        fs.write("web/io.stat",
+                 fmt::format("8:0 rbytes={0} wbytes={0} rios=10 wios=20 dbytes=0 dios=0\n"
+                             "8:16 rbytes={0} wbytes=0 rios=10 wios=0 dbytes=0 dios=0\n",
+                             bytes));
+    };
+    write_cgroup(fs, "web", 1000000, true);
+    fs.write("web/memory.max", "536870912\n");
+    fs.write("web/pids.current", "12\n");
+    fs.write("web/cpu.pressure",
+             "some avg10=1.52 avg60=0.87 avg300=0.25 total=123456\nfull avg10=0.50 avg60=0.00 avg300=0.00 total=1\n");
+    fs.write("web/memory.pressure",
+             "some avg10=3.00 avg60=0.00 avg300=0.00 total=0\nfull avg10=2.00 avg60=0.00 avg300=0.00 total=0\n");
+    write_io(1000);
+    write_cgroup(fs, "idle", 0, false);
+    CgroupCollector cgroups(fs.path(""), clock.clock(), 0);
+    collect(cgroups);
+
+    // two seconds later web used one and a half cores
+    clock.advance(std::chrono::seconds(2));
+    write_cgroup(fs, "web", 4000000, true);
+    fs.write("web/memory.max", "536870912\n");
+    write_io(5000);
+    EXPECT_EQ(collect(cgroups),
+              R"({"/":{"cpu":0,"cpu_throttled":0,"memory":0,"memory_max":0,"io_read_bytes_per_s":0,)"
+              R"("io_write_bytes_per_s":0,"io_reads_per_s":0,"io_writes_per_s":0,"pids":0,"cpu_pressure":0,)"
+              R"("cpu_pressure_full":0,"memory_pressure":0,"memory_pressure_full":0,"io_pressure":0,)"
+              R"("io_pressure_full":0},)"
+              R"("/web":{"cpu":150,"cpu_throttled":15,"memory":1048576,"memory_max":536870912,)"
+              R"("io_read_bytes_per_s":4000,"io_write_bytes_per_s":2000,"io_reads_per_s":0,"io_writes_per_s":0,)"
+              R"("pids":12,"cpu_pressure":1.52,"cpu_pressure_full":0.5,"memory_pressure":3,)"
+              R"("memory_pressure_full":2,"io_pressure":0,"io_pressure_full":0}})");
+
+    // a disk went away, taking its share of io.stat with it; that is no
+    // sign of 2^32 bytes having been read
+    clock.advance(std::chrono::seconds(1));
+    write_cgroup(fs, "web", 5000000, true);
+    fs.write("web/io.stat", "8:0 rbytes=5000 wbytes=5000 rios=10 wios=20 dbytes=0 dios=0\n");
+    auto json = collect(cgroups);
+    EXPECT_NE(json.find(R"("/web":{"cpu":0,"cpu_throttled":0,)"), std::string::npos) << json;
+    EXPECT_NE(json.find(R"("io_read_bytes_per_s":0,"io_write_bytes_per_s":0,)"), std::string::npos) << json;
+
+    // and rates resume from there
+    clock.advance(std::chrono::seconds(1));
+    write_cgroup(fs, "web", 6000000, true);
+    EXPECT_NE(collect(cgroups).find(R"("/web":{"cpu":100,)"), std::string::npos);
+}
+
+TEST(CgroupCollector, ReadsIoStatOfManyDevices) {
+    TemporaryDirectory fs("collector-test");
+    FakeClock clock;
+    fs.write("cgroup.controllers", "cpu io memory pids\n");
+    fs.write("cpu.stat", "usage_usec 0\n");
+    // well past a page of io.stat, none of which may go missing
+    auto write_io = [&fs](uint64_t bytes) {
+        std::string io_stat;
+        for (int device = 0; device < 200; ++device) {
+            io_stat += fmt::format("8:{} rbytes={} wbytes=0 rios=0 wios=0 dbytes=0 dios=0\n", device * 16, bytes);
+        }
+        fs.write("web/io.stat", io_stat);
+    };
+    write_cgroup(fs, "web", 0, true);
+    write_io(1000);
+    CgroupCollector cgroups(fs.path(""), clock.clock(), 0);
+    collect(cgroups);
+
+    clock.advance(std::chrono::seconds(1));
+    write_cgroup(fs, "web", 0, true);
+    write_io(2000);
+    auto json = collect(cgroups);
+    EXPECT_NE(json.find(R"("io_read_bytes_per_s":200000,)"), std::string::npos) << json;
+}
+
+TEST(CgroupCollector, FollowsTheTreeWithoutWalkingIt) {
+    TemporaryDirectory fs("collector-test");
+    fs.write("cgroup.controllers", "cpu io memory pids\n");
+    fs.write("cpu.stat", "usage_usec 0\n");
+    write_cgroup(fs, "system.slice", 0, true);
+    write_cgroup(fs, "system.slice/a.service", 0, true);
+    write_cgroup(fs, "system.slice/b.service", 0, true);
+    write_cgroup(fs, "user.slice", 0, true);
+    CgroupCollector cgroups(fs.path(""), std::chrono::steady_clock::now, 0);
+    collect(cgroups);
+    EXPECT_EQ(cgroups.cgroup_count(), 5U);
+    EXPECT_EQ(cgroups.open_file_count(), 5U * 9U);
+    auto listed = cgroups.listed_directory_count();
+    EXPECT_EQ(listed, 5U);
+
+    // nothing changed, nothing listed
+    collect(cgroups);
+    EXPECT_EQ(cgroups.listed_directory_count(), listed);
+
+    // a service starts, another stops and its cgroup is removed, a slice
+    // empties
+    write_cgroup(fs, "system.slice/c.service", 0, true);
+    std::filesystem::remove_all(fs.path("system.slice/b.service"));
+    write_cgroup(fs, "user.slice", 0, false);
+    Snapshot snapshot(cgroups.schema());
+    MUST(cgroups.collect(snapshot));
+    snapshot.finish(3, std::chrono::milliseconds(0));
+    // system.slice and the new service
+    EXPECT_EQ(cgroups.listed_directory_count(), listed + 2);
+    EXPECT_EQ(cgroups.cgroup_count(), 5U);
+    EXPECT_EQ(cgroups.open_file_count(), 5U * 9U);
+    std::vector<std::string> keys;
+    for (const auto& row : snapshot.rows()) {
+        keys.push_back(row.key);
+    }
+    EXPECT_EQ(keys,
+              (std::vector<std::string>{"/", "/system.slice", "/system.slice/a.service", "/system.slice/c.service"}));
+
+    // a service restarts between two samples: its cgroup is removed and
+    // created again under the same name
+    std::filesystem::remove_all(fs.path("system.slice/a.service"));
+    write_cgroup(fs, "system.slice/a.service", 0, true);
+    fs.write("system.slice/a.service/memory.current", "2097152\n");
+    collect(cgroups);
+    EXPECT_EQ(cgroups.cgroup_count(), 5U);
+    EXPECT_EQ(cgroups.open_file_count(), 5U * 9U);
+    Snapshot restarted(cgroups.schema());
+    MUST(cgroups.collect(restarted));
+    restarted.finish(5, std::chrono::milliseconds(0));
+    const auto* service = restarted.find_row("/system.slice/a.service");
+    ASSERT_NE(service, nullptr);
+    EXPECT_EQ(service->values[2], Value(uint64_t{2097152}));
+
+    CgroupCollector v1(fs.path("system.slice"), std::chrono::steady_clock::now, 0);
+    Snapshot v1_snapshot(v1.schema());
+    EXPECT_TRUE(v1.collect(v1_snapshot).is_error());
+}
+
+TEST(MemoryCollector, ReportsBytes) {
+    TemporaryDirectory fs("collector-test");
+    fs.write("meminfo",
+             "MemTotal:       16000 kB\n"
+             "MemFree:         4000 kB\n"
+             "MemAvailable:    8000 kB\n"
+             "Buffers:          100 kB\n"
+             "Cached:          2000 kB\n"
+             "SwapCached:         0 kB\n"
+             "SwapTotal:       1000 kB\n"
+             "SwapFree:        1000 kB\n");
+    MemoryCollector memory(fs.path("meminfo"));
+    EXPECT_EQ(collect(memory),
+              R"({"total":16384000,"free":4096000,"available":8192000,"buffers":102400,"cached":2048000,)"
+              R"("swap_total":1024000,"swap_free":1024000})");
+}
+
+TEST(ProcessCollector, ParsesCommandNamesWithParentheses) {
+    TemporaryDirectory fs("collector-test");
+    fs.write("uptime", "100.00 300.00\n");
+    fs.write("42/stat", "42 (my (odd) name) R 1 42 42 0 -1 0 0 0 0 0 7 3 0 0 20 0 1 0 100 4096 2 0\n");
+    fs.write("42/statm", "300 2 1 0 0 0 0\n");
+    fs.write("42/status", "Name:\tmy (odd) name\nUid:\t1000\t1000\t1000\t1000\n");
+    fs.write("self/stat", "not a process\n");
+    ProcessCollector processes(fs.path(""));
+    auto json = collect(processes);
+    EXPECT_EQ(json,
+              fmt::format(R"({{"42":{{"name":"my (odd) name","state":"R","cpu_ticks":10,"rss":{},"cpu":0,)"
+                          R"("threads":1,"shared":{},"uid":1000}}}})",
+                          2 * ::sysconf(_SC_PAGESIZE),
+                          ::sysconf(_SC_PAGESIZE)));
+}
+
+TEST(ProcessCollector, UpdatesTheTableIncrementally) {
+    TemporaryDirectory fs("collector-test");
+    auto ticks_per_second = static_cast<uint64_t>(::sysconf(_SC_CLK_TCK));
+    auto write_process = [&fs](uint32_t pid, std::string_view name, uint64_t utime, uint64_t start_time,
+                               uint32_t uid) {
+        fs.write(fmt::format("{}/stat", pid),
+                 fmt::format("{} ({}) S 1 1 1 0 -1 0 0 0 0 0 {} 0 0 0 20 0 1 0 {} 4096 2 0\n",
+                             pid,
+                             name,
+                             utime,
+                             start_time));
+        fs.write(fmt::format("{}/statm", pid), "300 2 1 0 0 0 0\n");
+        fs.write(fmt::format("{}/status", pid), fmt::format("Name:\t{}\nUid:\t{}\t0\t0\t0\n", name, uid));
+    };
+    fs.write("uptime", "100.00 300.00\n");
+    write_process(42, "busy", 1000, 500, 0);
+    write_process(43, "idle", 10, 600, 0);
+    write_process(44, "exiting", 10, 700, 0);
+    ProcessCollector processes(fs.path(""), 0);
+    collect(processes);
+    EXPECT_EQ(processes.open_file_count(), 6U);
+
+    // two seconds later 42 used half a core, 43 exited and its pid went to
+    // a process of another user, 44 is gone
+    fs.write("uptime", "102.00 303.00\n");
+    write_process(42, "busy", 1000 + ticks_per_second, 500, 0);
+    write_process(43, "other", 5, 900, 1000);
+    std::filesystem::remove_all(fs.path("44"));
+
+    Snapshot snapshot(processes.schema());
+    MUST(processes.collect(snapshot));
+    snapshot.finish(2, std::chrono::milliseconds(0));
+    ASSERT_EQ(snapshot.rows().size(), 2U);
+    const auto* busy = snapshot.find_row("42");
+    ASSERT_NE(busy, nullptr);
+    EXPECT_EQ(busy->values[4], Value(50.0));
+    const auto* other = snapshot.find_row("43");
+    ASSERT_NE(other, nullptr);
+    EXPECT_EQ(other->values[0], Value(std::string("other")));
+    EXPECT_EQ(other->values[4], Value(0.0));
+    EXPECT_EQ(other->values[7], Value(uint64_t{1000}));
+    EXPECT_EQ(processes.open_file_count(), 4U);
+}
+
+TEST(ProcessCollector, ScansLargeTablesInParallel) {
+    TemporaryDirectory fs("collector-test");
+    fs.write("uptime", "100.00 300.00\n");
+    constexpr uint32_t PROCESS_COUNT = ProcessCollector::PROCESSES_PER_TASK * 3 + 7;
+    for (uint32_t pid = 1; pid <= PROCESS_COUNT; ++pid) {
+        fs.write(fmt::format("{}/stat", pid),
+                 fmt::format("{} (process {}) S 1 1 1 0 -1 0 0 0 0 0 {} 0 0 0 20 0 1 0 5 4096 2 0\n", pid, pid, pid));
+        fs.write(fmt::format("{}/statm", pid), "300 2 1 0 0 0 0\n");
+        fs.write(fmt::format("{}/status", pid), "Uid:\t0\t0\t0\t0\n");
+    }
+    ProcessCollector processes(fs.path(""), 2);
+    Snapshot snapshot(processes.schema());
+    MUST(processes.collect(snapshot));
+    snapshot.finish(1, std::chrono::milliseconds(0));
+    ASSERT_EQ(snapshot.rows().size(), PROCESS_COUNT);
+    for (uint32_t pid = 1; pid <= PROCESS_COUNT; ++pid) {
+        const auto* row = snapshot.find_row(fmt::format("{}", pid));
+        ASSERT_NE(row, nullptr) << pid;
+        EXPECT_EQ(row->values[0], Value(fmt::format("process {}", pid)));
+        EXPECT_EQ(row->values[2], Value(uint64_t{pid}));
+    }
+}
+
+TEST(SensorCollector, ReportsHwmonThermalAndFrequencySensors) {
+    TemporaryDirectory fs("collector-test");
+    fs.write("hwmon/hwmon0/name", "coretemp\n");
+    fs.write("hwmon/hwmon0/temp1_input", "45000\n");
+    fs.write("hwmon/hwmon0/temp1_label", "Package id 0\n");
+    fs.write("hwmon/hwmon0/temp2_input", "43500\n");
+    fs.write("hwmon/hwmon1/name", "nct6775\n");
+    fs.write("hwmon/hwmon1/fan1_input", "1200\n");
+    fs.write("hwmon/hwmon1/fan1_min", "300\n");
+    fs.write("hwmon/hwmon1/power1_average", "90000000\n");
+    fs.write("hwmon/hwmon1/power1_input", "95250000\n");
+    fs.write("thermal/thermal_zone0/type", "acpitz\n");
+    fs.write("thermal/thermal_zone0/temp", "-5000\n");
+    fs.write("thermal/cooling_device0/type", "Processor\n");
+    fs.write("cpu/cpu0/cpufreq/scaling_cur_freq", "2400000\n");
+    fs.write("cpu/cpu1/cpufreq/scaling_cur_freq", "800123\n");
+    // offline, or without cpufreq
+    fs.write("cpu/cpu2/online", "0\n");
+    fs.write("cpu/cpufreq/boost", "1\n");
+    SensorCollector sensors(fs.path("hwmon"), fs.path("thermal"), fs.path("cpu"));
+    EXPECT_EQ(collect(sensors),
+              R"({"cpu0/frequency":{"chip":"cpufreq","label":"cpu0","kind":"frequency","value":2400},)"
+              R"("cpu1/frequency":{"chip":"cpufreq","label":"cpu1","kind":"frequency","value":800},)"
+              R"("hwmon0/temp1":{"chip":"coretemp","label":"Package id 0","kind":"temperature","value":45},)"
+              R"("hwmon0/temp2":{"chip":"coretemp","label":"temp2","kind":"temperature","value":43.5},)"
+              R"("hwmon1/fan1":{"chip":"nct6775","label":"fan1","kind":"fan","value":1200},)"
+              R"("hwmon1/power1":{"chip":"nct6775","label":"power1","kind":"power","value":95.25},)"
+              R"("thermal_zone0":{"chip":"thermal","label":"acpitz","kind":"temperature","value":-5}})");
+    EXPECT_EQ(sensors.sensor_count(), 7U);
+
+    // the files found are kept open and read in place, even once their
+    // directories are gone; no directory is listed until the next discovery
+    fs.write("cpu/cpu0/cpufreq/scaling_cur_freq", "3100000\n");
+    std::filesystem::rename(fs.path("hwmon/hwmon0"), fs.path("hwmon/moved"));
+    fs.write("hwmon/hwmon2/name", "new\n");
+    fs.write("hwmon/hwmon2/temp1_input", "1000\n");
+    Snapshot snapshot(sensors.schema());
+    MUST(sensors.collect(snapshot));
+    snapshot.finish(2, std::chrono::milliseconds(0));
+    EXPECT_EQ(snapshot.rows().size(), 7U);
+    ASSERT_NE(snapshot.find_row("cpu0/frequency"), nullptr);
+    EXPECT_EQ(snapshot.find_row("cpu0/frequency")->values[3], Value(3100.0));
+    EXPECT_NE(snapshot.find_row("hwmon0/temp1"), nullptr);
+    EXPECT_EQ(snapshot.find_row("hwmon2/temp1"), nullptr);
+
+    SensorCollector no_sensors(fs.path("missing"), fs.path("missing"), fs.path("missing"));
+    EXPECT_EQ(collect(no_sensors), "{}");
+}
@@ -0,0 +1,104 @@
+#include "Metrics/CpuShares.h"
+#include <cstdint>
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using namespace common::simd;
+using namespace metrics::cpu_shares;
+
+namespace {
+
+// Counters of as many cores, taken twice.
+struct Columns {
+    std::vector<uint64_t> current;
+    std::vector<uint64_t> previous;
+    std::vector<uint64_t> current_total;
+    std::vector<uint64_t> previous_total;
+};
+
+// busy cores, idle cores, counters going down and totals standing still,
+// with counters far from zero as after a long uptime
+auto make_columns(size_t length) -> Columns {
+    Columns columns;
+    for (size_t i = 0; i < length; ++i) {
+        uint64_t base = (uint64_t{1} << 40) + i * 7919;
+        uint64_t elapsed = i % 11 == 10 ? 0 : 1 + i * 37 % 400;
+        uint64_t delta = i % 13 == 12 ? uint64_t(-5) : i * 53 % (elapsed + 20);
+        columns.previous.push_back(base);
+        columns.current.push_back(base + delta);
+        columns.previous_total.push_back(base * 3);
+        columns.current_total.push_back(base * 3 + elapsed);
+    }
+    return columns;
+}
+
+} // namespace
+
+class CpuSharesTest : public ::testing::TestWithParam<Implementation> {
+protected:
+    void SetUp() override {
+        if (!is_supported(GetParam())) {
+            GTEST_SKIP() << format_implementation(GetParam()) << " not supported on this CPU";
+        }
+    }
+
+    auto compute(const std::vector<uint64_t>& current,
+                 const std::vector<uint64_t>& previous,
+                 const std::vector<uint64_t>& current_total,
+                 const std::vector<uint64_t>& previous_total) -> std::vector<double> {
+        std::vector<double> shares(current.size(), -1.0);
+        compute_using(GetParam(), current, previous, current_total, previous_total, shares);
+        return shares;
+    }
+};
+
+TEST_P(CpuSharesTest, MatchesScalarForAllLengthsAndOffsets) {
+    auto columns = make_columns(100);
+    for (size_t offset = 0; offset < 4; ++offset) {
+        for (size_t length = 0; length + offset <= columns.current.size(); ++length) {
+            std::vector<double> expected(length);
+            std::vector<double> shares(length);
+            auto span = [offset, length](const std::vector<uint64_t>& column) {
+                return std::span<const uint64_t>(column.data() + offset, length);
+            };
+            compute_using(Implementation::SCALAR,
+                          span(columns.current),
+                          span(columns.previous),
+                          span(columns.current_total),
+                          span(columns.previous_total),
+                          expected);
+            compute_using(GetParam(),
+                          span(columns.current),
+                          span(columns.previous),
+                          span(columns.current_total),
+                          span(columns.previous_total),
+                          shares);
+            ASSERT_EQ(shares, expected) << offset << "+" << length;
+        }
+    }
+}
+
+TEST_P(CpuSharesTest, RoundsToTenthsOfPercent) {
+    // 1/3, 2/3, halves of a tenth rounding to even, and all of the time
+    auto shares = compute({1, 2, 5, 15, 3000}, {0, 0, 0, 0, 1000}, {3, 3, 2000, 2000, 4000}, {0, 0, 0, 0, 2000});
+    EXPECT_EQ(shares, (std::vector<double>{33.3, 66.7, 0.2, 0.8, 100.0}));
+}
+
+TEST_P(CpuSharesTest, ReportsZeroWithoutElapsedTime) {
+    // the total standing still or going down, and a counter going down
+    auto shares = compute({10, 10, 5, 10}, {0, 0, 10, 0}, {100, 50, 200, 200}, {100, 100, 100, 100});
+    EXPECT_EQ(shares, (std::vector<double>{0.0, 0.0, 0.0, 10.0}));
+}
+
+TEST_P(CpuSharesTest, CapsAtHundredPercent) {
+    auto shares = compute({150, 101, 100, 100}, {0, 0, 0, 0}, {100, 100, 100, 100}, {0, 0, 0, 0});
+    EXPECT_EQ(shares, (std::vector<double>{100.0, 100.0, 100.0, 100.0}));
+}
+
+INSTANTIATE_TEST_SUITE_P(Implementations,
+                         CpuSharesTest,
+                         ::testing::Values(Implementation::SCALAR, Implementation::SSE2, Implementation::AVX2),
+                         [](const auto& info) {
+                             return std::string(format_implementation(info.param));
+                         });
@@ -0,0 +1,56 @@
+#include "Metrics/DeviceTable.h"
+#include <gtest/gtest.h>
+
+using namespace metrics;
+using namespace std::chrono_literals;
+
+TEST(DeviceTable, TellsWraparoundFromResets) {
+    EXPECT_EQ(counter_delta(100, 150), 50U);
+    // a 32-bit counter wrapping around
+    EXPECT_EQ(counter_delta(UINT32_MAX - 9, 10), 20U);
+    // a 64-bit counter can't have wrapped since the previous sample
+    EXPECT_EQ(counter_delta(uint64_t{1} << 40, 10), 0U);
+    // nor can a small one, which was reset rather than having gone up by
+    // almost 2^32
+    EXPECT_EQ(counter_delta(1000, 10), 0U);
+    EXPECT_EQ(counter_delta(uint64_t{1} << 30, 10), 0U);
+}
+
+TEST(DeviceTable, ReusesTheIdsOfDevicesGone) {
+    auto now = std::chrono::steady_clock::time_point{};
+    DeviceTable devices(1, [&now] { return now; });
+
+    devices.begin_sample();
+    auto eth0 = devices.see("eth0");
+    auto eth1 = devices.see("eth1");
+    EXPECT_NE(eth0, eth1);
+    EXPECT_TRUE(devices.is_new(eth0));
+    EXPECT_EQ(devices.rate(eth0, 0, 1000), 0.0);
+    devices.rate(eth1, 0, 5000);
+    devices.end_sample();
+
+    // eth1 goes away and veth0 takes its id
+    now += 2s;
+    devices.begin_sample();
+    EXPECT_EQ(devices.see("eth0"), eth0);
+    EXPECT_FALSE(devices.is_new(eth0));
+    EXPECT_EQ(devices.rate(eth0, 0, 3000), 1000.0);
+    devices.end_sample();
+    EXPECT_EQ(devices.size(), 1U);
+
+    now += 1s;
+    devices.begin_sample();
+    devices.see("eth0");
+    auto veth0 = devices.see("veth0");
+    EXPECT_EQ(veth0, eth1);
+    EXPECT_TRUE(devices.is_new(veth0));
+    // the counters of eth1 are not taken for those of veth0
+    EXPECT_EQ(devices.rate(veth0, 0, 6000), 0.0);
+    devices.end_sample();
+
+    now += 1s;
+    devices.begin_sample();
+    devices.see("eth0");
+    EXPECT_EQ(devices.rate(devices.see("veth0"), 0, 6500), 500.0);
+    devices.end_sample();
+}
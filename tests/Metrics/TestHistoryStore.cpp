@@ -0,0 +1,205 @@
+#include "Metrics/HistoryStore.h"
+#include "Metrics/QuantileSketch.h"
+#include "TemporaryDirectory.h"
+#include <array>
+#include <cstdlib>
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+using namespace metrics;
+using namespace std::chrono_literals;
+using test::TemporaryDirectory;
+
+namespace {
+
+constexpr std::array<FieldDescriptor, 3> FIELDS = {{
+    field<"name">(FieldType::TEXT),
+    field<"rx_bytes">(FieldType::UINT),
+    field<"load">(FieldType::FLOAT),
+}};
+
+constexpr Schema ROWS_SCHEMA = {Topic::NETWORK, "interface", FIELDS};
+constexpr Schema SINGLE_ROW_SCHEMA = {Topic::MEMORY, {}, FIELDS};
+
+// 1 s for 4 s, 2 s for 6 s
+constexpr std::array<HistoryStore::Resolution, 2> RESOLUTIONS = {{{1s, 4}, {2s, 3}}};
+
+auto record(HistoryStore& history,
+            const Schema& schema,
+            std::chrono::milliseconds timestamp,
+            std::vector<std::pair<std::string, uint64_t>> rows) -> void {
+    Snapshot snapshot(schema);
+    for (auto& [key, rx_bytes] : rows) {
+        auto& row = snapshot.add_row(key);
+        row.values[0] = "if " + key;
+        row.values[1] = rx_bytes;
+        row.values[2] = 0.5;
+    }
+    snapshot.finish(1, timestamp);
+    history.record(snapshot);
+}
+
+// Returns the numbers of the array starting with the first occurrence of
+// key after that of row.
+auto numbers_after(std::string_view json, std::string_view row, std::string_view key) -> std::vector<double> {
+    auto begin = json.find(key, json.find(row)) + key.size();
+    std::vector<double> numbers;
+    while (begin < json.size() && json[begin - 1] != ']') {
+        char* end = nullptr;
+        numbers.push_back(std::strtod(json.data() + begin, &end));
+        begin = static_cast<size_t>(end - json.data()) + 1;
+    }
+    return numbers;
+}
+
+auto history_json(const HistoryStore& history, Topic topic, std::chrono::milliseconds step = 0ms) -> std::string {
+    fmt::memory_buffer out;
+    MUST(history.write_json(out, topic, step));
+    return fmt::to_string(out);
+}
+
+} // namespace
+
+TEST(HistoryStore, AveragesSamplesPerStep) {
+    HistoryStore history(RESOLUTIONS);
+    MUST(history.add_topic(SINGLE_ROW_SCHEMA, 1));
+    EXPECT_EQ(history_json(history, Topic::MEMORY),
+              R"({"topic":"mem","step":1000,"start":0,"count":0,"history":{}})");
+
+    record(history, SINGLE_ROW_SCHEMA, 10000ms, {{"", 10}});
+    record(history, SINGLE_ROW_SCHEMA, 10500ms, {{"", 20}});
+    record(history, SINGLE_ROW_SCHEMA, 11000ms, {{"", 30}});
+    // nothing sampled during the 12th second
+    record(history, SINGLE_ROW_SCHEMA, 13250ms, {{"", 40}});
+    EXPECT_EQ(history_json(history, Topic::MEMORY),
+              R"({"topic":"mem","step":1000,"start":10000,"count":4,)"
+              R"("history":{"rx_bytes":[15,30,null,40],"load":[0.5,0.5,null,0.5]}})");
+    // steps are rounded up to the next resolution kept
+    EXPECT_EQ(history_json(history, Topic::MEMORY, 1500ms),
+              R"({"topic":"mem","step":2000,"start":10000,"count":2,)"
+              R"("history":{"rx_bytes":[20,40],"load":[0.5,0.5]}})");
+
+    // the oldest points make room for new ones
+    record(history, SINGLE_ROW_SCHEMA, 15000ms, {{"", 50}});
+    EXPECT_EQ(history_json(history, Topic::MEMORY),
+              R"({"topic":"mem","step":1000,"start":12000,"count":4,)"
+              R"("history":{"rx_bytes":[null,40,null,50],"load":[null,0.5,null,0.5]}})");
+    // after a long pause only the latest sample is left
+    record(history, SINGLE_ROW_SCHEMA, 60000ms, {{"", 60}});
+    EXPECT_EQ(history_json(history, Topic::MEMORY),
+              R"({"topic":"mem","step":1000,"start":57000,"count":4,)"
+              R"("history":{"rx_bytes":[null,null,null,60],"load":[null,null,null,0.5]}})");
+}
+
+TEST(HistoryStore, KeepsRowsUpToTheLimit) {
+    HistoryStore history(RESOLUTIONS);
+    MUST(history.add_topic(ROWS_SCHEMA, 2));
+    EXPECT_TRUE(history.is_kept(Topic::NETWORK));
+    EXPECT_FALSE(history.is_kept(Topic::MEMORY));
+    // 2 resolutions of 4 and 3 points, plus the sums of the steps in
+    // progress, for 2 numeric fields of 2 rows, and 2 slots of 128 bytes,
+    // every part starting on a cache line
+    EXPECT_EQ(history.memory_size(), 64 + 64 + 256 + 192 + 192);
+
+    // rows are taken in key order; lo doesn't fit
+    record(history, ROWS_SCHEMA, 1000ms, {{"lo", 1}, {"eth0", 2}, {"eth1", 3}});
+    EXPECT_EQ(history_json(history, Topic::NETWORK),
+              R"({"topic":"net","step":1000,"start":1000,"count":1,"history":{)"
+              R"("eth0":{"rx_bytes":[2],"load":[0.5]},"eth1":{"rx_bytes":[3],"load":[0.5]}}})");
+
+    // eth0 is gone, so lo takes its place, starting over
+    record(history, ROWS_SCHEMA, 2000ms, {{"lo", 4}, {"eth1", 5}});
+    EXPECT_EQ(history_json(history, Topic::NETWORK),
+              R"({"topic":"net","step":1000,"start":1000,"count":2,"history":{)"
+              R"("eth1":{"rx_bytes":[3,5],"load":[0.5,0.5]},"lo":{"rx_bytes":[null,4],"load":[null,0.5]}}})");
+}
+
+TEST(HistoryStore, AggregatesFieldsPerStep) {
+    HistoryStore history(RESOLUTIONS);
+    MUST(history.add_topic(ROWS_SCHEMA, 2));
+    // 1 to 4 on eth0, 10 to 40 on eth1 during the 100th to 103rd second,
+    // with eth1 missing the 101st
+    for (uint64_t i = 0; i < 4; ++i) {
+        std::vector<std::pair<std::string, uint64_t>> rows = {{"eth0", i + 1}};
+        if (i != 1) {
+            rows.emplace_back("eth1", (i + 1) * 10);
+        }
+        record(history, ROWS_SCHEMA, std::chrono::seconds(100 + i), std::move(rows));
+    }
+    fmt::memory_buffer out;
+    MUST(history.write_query_json(out, Topic::NETWORK, "rx_bytes", 4000ms, 2000ms));
+    auto json = fmt::to_string(out);
+    EXPECT_TRUE(json.starts_with(R"({"topic":"net","field":"rx_bytes","step":2000,"start":100000,"count":2,)"
+                                 R"("query":{"eth0":{"min":[1,3],"max":[2,4],"mean":[1.5,3.5],"p50":[)"))
+        << json;
+    EXPECT_TRUE(json.find(R"("eth1":{"min":[10,30],"max":[10,40],"mean":[10,35],"p50":[)") != std::string::npos)
+        << json;
+    // percentiles are the lower of two values, within the sketch's accuracy
+    constexpr auto ACCURACY = QuantileSketch::DEFAULT_RELATIVE_ACCURACY;
+    EXPECT_NEAR(numbers_after(json, R"("eth0":{)", R"("p99":[)")[1], 3, 3 * ACCURACY) << json;
+    EXPECT_NEAR(numbers_after(json, R"("eth1":{)", R"("p50":[)")[0], 10, 10 * ACCURACY) << json;
+    EXPECT_NEAR(numbers_after(json, R"("eth1":{)", R"("p95":[)")[1], 30, 30 * ACCURACY) << json;
+
+    // a window reaching back before the first sample
+    out.clear();
+    MUST(history.write_query_json(out, Topic::NETWORK, "load", 6000ms, 2000ms));
+    EXPECT_TRUE(fmt::to_string(out).find(R"("eth1":{"min":[null,0.5,0.5],)") != std::string::npos)
+        << fmt::to_string(out);
+
+    EXPECT_TRUE(history.write_query_json(out, Topic::NETWORK, "name", 4000ms, 2000ms).is_error());
+    EXPECT_TRUE(history.write_query_json(out, Topic::NETWORK, "rx_bytes", 4000ms, 1500ms).is_error());
+    EXPECT_TRUE(history.write_query_json(out, Topic::NETWORK, "rx_bytes", 8000ms, 2000ms).is_error());
+}
+
+TEST(HistoryStore, RefusesTopicsAndStepsNotKept) {
+    HistoryStore history(RESOLUTIONS);
+    MUST(history.add_topic(ROWS_SCHEMA, 2));
+    fmt::memory_buffer out;
+    EXPECT_TRUE(history.write_json(out, Topic::CPU, 0ms).is_error());
+    EXPECT_TRUE(history.write_json(out, Topic::NETWORK, 3000ms).is_error());
+}
+
+TEST(HistoryStore, RestoresHistoryFromItsDirectory) {
+    TemporaryDirectory directory("history-test");
+    std::string json;
+    {
+        HistoryStore history(RESOLUTIONS, directory.path().string());
+        MUST(history.add_topic(ROWS_SCHEMA, 2));
+        EXPECT_FALSE(history.is_restored(Topic::NETWORK));
+        record(history, ROWS_SCHEMA, 1000ms, {{"eth0", 1}});
+        record(history, ROWS_SCHEMA, 2000ms, {{"eth0", 2}, {"eth1", 3}});
+        json = history_json(history, Topic::NETWORK);
+        // the file is locked while mapped
+        HistoryStore other(RESOLUTIONS, directory.path().string());
+        EXPECT_TRUE(other.add_topic(ROWS_SCHEMA, 2).is_error());
+    }
+
+    HistoryStore history(RESOLUTIONS, directory.path().string());
+    MUST(history.add_topic(ROWS_SCHEMA, 2));
+    EXPECT_TRUE(history.is_restored(Topic::NETWORK));
+    EXPECT_EQ(history_json(history, Topic::NETWORK), json);
+    // rows keep their slots and the step in progress its samples
+    record(history, ROWS_SCHEMA, 2500ms, {{"eth1", 5}, {"eth0", 4}});
+    record(history, ROWS_SCHEMA, 3000ms, {{"eth1", 6}});
+    EXPECT_EQ(history_json(history, Topic::NETWORK),
+              R"({"topic":"net","step":1000,"start":1000,"count":3,"history":{)"
+              R"("eth0":{"rx_bytes":[1,3,null],"load":[0.5,0.5,null]},)"
+              R"("eth1":{"rx_bytes":[null,4,6],"load":[null,0.5,0.5]}}})");
+}
+
+TEST(HistoryStore, StartsAnewWhenTheLayoutChanged) {
+    TemporaryDirectory directory("history-test");
+    {
+        HistoryStore history(RESOLUTIONS, directory.path().string());
+        MUST(history.add_topic(ROWS_SCHEMA, 2));
+        record(history, ROWS_SCHEMA, 1000ms, {{"eth0", 1}});
+    }
+    HistoryStore history(RESOLUTIONS, directory.path().string());
+    MUST(history.add_topic(ROWS_SCHEMA, 3));
+    EXPECT_FALSE(history.is_restored(Topic::NETWORK));
+    EXPECT_EQ(history_json(history, Topic::NETWORK),
+              R"({"topic":"net","step":1000,"start":0,"count":0,"history":{}})");
+}
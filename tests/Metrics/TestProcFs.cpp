@@ -0,0 +1,75 @@
+#include "Metrics/ProcFs.h"
+#include "TemporaryDirectory.h"
+#include <array>
+#include <fcntl.h>
+#include <filesystem>
+#include <gtest/gtest.h>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+using namespace metrics;
+using test::TemporaryDirectory;
+
+TEST(ProcFs, ScansNumbersInPlace) {
+    std::string_view line = "  cpu0 12345\t0 18446744073709551615 x 7kB";
+    EXPECT_EQ(procfs::next_uint(line), 0U);
+    EXPECT_EQ(procfs::next_uint(line), 12345U);
+    EXPECT_EQ(procfs::next_uint(line), 0U);
+    EXPECT_EQ(procfs::next_uint(line), 18446744073709551615U);
+    EXPECT_EQ(procfs::next_uint(line), 0U);
+    EXPECT_EQ(procfs::next_uint(line), 7U);
+    EXPECT_TRUE(line.empty());
+    EXPECT_EQ(procfs::next_uint(line), 0U);
+
+    std::string_view loadavg = "0.52 12.5 3 1/234";
+    EXPECT_DOUBLE_EQ(procfs::next_decimal(loadavg), 0.52);
+    EXPECT_DOUBLE_EQ(procfs::next_decimal(loadavg), 12.5);
+    EXPECT_DOUBLE_EQ(procfs::next_decimal(loadavg), 3.0);
+    EXPECT_DOUBLE_EQ(procfs::next_decimal(loadavg), 1.0);
+    EXPECT_TRUE(loadavg.empty());
+}
+
+TEST(ProcFs, RereadsOpenFiles) {
+    TemporaryDirectory root("procfs-test");
+    root.write("stat", "first");
+
+    procfs::ProcFile file(root.path("stat"));
+    EXPECT_EQ(MUST(file.read()), "first");
+    // larger than the initial buffer
+    std::string large(procfs::ProcFile::INITIAL_BUFFER_SIZE * 3 + 1, 'x');
+    root.write("stat", large);
+    EXPECT_EQ(MUST(file.read()), large);
+    root.write("stat", "short");
+    EXPECT_EQ(MUST(file.read()), "short");
+
+    // a replaced file is only picked up once reading the old one failed,
+    // which for files in /proc happens when what they describe goes away
+    std::filesystem::remove(root.path("stat"));
+    EXPECT_EQ(MUST(file.read()), "short");
+
+    procfs::ProcFile missing(root.path("missing"));
+    EXPECT_TRUE(missing.read().is_error());
+}
+
+TEST(ProcFs, ReportsFilesOutgrowingTheBuffer) {
+    TemporaryDirectory root("procfs-test");
+    std::string large(100, 'x');
+    root.write("io.stat", large);
+    auto fd = ::open(root.path("io.stat").c_str(), O_RDONLY | O_CLOEXEC);
+    ASSERT_GE(fd, 0);
+
+    // a fixed buffer that the file fills may hold just part of it
+    std::array<char, 100> fixed{};
+    EXPECT_TRUE(procfs::read_file(fd, fixed).is_error());
+    std::array<char, 101> fits{};
+    EXPECT_EQ(MUST(procfs::read_file(fd, fits)), large);
+
+    // a growing buffer takes it whole
+    std::vector<char> growing(10);
+    EXPECT_EQ(MUST(procfs::read_file(fd, growing)), large);
+    root.write("io.stat", "short");
+    EXPECT_EQ(MUST(procfs::read_file(fd, growing)), "short");
+
+    ::close(fd);
+}
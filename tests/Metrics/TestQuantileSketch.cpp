@@ -0,0 +1,67 @@
+#include "Metrics/QuantileSketch.h"
+#include <algorithm>
+#include <cmath>
+#include <gtest/gtest.h>
+#include <limits>
+#include <vector>
+
+using namespace metrics;
+
+namespace {
+
+// Returns the exact q-quantile the way the sketch ranks values.
+auto exact_quantile(std::vector<double> values, double q) -> double {
+    std::sort(values.begin(), values.end());
+    return values[static_cast<size_t>(q * static_cast<double>(values.size() - 1))];
+}
+
+} // namespace
+
+TEST(QuantileSketch, StaysWithinItsRelativeAccuracy) {
+    QuantileSketch sketch;
+    std::vector<double> values;
+    // a skewed mix of negative, zero and positive values
+    for (int i = 0; i < 10000; ++i) {
+        auto value = i % 10 == 0 ? 0.0 : std::pow(1.001, i) * (i % 7 == 0 ? -1 : 1);
+        values.push_back(value);
+        sketch.add(value);
+    }
+    sketch.add(std::numeric_limits<double>::quiet_NaN());
+    EXPECT_EQ(sketch.count(), values.size());
+    for (auto q : {0.0, 0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.95, 0.99, 1.0}) {
+        auto exact = exact_quantile(values, q);
+        EXPECT_NEAR(sketch.quantile(q), exact, std::abs(exact) * QuantileSketch::DEFAULT_RELATIVE_ACCURACY) << q;
+    }
+}
+
+TEST(QuantileSketch, MergesTheSmallestMagnitudesBeyondItsBinLimit) {
+    QuantileSketch sketch;
+    std::vector<double> values;
+    // 24 orders of magnitude, far more than the bins cover
+    for (int exponent = -12; exponent < 12; ++exponent) {
+        for (int i = 1; i <= 10; ++i) {
+            values.push_back(i * std::pow(10.0, exponent));
+            sketch.add(values.back());
+        }
+    }
+    // the largest values keep their accuracy
+    for (auto q : {0.9, 0.99, 1.0}) {
+        auto exact = exact_quantile(values, q);
+        EXPECT_NEAR(sketch.quantile(q), exact, exact * QuantileSketch::DEFAULT_RELATIVE_ACCURACY) << q;
+    }
+    EXPECT_LE(sketch.quantile(0.0), exact_quantile(values, 0.5));
+}
+
+TEST(QuantileSketch, ClearsForReuse) {
+    QuantileSketch sketch;
+    EXPECT_TRUE(std::isnan(sketch.quantile(0.5)));
+    sketch.add(1000);
+    sketch.clear();
+    EXPECT_EQ(sketch.count(), 0U);
+    sketch.add(-3);
+    sketch.add(0);
+    sketch.add(5);
+    EXPECT_NEAR(sketch.quantile(0), -3, 0.03);
+    EXPECT_EQ(sketch.quantile(0.5), 0);
+    EXPECT_NEAR(sketch.quantile(1), 5, 0.05);
+}
@@ -0,0 +1,79 @@
+#include "Metrics/Reductions.h"
+#include <cmath>
+#include <gtest/gtest.h>
+#include <limits>
+#include <string>
+#include <vector>
+
+using namespace common::simd;
+using namespace metrics::reductions;
+
+namespace {
+
+constexpr double NaN = std::numeric_limits<double>::quiet_NaN();
+
+// every third point missing, values of both signs
+auto make_points(size_t length) -> std::vector<double> {
+    std::vector<double> points(length);
+    for (size_t i = 0; i < length; ++i) {
+        points[i] = i % 3 == 1 ? NaN : (static_cast<double>(i * 37 % 101) - 50.0) / 4;
+    }
+    return points;
+}
+
+} // namespace
+
+class ReductionsTest : public ::testing::TestWithParam<Implementation> {
+protected:
+    void SetUp() override {
+        if (!is_supported(GetParam())) {
+            GTEST_SKIP() << format_implementation(GetParam()) << " not supported on this CPU";
+        }
+    }
+};
+
+TEST_P(ReductionsTest, MatchesScalarForAllLengthsAndOffsets) {
+    // lengths around every vector width and unroll boundary, starting at
+    // every alignment of a double within a vector
+    auto points = make_points(100);
+    for (size_t offset = 0; offset < 4; ++offset) {
+        for (size_t length = 0; length + offset <= points.size(); ++length) {
+            std::span<const double> span(points.data() + offset, length);
+            auto expected = summarize_using(Implementation::SCALAR, span);
+            auto summary = summarize_using(GetParam(), span);
+            ASSERT_EQ(summary.count, expected.count) << offset << "+" << length;
+            EXPECT_EQ(summary.min, expected.min) << offset << "+" << length;
+            EXPECT_EQ(summary.max, expected.max) << offset << "+" << length;
+            EXPECT_DOUBLE_EQ(summary.sum, expected.sum) << offset << "+" << length;
+        }
+    }
+}
+
+TEST_P(ReductionsTest, SkipsMissingPoints) {
+    std::vector<double> points = {NaN, NaN, NaN, NaN, NaN, NaN, NaN, NaN, NaN};
+    auto summary = summarize_using(GetParam(), points);
+    EXPECT_EQ(summary.count, 0U);
+    EXPECT_TRUE(std::isnan(summary.mean()));
+
+    points[7] = -2.5;
+    summary = summarize_using(GetParam(), points);
+    EXPECT_EQ(summary.count, 1U);
+    EXPECT_EQ(summary.min, -2.5);
+    EXPECT_EQ(summary.max, -2.5);
+    EXPECT_EQ(summary.mean(), -2.5);
+}
+
+INSTANTIATE_TEST_SUITE_P(Implementations,
+                         ReductionsTest,
+                         ::testing::Values(Implementation::SCALAR, Implementation::SSE2, Implementation::AVX2),
+                         [](const auto& info) { return std::string(format_implementation(info.param)); });
+
+TEST(Reductions, DispatchesToSupportedImplementation) {
+    EXPECT_TRUE(is_supported(best_implementation()));
+
+    auto summary = summarize(std::vector<double>{1, NaN, 2, 3, 4, 5, 6, 7, 8, 9, NaN});
+    EXPECT_EQ(summary.count, 9U);
+    EXPECT_EQ(summary.min, 1);
+    EXPECT_EQ(summary.max, 9);
+    EXPECT_EQ(summary.mean(), 5);
+}
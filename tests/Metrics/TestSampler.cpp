@@ -0,0 +1,152 @@
+#include "Metrics/Sampler.h"
+#include "Metrics/SamplerCollector.h"
+#include <array>
+#include <gtest/gtest.h>
+#include <map>
+#include <vector>
+
+using namespace metrics;
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr std::array<FieldDescriptor, 1> FIELDS = {{field<"count">(FieldType::UINT)}};
+
+class CountingCollector final : public Collector {
+public:
+    explicit CountingCollector(Topic topic) :
+        schema_{topic, {}, FIELDS} {}
+
+    [[nodiscard]] auto schema() const -> const Schema& override { return schema_; }
+    auto collect(Snapshot& snapshot) -> common::ErrorOr<void> override {
+        snapshot.add_row().values[0] = ++count_;
+        return {};
+    }
+
+private:
+    Schema schema_;
+    uint64_t count_{0};
+};
+
+// Keeps the sampler thread busy for a millisecond per sample.
+class SpinningCollector final : public Collector {
+public:
+    [[nodiscard]] auto schema() const -> const Schema& override { return schema_; }
+    auto collect(Snapshot& snapshot) -> common::ErrorOr<void> override {
+        auto until = std::chrono::steady_clock::now() + 1ms;
+        uint64_t spins = 0;
+        while (std::chrono::steady_clock::now() < until) {
+            ++spins;
+        }
+        snapshot.add_row().values[0] = spins;
+        return {};
+    }
+
+private:
+    Schema schema_{Topic::NETWORK, {}, FIELDS};
+};
+
+} // namespace
+
+TEST(Sampler, SamplesTopicsAtTheirFastestSubscribersInterval) {
+    std::map<Topic, std::chrono::milliseconds> demand = {{Topic::CPU, 200ms}, {Topic::MEMORY, 1000ms}};
+    std::vector<Sampler::SnapshotPointer> published;
+    Sampler sampler([&](Topic topic) { return demand.contains(topic) ? demand[topic] : 0ms; },
+                    [&](Sampler::SnapshotPointer snapshot, std::span<const Sampler::SnapshotPointer>) {
+                        published.push_back(std::move(snapshot));
+                    });
+    sampler.add_collector(std::make_unique<CountingCollector>(Topic::CPU));
+    sampler.add_collector(std::make_unique<CountingCollector>(Topic::MEMORY));
+    sampler.add_collector(std::make_unique<CountingCollector>(Topic::PROCESSES));
+
+    auto start = Sampler::Clock::time_point{} + 1h;
+    for (auto now = start; now < start + 2s; now += 10ms) {
+        auto next_due = sampler.sample_due_topics(now);
+        EXPECT_GT(next_due, now);
+        EXPECT_LE(next_due, now + Sampler::DEMAND_POLL_INTERVAL);
+    }
+    EXPECT_EQ(sampler.sample_count(Topic::CPU), 10U);
+    EXPECT_EQ(sampler.sample_count(Topic::MEMORY), 2U);
+    // nobody subscribed; never sampled
+    EXPECT_EQ(sampler.sample_count(Topic::PROCESSES), 0U);
+
+    ASSERT_FALSE(published.empty());
+    EXPECT_EQ(published.front()->topic(), Topic::CPU);
+    EXPECT_EQ(published.front()->version(), 1U);
+    ASSERT_EQ(published.front()->rows().size(), 1U);
+    EXPECT_EQ(published.front()->rows()[0].values[0], Value(uint64_t{1}));
+}
+
+TEST(Sampler, PublishesRecentHistory) {
+    std::vector<uint64_t> versions;
+    std::vector<size_t> history_sizes;
+    Sampler sampler([](Topic) { return 100ms; },
+                    [&](Sampler::SnapshotPointer snapshot, std::span<const Sampler::SnapshotPointer> history) {
+                        versions.push_back(snapshot->version());
+                        history_sizes.push_back(history.size());
+                        if (!history.empty()) {
+                            // oldest first, ending right before the new one
+                            EXPECT_EQ(history.back()->version() + 1, snapshot->version());
+                        }
+                    });
+    sampler.add_collector(std::make_unique<CountingCollector>(Topic::DISK));
+
+    auto now = Sampler::Clock::time_point{} + 1h;
+    for (size_t i = 0; i < Sampler::HISTORY_LENGTH + 4; ++i) {
+        sampler.sample_due_topics(now += 100ms);
+    }
+    ASSERT_EQ(versions.size(), Sampler::HISTORY_LENGTH + 4);
+    EXPECT_EQ(versions.back(), Sampler::HISTORY_LENGTH + 4);
+    EXPECT_EQ(history_sizes.front(), 0U);
+    EXPECT_EQ(history_sizes.back(), Sampler::HISTORY_LENGTH);
+}
+
+TEST(Sampler, ReactsToChangingDemand) {
+    auto interval = 0ms;
+    Sampler sampler([&](Topic) { return interval; },
+                    [](Sampler::SnapshotPointer, std::span<const Sampler::SnapshotPointer>) {});
+    sampler.add_collector(std::make_unique<CountingCollector>(Topic::NETWORK));
+
+    auto now = Sampler::Clock::time_point{} + 1h;
+    sampler.sample_due_topics(now);
+    EXPECT_EQ(sampler.sample_count(Topic::NETWORK), 0U);
+
+    // a new subscriber gets a sample right away
+    interval = 5000ms;
+    sampler.sample_due_topics(now += 10ms);
+    EXPECT_EQ(sampler.sample_count(Topic::NETWORK), 1U);
+
+    // a faster one doesn't wait for the slower schedule
+    interval = 100ms;
+    sampler.sample_due_topics(now += 10ms);
+    sampler.sample_due_topics(now += 100ms);
+    EXPECT_EQ(sampler.sample_count(Topic::NETWORK), 2U);
+}
+
+TEST(Sampler, MeasuresWhatSamplesCost) {
+    std::map<Topic, std::chrono::milliseconds> demand = {{Topic::NETWORK, 100ms}, {Topic::SAMPLER, 100ms}};
+    Sampler::SnapshotPointer latest;
+    Sampler sampler([&](Topic topic) { return demand.contains(topic) ? demand[topic] : 0ms; },
+                    [&](Sampler::SnapshotPointer snapshot, std::span<const Sampler::SnapshotPointer>) {
+                        latest = std::move(snapshot);
+                    });
+    sampler.add_collector(std::make_unique<SpinningCollector>());
+    sampler.add_collector(std::make_unique<SamplerCollector>(sampler));
+
+    auto now = Sampler::Clock::time_point{} + 1h;
+    sampler.sample_due_topics(now);
+    const auto& cost = sampler.sample_cost(Topic::NETWORK);
+    EXPECT_GE(cost.wall_time, 1ms);
+    EXPECT_GT(cost.cpu_time, 0ns);
+    EXPECT_EQ(cost.total_cpu_time, cost.cpu_time);
+    EXPECT_EQ(sampler.sample_cost(Topic::CPU).wall_time, 0ns);
+
+    // the sampler topic comes last, so it reports the sample just taken
+    ASSERT_NE(latest, nullptr);
+    ASSERT_EQ(latest->topic(), Topic::SAMPLER);
+    const auto* row = latest->find_row("net");
+    ASSERT_NE(row, nullptr);
+    EXPECT_EQ(row->values[0], Value(uint64_t{1}));
+    EXPECT_GE(std::get<uint64_t>(row->values[2]), 1000U);
+    EXPECT_EQ(latest->find_row("cpu"), nullptr);
+}
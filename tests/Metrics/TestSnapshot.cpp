@@ -0,0 +1,135 @@
+#include "Metrics/Snapshot.h"
+#include "Metrics/SnapshotJson.h"
+#include "Metrics/SnapshotMessage.h"
+#include "WebSocket/FrameCodec.h"
+#include <array>
+#include <gtest/gtest.h>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace metrics;
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr std::array<FieldDescriptor, 3> FIELDS = {{
+    field<"name">(FieldType::TEXT),
+    field<"rx_bytes">(FieldType::UINT),
+    field<"load">(FieldType::FLOAT),
+}};
+// keys are encoded at compile time
+static_assert(FIELDS[1].name == "rx_bytes");
+static_assert(FIELDS[1].json_key == R"(,"rx_bytes":)");
+
+constexpr Schema ROWS_SCHEMA = {Topic::NETWORK, "interface", FIELDS};
+constexpr Schema SINGLE_ROW_SCHEMA = {Topic::MEMORY, {}, FIELDS};
+
+auto make_snapshot(const Schema& schema, uint64_t version, std::vector<std::pair<std::string, uint64_t>> rows)
+    -> std::shared_ptr<Snapshot> {
+    auto snapshot = std::make_shared<Snapshot>(schema);
+    for (auto& [key, rx_bytes] : rows) {
+        auto& row = snapshot->add_row(key);
+        row.values[0] = "if " + key;
+        row.values[1] = rx_bytes;
+        row.values[2] = 0.5;
+    }
+    snapshot->finish(version, 1000ms * version);
+    return snapshot;
+}
+
+auto keyframe(const Snapshot& snapshot) -> std::string {
+    fmt::memory_buffer out;
+    json::write_keyframe(out, snapshot);
+    return fmt::to_string(out);
+}
+
+auto delta(const Snapshot& base, const Snapshot& snapshot) -> std::string {
+    fmt::memory_buffer out;
+    json::write_delta(out, base, snapshot);
+    return fmt::to_string(out);
+}
+
+// Returns the payload of a text frame as encoded by make_frame().
+auto payload_of(const common::SharedBuffer& frame) -> std::string {
+    auto header = ws::parse_frame_header(frame.bytes());
+    auto payload = frame.bytes().subspan(frame.size() - header.payload_length);
+    return {reinterpret_cast<const char*>(payload.data()), payload.size()};
+}
+
+} // namespace
+
+TEST(Snapshot, SortsRowsByKey) {
+    auto snapshot = make_snapshot(ROWS_SCHEMA, 1, {{"wlan0", 1}, {"eth0", 2}, {"lo", 3}});
+    ASSERT_EQ(snapshot->rows().size(), 3U);
+    EXPECT_EQ(snapshot->rows()[0].key, "eth0");
+    EXPECT_EQ(snapshot->rows()[2].key, "wlan0");
+    ASSERT_NE(snapshot->find_row("lo"), nullptr);
+    EXPECT_EQ(snapshot->find_row("lo")->values[1], Value(uint64_t{3}));
+    EXPECT_EQ(snapshot->find_row("eth1"), nullptr);
+}
+
+TEST(SnapshotJson, WritesKeyframes) {
+    auto rows = make_snapshot(ROWS_SCHEMA, 3, {{"lo", 1}, {"eth0", 2}});
+    EXPECT_EQ(keyframe(*rows),
+              R"({"topic":"net","version":3,"timestamp":3000,"keyframe":true,"data":{)"
+              R"("eth0":{"name":"if eth0","rx_bytes":2,"load":0.5},)"
+              R"("lo":{"name":"if lo","rx_bytes":1,"load":0.5}}})");
+
+    auto single_row = make_snapshot(SINGLE_ROW_SCHEMA, 1, {{"", 7}});
+    EXPECT_EQ(keyframe(*single_row),
+              R"({"topic":"mem","version":1,"timestamp":1000,"keyframe":true,)"
+              R"("data":{"name":"if ","rx_bytes":7,"load":0.5}})");
+}
+
+TEST(SnapshotJson, WritesOnlyChangesInDeltas) {
+    auto base = make_snapshot(ROWS_SCHEMA, 1, {{"eth0", 10}, {"eth1", 20}, {"lo", 30}});
+    auto snapshot = make_snapshot(ROWS_SCHEMA, 4, {{"eth0", 10}, {"lo", 35}, {"tun0", 1}});
+    EXPECT_EQ(delta(*base, *snapshot),
+              R"({"topic":"net","version":4,"base":1,"timestamp":4000,"data":{)"
+              R"("lo":{"rx_bytes":35},"tun0":{"name":"if tun0","rx_bytes":1,"load":0.5}},"removed":["eth1"]})");
+
+    auto unchanged = make_snapshot(ROWS_SCHEMA, 5, {{"eth0", 10}, {"lo", 35}, {"tun0", 1}});
+    EXPECT_EQ(delta(*snapshot, *unchanged), R"({"topic":"net","version":5,"base":4,"timestamp":5000,"data":{}})");
+
+    auto single_base = make_snapshot(SINGLE_ROW_SCHEMA, 1, {{"", 7}});
+    auto single_row = make_snapshot(SINGLE_ROW_SCHEMA, 2, {{"", 8}});
+    EXPECT_EQ(delta(*single_base, *single_row),
+              R"({"topic":"mem","version":2,"base":1,"timestamp":2000,"data":{"rx_bytes":8}})");
+}
+
+TEST(SnapshotJson, EscapesStrings) {
+    fmt::memory_buffer out;
+    json::write_string(out, "a \"quoted\"\\path\n\x01");
+    EXPECT_EQ(fmt::to_string(out), R"("a \"quoted\"\\path\n\u0001")");
+}
+
+TEST(SnapshotMessage, SharesFramesPerBase) {
+    std::vector<SnapshotMessage::SnapshotPointer> history = {
+        make_snapshot(ROWS_SCHEMA, 1, {{"eth0", 1}}),
+        make_snapshot(ROWS_SCHEMA, 2, {{"eth0", 2}}),
+    };
+    SnapshotMessage message(make_snapshot(ROWS_SCHEMA, 3, {{"eth0", 3}}), history);
+    EXPECT_EQ(message.version(), 3U);
+    EXPECT_TRUE(message.has_base(1));
+    EXPECT_FALSE(message.has_base(0));
+    EXPECT_FALSE(message.has_base(3));
+
+    auto from_one = message.frame_for(1, ws::WireFormat::JSON);
+    auto from_two = message.frame_for(2, ws::WireFormat::JSON);
+    EXPECT_EQ(payload_of(from_one), delta(*history[0], *make_snapshot(ROWS_SCHEMA, 3, {{"eth0", 3}})));
+    // encoded once per base, then shared
+    EXPECT_EQ(message.frame_for(1, ws::WireFormat::JSON).bytes().data(), from_one.bytes().data());
+    EXPECT_NE(from_two.bytes().data(), from_one.bytes().data());
+
+    // no usable base; everybody shares the keyframe
+    auto keyframe_frame = message.frame_for(0, ws::WireFormat::JSON);
+    EXPECT_TRUE(payload_of(keyframe_frame).find(R"("keyframe":true)") != std::string::npos);
+    EXPECT_EQ(message.frame_for(99, ws::WireFormat::JSON).bytes().data(), keyframe_frame.bytes().data());
+
+    // each wire format has frames of its own
+    auto binary = message.frame_for(1, ws::WireFormat::BINARY);
+    EXPECT_EQ(ws::parse_frame_header(binary.bytes()).opcode, ws::Opcode::BINARY);
+    EXPECT_EQ(message.frame_for(1, ws::WireFormat::BINARY).bytes().data(), binary.bytes().data());
+    EXPECT_NE(message.frame_for(0, ws::WireFormat::BINARY).bytes().data(), keyframe_frame.bytes().data());
+}
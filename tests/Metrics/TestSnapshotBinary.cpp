@@ -0,0 +1,182 @@
+#include "Metrics/SnapshotBinary.h"
+#include <array>
+#include <gtest/gtest.h>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace metrics;
+using namespace metrics::binary;
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr std::array<FieldDescriptor, 3> FIELDS = {{
+    field<"name">(FieldType::TEXT),
+    field<"rx_bytes">(FieldType::UINT),
+    field<"load">(FieldType::FLOAT),
+}};
+constexpr Schema SCHEMA = {Topic::NETWORK, "interface", FIELDS};
+
+struct TestRow {
+    std::string key;
+    uint64_t rx_bytes;
+    double load;
+};
+
+auto make_snapshot(uint64_t version, const std::vector<TestRow>& rows) -> std::shared_ptr<Snapshot> {
+    auto snapshot = std::make_shared<Snapshot>(SCHEMA);
+    for (const auto& test_row : rows) {
+        auto& row = snapshot->add_row(test_row.key);
+        row.values[0] = "if " + test_row.key;
+        row.values[1] = test_row.rx_bytes;
+        row.values[2] = test_row.load;
+    }
+    snapshot->finish(version, 1000ms * version);
+    return snapshot;
+}
+
+// Checks that the decoded table holds exactly the snapshot's rows.
+auto expect_matches(const Table& table, const Snapshot& snapshot) -> void {
+    EXPECT_EQ(table.topic, snapshot.topic());
+    EXPECT_EQ(table.version, snapshot.version());
+    EXPECT_EQ(table.timestamp, snapshot.timestamp());
+    ASSERT_EQ(table.rows.size(), snapshot.rows().size());
+    for (const auto& row : snapshot.rows()) {
+        auto it = table.rows.find(row.key);
+        ASSERT_NE(it, table.rows.end()) << row.key;
+        EXPECT_EQ(it->second, row.values) << row.key;
+    }
+}
+
+} // namespace
+
+TEST(SnapshotBinary, VarintsAndZigzagRoundTrip) {
+    const uint64_t values[] = {0, 1, 127, 128, 300, uint64_t{1} << 35, std::numeric_limits<uint64_t>::max()};
+    std::vector<uint8_t> out;
+    for (auto value : values) {
+        write_varint(out, value);
+    }
+    EXPECT_EQ(out[0], 0x00);
+    EXPECT_EQ(out[3], 0x80);
+    EXPECT_EQ(out[4], 0x01);
+    std::span<const uint8_t> input = out;
+    for (auto value : values) {
+        EXPECT_EQ(MUST(read_varint(input)), value);
+    }
+    EXPECT_TRUE(input.empty());
+
+    // truncated and overlong
+    std::span<const uint8_t> truncated = std::span(out).first(out.size() - 1).last(3);
+    EXPECT_TRUE(read_varint(truncated).is_error());
+    std::vector<uint8_t> overlong(11, 0xFF);
+    std::span<const uint8_t> overlong_input = overlong;
+    EXPECT_TRUE(read_varint(overlong_input).is_error());
+
+    EXPECT_EQ(zigzag_encode(0), 0U);
+    EXPECT_EQ(zigzag_encode(-1), 1U);
+    EXPECT_EQ(zigzag_encode(1), 2U);
+    for (int64_t value : {int64_t{-300}, int64_t{12345}, std::numeric_limits<int64_t>::min()}) {
+        EXPECT_EQ(zigzag_decode(zigzag_encode(value)), value);
+    }
+}
+
+TEST(SnapshotBinary, WritesFixedHeader) {
+    auto snapshot = make_snapshot(7, {{"eth0", 1, 0.5}});
+    std::vector<uint8_t> out;
+    write_keyframe(out, *snapshot);
+    ASSERT_GE(out.size(), HEADER_SIZE);
+    auto header = MUST(read_header(out));
+    EXPECT_TRUE(header.is_keyframe());
+    EXPECT_EQ(header.topic, static_cast<uint8_t>(Topic::NETWORK));
+    EXPECT_EQ(header.row_count, 1U);
+    EXPECT_EQ(header.version, 7U);
+    EXPECT_EQ(header.base, 0U);
+    EXPECT_EQ(header.timestamp, 7000U);
+
+    out[0] = WIRE_VERSION + 1;
+    EXPECT_TRUE(read_header(out).is_error());
+    EXPECT_TRUE(read_header(std::span(out).first(HEADER_SIZE - 1)).is_error());
+}
+
+TEST(SnapshotBinary, DecoderAppliesDeltasToAcknowledgedVersions) {
+    auto v1 = make_snapshot(1, {{"eth0", 1000, 0.5}, {"eth1", 5000, 1.5}, {"lo", 42, 0.0}});
+    // a counter growing, one going backwards after a reset, a row removed
+    // and one added
+    auto v2 = make_snapshot(2, {{"eth0", 1100, 0.5}, {"lo", 7, 0.0}, {"tun0", 1, 2.5}});
+    auto v3 = make_snapshot(3, {{"eth0", 1300, 0.75}, {"lo", 7, 0.0}, {"tun0", 1, 2.5}});
+
+    Decoder decoder;
+    std::vector<uint8_t> message;
+    write_keyframe(message, *v1);
+    expect_matches(*MUST(decoder.decode(message)), *v1);
+
+    message.clear();
+    write_delta(message, *v1, *v2);
+    expect_matches(*MUST(decoder.decode(message)), *v2);
+
+    // the server keeps basing deltas on version 1 until it is acknowledged
+    // otherwise; the decoder still holds it
+    message.clear();
+    write_delta(message, *v1, *v3);
+    std::vector<uint8_t> keyframe;
+    write_keyframe(keyframe, *v3);
+    EXPECT_LT(message.size(), keyframe.size());
+    expect_matches(*MUST(decoder.decode(message)), *v3);
+    expect_matches(*decoder.latest(Topic::NETWORK), *v3);
+
+    decoder.acknowledge(Topic::NETWORK, 2);
+    EXPECT_TRUE(decoder.decode(message).is_error());
+    message.clear();
+    write_delta(message, *v2, *v3);
+    expect_matches(*MUST(decoder.decode(message)), *v3);
+}
+
+TEST(SnapshotBinary, DecoderKeepsLateVersionsWhenFull) {
+    Decoder decoder;
+    std::vector<uint8_t> message;
+    // more versions than the decoder keeps
+    for (uint64_t version = 2; version <= 100; ++version) {
+        message.clear();
+        write_keyframe(message, *make_snapshot(version, {{"eth0", version, 0.5}}));
+        ASSERT_FALSE(decoder.decode(message).is_error());
+    }
+
+    // a replayed keyframe older than everything kept is stored all the same
+    auto v1 = make_snapshot(1, {{"eth0", 1, 0.5}, {"lo", 7, 0.0}});
+    message.clear();
+    write_keyframe(message, *v1);
+    expect_matches(*MUST(decoder.decode(message)), *v1);
+    expect_matches(*decoder.latest(Topic::NETWORK), *make_snapshot(100, {{"eth0", 100, 0.5}}));
+
+    auto v101 = make_snapshot(101, {{"eth0", 101, 0.5}, {"lo", 7, 0.0}});
+    message.clear();
+    write_delta(message, *v1, *v101);
+    expect_matches(*MUST(decoder.decode(message)), *v101);
+}
+
+TEST(SnapshotBinary, UnchangedRowsAreLeftOut) {
+    auto v1 = make_snapshot(1, {{"eth0", 1000, 0.5}, {"eth1", 5000, 1.5}});
+    auto v2 = make_snapshot(2, {{"eth0", 1001, 0.5}, {"eth1", 5000, 1.5}});
+    std::vector<uint8_t> message;
+    write_delta(message, *v1, *v2);
+    EXPECT_EQ(MUST(read_header(message)).row_count, 1U);
+    // header, key "eth0", one field: tag and a single byte difference, no
+    // removed rows
+    EXPECT_EQ(message.size(), HEADER_SIZE + 5 + 1 + 2 + 1);
+}
+
+TEST(SnapshotBinary, RejectsMalformedMessages) {
+    auto v1 = make_snapshot(1, {{"eth0", 1000, 0.5}});
+    std::vector<uint8_t> message;
+    write_keyframe(message, *v1);
+
+    for (size_t length = HEADER_SIZE; length < message.size(); ++length) {
+        Decoder decoder;
+        EXPECT_TRUE(decoder.decode(std::span(message).first(length)).is_error()) << length;
+    }
+    message.push_back(0);
+    Decoder decoder;
+    EXPECT_TRUE(decoder.decode(message).is_error());
+}
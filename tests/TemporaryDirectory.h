@@ -0,0 +1,53 @@
+#pragma once
+
+#include "Common/Assertions.h"
+#include <cstdlib>
+#include <filesystem>
+#include <fmt/core.h>
+#include <fstream>
+#include <string>
+#include <string_view>
+
+namespace test {
+
+// TemporaryDirectory is a fresh directory under /tmp for the tests and
+// benchmarks that need files, such as a fake /proc or /sys tree or history
+// segments. It is removed with everything in it once it goes out of scope.
+class TemporaryDirectory final {
+public:
+    // The directory's name starts with given prefix, which tells what left
+    // it behind should a test crash.
+    explicit TemporaryDirectory(std::string_view prefix = "test") {
+        auto path_template = fmt::format("/tmp/{}-XXXXXX", prefix);
+        auto* path = ::mkdtemp(path_template.data());
+        VERIFY(path != nullptr);
+        root_ = path;
+    }
+
+    TemporaryDirectory(const TemporaryDirectory&) = delete;
+    TemporaryDirectory(TemporaryDirectory&&) noexcept = delete;
+    ~TemporaryDirectory() noexcept {
+        std::error_code error;
+        std::filesystem::remove_all(root_, error);
+    }
+
+    auto operator=(const TemporaryDirectory&) -> TemporaryDirectory& = delete;
+    auto operator=(TemporaryDirectory&&) noexcept -> TemporaryDirectory& = delete;
+
+    [[nodiscard]] auto path() const -> const std::filesystem::path& { return root_; }
+
+    // Returns the path of given file relative to the directory.
+    [[nodiscard]] auto path(const std::filesystem::path& name) const -> std::string { return (root_ / name).string(); }
+
+    // Replaces the contents of given file relative to the directory, creating
+    // the file and the directories leading to it as needed.
+    auto write(const std::filesystem::path& name, std::string_view content) const -> void {
+        std::filesystem::create_directories((root_ / name).parent_path());
+        std::ofstream(root_ / name) << content;
+    }
+
+private:
+    std::filesystem::path root_;
+};
+
+} // namespace test
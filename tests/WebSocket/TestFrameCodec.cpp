@@ -0,0 +1,68 @@
+#include "WebSocket/FrameCodec.h"
+#include <gtest/gtest.h>
+#include <string_view>
+#include <vector>
+
+using namespace ws;
+
+static auto bytes(std::string_view string) -> std::span<const uint8_t> {
+    return {reinterpret_cast<const uint8_t*>(string.data()), string.size()};
+}
+
+TEST(FrameCodec, ParsesMaskedFrameFromRfc) {
+    // single-frame masked text message "Hello" from RFC 6455 section 5.7
+    std::vector<uint8_t> frame = {0x81, 0x85, 0x37, 0xfa, 0x21, 0x3d, 0x7f, 0x9f, 0x4d, 0x51, 0x58};
+    ASSERT_EQ(frame_header_length(frame[0], frame[1]), 6U);
+
+    auto header = parse_frame_header(frame);
+    EXPECT_TRUE(header.fin);
+    EXPECT_EQ(header.opcode, Opcode::TEXT);
+    EXPECT_TRUE(header.masked);
+    EXPECT_EQ(header.payload_length, 5U);
+
+    auto payload = std::span<uint8_t>(frame).subspan(6);
+    unmask_payload(header, payload, payload, 0);
+    EXPECT_EQ(std::string_view(reinterpret_cast<const char*>(payload.data()), payload.size()), "Hello");
+}
+
+TEST(FrameCodec, EncodesAllPayloadLengthForms) {
+    for (uint64_t length : {uint64_t{0}, uint64_t{125}, uint64_t{126}, uint64_t{65535}, uint64_t{65536}}) {
+        for (bool masked : {false, true}) {
+            FrameHeader header{.fin = false,
+                               .opcode = Opcode::BINARY,
+                               .masked = masked,
+                               .mask_key = {1, 2, 3, 4},
+                               .payload_length = length};
+            std::array<uint8_t, MAX_FRAME_HEADER_SIZE> encoded{};
+            auto encoded_length = write_frame_header(header, encoded);
+            ASSERT_EQ(encoded_length, encoded_frame_header_length(header));
+            ASSERT_EQ(frame_header_length(encoded[0], encoded[1]), encoded_length);
+
+            auto decoded = parse_frame_header(std::span<const uint8_t>(encoded.data(), encoded_length));
+            EXPECT_FALSE(decoded.fin);
+            EXPECT_EQ(decoded.opcode, Opcode::BINARY);
+            EXPECT_EQ(decoded.masked, masked);
+            EXPECT_EQ(decoded.payload_length, length);
+            if (masked) {
+                EXPECT_EQ(decoded.mask_key, header.mask_key);
+            }
+        }
+    }
+}
+
+TEST(FrameCodec, WritesMaskedFrameThatUnmasksToPayload) {
+    auto payload = bytes("subscribe cpu.per_core mem net");
+    FrameHeader header{.opcode = Opcode::TEXT,
+                       .masked = true,
+                       .mask_key = {0xDE, 0xAD, 0xBE, 0xEF},
+                       .payload_length = payload.size()};
+    std::vector<uint8_t> frame(MAX_FRAME_HEADER_SIZE + payload.size());
+    auto frame_length = write_frame(header, payload, frame);
+    ASSERT_EQ(frame_length, 6 + payload.size());
+
+    auto decoded = parse_frame_header(frame);
+    auto masked_payload = std::span<uint8_t>(frame).subspan(6, payload.size());
+    EXPECT_FALSE(std::equal(masked_payload.begin(), masked_payload.end(), payload.begin()));
+    unmask_payload(decoded, masked_payload, masked_payload, 0);
+    EXPECT_TRUE(std::equal(masked_payload.begin(), masked_payload.end(), payload.begin()));
+}
@@ -0,0 +1,182 @@
+#include "WebSocket/FrameDecoder.h"
+#include <gtest/gtest.h>
+#include <string>
+#include <vector>
+
+using namespace common;
+using namespace ws;
+
+namespace {
+
+struct RecordingHandler final : public FrameDecoder::Handler {
+    struct Message {
+        Opcode opcode;
+        std::string payload;
+    };
+
+    auto on_message_data(Opcode opcode, std::span<const uint8_t> data, bool message_complete)
+        -> ErrorOr<void> override {
+        current.append(reinterpret_cast<const char*>(data.data()), data.size());
+        ++slices;
+        if (message_complete) {
+            messages.push_back({opcode, std::move(current)});
+            current.clear();
+        }
+        return {};
+    }
+
+    auto on_control_frame(Opcode opcode, std::span<const uint8_t> payload) -> ErrorOr<void> override {
+        control_frames.push_back({opcode, std::string(reinterpret_cast<const char*>(payload.data()), payload.size())});
+        return {};
+    }
+
+    std::vector<Message> messages;
+    std::vector<Message> control_frames;
+    std::string current;
+    size_t slices{0};
+};
+
+auto append_frame(std::vector<uint8_t>& stream, Opcode opcode, std::string_view payload, bool fin = true) -> void {
+    FrameHeader header{.fin = fin,
+                       .opcode = opcode,
+                       .masked = true,
+                       .mask_key = {0x12, 0x34, 0x56, 0x78},
+                       .payload_length = payload.size()};
+    std::vector<uint8_t> frame(MAX_FRAME_HEADER_SIZE + payload.size());
+    auto length = write_frame(header, {reinterpret_cast<const uint8_t*>(payload.data()), payload.size()}, frame);
+    stream.insert(stream.end(), frame.begin(), frame.begin() + static_cast<ptrdiff_t>(length));
+}
+
+} // namespace
+
+TEST(FrameDecoder, DecodesAllPayloadLengthForms) {
+    std::vector<uint8_t> stream;
+    std::string small(125, 's');
+    std::string medium(40000, 'm');
+    std::string large(70000, 'l');
+    append_frame(stream, Opcode::TEXT, small);
+    append_frame(stream, Opcode::BINARY, medium);
+    append_frame(stream, Opcode::BINARY, large);
+
+    FrameDecoder decoder;
+    RecordingHandler handler;
+    ASSERT_TRUE(decoder.decode(stream, handler).is_value());
+    ASSERT_EQ(handler.messages.size(), 3U);
+    EXPECT_EQ(handler.messages[0].opcode, Opcode::TEXT);
+    EXPECT_EQ(handler.messages[0].payload, small);
+    EXPECT_EQ(handler.messages[1].payload, medium);
+    EXPECT_EQ(handler.messages[2].payload, large);
+}
+
+TEST(FrameDecoder, ResumesAcrossReadsOfAnySize) {
+    std::vector<uint8_t> stream;
+    append_frame(stream, Opcode::TEXT, "Hel", false);
+    append_frame(stream, Opcode::PING, "are you there");
+    append_frame(stream, Opcode::CONTINUATION, "", false);
+    append_frame(stream, Opcode::CONTINUATION, std::string(300, 'o'), false);
+    append_frame(stream, Opcode::PONG, "");
+    append_frame(stream, Opcode::CONTINUATION, "!");
+    append_frame(stream, Opcode::BINARY, "");
+    append_frame(stream, Opcode::CLOSE, "\x03\xe8");
+
+    for (size_t read_size : {size_t{1}, size_t{2}, size_t{3}, size_t{7}, size_t{64}, stream.size()}) {
+        auto data = stream;
+        FrameDecoder decoder;
+        RecordingHandler handler;
+        for (size_t offset = 0; offset < data.size(); offset += read_size) {
+            auto read = std::span<uint8_t>(data).subspan(offset, std::min(read_size, data.size() - offset));
+            ASSERT_TRUE(decoder.decode(read, handler).is_value()) << "read size " << read_size;
+        }
+
+        ASSERT_EQ(handler.messages.size(), 2U) << "read size " << read_size;
+        EXPECT_EQ(handler.messages[0].opcode, Opcode::TEXT);
+        EXPECT_EQ(handler.messages[0].payload, "Hel" + std::string(300, 'o') + "!");
+        EXPECT_EQ(handler.messages[1].opcode, Opcode::BINARY);
+        EXPECT_EQ(handler.messages[1].payload, "");
+
+        ASSERT_EQ(handler.control_frames.size(), 3U);
+        EXPECT_EQ(handler.control_frames[0].opcode, Opcode::PING);
+        EXPECT_EQ(handler.control_frames[0].payload, "are you there");
+        EXPECT_EQ(handler.control_frames[1].opcode, Opcode::PONG);
+        EXPECT_EQ(handler.control_frames[2].opcode, Opcode::CLOSE);
+        EXPECT_TRUE(decoder.is_closed());
+    }
+}
+
+TEST(FrameDecoder, HandsOutPayloadAsItArrives) {
+    std::vector<uint8_t> stream;
+    append_frame(stream, Opcode::BINARY, std::string(1000, 'x'));
+
+    FrameDecoder decoder;
+    RecordingHandler handler;
+    auto data = std::span<uint8_t>(stream);
+    ASSERT_TRUE(decoder.decode(data.first(500), handler).is_value());
+    EXPECT_TRUE(handler.messages.empty());
+    EXPECT_EQ(handler.current.size(), 500U - 8);
+    ASSERT_TRUE(decoder.decode(data.subspan(500), handler).is_value());
+    ASSERT_EQ(handler.messages.size(), 1U);
+    EXPECT_EQ(handler.slices, 2U);
+}
+
+TEST(FrameDecoder, IgnoresBytesAfterCloseFrame) {
+    std::vector<uint8_t> stream;
+    append_frame(stream, Opcode::CLOSE, "");
+    append_frame(stream, Opcode::TEXT, "too late");
+
+    FrameDecoder decoder;
+    RecordingHandler handler;
+    ASSERT_TRUE(decoder.decode(stream, handler).is_value());
+    EXPECT_TRUE(handler.messages.empty());
+    EXPECT_EQ(handler.control_frames.size(), 1U);
+}
+
+TEST(FrameDecoder, RejectsProtocolViolations) {
+    struct Case {
+        const char* name;
+        std::vector<uint8_t> stream;
+        CloseCode close_code;
+    };
+    std::vector<Case> cases;
+
+    std::vector<uint8_t> stream;
+    append_frame(stream, Opcode::CONTINUATION, "orphan");
+    cases.push_back({"continuation without message", stream, CloseCode::PROTOCOL_ERROR});
+
+    stream.clear();
+    append_frame(stream, Opcode::TEXT, "a", false);
+    append_frame(stream, Opcode::TEXT, "b");
+    cases.push_back({"data frame inside fragmented message", stream, CloseCode::PROTOCOL_ERROR});
+
+    stream.clear();
+    append_frame(stream, Opcode::PING, "", false);
+    cases.push_back({"fragmented control frame", stream, CloseCode::PROTOCOL_ERROR});
+
+    stream.clear();
+    append_frame(stream, Opcode::PING, std::string(126, 'p'));
+    cases.push_back({"oversized control frame", stream, CloseCode::PROTOCOL_ERROR});
+
+    stream.clear();
+    append_frame(stream, Opcode::TEXT, "rsv");
+    stream[0] |= 0x40;
+    cases.push_back({"reserved bit", stream, CloseCode::PROTOCOL_ERROR});
+
+    stream.clear();
+    append_frame(stream, Opcode::TEXT, "opcode");
+    stream[0] = (stream[0] & 0xF0) | 0x3;
+    cases.push_back({"reserved opcode", stream, CloseCode::PROTOCOL_ERROR});
+
+    cases.push_back({"unmasked frame", {0x81, 0x02, 'h', 'i'}, CloseCode::PROTOCOL_ERROR});
+
+    stream.clear();
+    append_frame(stream, Opcode::BINARY, std::string(600, 'b'), false);
+    append_frame(stream, Opcode::CONTINUATION, std::string(600, 'b'));
+    cases.push_back({"message too big", stream, CloseCode::MESSAGE_TOO_BIG});
+
+    for (auto& test_case : cases) {
+        FrameDecoder decoder(1000);
+        RecordingHandler handler;
+        EXPECT_TRUE(decoder.decode(test_case.stream, handler).is_error()) << test_case.name;
+        EXPECT_TRUE(decoder.is_failed()) << test_case.name;
+        EXPECT_EQ(decoder.close_code(), test_case.close_code) << test_case.name;
+    }
+}
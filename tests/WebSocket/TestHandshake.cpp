@@ -0,0 +1,131 @@
+#include "Common/Base64.h"
+#include "Common/Sha1.h"
+#include "WebSocket/Handshake.h"
+#include <fmt/format.h>
+#include <gtest/gtest.h>
+#include <string>
+
+using namespace common;
+using namespace ws;
+
+static auto to_hex(const Sha1::Digest& digest) -> std::string {
+    static constexpr std::string_view digits = "0123456789abcdef";
+    std::string hex;
+    for (auto byte : digest) {
+        hex.push_back(digits[byte >> 4]);
+        hex.push_back(digits[byte & 0xF]);
+    }
+    return hex;
+}
+
+static auto bytes(std::string_view string) -> std::span<const uint8_t> {
+    return {reinterpret_cast<const uint8_t*>(string.data()), string.size()};
+}
+
+TEST(Handshake, Sha1MatchesTestVectors) {
+    EXPECT_EQ(to_hex(Sha1::digest(bytes(""))), "da39a3ee5e6b4b0d3255bfef95601890afd80709");
+    EXPECT_EQ(to_hex(Sha1::digest(bytes("abc"))), "a9993e364706816aba3e25717850c26c9cd0d89d");
+    EXPECT_EQ(to_hex(Sha1::digest(bytes("abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq"))),
+              "84983e441c3bd26ebaae4aa1f95129e5e54670f1");
+
+    // feeding the input in pieces gives the same digest
+    std::string million(1000000, 'a');
+    Sha1 sha1;
+    for (size_t i = 0; i < million.size(); i += 999) {
+        sha1.update(bytes(std::string_view(million).substr(i, 999)));
+    }
+    EXPECT_EQ(to_hex(sha1.finalize()), "34aa973cd4c4daa4f61eeb2bdbad27316534016f");
+}
+
+TEST(Handshake, Base64RoundTrips) {
+    const std::string_view inputs[] = {"", "f", "fo", "foo", "foob", "fooba", "foobar"};
+    const std::string_view expected[] = {"", "Zg==", "Zm8=", "Zm9v", "Zm9vYg==", "Zm9vYmE=", "Zm9vYmFy"};
+    for (size_t i = 0; i < std::size(inputs); ++i) {
+        std::array<char, 16> encoded{};
+        auto encoded_length = base64::encode(bytes(inputs[i]), encoded);
+        EXPECT_EQ(std::string_view(encoded.data(), encoded_length), expected[i]);
+
+        std::array<uint8_t, 16> decoded{};
+        auto decoded_length = base64::decode(expected[i], decoded);
+        ASSERT_TRUE(decoded_length.has_value());
+        EXPECT_EQ(std::string_view(reinterpret_cast<const char*>(decoded.data()), decoded_length.value()), inputs[i]);
+    }
+
+    std::array<uint8_t, 16> decoded{};
+    EXPECT_FALSE(base64::decode("Zm9", decoded).has_value());
+    EXPECT_FALSE(base64::decode("Zm9*", decoded).has_value());
+}
+
+TEST(Handshake, ComputesAcceptKey) {
+    // example from RFC 6455 section 1.3
+    auto accept_key = handshake::compute_accept_key("dGhlIHNhbXBsZSBub25jZQ==");
+    EXPECT_EQ(std::string_view(accept_key.data(), accept_key.size()), "s3pPLMBiTxaQ9kYGzzhZRbK+xOo=");
+}
+
+TEST(Handshake, ValidatesUpgradeRequest) {
+    HttpRequestParser parser;
+    ASSERT_EQ(parser.parse("GET /chat HTTP/1.1\r\n"
+                           "Host: server.example.com\r\n"
+                           "Upgrade: WebSocket\r\n"
+                           "Connection: Upgrade\r\n"
+                           "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                           "Sec-WebSocket-Version: 13\r\n"
+                           "\r\n"),
+              HttpRequestParser::Status::COMPLETE);
+    auto client_key = handshake::validate_upgrade_request(parser);
+    ASSERT_TRUE(client_key.is_value());
+    EXPECT_EQ(client_key.value(), "dGhlIHNhbXBsZSBub25jZQ==");
+
+    std::array<char, handshake::MAX_RESPONSE_SIZE> response;
+    auto length = handshake::write_accept_response(handshake::compute_accept_key(client_key.value()), response);
+    EXPECT_EQ(std::string_view(response.data(), length),
+              "HTTP/1.1 101 Switching Protocols\r\n"
+              "Upgrade: websocket\r\n"
+              "Connection: Upgrade\r\n"
+              "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n\r\n");
+}
+
+TEST(Handshake, NegotiatesWireFormat) {
+    auto select = [](std::string_view subprotocols) {
+        auto request = fmt::format("GET / HTTP/1.1\r\nHost: h\r\nSec-WebSocket-Protocol: {}\r\n\r\n", subprotocols);
+        HttpRequestParser parser;
+        EXPECT_EQ(parser.parse(request), HttpRequestParser::Status::COMPLETE);
+        return handshake::select_wire_format(parser);
+    };
+    EXPECT_EQ(select("wstop.json"), WireFormat::JSON);
+    // the most compact format wins whatever the client's order
+    EXPECT_EQ(select("wstop.json, wstop.binary"), WireFormat::BINARY);
+    EXPECT_EQ(select("chat, superchat"), std::nullopt);
+
+    std::array<char, handshake::MAX_RESPONSE_SIZE> response;
+    auto length = handshake::write_accept_response(
+        handshake::compute_accept_key("dGhlIHNhbXBsZSBub25jZQ=="), response, format_wire_format(WireFormat::BINARY));
+    EXPECT_EQ(std::string_view(response.data(), length),
+              "HTTP/1.1 101 Switching Protocols\r\n"
+              "Upgrade: websocket\r\n"
+              "Connection: Upgrade\r\n"
+              "Sec-WebSocket-Accept: s3pPLMBiTxaQ9kYGzzhZRbK+xOo=\r\n"
+              "Sec-WebSocket-Protocol: wstop.binary\r\n\r\n");
+}
+
+TEST(Handshake, RejectsInvalidUpgradeRequests) {
+    const std::string_view invalid_requests[] = {
+        // wrong method
+        "POST / HTTP/1.1\r\nHost: h\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n",
+        // no upgrade
+        "GET / HTTP/1.1\r\nHost: h\r\nConnection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 13\r\n\r\n",
+        // key of wrong length
+        "GET / HTTP/1.1\r\nHost: h\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+        "Sec-WebSocket-Key: Zm9v\r\nSec-WebSocket-Version: 13\r\n\r\n",
+        // unsupported version
+        "GET / HTTP/1.1\r\nHost: h\r\nUpgrade: websocket\r\nConnection: Upgrade\r\n"
+        "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\nSec-WebSocket-Version: 8\r\n\r\n",
+    };
+    for (auto request : invalid_requests) {
+        HttpRequestParser parser;
+        ASSERT_EQ(parser.parse(request), HttpRequestParser::Status::COMPLETE);
+        EXPECT_TRUE(handshake::validate_upgrade_request(parser).is_error()) << request;
+    }
+}
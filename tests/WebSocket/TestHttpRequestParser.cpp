@@ -0,0 +1,82 @@
+#include "WebSocket/HttpRequestParser.h"
+#include <gtest/gtest.h>
+#include <string>
+
+using namespace ws;
+
+static constexpr std::string_view UPGRADE_REQUEST = "GET /chat HTTP/1.1\r\n"
+                                                    "Host: server.example.com\r\n"
+                                                    "Upgrade: websocket\r\n"
+                                                    "Connection: keep-alive, Upgrade\r\n"
+                                                    "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                                                    "Sec-WebSocket-Version: 13\r\n"
+                                                    "\r\n";
+
+TEST(HttpRequestParser, ParsesCompleteRequest) {
+    HttpRequestParser parser;
+    EXPECT_EQ(parser.parse(UPGRADE_REQUEST), HttpRequestParser::Status::COMPLETE);
+    EXPECT_EQ(parser.method(), "GET");
+    EXPECT_EQ(parser.target(), "/chat");
+    EXPECT_EQ(parser.version(), "HTTP/1.1");
+    EXPECT_EQ(parser.header_count(), 5U);
+    EXPECT_EQ(parser.header("host"), "server.example.com");
+    EXPECT_EQ(parser.header("SEC-WEBSOCKET-KEY"), "dGhlIHNhbXBsZSBub25jZQ==");
+    EXPECT_EQ(parser.header("Origin"), "");
+    EXPECT_EQ(parser.head_length(), UPGRADE_REQUEST.size());
+    EXPECT_TRUE(contains_token(parser.header("Connection"), "upgrade"));
+    EXPECT_FALSE(contains_token(parser.header("Connection"), "close"));
+}
+
+TEST(HttpRequestParser, ParsesRequestSplitAcrossReads) {
+    // feed the request one byte at a time into a buffer that never moves
+    std::string buffer;
+    buffer.reserve(UPGRADE_REQUEST.size());
+
+    HttpRequestParser parser;
+    for (size_t i = 0; i < UPGRADE_REQUEST.size(); ++i) {
+        buffer.push_back(UPGRADE_REQUEST[i]);
+        auto status = parser.parse(buffer);
+        if (i + 1 < UPGRADE_REQUEST.size()) {
+            ASSERT_EQ(status, HttpRequestParser::Status::INCOMPLETE) << "at byte " << i;
+        } else {
+            ASSERT_EQ(status, HttpRequestParser::Status::COMPLETE);
+        }
+    }
+    EXPECT_EQ(parser.header("Upgrade"), "websocket");
+    EXPECT_EQ(parser.header("Sec-WebSocket-Version"), "13");
+}
+
+TEST(HttpRequestParser, LeavesTrailingBytesUnconsumed) {
+    std::string buffer(UPGRADE_REQUEST);
+    buffer.append("\x81\x85", 2);
+
+    HttpRequestParser parser;
+    EXPECT_EQ(parser.parse(buffer), HttpRequestParser::Status::COMPLETE);
+    EXPECT_EQ(parser.head_length(), UPGRADE_REQUEST.size());
+}
+
+TEST(HttpRequestParser, RejectsMalformedRequests) {
+    const std::string_view malformed_requests[] = {
+        "GET\r\n\r\n",
+        "GET /chat\r\n\r\n",
+        "GET /chat HTTP/1.1\r\nHost server\r\n\r\n",
+        "GET /chat HTTP/1.1\r\n: empty-name\r\n\r\n",
+        "GET /chat HTTP/1.1\r\nHost: server\r\n folded\r\n\r\n",
+        "G(T /chat HTTP/1.1\r\n\r\n",
+    };
+    for (auto request : malformed_requests) {
+        HttpRequestParser parser;
+        EXPECT_EQ(parser.parse(request), HttpRequestParser::Status::INVALID) << request;
+    }
+}
+
+TEST(HttpRequestParser, RejectsTooManyHeaders) {
+    std::string request = "GET / HTTP/1.1\r\n";
+    for (size_t i = 0; i <= HttpRequestParser::MAX_HEADERS; ++i) {
+        request += "X-Header: value\r\n";
+    }
+    request += "\r\n";
+
+    HttpRequestParser parser;
+    EXPECT_EQ(parser.parse(request), HttpRequestParser::Status::INVALID);
+}
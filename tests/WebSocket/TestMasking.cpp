@@ -0,0 +1,100 @@
+#include "WebSocket/Masking.h"
+#include <gtest/gtest.h>
+#include <vector>
+
+using namespace common::simd;
+using namespace ws;
+using namespace ws::masking;
+
+static constexpr MaskKey KEY = {0x37, 0xFA, 0x21, 0x3D};
+
+static auto make_payload(size_t length) -> std::vector<uint8_t> {
+    std::vector<uint8_t> payload(length);
+    for (size_t i = 0; i < length; ++i) {
+        payload[i] = static_cast<uint8_t>(i * 31 + 7);
+    }
+    return payload;
+}
+
+static auto reference_mask(const std::vector<uint8_t>& input, size_t key_offset) -> std::vector<uint8_t> {
+    std::vector<uint8_t> output(input.size());
+    for (size_t i = 0; i < input.size(); ++i) {
+        output[i] = input[i] ^ KEY[(key_offset + i) % 4];
+    }
+    return output;
+}
+
+class MaskingTest : public ::testing::TestWithParam<Implementation> {
+protected:
+    void SetUp() override {
+        if (!is_supported(GetParam())) {
+            GTEST_SKIP() << format_implementation(GetParam()) << " not supported on this CPU";
+        }
+    }
+};
+
+TEST_P(MaskingTest, MatchesReferenceForAllLengthsAndAlignments) {
+    // lengths around every vector width and unroll boundary, with both the
+    // input and the output misaligned by every possible amount
+    for (size_t length = 0; length <= 300; ++length) {
+        auto payload = make_payload(length);
+        for (size_t misalignment = 0; misalignment < 32; misalignment += 3) {
+            for (size_t key_offset = 0; key_offset < 4; ++key_offset) {
+                std::vector<uint8_t> input(length + 64);
+                std::vector<uint8_t> output(length + 64, 0xEE);
+                std::copy(payload.begin(), payload.end(), input.begin() + static_cast<ptrdiff_t>(misalignment));
+
+                auto in = std::span<const uint8_t>(input.data() + misalignment, length);
+                auto out = std::span<uint8_t>(output.data() + 31 - misalignment, length);
+                apply_mask_using(GetParam(), in, out, KEY, key_offset);
+
+                auto expected = reference_mask(payload, key_offset);
+                ASSERT_TRUE(std::equal(out.begin(), out.end(), expected.begin()))
+                    << "length " << length << ", misalignment " << misalignment << ", key offset " << key_offset;
+                // nothing written past the end
+                ASSERT_EQ(output[31 - misalignment + length], 0xEE);
+            }
+        }
+    }
+}
+
+TEST_P(MaskingTest, MasksInPlaceAndRoundTrips) {
+    auto payload = make_payload(4099);
+    auto data = payload;
+    auto span = std::span<uint8_t>(data.data() + 1, data.size() - 1);
+    apply_mask_using(GetParam(), span, span, KEY, 0);
+    EXPECT_NE(data, payload);
+    apply_mask_using(GetParam(), span, span, KEY, 0);
+    EXPECT_EQ(data, payload);
+}
+
+TEST_P(MaskingTest, UnmasksPayloadPieceByPiece) {
+    auto payload = make_payload(1000);
+    auto expected = reference_mask(payload, 0);
+
+    std::vector<uint8_t> output(payload.size());
+    for (size_t offset = 0; offset < payload.size();) {
+        auto piece = std::min<size_t>(offset % 97 + 1, payload.size() - offset);
+        apply_mask_using(GetParam(),
+                         std::span<const uint8_t>(payload).subspan(offset, piece),
+                         std::span<uint8_t>(output).subspan(offset, piece),
+                         KEY,
+                         offset);
+        offset += piece;
+    }
+    EXPECT_EQ(output, expected);
+}
+
+INSTANTIATE_TEST_SUITE_P(Implementations,
+                         MaskingTest,
+                         ::testing::Values(Implementation::SCALAR, Implementation::SSE2, Implementation::AVX2),
+                         [](const auto& info) { return std::string(format_implementation(info.param)); });
+
+TEST(Masking, DispatchesToSupportedImplementation) {
+    EXPECT_TRUE(is_supported(best_implementation()));
+
+    auto payload = make_payload(777);
+    auto data = payload;
+    apply_mask(data, KEY, 2);
+    EXPECT_EQ(data, reference_mask(payload, 2));
+}
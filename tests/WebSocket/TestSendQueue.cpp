@@ -0,0 +1,207 @@
+#include "WebSocket/SendQueue.h"
+#include <gtest/gtest.h>
+#include <string>
+
+using namespace common;
+using namespace ws;
+using namespace std::chrono_literals;
+
+static auto message(std::string_view text) -> SharedBuffer {
+    return SharedBuffer::copy_of({reinterpret_cast<const uint8_t*>(text.data()), text.size()});
+}
+
+static auto pop(SendQueue& queue) -> std::string {
+    auto front = queue.front();
+    std::string text(reinterpret_cast<const char*>(front.data()), front.size());
+    queue.on_sent(front.size());
+    return text;
+}
+
+static const auto T0 = SendQueue::Clock::time_point{} + 1h;
+
+TEST(SendQueue, ConflatesToNewestMessagePerTopic) {
+    SendQueueCounters counters;
+    SendQueue queue({.policy = OverflowPolicy::CONFLATE}, &counters);
+
+    ASSERT_TRUE(queue.push(message("cpu-1"), 0, T0));
+    ASSERT_TRUE(queue.push(message("mem-1"), 1, T0));
+    ASSERT_TRUE(queue.push(message("cpu-2"), 0, T0));
+    ASSERT_TRUE(queue.push(message("cpu-3"), 0, T0));
+    ASSERT_TRUE(queue.push(message("mem-2"), 1, T0));
+    ASSERT_TRUE(queue.push(message("net-1"), 2, T0));
+    ASSERT_TRUE(queue.push(message("cpu-4"), 0, T0));
+
+    // the front message may be in flight already and is never replaced
+    EXPECT_EQ(queue.message_count(), 4U);
+    EXPECT_EQ(pop(queue), "cpu-1");
+    EXPECT_EQ(pop(queue), "mem-2");
+    EXPECT_EQ(pop(queue), "cpu-4");
+    EXPECT_EQ(pop(queue), "net-1");
+    EXPECT_TRUE(queue.is_empty());
+    EXPECT_EQ(queue.queued_bytes(), 0U);
+    EXPECT_EQ(snapshot(counters).conflated, 3U);
+}
+
+TEST(SendQueue, ConflatesAcrossGrowingAndEmptying) {
+    SendQueue queue({.policy = OverflowPolicy::CONFLATE});
+
+    // the newest message per topic moves along with the ring
+    ASSERT_TRUE(queue.push(message("front"), NO_TOPIC, T0));
+    for (TopicId topic = 0; topic < MAX_TOPICS; ++topic) {
+        ASSERT_TRUE(queue.push(message("old"), topic, T0));
+    }
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_TRUE(queue.push(message(std::to_string(i)), NO_TOPIC, T0));
+    }
+    ASSERT_TRUE(queue.push(message("new"), 7, T0));
+    EXPECT_EQ(pop(queue), "front");
+    for (TopicId topic = 0; topic < MAX_TOPICS; ++topic) {
+        EXPECT_EQ(pop(queue), topic == 7 ? "new" : "old");
+    }
+    while (!queue.is_empty()) {
+        pop(queue);
+    }
+
+    // and is forgotten with it
+    ASSERT_TRUE(queue.push(message("first"), 7, T0));
+    ASSERT_TRUE(queue.push(message("second"), 7, T0));
+    ASSERT_TRUE(queue.push(message("third"), 7, T0));
+    EXPECT_EQ(pop(queue), "first");
+    EXPECT_EQ(pop(queue), "third");
+    EXPECT_TRUE(queue.is_empty());
+}
+
+TEST(SendQueue, NeverConflatesOrDropsControlOutput) {
+    SendQueueCounters counters;
+    SendQueue queue({.policy = OverflowPolicy::DROP_OLDEST, .max_bytes = 20}, &counters);
+
+    ASSERT_TRUE(queue.push_control(message("101 switching")));
+    ASSERT_TRUE(queue.push_control(message("pong")));
+    ASSERT_TRUE(queue.push(message("data"), 0, T0));
+
+    EXPECT_EQ(pop(queue), "101 switching");
+    EXPECT_EQ(pop(queue), "pong");
+    EXPECT_TRUE(queue.is_empty());
+    EXPECT_EQ(snapshot(counters).dropped, 1U);
+}
+
+TEST(SendQueue, DisconnectsPeerPingingWithoutReading) {
+    for (auto policy : {OverflowPolicy::CONFLATE, OverflowPolicy::DROP_OLDEST, OverflowPolicy::DISCONNECT}) {
+        SendQueueCounters counters;
+        SendQueue queue({.policy = policy, .max_bytes = 16}, &counters);
+        // every ping is answered with a pong the peer never reads
+        for (int i = 0; i < 4; ++i) {
+            EXPECT_TRUE(queue.push_control(message("pong")));
+        }
+        EXPECT_FALSE(queue.push_control(message("pong")));
+        // the queue is left as it was
+        EXPECT_EQ(queue.queued_bytes(), 16U);
+        EXPECT_EQ(snapshot(counters).disconnected, 1U);
+
+        // sent control output makes room again
+        EXPECT_EQ(pop(queue), "pong");
+        EXPECT_TRUE(queue.push_control(message("pong")));
+    }
+}
+
+TEST(SendQueue, DropsOldestToStayWithinByteBudget) {
+    SendQueueCounters counters;
+    SendQueue queue({.policy = OverflowPolicy::DROP_OLDEST, .max_bytes = 12}, &counters);
+
+    for (auto text : {"aaaa", "bbbb", "cccc", "dddd", "eeee"}) {
+        ASSERT_TRUE(queue.push(message(text), NO_TOPIC, T0));
+    }
+    EXPECT_EQ(queue.queued_bytes(), 12U);
+    EXPECT_EQ(pop(queue), "aaaa");
+    EXPECT_EQ(pop(queue), "dddd");
+    EXPECT_EQ(pop(queue), "eeee");
+    EXPECT_EQ(snapshot(counters).dropped, 2U);
+}
+
+TEST(SendQueue, HoldsNoMemoryWhileEmpty) {
+    SendQueue queue({.policy = OverflowPolicy::DROP_OLDEST});
+    EXPECT_EQ(queue.capacity(), 0U);
+
+    // grows past the ring that fits a chunk, keeping the order
+    for (int i = 0; i < 1000; ++i) {
+        ASSERT_TRUE(queue.push(message(std::to_string(i)), NO_TOPIC, T0));
+        if (i % 3 == 0) {
+            ASSERT_TRUE(queue.push_control(message("ctl")));
+        }
+    }
+    EXPECT_GE(queue.capacity(), 1334U);
+    for (int i = 0; i < 1000; ++i) {
+        EXPECT_EQ(pop(queue), std::to_string(i));
+        if (i % 3 == 0) {
+            EXPECT_EQ(pop(queue), "ctl");
+        }
+    }
+    EXPECT_TRUE(queue.is_empty());
+    EXPECT_EQ(queue.capacity(), 0U);
+
+    ASSERT_TRUE(queue.push(message("again"), NO_TOPIC, T0));
+    EXPECT_GT(queue.capacity(), 0U);
+    EXPECT_EQ(pop(queue), "again");
+    EXPECT_EQ(queue.capacity(), 0U);
+}
+
+TEST(SendQueue, DropsMessagesPastAgeBudget) {
+    SendQueueCounters counters;
+    SendQueue queue({.policy = OverflowPolicy::DROP_OLDEST, .max_age = 100ms}, &counters);
+
+    ASSERT_TRUE(queue.push(message("sending"), NO_TOPIC, T0));
+    ASSERT_TRUE(queue.push(message("stale"), NO_TOPIC, T0));
+    ASSERT_TRUE(queue.push(message("fresh"), NO_TOPIC, T0 + 50ms));
+    ASSERT_TRUE(queue.push(message("newest"), NO_TOPIC, T0 + 120ms));
+
+    EXPECT_EQ(pop(queue), "sending");
+    EXPECT_EQ(pop(queue), "fresh");
+    EXPECT_EQ(pop(queue), "newest");
+    EXPECT_EQ(snapshot(counters).dropped, 1U);
+}
+
+TEST(SendQueue, DisconnectsWhenBudgetIsExceeded) {
+    SendQueueCounters counters;
+    SendQueue by_bytes({.policy = OverflowPolicy::DISCONNECT, .max_bytes = 8}, &counters);
+    EXPECT_TRUE(by_bytes.push(message("aaaa"), NO_TOPIC, T0));
+    EXPECT_TRUE(by_bytes.push(message("bbbb"), NO_TOPIC, T0));
+    EXPECT_FALSE(by_bytes.push(message("cccc"), NO_TOPIC, T0));
+    // the queue is left as it was
+    EXPECT_EQ(by_bytes.queued_bytes(), 8U);
+    EXPECT_EQ(by_bytes.message_count(), 2U);
+
+    SendQueue by_age({.policy = OverflowPolicy::DISCONNECT, .max_age = 100ms}, &counters);
+    EXPECT_TRUE(by_age.push(message("stuck"), NO_TOPIC, T0));
+    EXPECT_TRUE(by_age.push(message("later"), NO_TOPIC, T0 + 100ms));
+    EXPECT_FALSE(by_age.push(message("too late"), NO_TOPIC, T0 + 101ms));
+
+    EXPECT_EQ(snapshot(counters).disconnected, 2U);
+}
+
+TEST(SendQueue, LeavesQueueAsItWasWhenConflatingExceedsBudget) {
+    SendQueueCounters counters;
+    SendQueue queue({.policy = OverflowPolicy::CONFLATE, .max_bytes = 10}, &counters);
+    ASSERT_TRUE(queue.push(message("cpu-1"), 0, T0));
+    ASSERT_TRUE(queue.push(message("mem-1"), 1, T0));
+    ASSERT_TRUE(queue.push(message("mem-2"), 1, T0));
+    EXPECT_FALSE(queue.push(message("mem-3-larger"), 1, T0));
+    EXPECT_FALSE(queue.push(message("net-1"), 2, T0));
+
+    EXPECT_EQ(queue.queued_bytes(), 10U);
+    EXPECT_EQ(pop(queue), "cpu-1");
+    EXPECT_EQ(pop(queue), "mem-2");
+    EXPECT_EQ(snapshot(counters).disconnected, 2U);
+    EXPECT_EQ(snapshot(counters).conflated, 1U);
+}
+
+TEST(SendQueue, KeepsPartiallySentFrontIntact) {
+    SendQueue queue({.policy = OverflowPolicy::CONFLATE});
+    ASSERT_TRUE(queue.push(message("cpu-1"), 0, T0));
+    queue.on_sent(2);
+    ASSERT_TRUE(queue.push(message("cpu-2"), 0, T0));
+    ASSERT_TRUE(queue.push(message("cpu-3"), 0, T0));
+
+    EXPECT_EQ(pop(queue), "u-1");
+    EXPECT_EQ(pop(queue), "cpu-3");
+    EXPECT_TRUE(queue.is_empty());
+}
@@ -0,0 +1,253 @@
+#include "Metrics/Topic.h"
+#include "WebSocket/Subscriptions.h"
+#include <gtest/gtest.h>
+#include <set>
+#include <vector>
+
+using namespace ws;
+using namespace std::chrono_literals;
+
+static constexpr auto CPU = static_cast<TopicId>(metrics::Topic::CPU);
+static constexpr auto MEMORY = static_cast<TopicId>(metrics::Topic::MEMORY);
+
+TEST(SubscriptionCommand, ParsesSubscribeAndUnsubscribe) {
+    auto command = MUST(parse_subscription_command("subscribe cpu.per_core 250"));
+    EXPECT_EQ(command.action, SubscriptionCommand::Action::SUBSCRIBE);
+    EXPECT_EQ(command.topic, static_cast<TopicId>(metrics::Topic::CPU_PER_CORE));
+    EXPECT_EQ(command.interval, 250ms);
+
+    command = MUST(parse_subscription_command("  subscribe   mem "));
+    EXPECT_EQ(command.topic, MEMORY);
+    EXPECT_EQ(command.interval, SubscriptionCommand::DEFAULT_INTERVAL);
+
+    command = MUST(parse_subscription_command("unsubscribe procs"));
+    EXPECT_EQ(command.action, SubscriptionCommand::Action::UNSUBSCRIBE);
+    EXPECT_EQ(command.topic, static_cast<TopicId>(metrics::Topic::PROCESSES));
+}
+
+TEST(SubscriptionCommand, ParsesDeltaCommands) {
+    auto command = MUST(parse_subscription_command("subscribe net 500 delta"));
+    EXPECT_EQ(command.interval, 500ms);
+    EXPECT_TRUE(command.delta);
+
+    command = MUST(parse_subscription_command("subscribe net delta"));
+    EXPECT_EQ(command.interval, SubscriptionCommand::DEFAULT_INTERVAL);
+    EXPECT_TRUE(command.delta);
+
+    command = MUST(parse_subscription_command("ack net 42"));
+    EXPECT_EQ(command.action, SubscriptionCommand::Action::ACK);
+    EXPECT_EQ(command.version, 42U);
+
+    command = MUST(parse_subscription_command("keyframe net"));
+    EXPECT_EQ(command.action, SubscriptionCommand::Action::KEYFRAME);
+}
+
+TEST(SubscriptionCommand, ParsesHistoryCommands) {
+    auto command = MUST(parse_subscription_command("history cpu.per_core"));
+    EXPECT_EQ(command.action, SubscriptionCommand::Action::HISTORY);
+    EXPECT_EQ(command.step, 0ms);
+
+    command = MUST(parse_subscription_command("history net 60000"));
+    EXPECT_EQ(command.action, SubscriptionCommand::Action::HISTORY);
+    EXPECT_EQ(command.step, 60000ms);
+
+    command = MUST(parse_subscription_command("query cpu.per_core usage 300000 10000"));
+    EXPECT_EQ(command.action, SubscriptionCommand::Action::QUERY);
+    EXPECT_EQ(command.field, "usage");
+    EXPECT_EQ(command.window, 300000ms);
+    EXPECT_EQ(command.step, 10000ms);
+}
+
+TEST(SubscriptionCommand, RejectsMalformedCommands) {
+    EXPECT_TRUE(parse_subscription_command("").is_error());
+    EXPECT_TRUE(parse_subscription_command("publish cpu").is_error());
+    EXPECT_TRUE(parse_subscription_command("subscribe gpu").is_error());
+    EXPECT_TRUE(parse_subscription_command("subscribe cpu fast").is_error());
+    EXPECT_TRUE(parse_subscription_command("subscribe cpu 0").is_error());
+    EXPECT_TRUE(parse_subscription_command("subscribe cpu 100 200").is_error());
+    EXPECT_TRUE(parse_subscription_command("unsubscribe cpu 100").is_error());
+    EXPECT_TRUE(parse_subscription_command("subscribe cpu delta 100").is_error());
+    EXPECT_TRUE(parse_subscription_command("ack cpu").is_error());
+    EXPECT_TRUE(parse_subscription_command("ack cpu -1").is_error());
+    EXPECT_TRUE(parse_subscription_command("keyframe cpu now").is_error());
+    EXPECT_TRUE(parse_subscription_command("history cpu 1s").is_error());
+    EXPECT_TRUE(parse_subscription_command("history cpu 1000 2000").is_error());
+    EXPECT_TRUE(parse_subscription_command("query cpu usage").is_error());
+    EXPECT_TRUE(parse_subscription_command("query cpu usage 300000").is_error());
+    EXPECT_TRUE(parse_subscription_command("query cpu usage 300000 0").is_error());
+    EXPECT_TRUE(parse_subscription_command("query cpu usage 300000 10000 1").is_error());
+}
+
+TEST(Subscriptions, SlowSubscribersSkipSamplesButKeepTheirPace) {
+    Subscriptions subscriptions;
+    subscriptions.subscribe(CPU, 1000ms);
+    EXPECT_TRUE(subscriptions.is_subscribed(CPU));
+    EXPECT_FALSE(subscriptions.is_subscribed(MEMORY));
+    EXPECT_FALSE(subscriptions.take_due(MEMORY, {}));
+
+    // samples arrive every 100 ms on behalf of a faster subscriber
+    auto start = Subscriptions::Clock::time_point{} + 1h;
+    std::vector<Subscriptions::Clock::time_point> delivered;
+    for (int i = 0; i < 100; ++i) {
+        if (subscriptions.take_due(CPU, start + i * 100ms)) {
+            delivered.push_back(start + i * 100ms);
+        }
+    }
+    // the first right away, then one per interval
+    ASSERT_GE(delivered.size(), 10U);
+    EXPECT_EQ(delivered.front(), start);
+    for (size_t i = 2; i < delivered.size(); ++i) {
+        EXPECT_EQ(delivered[i] - delivered[i - 1], 1000ms);
+    }
+
+    subscriptions.unsubscribe(CPU);
+    EXPECT_EQ(subscriptions.mask(), 0U);
+    EXPECT_FALSE(subscriptions.take_due(CPU, start + 1h));
+}
+
+TEST(Subscriptions, ClampsIntervals) {
+    Subscriptions subscriptions;
+    subscriptions.subscribe(CPU, 1ms);
+    EXPECT_EQ(subscriptions.interval(CPU), Subscriptions::MIN_INTERVAL);
+    subscriptions.subscribe(CPU, 100h);
+    EXPECT_EQ(subscriptions.interval(CPU), Subscriptions::MAX_INTERVAL);
+}
+
+TEST(Subscriptions, DeltasAreBasedOnTheLatestAcknowledgement) {
+    Subscriptions subscriptions;
+    subscriptions.subscribe(CPU, 1000ms);
+    // only delta subscribers acknowledge
+    EXPECT_FALSE(subscriptions.acknowledge(CPU, 1));
+    EXPECT_EQ(subscriptions.delta_base(CPU), 0U);
+
+    subscriptions.subscribe(CPU, 1000ms, true);
+    EXPECT_EQ(subscriptions.delta_base(CPU), 0U);
+    EXPECT_TRUE(subscriptions.acknowledge(CPU, 5));
+    EXPECT_TRUE(subscriptions.acknowledge(CPU, 3));
+    EXPECT_EQ(subscriptions.delta_base(CPU), 5U);
+
+    // keyframes on request and after a run of deltas
+    EXPECT_TRUE(subscriptions.request_keyframe(CPU));
+    EXPECT_EQ(subscriptions.delta_base(CPU), 0U);
+    subscriptions.on_delivered(CPU, 0);
+    for (uint32_t i = 0; i < Subscriptions::KEYFRAME_INTERVAL; ++i) {
+        EXPECT_EQ(subscriptions.delta_base(CPU), 5U);
+        subscriptions.on_delivered(CPU, 5);
+    }
+    EXPECT_EQ(subscriptions.delta_base(CPU), 0U);
+    subscriptions.on_delivered(CPU, 0);
+    EXPECT_EQ(subscriptions.delta_base(CPU), 5U);
+
+    // leaving delta mode forgets the acknowledgement
+    subscriptions.subscribe(CPU, 1000ms);
+    subscriptions.subscribe(CPU, 1000ms, true);
+    EXPECT_EQ(subscriptions.delta_base(CPU), 0U);
+    EXPECT_FALSE(subscriptions.request_keyframe(MEMORY));
+}
+
+TEST(Subscriptions, KeepsStateOnlyForSubscribedTopics) {
+    // so that taking a chunk comes from the thread's cache
+    common::buffer_pool::release(common::buffer_pool::allocate());
+    auto cached_chunks = common::buffer_pool::thread_cached_chunks();
+    Subscriptions subscriptions;
+    // topics subscribed to in any order keep their own state
+    for (TopicId topic : {TopicId{7}, TopicId{2}, TopicId{MAX_TOPICS - 1}, TopicId{0}, TopicId{4}}) {
+        subscriptions.subscribe(topic, std::chrono::milliseconds(100 + topic), true);
+        EXPECT_TRUE(subscriptions.acknowledge(topic, 1000 + topic));
+    }
+    EXPECT_EQ(common::buffer_pool::thread_cached_chunks() + 1, cached_chunks);
+    subscriptions.unsubscribe(4);
+    subscriptions.unsubscribe(0);
+    for (TopicId topic : {TopicId{2}, TopicId{7}, TopicId{MAX_TOPICS - 1}}) {
+        EXPECT_EQ(subscriptions.interval(topic), std::chrono::milliseconds(100 + topic));
+        EXPECT_EQ(subscriptions.delta_base(topic), 1000U + topic);
+    }
+    EXPECT_EQ(subscriptions.interval(4), 0ms);
+    subscriptions.subscribe(4, 1000ms);
+    EXPECT_EQ(subscriptions.delta_base(4), 0U);
+    EXPECT_EQ(subscriptions.interval(7), 107ms);
+
+    // the last unsubscribe hands the state back
+    for (TopicId topic : {TopicId{2}, TopicId{4}, TopicId{7}, TopicId{MAX_TOPICS - 1}}) {
+        subscriptions.unsubscribe(topic);
+    }
+    EXPECT_EQ(subscriptions.mask(), 0U);
+    EXPECT_EQ(common::buffer_pool::thread_cached_chunks(), cached_chunks);
+}
+
+TEST(SubscriptionIndex, TracksSubscribersAndFastestInterval) {
+    SubscriptionIndex index;
+    Subscriptions fast;
+    fast.subscribe(CPU, 200ms);
+    SubscriptionIndex::Membership fast_membership;
+    Subscriptions slow;
+    slow.subscribe(CPU, 1000ms);
+    slow.subscribe(MEMORY, 5000ms);
+    SubscriptionIndex::Membership slow_membership;
+
+    index.update(1, fast_membership, fast);
+    index.update(2, slow_membership, slow);
+    EXPECT_EQ(index.subscribers(CPU).size(), 2U);
+    EXPECT_EQ(index.fastest_interval(CPU), 200ms);
+    EXPECT_EQ(index.fastest_interval(MEMORY), 5000ms);
+    EXPECT_EQ(slow_membership.mask, slow.mask());
+
+    index.remove(fast_membership);
+    EXPECT_EQ(fast_membership.mask, 0U);
+    EXPECT_EQ(std::vector<uint64_t>(index.subscribers(CPU).begin(), index.subscribers(CPU).end()),
+              std::vector<uint64_t>{2});
+    EXPECT_EQ(index.fastest_interval(CPU), 1000ms);
+
+    slow.unsubscribe(CPU);
+    index.update(2, slow_membership, slow);
+    EXPECT_TRUE(index.subscribers(CPU).empty());
+    EXPECT_EQ(index.fastest_interval(CPU), 0ms);
+    EXPECT_EQ(index.fastest_interval(MEMORY), 5000ms);
+
+    index.remove(slow_membership);
+    EXPECT_EQ(slow_membership.mask, 0U);
+    EXPECT_EQ(index.fastest_interval(MEMORY), 0ms);
+}
+
+TEST(SubscriptionIndex, RemovesConnectionsInAnyOrder) {
+    constexpr size_t CONNECTION_COUNT = 1000;
+    SubscriptionIndex index;
+    std::vector<SubscriptionIndex::Membership> memberships(CONNECTION_COUNT);
+    for (size_t i = 0; i < CONNECTION_COUNT; ++i) {
+        Subscriptions subscriptions;
+        // most with the default interval, a few faster ones
+        subscriptions.subscribe(CPU, i % 100 == 0 ? std::chrono::milliseconds(100 + i) : 1000ms);
+        if (i % 2 == 0) {
+            subscriptions.subscribe(MEMORY, 1000ms);
+        }
+        index.update(i + 1, memberships[i], subscriptions);
+    }
+    EXPECT_EQ(index.fastest_interval(CPU), 100ms);
+
+    // reap every third one, then the rest from the back
+    std::vector<bool> removed(CONNECTION_COUNT, false);
+    auto remove = [&](size_t i) {
+        index.remove(memberships[i]);
+        removed[i] = true;
+        std::set<uint64_t> expected;
+        for (size_t j = 0; j < CONNECTION_COUNT; ++j) {
+            if (!removed[j]) {
+                expected.insert(j + 1);
+            }
+        }
+        auto subscribers = index.subscribers(CPU);
+        ASSERT_EQ(std::set<uint64_t>(subscribers.begin(), subscribers.end()), expected);
+    };
+    for (size_t i = 0; i < CONNECTION_COUNT; i += 3) {
+        remove(i);
+    }
+    // the 100 ms subscriber, connection 0, is gone
+    EXPECT_EQ(index.fastest_interval(CPU), 200ms);
+    for (size_t i = CONNECTION_COUNT; i-- > 0;) {
+        if (!removed[i]) {
+            remove(i);
+        }
+    }
+    EXPECT_EQ(index.fastest_interval(CPU), 0ms);
+    EXPECT_TRUE(index.subscribers(MEMORY).empty());
+}
@@ -0,0 +1,483 @@
+#include "Metrics/Topic.h"
+#include "WebSocket/Handshake.h"
+#include "WebSocket/WebSocketServer.h"
+#include <arpa/inet.h>
+#include <atomic>
+#include <cerrno>
+#include <fcntl.h>
+#include <chrono>
+#include <fmt/format.h>
+#include <gtest/gtest.h>
+#include <memory>
+#include <netinet/in.h>
+#include <numeric>
+#include <string>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+using namespace common;
+using namespace ws;
+using namespace std::chrono_literals;
+
+namespace {
+
+constexpr uint16_t TEST_PORT = 18080;
+
+// Encodes version n relative to base b as "n/b", keyframes as "n/k", in text
+// frames for JSON and binary frames for the binary wire format.
+class FakeVersionedMessage final : public VersionedMessage {
+public:
+    explicit FakeVersionedMessage(uint64_t version) :
+        version_(version) {}
+
+    [[nodiscard]] auto version() const -> uint64_t override { return version_; }
+    [[nodiscard]] auto has_base(uint64_t base) const -> bool override { return base != 0 && base < version_; }
+    auto frame_for(uint64_t base, WireFormat wire_format) -> SharedBuffer override {
+        auto text = has_base(base) ? fmt::format("{}/{}", version_, base) : fmt::format("{}/k", version_);
+        return make_frame(wire_format == WireFormat::BINARY ? Opcode::BINARY : Opcode::TEXT,
+                          {reinterpret_cast<const uint8_t*>(text.data()), text.size()});
+    }
+
+private:
+    uint64_t version_;
+};
+
+// Minimal blocking test client; every receive times out after a second.
+// Receives are retried when interrupted, which happens when the kernel tears
+// down the io_uring instance of a previous test's server.
+class TestClient final {
+public:
+    TestClient() {
+        fd_ = ::socket(AF_INET, SOCK_STREAM, 0);
+        timeval timeout{.tv_sec = 1, .tv_usec = 0};
+        ::setsockopt(fd_, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        sockaddr_in address{};
+        address.sin_family = AF_INET;
+        address.sin_port = htons(TEST_PORT);
+        address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        connected_ = ::connect(fd_, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+    }
+
+    TestClient(const TestClient&) = delete;
+    ~TestClient() { ::close(fd_); }
+
+    // Builds an opening handshake request, offering given subprotocols unless
+    // empty and carrying given extra header lines.
+    static auto handshake_request(std::string_view subprotocols = {}, std::string_view extra_headers = {})
+        -> std::string {
+        std::string request = "GET / HTTP/1.1\r\n"
+                              "Host: localhost\r\n"
+                              "Upgrade: websocket\r\n"
+                              "Connection: Upgrade\r\n"
+                              "Sec-WebSocket-Key: dGhlIHNhbXBsZSBub25jZQ==\r\n"
+                              "Sec-WebSocket-Version: 13\r\n";
+        if (!subprotocols.empty()) {
+            request += fmt::format("Sec-WebSocket-Protocol: {}\r\n", subprotocols);
+        }
+        request += extra_headers;
+        request += "\r\n";
+        return request;
+    }
+
+    // A short masked text frame; the zero masking key leaves it as is.
+    static auto text_frame(std::string_view text) -> std::string {
+        std::string frame = {'\x81', static_cast<char>(0x80 | text.size()), 0, 0, 0, 0};
+        frame += text;
+        return frame;
+    }
+
+    // Performs the opening handshake, sending early data right behind the
+    // request in the same write. The response is kept for inspection.
+    auto upgrade(std::string_view subprotocols = {},
+                 std::string_view extra_headers = {},
+                 std::string_view early_data = {}) -> bool {
+        auto request = handshake_request(subprotocols, extra_headers);
+        request += early_data;
+        if (!connected_ || ::send(fd_, request.data(), request.size(), 0) != static_cast<ssize_t>(request.size())) {
+            return false;
+        }
+        auto& response = handshake_response_;
+        while (response.find("\r\n\r\n") == std::string::npos) {
+            char c;
+            auto rc = ::recv(fd_, &c, 1, 0);
+            if (rc < 0 && errno == EINTR) {
+                continue;
+            }
+            if (rc != 1) {
+                return false;
+            }
+            response.push_back(c);
+        }
+        return response.starts_with("HTTP/1.1 101");
+    }
+
+    [[nodiscard]] auto handshake_response() const -> const std::string& { return handshake_response_; }
+
+    auto send_text(std::string_view text) -> bool {
+        auto frame = text_frame(text);
+        return ::send(fd_, frame.data(), frame.size(), 0) == static_cast<ssize_t>(frame.size());
+    }
+
+    auto receive_exactly(size_t length) -> std::vector<uint8_t> {
+        std::vector<uint8_t> data(length);
+        size_t received = 0;
+        while (received < length) {
+            auto rc = ::recv(fd_, data.data() + received, length - received, 0);
+            if (rc < 0 && errno == EINTR) {
+                continue;
+            }
+            if (rc <= 0) {
+                data.resize(received);
+                break;
+            }
+            received += static_cast<size_t>(rc);
+        }
+        return data;
+    }
+
+private:
+    int fd_;
+    bool connected_{false};
+    std::string handshake_response_;
+};
+
+} // namespace
+
+class WebSocketServerTest : public ::testing::TestWithParam<IoBackend> {};
+
+TEST_P(WebSocketServerTest, BroadcastReachesEveryOpenConnection) {
+    auto server = MUST(WebSocketServer::create(TEST_PORT, "127.0.0.1", 2, GetParam()));
+
+    std::vector<std::unique_ptr<TestClient>> clients;
+    for (int i = 0; i < 8; ++i) {
+        clients.push_back(std::make_unique<TestClient>());
+        ASSERT_TRUE(clients.back()->upgrade());
+    }
+
+    std::string payload(300, 'm');
+    auto frame = make_frame(Opcode::TEXT, {reinterpret_cast<const uint8_t*>(payload.data()), payload.size()});
+    server.broadcast(frame);
+    server.broadcast(Opcode::BINARY, frame.bytes().first(3));
+
+    for (auto& client : clients) {
+        auto received = client->receive_exactly(frame.size());
+        ASSERT_TRUE(std::equal(received.begin(), received.end(), frame.bytes().begin(), frame.bytes().end()));
+        EXPECT_EQ(client->receive_exactly(5), (std::vector<uint8_t>{0x82, 0x03, 0x81, 0x7E, 0x01}));
+    }
+
+    // the reactors dropped their references once everything was sent
+    for (int i = 0; i < 100 && frame.use_count() > 1; ++i) {
+        std::this_thread::sleep_for(10ms);
+    }
+    EXPECT_EQ(frame.use_count(), 1U);
+
+    server.shutdown();
+}
+
+TEST_P(WebSocketServerTest, SlowClientIsDisconnectedWithoutHoldingUpOthers) {
+    ConnectionSettings settings;
+    settings.send_queue.policy = OverflowPolicy::DISCONNECT;
+    settings.send_queue.max_bytes = 1024 * 1024;
+    auto server = MUST(WebSocketServer::create(TEST_PORT, "127.0.0.1", 1, GetParam(), settings));
+
+    TestClient slow_client;
+    TestClient fast_client;
+    ASSERT_TRUE(slow_client.upgrade());
+    ASSERT_TRUE(fast_client.upgrade());
+
+    // the slow client never reads; once its socket buffers are full its
+    // queue grows past the budget
+    std::vector<uint8_t> payload(64 * 1024, 's');
+    auto frame = make_frame(Opcode::BINARY, payload);
+    for (int i = 0; i < 200 && server.send_queue_statistics().disconnected == 0; ++i) {
+        server.broadcast(frame);
+        auto received = fast_client.receive_exactly(frame.size());
+        ASSERT_EQ(received.size(), frame.size());
+    }
+    EXPECT_EQ(server.send_queue_statistics().disconnected, 1U);
+
+    server.broadcast(frame);
+    EXPECT_EQ(fast_client.receive_exactly(frame.size()).size(), frame.size());
+
+    server.shutdown();
+}
+
+TEST_P(WebSocketServerTest, TopicsOnlyReachTheirSubscribers) {
+    auto server = MUST(WebSocketServer::create(TEST_PORT, "127.0.0.1", 2, GetParam()));
+    auto cpu = static_cast<TopicId>(metrics::Topic::CPU);
+    auto memory = static_cast<TopicId>(metrics::Topic::MEMORY);
+
+    TestClient cpu_client;
+    TestClient memory_client;
+    ASSERT_TRUE(cpu_client.upgrade());
+    ASSERT_TRUE(memory_client.upgrade());
+    ASSERT_TRUE(cpu_client.send_text("subscribe cpu 500"));
+    // commands of a connection are handled in order
+    ASSERT_TRUE(memory_client.send_text("subscribe cpu 2000"));
+    ASSERT_TRUE(memory_client.send_text("subscribe mem 200"));
+    for (int i = 0; i < 100 && (server.topic_interval(cpu) != 500ms || server.topic_interval(memory) != 200ms); ++i) {
+        std::this_thread::sleep_for(10ms);
+    }
+    EXPECT_EQ(server.topic_interval(cpu), 500ms);
+    EXPECT_EQ(server.topic_interval(memory), 200ms);
+
+    server.broadcast(Opcode::TEXT, std::vector<uint8_t>{'m'}, memory);
+    server.broadcast(Opcode::TEXT, std::vector<uint8_t>{'c'}, cpu);
+    EXPECT_EQ(cpu_client.receive_exactly(3), (std::vector<uint8_t>{0x81, 0x01, 'c'}));
+    EXPECT_EQ(memory_client.receive_exactly(6), (std::vector<uint8_t>{0x81, 0x01, 'm', 0x81, 0x01, 'c'}));
+
+    ASSERT_TRUE(memory_client.send_text("unsubscribe mem"));
+    ASSERT_TRUE(memory_client.send_text("subscribe gpu"));
+    std::string_view error = R"({"error":"unknown topic"})";
+    auto response = memory_client.receive_exactly(2 + error.size());
+    ASSERT_EQ(response.size(), 2 + error.size());
+    EXPECT_EQ(std::string_view(reinterpret_cast<const char*>(response.data()) + 2, error.size()), error);
+    EXPECT_EQ(server.topic_interval(memory), 0ms);
+
+    server.shutdown();
+}
+
+TEST_P(WebSocketServerTest, DeltaSubscribersGetFramesRelativeToTheirAcknowledgement) {
+    auto server = MUST(WebSocketServer::create(TEST_PORT, "127.0.0.1", 1, GetParam()));
+    auto cpu = static_cast<TopicId>(metrics::Topic::CPU);
+
+    TestClient delta_client;
+    TestClient plain_client;
+    ASSERT_TRUE(delta_client.upgrade());
+    ASSERT_TRUE(plain_client.upgrade());
+    ASSERT_TRUE(delta_client.send_text("subscribe cpu 100 delta"));
+    ASSERT_TRUE(plain_client.send_text("subscribe cpu 100"));
+    for (int i = 0; i < 100 && server.topic_interval(cpu) != 100ms; ++i) {
+        std::this_thread::sleep_for(10ms);
+    }
+    auto expect_text = [](TestClient& client, std::string_view text) {
+        auto frame = client.receive_exactly(2 + text.size());
+        ASSERT_EQ(frame.size(), 2 + text.size());
+        EXPECT_EQ(std::string_view(reinterpret_cast<const char*>(frame.data()) + 2, text.size()), text);
+    };
+
+    server.broadcast(std::make_shared<FakeVersionedMessage>(1), cpu);
+    expect_text(delta_client, "1/k");
+    expect_text(plain_client, "1/k");
+
+    // the error answering the second command tells the first one was handled
+    ASSERT_TRUE(delta_client.send_text("ack cpu 1"));
+    ASSERT_TRUE(delta_client.send_text("ack mem 1"));
+    expect_text(delta_client, R"({"error":"not subscribed in delta mode"})");
+
+    std::this_thread::sleep_for(100ms);
+    server.broadcast(std::make_shared<FakeVersionedMessage>(2), cpu);
+    expect_text(delta_client, "2/1");
+    expect_text(plain_client, "2/k");
+
+    server.shutdown();
+}
+
+TEST_P(WebSocketServerTest, WireFormatIsNegotiatedPerConnection) {
+    auto server = MUST(WebSocketServer::create(TEST_PORT, "127.0.0.1", 1, GetParam()));
+    auto cpu = static_cast<TopicId>(metrics::Topic::CPU);
+
+    TestClient binary_client;
+    TestClient json_client;
+    TestClient default_client;
+    ASSERT_TRUE(binary_client.upgrade("chat, wstop.json, wstop.binary"));
+    ASSERT_TRUE(json_client.upgrade("wstop.json"));
+    ASSERT_TRUE(default_client.upgrade("chat"));
+    EXPECT_NE(binary_client.handshake_response().find("\r\nSec-WebSocket-Protocol: wstop.binary\r\n"),
+              std::string::npos);
+    EXPECT_NE(json_client.handshake_response().find("\r\nSec-WebSocket-Protocol: wstop.json\r\n"),
+              std::string::npos);
+    // a subprotocol we don't speak isn't confirmed
+    EXPECT_EQ(default_client.handshake_response().find("Sec-WebSocket-Protocol"), std::string::npos);
+
+    for (auto* client : {&binary_client, &json_client, &default_client}) {
+        ASSERT_TRUE(client->send_text("subscribe cpu"));
+    }
+    for (int i = 0; i < 100 && server.topic_interval(cpu).count() == 0; ++i) {
+        std::this_thread::sleep_for(10ms);
+    }
+    // let the other subscriptions catch up with the first
+    std::this_thread::sleep_for(50ms);
+
+    server.broadcast(std::make_shared<FakeVersionedMessage>(1), cpu);
+    EXPECT_EQ(binary_client.receive_exactly(5), (std::vector<uint8_t>{0x82, 0x03, '1', '/', 'k'}));
+    EXPECT_EQ(json_client.receive_exactly(5), (std::vector<uint8_t>{0x81, 0x03, '1', '/', 'k'}));
+    EXPECT_EQ(default_client.receive_exactly(5), (std::vector<uint8_t>{0x81, 0x03, '1', '/', 'k'}));
+
+    server.shutdown();
+}
+
+TEST_P(WebSocketServerTest, QueriesAreAnsweredByTheQueryFunction) {
+    ConnectionSettings settings;
+    settings.query_function = [](const SubscriptionCommand& command) -> ErrorOr<std::string> {
+        if (command.step > 1000ms) {
+            return {Error::from_string("step too coarse")};
+        }
+        return fmt::format("history of {} at {}", command.topic, command.step.count());
+    };
+    auto server = MUST(WebSocketServer::create(TEST_PORT, "127.0.0.1", 1, GetParam(), settings));
+
+    TestClient client;
+    ASSERT_TRUE(client.upgrade());
+    auto expect_text = [&client](std::string_view text) {
+        auto frame = client.receive_exactly(2 + text.size());
+        ASSERT_EQ(frame.size(), 2 + text.size());
+        EXPECT_EQ(std::string_view(reinterpret_cast<const char*>(frame.data()) + 2, text.size()), text);
+    };
+    ASSERT_TRUE(client.send_text("history mem 500"));
+    expect_text(fmt::format("history of {} at 500", static_cast<int>(metrics::Topic::MEMORY)));
+    ASSERT_TRUE(client.send_text("history mem 60000"));
+    expect_text(R"({"error":"step too coarse"})");
+
+    server.shutdown();
+}
+
+TEST_P(WebSocketServerTest, SlowQueriesHoldUpNoOtherConnection) {
+    std::atomic<bool> answer_now{false};
+    ConnectionSettings settings;
+    settings.query_function = [&answer_now](const SubscriptionCommand&) -> ErrorOr<std::string> {
+        while (!answer_now.load()) {
+            std::this_thread::sleep_for(1ms);
+        }
+        return std::string("done");
+    };
+    auto server = MUST(WebSocketServer::create(TEST_PORT, "127.0.0.1", 1, GetParam(), settings));
+
+    TestClient querying;
+    ASSERT_TRUE(querying.upgrade());
+    ASSERT_TRUE(querying.send_text("history mem 500"));
+    std::this_thread::sleep_for(50ms);
+
+    // the shard keeps serving while the query is being answered
+    TestClient other;
+    EXPECT_TRUE(other.upgrade());
+    server.broadcast(Opcode::TEXT, std::vector<uint8_t>{'m'});
+    EXPECT_EQ(other.receive_exactly(3), (std::vector<uint8_t>{0x81, 0x01, 'm'}));
+
+    answer_now = true;
+    EXPECT_EQ(querying.receive_exactly(3), (std::vector<uint8_t>{0x81, 0x01, 'm'}));
+    EXPECT_EQ(querying.receive_exactly(6), (std::vector<uint8_t>{0x81, 0x04, 'd', 'o', 'n', 'e'}));
+
+    server.shutdown();
+}
+
+TEST_P(WebSocketServerTest, LargeAnswersArriveWhole) {
+    std::string answer(100000, ' ');
+    for (size_t i = 0; i < answer.size(); ++i) {
+        answer[i] = static_cast<char>('a' + i % 26);
+    }
+    ConnectionSettings settings;
+    settings.query_function = [&answer](const SubscriptionCommand&) -> ErrorOr<std::string> { return answer; };
+    auto server = MUST(WebSocketServer::create(TEST_PORT, "127.0.0.1", 1, GetParam(), settings));
+
+    TestClient client;
+    ASSERT_TRUE(client.upgrade());
+    ASSERT_TRUE(client.send_text("history mem 500"));
+    // sent as a chain of chunks, received as one frame with a 64-bit length
+    auto frame = client.receive_exactly(10 + answer.size());
+    ASSERT_EQ(frame.size(), 10 + answer.size());
+    EXPECT_EQ(frame[0], 0x81);
+    EXPECT_EQ(frame[1], 127);
+    EXPECT_EQ(std::string_view(reinterpret_cast<const char*>(frame.data()) + 10, answer.size()), answer);
+
+    server.shutdown();
+}
+
+TEST_P(WebSocketServerTest, LongHandshakeRequestsAreAcceptedUpToTheLimit) {
+    auto server = MUST(WebSocketServer::create(TEST_PORT, "127.0.0.1", 1, GetParam()));
+
+    TestClient accepted;
+    auto cookie = fmt::format("Cookie: {}\r\n", std::string(handshake::MAX_REQUEST_SIZE - 400, 'c'));
+    EXPECT_TRUE(accepted.upgrade({}, cookie));
+
+    TestClient rejected;
+    cookie = fmt::format("Cookie: {}\r\n", std::string(handshake::MAX_REQUEST_SIZE, 'c'));
+    EXPECT_FALSE(rejected.upgrade({}, cookie));
+    EXPECT_TRUE(rejected.handshake_response().starts_with("HTTP/1.1 431")) << rejected.handshake_response();
+
+    server.shutdown();
+}
+
+TEST_P(WebSocketServerTest, FramesBehindALongHandshakeRequestAreNotCountedAgainstTheLimit) {
+    auto server = MUST(WebSocketServer::create(TEST_PORT, "127.0.0.1", 1, GetParam()));
+    auto memory = static_cast<TopicId>(metrics::Topic::MEMORY);
+
+    // the request leaves room for only part of the frame behind it
+    auto request_size = TestClient::handshake_request({}, "Cookie: \r\n").size();
+    auto cookie = fmt::format("Cookie: {}\r\n", std::string(handshake::MAX_REQUEST_SIZE - request_size - 4, 'c'));
+    TestClient client;
+    ASSERT_TRUE(client.upgrade({}, cookie, TestClient::text_frame("subscribe mem 200")))
+        << client.handshake_response();
+    for (int i = 0; i < 100 && server.topic_interval(memory) != 200ms; ++i) {
+        std::this_thread::sleep_for(10ms);
+    }
+    EXPECT_EQ(server.topic_interval(memory), 200ms);
+
+    server.shutdown();
+}
+
+TEST_P(WebSocketServerTest, AcceptingResumesOnceDescriptorsAreAvailable) {
+    auto server = MUST(WebSocketServer::create(TEST_PORT, "127.0.0.1", 1, GetParam()));
+
+    // use up every descriptor but the one the client takes, so that the
+    // server's accept fails with EMFILE
+    rlimit original_limit{};
+    ASSERT_EQ(::getrlimit(RLIMIT_NOFILE, &original_limit), 0);
+    rlimit lowered_limit = original_limit;
+    lowered_limit.rlim_cur = std::min<rlim_t>(original_limit.rlim_cur, 512);
+    ASSERT_EQ(::setrlimit(RLIMIT_NOFILE, &lowered_limit), 0);
+    std::vector<int> descriptors;
+    for (int fd = ::open("/dev/null", O_RDONLY); fd >= 0; fd = ::open("/dev/null", O_RDONLY)) {
+        descriptors.push_back(fd);
+    }
+    ASSERT_FALSE(descriptors.empty());
+    ::close(descriptors.back());
+    descriptors.pop_back();
+    TestClient client;
+    std::this_thread::sleep_for(50ms);
+    for (auto fd : descriptors) {
+        ::close(fd);
+    }
+    ASSERT_EQ(::setrlimit(RLIMIT_NOFILE, &original_limit), 0);
+
+    // the connection waiting in the backlog raises no new event
+    EXPECT_TRUE(client.upgrade());
+    EXPECT_EQ(server.connection_counts(), std::vector<size_t>{1});
+
+    server.shutdown();
+}
+
+TEST_P(WebSocketServerTest, StalledHandshakeIsDropped) {
+    ConnectionSettings settings;
+    settings.timeouts.handshake_timeout = 50ms;
+    auto server = MUST(WebSocketServer::create(TEST_PORT, "127.0.0.1", 1, GetParam(), settings));
+
+    TestClient client;
+    auto started_at = std::chrono::steady_clock::now();
+    EXPECT_TRUE(client.receive_exactly(1).empty());
+    EXPECT_LT(std::chrono::steady_clock::now() - started_at, 500ms);
+
+    server.shutdown();
+}
+
+TEST_P(WebSocketServerTest, UnansweredPingClosesConnection) {
+    ConnectionSettings settings;
+    settings.timeouts.ping_interval = 50ms;
+    settings.timeouts.pong_timeout = 50ms;
+    auto server = MUST(WebSocketServer::create(TEST_PORT, "127.0.0.1", 1, GetParam(), settings));
+
+    TestClient client;
+    ASSERT_TRUE(client.upgrade());
+    EXPECT_EQ(client.receive_exactly(2), (std::vector<uint8_t>{0x89, 0x00}));
+    EXPECT_TRUE(client.receive_exactly(1).empty());
+
+    server.shutdown();
+}
+
+INSTANTIATE_TEST_SUITE_P(IoBackends,
+                         WebSocketServerTest,
+                         ::testing::Values(IoBackend::EPOLL, IoBackend::IO_URING),
+                         [](const auto& info) { return std::string(format_io_backend(info.param)); });